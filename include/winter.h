@@ -23,4 +23,355 @@ typedef struct winterState_t winterState_t;
 winterState_t *winterCreateState(winterAlloc_t allocator);
 void           winterFreeState(winterState_t *state);
 
+//Cycle collector
+//Reference counting alone can't free tables that reference themselves, so tables whose
+//count drops to nonzero are buffered and checked for garbage cycles in bounded slices. A slice
+//takes roots until it has traced its budget of objects, everything a root reaches counts
+void   winterCollect(winterState_t *state);                          //processes every buffered root
+size_t winterCollectStep(winterState_t *state);                      //processes one slice, returns roots left
+void   winterSetCollectBudget(winterState_t *state, size_t objects); //objects per slice, 0 for default
+
+//Pool allocator statistics
+//Small objects are carved from pages of large blocks requested from the allocator
+typedef struct winterPoolStats_t {
+	size_t blocks;        //blocks held from the allocator
+	size_t pages;         //pages in those blocks
+	size_t freePages;     //pages not assigned to a size class
+	size_t slots;         //object slots in assigned pages
+	size_t usedSlots;     //slots holding live objects
+	size_t usedBytes;     //bytes in those slots
+	size_t largeAllocs;   //live objects too big for the pool
+	size_t hostCalls;     //calls made to the allocator
+	double fragmentation; //share of assigned page memory not in use
+} winterPoolStats_t;
+void winterGetPoolStats(winterState_t *state, winterPoolStats_t *stats);
+
+//Memory accounting
+typedef struct winterMemoryStats_t {
+	size_t bytes; //bytes held by live allocations
+	size_t peak;  //highest value 'bytes' reached
+	size_t limit; //0 when unlimited
+	
+	//Live objects by type
+	size_t strings;
+	size_t tables;
+	size_t errors;
+	size_t functions;
+	size_t arrays;
+	size_t nodes; //syntax tree nodes
+} winterMemoryStats_t;
+void winterGetMemoryStats(winterState_t *state, winterMemoryStats_t *stats);
+//Allocating past the limit raises an "out of memory" error in the running script
+void winterSetMemoryLimit(winterState_t *state, size_t bytes);
+
+//Heap snapshot
+//Streams every value reachable from the globals, the stack, suspended coroutines and
+//pending event loop tasks as a graph of nodes and edges, summarize it with
+//tools/heapsummary.c. Returns the writer's first nonzero result, or -1 if there was no
+//memory to keep track of the shared values written
+typedef int (*winterWriter_t)(void *user, const void *data, size_t size);
+int winterHeapSnapshot(winterState_t *state, winterWriter_t writer, void *user);
+
+//Values
+//Strings are bytes. Scripts index the ones that are valid UTF-8 by codepoint from 0, getting
+//a string of one codepoint back, and others by byte
+//Hosts can declare values, e.g. arrays of arguments for winterCall, and copy them. Set them
+//with the functions below and read them with winterTypeOf and the winterTo functions, the
+//fields are internal
+typedef struct object_t {
+	int type; //winterType_t or an internal type
+	union {
+		winterInt_t       integer;
+		winterFloat_t     floating;
+		void             *pointer;
+		struct wstring_t *string;
+	};
+} winterValue_t;
+typedef enum winterType_t {
+	WINTER_NULL = 2,
+	WINTER_INT,
+	WINTER_FLOAT,
+	WINTER_STRING,
+	WINTER_TABLE,
+	WINTER_FUNCTION,
+	WINTER_ERROR,
+	WINTER_ARRAY = 11
+} winterType_t;
+winterType_t  winterTypeOf(const winterValue_t *value);
+winterInt_t   winterToInt(const winterValue_t *value);                    //numbers are converted
+winterFloat_t winterToFloat(const winterValue_t *value);
+const char   *winterToString(const winterValue_t *value, size_t *length); //NULL if not a string
+void winterSetNull(winterValue_t *value);
+void winterSetInt(winterValue_t *value, winterInt_t integer);
+void winterSetFloat(winterValue_t *value, winterFloat_t floating);
+void winterSetString(winterState_t *state, winterValue_t *value, const char *string, size_t length);
+void winterSetError(winterState_t *state, winterValue_t *value, const char *format, ...);
+
+//Tables
+//Tables whose keys are all strings share their layout with others that have the same keys,
+//and scripts read their fields through inline caches, so prefer string keys for records
+void winterSetTable(winterState_t *state, winterValue_t *value);
+//Returns -1 if the value isn't a table or is frozen
+int  winterTableSet(winterState_t *state, winterValue_t *table, const winterValue_t *key, const winterValue_t *value);
+//Returns NULL if the key isn't in the table or the value isn't a table
+//The pointer is only valid until the table is changed
+const winterValue_t *winterTableGet(const winterValue_t *table, const winterValue_t *key);
+//Replaces the value with a read only copy of it and everything it reaches, allocated in one
+//block with the state's allocator, which must then be thread-safe. Any number of states can
+//read a frozen table at the same time from any thread without locking, and its keys are
+//hashed up front so lookups are faster than in tables. Scripts see frozen tables as tables
+//and raise an error when modifying them. The block is held by the state and by every state
+//the value is passed to with winterCall, winterTableSet, winterSubmit or a channel, until
+//they're freed. Returns -1 if a function or an array is reached or the allocator fails
+int winterFreeze(winterState_t *state, winterValue_t *value);
+int winterIsFrozen(const winterValue_t *value);
+
+//Arrays
+//Typed numeric arrays hold float64, int64, float32 or int32 elements unboxed, scripts index
+//them like tables from 0 and get ints or floats back. Opening them registers these globals
+//
+//  array(kind, length)    returns an array of zeros, 'kind' is "float64", "int64", "float32" or "int32"
+//  length(a)              returns the number of elements, or the codepoints of a string
+//  slice(a, start, stop[, step])
+//                         returns a view sharing the elements from start to before stop
+//  copy(a[, kind])        returns a contiguous copy, converting the elements to 'kind'
+//  fill(a, value)         sets every element, returns the array
+//  vadd(a, b[, out])      returns a + b element by element, b can be a number, 'out' is
+//                         written instead of a new array. vsub, vmul and vdiv are the same
+//  min(a), max(a)         return the smallest or largest element, with two arrays or an array
+//                         and a number they work like vadd
+//  sum(a), dot(a, b)      return the sum of the elements or of their products
+//  compare(a, op, b)      returns an int32 mask of 1 where a op b holds and 0 elsewhere, 'op'
+//                         is "==", "!=", "<", "<=", ">" or ">="
+//  gather(a, indices)     returns the elements at the indices of an int64 or int32 array
+//  scatter(a, indices, values)
+//                         sets the elements at the indices to 'values', an array or a number
+//  sort(a[, fn])          sorts in place and returns 'a', which can also be a table with the keys
+//                         0 to n-1 holding numbers or strings. fn(x, y) returns true if x goes
+//                         before y, with it any values can be sorted and equal ones keep their order
+//  parallelmap(a, fn[, out[, extra]])
+//                         sets out[i] to fn(a[i]) or fn(a[i], extra) on worker threads, returns
+//                         'out' or a new array like 'a'
+//  parallelreduce(a, fn, init[, extra])
+//                         folds ranges with acc = fn(acc, a[i]) from 'init' on worker threads and
+//                         then the ranges in order, so 'fn' must be associative
+//
+//The callbacks of parallelmap and parallelreduce can't capture variables, 'extra' must be
+//null, a number or a frozen table, and they run in worker states with the arrays open and
+//their own globals, see winterSetWorkers
+//Mixed kinds are worked out in int64 unless one is a float, which makes them float64, and
+//vdiv always returns floats. The loops use AVX2 on x86-64 CPUs that have it. Arrays can't
+//be frozen, sent, saved in images or passed to other threads
+void winterOpenArrays(winterState_t *state);
+typedef enum winterArrayType_t {
+	WINTER_FLOAT64,
+	WINTER_INT64,
+	WINTER_FLOAT32,
+	WINTER_INT32
+} winterArrayType_t;
+enum { WINTER_READ_ONLY = 1 };
+typedef void (*winterRelease_t)(void *user, void *data);
+//Sets the value to an array of 'length' elements read and written in place at 'data', which
+//must stay valid until 'release' is called with 'user' and 'data'. That happens once the
+//array and every slice of it are freed, at the latest in winterFreeState, and 'release'
+//may be NULL. Scripts raise an error when writing to an array made with WINTER_READ_ONLY.
+//Returns -1 without calling 'release' if 'data' isn't aligned to the element size
+int winterSetArray(winterState_t *state, winterValue_t *value, winterArrayType_t type, void *data, size_t length,
+				   int flags, winterRelease_t release, void *user);
+//Returns the first element and sets the type, length and stride in elements of the array,
+//any of which may be NULL. Returns NULL if the value isn't an array
+void *winterToArray(const winterValue_t *value, winterArrayType_t *type, size_t *length, ptrdiff_t *stride);
+
+//JSON
+//Opening it registers jsondecode(s), which returns the value of the JSON text 's', and
+//jsonencode(v), which returns 'v' as JSON text. Objects decode to tables and arrays to
+//tables with the keys 0 to n-1, true and false to 1 and 0. Tables with the keys 0 to n-1,
+//frozen ones too, and typed arrays encode as arrays, other tables as objects with string
+//or int keys. Empty tables encode as {}, except ones decoded from [] that aren't frozen.
+//Floats keep a fraction or an exponent so they decode as floats again, NaN and the
+//infinities encode as null. Strings are copied as bytes, escapes decode to UTF-8
+void winterOpenJson(winterState_t *state);
+//Returns the value or an error, see winterRun
+const winterValue_t *winterDecodeJson(winterState_t *state, const char *json, size_t length);
+//Returns 0 on success, the writer's first nonzero result, or -1 if the value can't be encoded
+int winterEncodeJson(winterState_t *state, const winterValue_t *value, winterWriter_t writer, void *user);
+
+//Packing
+//A compact binary form of values for caching them or passing them to other processes on
+//the same kind of machine. Tables, strings and arrays reached more than once are written
+//once and referred to after, so shared parts and cycles decode as they were. Frozen tables
+//decode as tables. Opening it registers pack(v), which returns the binary form as a string,
+//and unpack(s)
+void winterOpenPack(winterState_t *state);
+//Writes at most 'size' bytes of the value to 'buffer' and returns the size of all of it, so
+//a larger result means the buffer was too small. Returns 0 if it can't be encoded
+size_t winterEncodeValue(winterState_t *state, const winterValue_t *value, void *buffer, size_t size);
+enum { WINTER_BORROW = 1 };
+//Returns the value or an error, see winterRun. With WINTER_BORROW strings point into
+//'data', which must then stay unchanged until the state is freed
+const winterValue_t *winterDecodeValue(winterState_t *state, const void *data, size_t size, int flags);
+
+//Regular expressions
+//Patterns match bytes and take time linear in the subject, there's no backtracking. They
+//have . [] [^] \d \w \s and their negations, ^ and $ for the start and end of the subject,
+//groups, (?:) groups that don't capture, | and the repeats * + ? {n} {n,} {n,m}, lazy with
+//a ? after. Opening it registers match(pattern, s[, start]), which returns an int array of
+//the byte offsets of the start and end of the leftmost match and of each group, -1 for
+//groups that took no part, or null. matches(pattern, s[, start]) returns 1 or 0 and is
+//faster when the groups aren't needed, and substr(s, from[, to]) copies out the bytes of a
+//span. Compiled patterns are cached by the state
+void winterOpenRegex(winterState_t *state);
+
+//Native functions
+//The arguments are a contiguous slice of the caller's registers with room for at least
+//one value, results are written over them starting at args[0]. Returns the number of
+//results, returning an error value raises it in the script
+typedef int (*winterCFunction_t)(winterState_t *state, winterValue_t *args, int argc);
+//Sets the global 'name' to the function, calls are checked against 'arity' unless it is -1
+void winterRegister(winterState_t *state, const char *name, winterCFunction_t function, int arity);
+
+//Chunks
+//A chunk is a compiled script that can be run any number of times until it is freed, which
+//must happen before the state is freed. Binary chunks load without lexing or compiling.
+//Loading functions return NULL and copy a message into 'error' (unless it's NULL) on failure
+typedef struct proto_t winterChunk_t;
+winterChunk_t *winterLoadString(winterState_t *state, const char *source, char *error, size_t errorSize);
+winterChunk_t *winterLoadChunk(winterState_t *state, const void *data, size_t size, char *error, size_t errorSize);
+//Maps a binary chunk file into memory, its code is used in place
+winterChunk_t *winterMapChunk(winterState_t *state, const char *path, char *error, size_t errorSize);
+//Maps the binary chunk of the source from the cache directory, or compiles the source and
+//stores its chunk there. Entries are named by a hash of the source and keep the source, an
+//entry is only used if it holds the same text
+winterChunk_t *winterLoadCached(winterState_t *state, const char *source, const char *cacheDir, char *error, size_t errorSize);
+//Writes the binary form of the chunk, 'strip' leaves out the line table
+int  winterDumpChunk(winterState_t *state, winterChunk_t *chunk, int strip, winterWriter_t writer, void *user);
+void winterFreeChunk(winterState_t *state, winterChunk_t *chunk);
+//Returns an immutable copy of the chunk that any number of states can run at the same time,
+//from any thread. It's allocated in one block with the state's allocator, which must then
+//be thread-safe, and isn't counted against any state's memory. Each reference is released
+//with winterFreeChunk by any state, and a state holds one for each shared chunk it has run
+//until it's freed since its values may point into the chunk. Returns NULL if the allocator fails
+winterChunk_t *winterShareChunk(winterState_t *state, winterChunk_t *chunk);
+//Adds a reference to a shared chunk, for handing it to another thread
+winterChunk_t *winterRetainChunk(winterChunk_t *chunk);
+//Errors are returned as the result, which stays valid until the state is used again
+//Not to be called from native functions
+const winterValue_t *winterRun(winterState_t *state, winterChunk_t *chunk);
+//Calls the global function 'name', see winterRun. The arguments can't be results of the state
+const winterValue_t *winterCall(winterState_t *state, const char *name, const winterValue_t *args, int argc);
+
+//Coroutines
+//A coroutine is a call with its own stack of frames on the heap, which suspends itself with
+//yield(value) and carries on when the host resumes it. No native stack is kept while it
+//waits, so a state can hold thousands of them, e.g. one per request waiting on I/O. yield
+//can't suspend across a native call. Coroutines must be freed before the state is freed
+typedef struct coroutine_t winterCoroutine_t;
+typedef enum winterCoroutineStatus_t {
+	WINTER_SUSPENDED, //not started yet or waiting in yield
+	WINTER_FINISHED   //returned or raised an error
+} winterCoroutineStatus_t;
+//Creates a suspended call of the global function 'name', see winterCall. Returns NULL when
+//out of memory
+winterCoroutine_t *winterCreateCoroutine(winterState_t *state, const char *name, const winterValue_t *args, int argc);
+//Runs the coroutine until it yields or finishes, returning the value it yielded or its
+//result. The yield it's suspended in returns 'value', which is ignored when it starts and
+//may be NULL for null. It can only be called from the host, not from inside a native. See
+//winterRun
+const winterValue_t *winterResume(winterState_t *state, winterCoroutine_t *coroutine, const winterValue_t *value);
+winterCoroutineStatus_t winterCoroutineStatus(const winterCoroutine_t *coroutine);
+void winterFreeCoroutine(winterState_t *state, winterCoroutine_t *coroutine);
+
+//JIT
+//Builds with WINTER_JIT compile functions that are called often to x86-64 machine code,
+//which hands anything it doesn't cover back to the interpreter. It's on by default, turning
+//it off runs every function in the interpreter again
+void winterSetJit(winterState_t *state, int enabled);
+
+//Heap images
+//An image holds the globals and everything they reference, loading one into a fresh state
+//skips running the script that set them up. Native functions are saved by the name they
+//were registered under and must be registered again before loading. Saving fails while
+//a script is running or if a frozen table or an array is reachable. Both return 0 on success
+int winterSaveImage(winterState_t *state, winterWriter_t writer, void *user);
+//Globals in the image replace those of the same name, a failed load sets none of them.
+//Prototype code is used in place
+int winterLoadImage(winterState_t *state, const void *data, size_t size, char *error, size_t errorSize);
+int winterMapImage(winterState_t *state, const char *path, char *error, size_t errorSize);
+
+//Executor
+//Runs jobs on a pool of worker threads that each have their own state. Jobs are shared
+//out in batches and idle workers steal from busy ones, so the load spreads over every core
+typedef struct executor_t winterExecutor_t;
+//Prepares a worker's state, e.g. registering native functions. Called before creation returns
+typedef void (*winterWorkerInit_t)(void *user, winterState_t *state);
+//Called on the worker thread when a job finishes, the result is only valid during the call
+typedef void (*winterJobDone_t)(void *user, winterState_t *state, const winterValue_t *result);
+//Starts one worker per core when 'numWorkers' is 0. The allocator must be thread-safe
+winterExecutor_t *winterCreateExecutor(winterAlloc_t allocator, int numWorkers, winterWorkerInit_t init, void *user);
+//Queues a call of the global function 'name' with up to 16 arguments that are null, numbers
+//or frozen tables. The chunk must be shared, it's run once in a worker's state before its
+//first call there. When 'name' is NULL the job runs the chunk itself every time. Returns 0 on success
+int  winterSubmit(winterExecutor_t *executor, winterChunk_t *chunk, const char *name, const winterValue_t *args, int argc,
+				  winterJobDone_t done, void *user);
+//Blocks until every submitted job has finished
+void winterWait(winterExecutor_t *executor);
+//Waits for the jobs, then stops the workers and frees their states
+void winterFreeExecutor(winterExecutor_t *executor);
+//Sets the workers parallelmap and parallelreduce start on first use, one per core when
+//'numWorkers' is 0, 'init' is called on each worker after the arrays are opened. Stops the
+//current ones. The state's allocator must be thread-safe once they run
+void winterSetWorkers(winterState_t *state, int numWorkers, winterWorkerInit_t init, void *user);
+
+//Channels
+//Bounded queues that pass values between states, usually on different threads. Sending
+//copies the value and every table it reaches into one message and receiving builds it in
+//the receiving state in one pass. Frozen tables aren't copied and functions and arrays
+//can't be sent. Neither call blocks
+typedef struct channel_t winterChannel_t;
+typedef enum winterChannelFlags_t {
+	WINTER_SINGLE_PRODUCER = 1, //only one thread sends at a time
+	WINTER_SINGLE_CONSUMER = 2  //only one thread receives at a time
+} winterChannelFlags_t;
+//The capacity is rounded up to a power of two. The allocator must be thread-safe
+winterChannel_t *winterCreateChannel(winterAlloc_t allocator, size_t capacity, int flags);
+//Frees the messages still queued
+void winterFreeChannel(winterChannel_t *channel);
+//Returns 0 on success, 1 if the channel is full and -1 if the value can't be sent
+int  winterSend(winterState_t *state, winterChannel_t *channel, const winterValue_t *value);
+//Returns NULL if the channel is empty, see winterRun
+const winterValue_t *winterReceive(winterState_t *state, winterChannel_t *channel);
+
+//Event loop
+//Runs coroutines on one thread with Linux epoll, resuming each when what it waits on is
+//ready. Only built with WINTER_EVENT_LOOP. Creating a loop registers these globals
+//
+//  read(fd, size)         waits for data, returns a new string of at most 'size' bytes and
+//                         64 KiB, which is empty at the end of the stream
+//  write(fd, string)      waits until all of the string is written, returns its length
+//  accept(fd)             waits for a connection on a listening socket, returns its descriptor
+//  connect(address, port) connects to an IPv4 address, returns the socket's descriptor
+//  sleep(ms)              waits for the milliseconds to pass
+//  spawn(name, ...)       starts a coroutine calling the global function 'name'
+//  after(ms, name, ...)   like spawn, once the milliseconds pass
+//  listen(port)           returns a listening socket, port 0 picks a free one
+//  port(fd)               returns the port a socket is bound to
+//  pipe()                 returns a table with the read end at 0 and the write end at 1
+//  close(fd)              coroutines waiting on the descriptor raise an error
+//  now()                  returns monotonic time in milliseconds
+//
+//The first five suspend the calling coroutine, and all of them raise errors. Descriptors
+//are made non-blocking when they're first waited on. A descriptor has at most one reader
+//and one writer waiting at a time
+typedef struct loop_t winterLoop_t;
+//'done' is called with the results of coroutines started by spawn and after, and may be NULL.
+//Returns NULL if the state already has a loop or epoll can't be set up
+winterLoop_t *winterCreateLoop(winterState_t *state, winterJobDone_t done, void *user);
+//Queues a coroutine calling the global function 'name', see winterCreateCoroutine. 'done'
+//is called with its result when it finishes and may be NULL. Returns 0 on success
+int  winterSpawn(winterLoop_t *loop, const char *name, const winterValue_t *args, int argc, winterJobDone_t done, void *user);
+//Runs until every coroutine has finished. Returns 0, or -1 if waiting for events fails
+int  winterRunLoop(winterLoop_t *loop);
+//Frees the coroutines that haven't finished, must be called before the state is freed
+void winterFreeLoop(winterLoop_t *loop);
+
 #endif
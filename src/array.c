@@ -0,0 +1,537 @@
+#include "array.h"
+#include "kernel.h"
+#include "parallel.h"
+#include "sort.h"
+#include "gc.h"
+#include "wstring.h"
+#include "winter.h"
+#include <string.h>
+#include <stdint.h>
+
+static const char *kindNames[] = { "float64", "int64", "float32", "int32" };
+
+array_t *_winter_arrayAlloc(winterState_t *state, arrayType_t kind, size_t length) {
+	size_t bytes = _winter_arrayWidth(kind) * length;
+	array_t *out = MALLOC(sizeof(array_t) + bytes);
+	out->_refcount = 0;
+	out->_zct      = false;
+	out->_type     = TYPE_ARRAY;
+	out->_mark     = false;
+	out->kind      = kind;
+	out->readOnly  = false;
+	out->length    = length;
+	out->stride    = 1;
+	out->data      = (unsigned char*)(out + 1);
+	out->base      = NULL;
+	out->release   = NULL;
+	out->user      = NULL;
+	memset(out->data, 0, bytes);
+	state->memory.arrays++;
+	_winter_zctPush(state, TYPE_ARRAY, out);
+	return out;
+}
+
+array_t *_winter_arrayView(winterState_t *state, array_t *array, size_t start, size_t length, ptrdiff_t step) {
+	array_t *out = MALLOC(sizeof(array_t));
+	out->_refcount = 0;
+	out->_zct      = false;
+	out->_type     = TYPE_ARRAY;
+	out->_mark     = false;
+	out->kind      = array->kind;
+	out->readOnly  = array->readOnly;
+	out->length    = length;
+	out->stride    = array->stride * step;
+	out->data      = length > 0 ? _winter_arrayAt(array, start) : array->data;
+	out->base      = array->base != NULL ? array->base : array;
+	out->release   = NULL;
+	out->user      = NULL;
+	_winter_objectAddRef(state, &(object_t){ TYPE_ARRAY, { .pointer = out->base } });
+	state->memory.arrays++;
+	_winter_zctPush(state, TYPE_ARRAY, out);
+	return out;
+}
+
+void _winter_arrayFree(winterState_t *state, array_t *array) {
+	if (array->base != NULL) {
+		_winter_objectDelRef(state, &(object_t){ TYPE_ARRAY, { .pointer = array->base } });
+	} else if (array->release != NULL) {
+		array->release(array->user, array->data);
+	}
+	state->memory.arrays--;
+	FREE(array);
+}
+
+//Out of range floats saturate and NaN becomes 0
+static inline int64_t floatToInt64(double value) {
+	if (value != value) return 0;
+	if (value >= 9223372036854775807.0) return INT64_MAX;
+	if (value <= -9223372036854775808.0) return INT64_MIN;
+	return (int64_t)value;
+}
+static inline int32_t floatToInt32(double value) {
+	if (value != value) return 0;
+	if (value >= 2147483647.0) return INT32_MAX;
+	if (value <= -2147483648.0) return INT32_MIN;
+	return (int32_t)value;
+}
+
+object_t _winter_arrayGet(const array_t *array, size_t index) {
+	const void *p = _winter_arrayAt(array, index);
+	switch ((arrayType_t)array->kind) {
+		case ARRAY_FLOAT64: return (object_t){ TYPE_FLOAT, { .floating = *(const double*)p } };
+		case ARRAY_FLOAT32: return (object_t){ TYPE_FLOAT, { .floating = *(const float*)p } };
+		case ARRAY_INT64:   return (object_t){ TYPE_INT,   { .integer  = *(const int64_t*)p } };
+		default:            return (object_t){ TYPE_INT,   { .integer  = *(const int32_t*)p } };
+	}
+}
+
+//Writes the number as one element of 'kind'
+static bool_t store(void *p, arrayType_t kind, const object_t *value) {
+	if (value->type == TYPE_INT) {
+		switch (kind) {
+			case ARRAY_FLOAT64: *(double*)p  = (double)value->integer; break;
+			case ARRAY_FLOAT32: *(float*)p   = (float)value->integer; break;
+			case ARRAY_INT64:   *(int64_t*)p = value->integer; break;
+			case ARRAY_INT32:   *(int32_t*)p = (int32_t)value->integer; break;
+		}
+	} else if (value->type == TYPE_FLOAT) {
+		switch (kind) {
+			case ARRAY_FLOAT64: *(double*)p  = value->floating; break;
+			case ARRAY_FLOAT32: *(float*)p   = (float)value->floating; break;
+			case ARRAY_INT64:   *(int64_t*)p = floatToInt64(value->floating); break;
+			case ARRAY_INT32:   *(int32_t*)p = floatToInt32(value->floating); break;
+		}
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool_t _winter_arraySet(array_t *array, size_t index, const object_t *value) {
+	return store(_winter_arrayAt(array, index), array->kind, value);
+}
+
+//Operands
+
+#define CONVERT(S, out, kind, src) do {                                                   \
+	const unsigned char *p = (src)->data;                                                 \
+	ptrdiff_t step = (src)->stride * (ptrdiff_t)sizeof(S);                                \
+	size_t n = (src)->length;                                                             \
+	switch (kind) {                                                                       \
+		case ARRAY_FLOAT64: for (size_t i = 0; i < n; i++, p += step) ((double*)out)[i]  = (double)*(const S*)p; break; \
+		case ARRAY_FLOAT32: for (size_t i = 0; i < n; i++, p += step) ((float*)out)[i]   = (float)*(const S*)p; break; \
+		case ARRAY_INT64:   for (size_t i = 0; i < n; i++, p += step) ((int64_t*)out)[i] = TO_INT64(*(const S*)p); break; \
+		case ARRAY_INT32:   for (size_t i = 0; i < n; i++, p += step) ((int32_t*)out)[i] = TO_INT32(*(const S*)p); break; \
+	}                                                                                     \
+} while (0)
+
+//Copies the elements of 'src' into 'out' as a contiguous buffer of 'kind'
+static void convert(void *out, arrayType_t kind, const array_t *src) {
+	switch ((arrayType_t)src->kind) {
+#define TO_INT64(v) floatToInt64(v)
+#define TO_INT32(v) floatToInt32(v)
+		case ARRAY_FLOAT64: CONVERT(double, out, kind, src); break;
+		case ARRAY_FLOAT32: CONVERT(float,  out, kind, src); break;
+#undef TO_INT64
+#undef TO_INT32
+#define TO_INT64(v) ((int64_t)(v))
+#define TO_INT32(v) ((int32_t)(v))
+		case ARRAY_INT64:   CONVERT(int64_t, out, kind, src); break;
+		case ARRAY_INT32:   CONVERT(int32_t, out, kind, src); break;
+#undef TO_INT64
+#undef TO_INT32
+	}
+}
+
+//Kernels take contiguous buffers of one kind, other arrays are copied into scratch memory
+static inline bool_t needsCopy(const array_t *array, arrayType_t kind) {
+	return array->kind != kind || !_winter_arrayContiguous(array);
+}
+static inline size_t scratchSize(const array_t *array, arrayType_t kind) {
+	return needsCopy(array, kind) ? array->length * _winter_arrayWidth(kind) : 0;
+}
+static inline const void *contiguous(const array_t *array, arrayType_t kind, unsigned char *scratch) {
+	if (!needsCopy(array, kind)) {
+		return array->data;
+	}
+	convert(scratch, kind, array);
+	return scratch;
+}
+
+static inline arrayType_t promote(arrayType_t a, arrayType_t b) {
+	if (a == b) return a;
+	return isFloatArray(a) || isFloatArray(b) ? ARRAY_FLOAT64 : ARRAY_INT64;
+}
+
+static inline array_t *toArray(const object_t *value) {
+	return value->type == TYPE_ARRAY ? value->pointer : NULL;
+}
+static inline bool_t isScalar(const object_t *value) {
+	return value->type == TYPE_INT || value->type == TYPE_FLOAT;
+}
+
+static bool_t parseKind(const object_t *value, arrayType_t *kind) {
+	if (value->type != TYPE_STRING) return false;
+	for (int i = 0; i < 4; i++) {
+		if (strcmp(value->string->data, kindNames[i]) == 0) {
+			*kind = (arrayType_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//Natives
+
+//array(kind, length) returns an array of zeros
+static int arrayNew(winterState_t *state, winterValue_t *args, int argc) {
+	arrayType_t kind;
+	if (!parseKind(&args[0], &kind) || args[1].type != TYPE_INT || args[1].integer < 0 ||
+		(uint64_t)args[1].integer > PTRDIFF_MAX / 8) {
+		_winter_objectNewError(state, &args[0], "array expects a kind and a length");
+		return 1;
+	}
+	args[0] = (object_t){ TYPE_ARRAY, { .pointer = _winter_arrayAlloc(state, kind, (size_t)args[1].integer) } };
+	return 1;
+}
+
+static int arrayLength(winterState_t *state, winterValue_t *args, int argc) {
+	if (args[0].type == TYPE_ARRAY) {
+		args[0] = (object_t){ TYPE_INT, { .integer = (winterInt_t)((array_t*)args[0].pointer)->length } };
+	} else if (args[0].type == TYPE_STRING) {
+		args[0] = (object_t){ TYPE_INT, { .integer = (winterInt_t)_winter_stringLength(state, args[0].string) } };
+	} else {
+		_winter_objectNewError(state, &args[0], "length expects an array or a string");
+	}
+	return 1;
+}
+
+//slice(a, start, stop[, step]) returns a view sharing the elements, a negative step goes
+//backwards from start. Bounds are clamped like in Python, but negative ones don't count from the end
+static int arraySlice(winterState_t *state, winterValue_t *args, int argc) {
+	array_t *array = argc > 0 ? toArray(&args[0]) : NULL;
+	winterInt_t step = argc > 3 && args[3].type == TYPE_INT ? args[3].integer : 1;
+	if (array == NULL || argc < 3 || argc > 4 || args[1].type != TYPE_INT || args[2].type != TYPE_INT ||
+		(argc == 4 && args[3].type != TYPE_INT) || step == 0) {
+		_winter_objectNewError(state, &args[0], "slice expects an array, a start, a stop and an optional nonzero step");
+		return 1;
+	}
+	winterInt_t length = (winterInt_t)array->length, start = args[1].integer, stop = args[2].integer, count = 0;
+	if (step > 0) {
+		start = start < 0 ? 0 : start > length ? length : start;
+		stop  = stop  < 0 ? 0 : stop  > length ? length : stop;
+		count = stop > start ? (stop - start - 1) / step + 1 : 0;
+	} else {
+		start = start < -1 ? -1 : start >= length ? length - 1 : start;
+		stop  = stop  < -1 ? -1 : stop  >= length ? length - 1 : stop;
+		count = start > stop ? (start - stop - 1) / -step + 1 : 0;
+	}
+	args[0] = (object_t){ TYPE_ARRAY, { .pointer = _winter_arrayView(state, array, (size_t)start, (size_t)count, step) } };
+	return 1;
+}
+
+//copy(a[, kind]) returns a contiguous copy, converting the elements
+static int arrayCopy(winterState_t *state, winterValue_t *args, int argc) {
+	array_t *array = argc > 0 ? toArray(&args[0]) : NULL;
+	arrayType_t kind = array != NULL ? array->kind : ARRAY_FLOAT64;
+	if (array == NULL || argc < 1 || argc > 2 || (argc == 2 && !parseKind(&args[1], &kind))) {
+		_winter_objectNewError(state, &args[0], "copy expects an array and an optional kind");
+		return 1;
+	}
+	array_t *out = _winter_arrayAlloc(state, kind, array->length);
+	convert(out->data, kind, array);
+	args[0] = (object_t){ TYPE_ARRAY, { .pointer = out } };
+	return 1;
+}
+
+//fill(a, value) sets every element and returns the array
+static int arrayFill(winterState_t *state, winterValue_t *args, int argc) {
+	array_t *array = toArray(&args[0]);
+	unsigned char element[8];
+	if (array == NULL || !store(element, array->kind, &args[1])) {
+		_winter_objectNewError(state, &args[0], "fill expects an array and a number");
+		return 1;
+	} else if (array->readOnly) {
+		_winter_objectNewError(state, &args[0], "attempt to modify a read only array");
+		return 1;
+	}
+	size_t width = _winter_arrayWidth(array->kind);
+	for (size_t i = 0; i < array->length; i++) {
+		memcpy(_winter_arrayAt(array, i), element, width);
+	}
+	return 1;
+}
+
+//Runs an arithmetic kernel over (a, b[, out]), b can be a number
+//Numbers take the kind of the array unless a float meets an integer array
+static int elementwise(winterState_t *state, winterValue_t *args, int argc, kernelOp_t op, const char *name) {
+	array_t *a = argc > 0 ? toArray(&args[0]) : NULL, *b = argc > 1 ? toArray(&args[1]) : NULL, *out = argc > 2 ? toArray(&args[2]) : NULL;
+	if (a == NULL || argc < 2 || argc > 3 || (b == NULL && !isScalar(&args[1])) || (argc == 3 && out == NULL)) {
+		_winter_objectNewError(state, &args[0], "%s expects two arrays or an array and a number, and an optional output array", name);
+		return 1;
+	} else if (b != NULL && b->length != a->length) {
+		_winter_objectNewError(state, &args[0], "%s expects arrays of the same length", name);
+		return 1;
+	}
+	arrayType_t kind = a->kind;
+	if (b != NULL) {
+		kind = promote(a->kind, b->kind);
+	} else if (args[1].type == TYPE_FLOAT && !isFloatArray(kind)) {
+		kind = ARRAY_FLOAT64;
+	}
+	if (op == KERNEL_DIV && !isFloatArray(kind)) {
+		kind = ARRAY_FLOAT64;
+	}
+	if (out != NULL && (out->kind != kind || out->length != a->length || !_winter_arrayContiguous(out))) {
+		_winter_objectNewError(state, &args[0], "%s expects a contiguous %s output array of the same length", name, kindNames[kind]);
+		return 1;
+	} else if (out != NULL && out->readOnly) {
+		_winter_objectNewError(state, &args[0], "attempt to modify a read only array");
+		return 1;
+	} else if (out == NULL) {
+		out = _winter_arrayAlloc(state, kind, a->length);
+	}
+	
+	//Allocated last so raising can't leak it
+	size_t sizeA = scratchSize(a, kind), sizeB = b != NULL ? scratchSize(b, kind) : 0;
+	unsigned char *scratch = sizeA + sizeB > 0 ? MALLOC(sizeA + sizeB) : NULL, number[8];
+	const void *x = contiguous(a, kind, scratch), *y = number;
+	if (b != NULL) {
+		y = contiguous(b, kind, scratch + sizeA);
+	} else {
+		store(number, kind, &args[1]);
+	}
+	_winter_kernelArith(kind, op, out->data, x, y, b == NULL, a->length);
+	if (scratch != NULL) {
+		FREE(scratch);
+	}
+	args[0] = (object_t){ TYPE_ARRAY, { .pointer = out } };
+	return 1;
+}
+
+static int arrayAdd(winterState_t *state, winterValue_t *args, int argc) {
+	return elementwise(state, args, argc, KERNEL_ADD, "vadd");
+}
+static int arraySub(winterState_t *state, winterValue_t *args, int argc) {
+	return elementwise(state, args, argc, KERNEL_SUB, "vsub");
+}
+static int arrayMul(winterState_t *state, winterValue_t *args, int argc) {
+	return elementwise(state, args, argc, KERNEL_MUL, "vmul");
+}
+static int arrayDiv(winterState_t *state, winterValue_t *args, int argc) {
+	return elementwise(state, args, argc, KERNEL_DIV, "vdiv");
+}
+
+//min(a) and max(a) reduce the array, with more arguments they work like vadd
+static int extreme(winterState_t *state, winterValue_t *args, int argc, kernelOp_t op, const char *name) {
+	if (argc != 1) {
+		return elementwise(state, args, argc, op, name);
+	}
+	array_t *array = toArray(&args[0]);
+	if (array == NULL || array->length == 0) {
+		_winter_objectNewError(state, &args[0], "%s expects a nonempty array", name);
+		return 1;
+	}
+	unsigned char *scratch = MALLOC(scratchSize(array, array->kind) + 1);
+	args[0] = _winter_kernelReduce(array->kind, op, contiguous(array, array->kind, scratch), array->length);
+	FREE(scratch);
+	return 1;
+}
+static int arrayMin(winterState_t *state, winterValue_t *args, int argc) {
+	return extreme(state, args, argc, KERNEL_MIN, "min");
+}
+static int arrayMax(winterState_t *state, winterValue_t *args, int argc) {
+	return extreme(state, args, argc, KERNEL_MAX, "max");
+}
+
+static int arraySum(winterState_t *state, winterValue_t *args, int argc) {
+	array_t *array = toArray(&args[0]);
+	if (array == NULL) {
+		_winter_objectNewError(state, &args[0], "sum expects an array");
+		return 1;
+	}
+	unsigned char *scratch = MALLOC(scratchSize(array, array->kind) + 1);
+	args[0] = _winter_kernelReduce(array->kind, KERNEL_ADD, contiguous(array, array->kind, scratch), array->length);
+	FREE(scratch);
+	return 1;
+}
+
+static int arrayDot(winterState_t *state, winterValue_t *args, int argc) {
+	array_t *a = toArray(&args[0]), *b = toArray(&args[1]);
+	if (a == NULL || b == NULL || a->length != b->length) {
+		_winter_objectNewError(state, &args[0], "dot expects two arrays of the same length");
+		return 1;
+	}
+	arrayType_t kind = promote(a->kind, b->kind);
+	size_t sizeA = scratchSize(a, kind);
+	unsigned char *scratch = MALLOC(sizeA + scratchSize(b, kind) + 1);
+	args[0] = _winter_kernelDot(kind, contiguous(a, kind, scratch), contiguous(b, kind, scratch + sizeA), a->length);
+	FREE(scratch);
+	return 1;
+}
+
+static const char *compareNames[] = { "==", "!=", "<", "<=", ">", ">=" };
+
+//compare(a, op, b) returns an int32 array of 1 where the comparison holds and 0 elsewhere
+static int arrayCompare(winterState_t *state, winterValue_t *args, int argc) {
+	array_t *a = toArray(&args[0]), *b = toArray(&args[2]);
+	int op = -1;
+	for (int i = 0; i < 6 && args[1].type == TYPE_STRING; i++) {
+		if (strcmp(args[1].string->data, compareNames[i]) == 0) op = i;
+	}
+	if (a == NULL || op < 0 || (b == NULL && !isScalar(&args[2])) || (b != NULL && b->length != a->length)) {
+		_winter_objectNewError(state, &args[0], "compare expects an array, an operator and an array of the same length or a number");
+		return 1;
+	}
+	arrayType_t kind = a->kind;
+	if (b != NULL) {
+		kind = promote(a->kind, b->kind);
+	} else if (args[2].type == TYPE_FLOAT && !isFloatArray(kind)) {
+		kind = ARRAY_FLOAT64;
+	}
+	array_t *mask = _winter_arrayAlloc(state, ARRAY_INT32, a->length);
+	
+	size_t sizeA = scratchSize(a, kind), sizeB = b != NULL ? scratchSize(b, kind) : 0;
+	unsigned char *scratch = sizeA + sizeB > 0 ? MALLOC(sizeA + sizeB) : NULL, number[8];
+	const void *x = contiguous(a, kind, scratch), *y = number;
+	if (b != NULL) {
+		y = contiguous(b, kind, scratch + sizeA);
+	} else {
+		store(number, kind, &args[2]);
+	}
+	_winter_kernelCompare(kind, (kernelCompare_t)op, (int32_t*)mask->data, x, y, b == NULL, a->length);
+	if (scratch != NULL) {
+		FREE(scratch);
+	}
+	args[0] = (object_t){ TYPE_ARRAY, { .pointer = mask } };
+	return 1;
+}
+
+static inline array_t *toIndices(const object_t *value) {
+	array_t *array = toArray(value);
+	return array != NULL && !isFloatArray(array->kind) ? array : NULL;
+}
+
+//gather(a, indices) returns the elements at the indices, which is an int64 or int32 array
+static int arrayGather(winterState_t *state, winterValue_t *args, int argc) {
+	array_t *array = toArray(&args[0]), *indices = toIndices(&args[1]);
+	if (array == NULL || indices == NULL) {
+		_winter_objectNewError(state, &args[0], "gather expects an array and an integer array of indices");
+		return 1;
+	}
+	array_t *out = _winter_arrayAlloc(state, array->kind, indices->length);
+	
+	size_t sizeData = scratchSize(array, array->kind);
+	unsigned char *scratch = MALLOC(sizeData + scratchSize(indices, indices->kind) + 1);
+	const void *data = contiguous(array, array->kind, scratch);
+	const void *index = contiguous(indices, indices->kind, scratch + sizeData);
+	bool_t ok = _winter_kernelGather(array->kind, out->data, data, array->length, indices->kind, index, indices->length);
+	FREE(scratch);
+	if (!ok) {
+		_winter_objectNewError(state, &args[0], "gather index out of range");
+		return 1;
+	}
+	args[0] = (object_t){ TYPE_ARRAY, { .pointer = out } };
+	return 1;
+}
+
+//scatter(a, indices, values) sets a[indices[i]] to values[i], or to 'values' if it's a
+//number, and returns the array. Nothing is written if an index is out of range
+static int arrayScatter(winterState_t *state, winterValue_t *args, int argc) {
+	array_t *array = toArray(&args[0]), *indices = toIndices(&args[1]), *values = toArray(&args[2]);
+	if (array == NULL || indices == NULL || (values == NULL && !isScalar(&args[2])) ||
+		(values != NULL && values->length != indices->length)) {
+		_winter_objectNewError(state, &args[0], "scatter expects an array, an integer array of indices and an array of values or a number");
+		return 1;
+	} else if (array->readOnly) {
+		_winter_objectNewError(state, &args[0], "attempt to modify a read only array");
+		return 1;
+	}
+	arrayType_t kind = array->kind;
+	size_t width = _winter_arrayWidth(kind), n = indices->length;
+	for (size_t i = 0; i < n; i++) {
+		winterInt_t index = _winter_arrayGet(indices, i).integer;
+		if (index < 0 || (uint64_t)index >= array->length) {
+			_winter_objectNewError(state, &args[0], "scatter index out of range");
+			return 1;
+		}
+	}
+	
+	unsigned char *scratch = MALLOC((values != NULL ? scratchSize(values, kind) : 0) + 8);
+	const unsigned char *source = scratch;
+	size_t step = width;
+	if (values != NULL) {
+		source = contiguous(values, kind, scratch);
+	} else {
+		store(scratch, kind, &args[2]);
+		step = 0;
+	}
+	for (size_t i = 0; i < n; i++) {
+		winterInt_t index = _winter_arrayGet(indices, i).integer;
+		memcpy(_winter_arrayAt(array, (size_t)index), source + i * step, width);
+	}
+	FREE(scratch);
+	return 1;
+}
+
+//Public
+
+int winterSetArray(winterState_t *state, winterValue_t *value, winterArrayType_t type, void *data, size_t length,
+				   int flags, winterRelease_t release, void *user) {
+	if ((unsigned)type > ARRAY_INT32 || (data == NULL && length > 0) ||
+		(uintptr_t)data % _winter_arrayWidth((arrayType_t)type) != 0) {
+		return -1;
+	}
+	array_t *out = MALLOC(sizeof(array_t));
+	out->_refcount = 0;
+	out->_zct      = false;
+	out->_type     = TYPE_ARRAY;
+	out->_mark     = false;
+	out->kind      = (arrayType_t)type;
+	out->readOnly  = (flags & WINTER_READ_ONLY) != 0;
+	out->length    = length;
+	out->stride    = 1;
+	out->data      = data;
+	out->base      = NULL;
+	out->release   = release;
+	out->user      = user;
+	state->memory.arrays++;
+	_winter_zctPush(state, TYPE_ARRAY, out);
+	*value = (object_t){ TYPE_ARRAY, { .pointer = out } };
+	return 0;
+}
+
+void *winterToArray(const winterValue_t *value, winterArrayType_t *type, size_t *length, ptrdiff_t *stride) {
+	if (value->type == TYPE_REFERENCE) {
+		value = value->pointer;
+	}
+	if (value->type != TYPE_ARRAY) {
+		return NULL;
+	}
+	array_t *array = value->pointer;
+	if (type != NULL)   *type   = (winterArrayType_t)array->kind;
+	if (length != NULL) *length = array->length;
+	if (stride != NULL) *stride = array->stride;
+	return array->data;
+}
+
+void winterOpenArrays(winterState_t *state) {
+	winterRegister(state, "array",   arrayNew,     2);
+	winterRegister(state, "length",  arrayLength,  1);
+	winterRegister(state, "slice",   arraySlice,  -1);
+	winterRegister(state, "copy",    arrayCopy,   -1);
+	winterRegister(state, "fill",    arrayFill,    2);
+	winterRegister(state, "vadd",    arrayAdd,    -1);
+	winterRegister(state, "vsub",    arraySub,    -1);
+	winterRegister(state, "vmul",    arrayMul,    -1);
+	winterRegister(state, "vdiv",    arrayDiv,    -1);
+	winterRegister(state, "min",     arrayMin,    -1);
+	winterRegister(state, "max",     arrayMax,    -1);
+	winterRegister(state, "sum",     arraySum,     1);
+	winterRegister(state, "dot",     arrayDot,     2);
+	winterRegister(state, "compare", arrayCompare, 3);
+	winterRegister(state, "gather",  arrayGather,  2);
+	winterRegister(state, "scatter", arrayScatter, 3);
+	_winter_parallelOpen(state);
+	_winter_sortOpen(state);
+}
@@ -0,0 +1,61 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include "wtype.h"
+#include "object.h"
+
+//Typed numeric arrays
+//
+//Elements are stored unboxed in a buffer and read as ints or floats. Views made with
+//slice share the buffer of the array they were made from and step through it by their
+//stride, which is in elements and can be negative. Arrays made with winterSetArray use
+//host memory in place and hand it back through their release callback. Arithmetic,
+//reductions, comparisons and gathers run over whole arrays with the kernels in kernel.h
+typedef enum arrayType_t {
+	ARRAY_FLOAT64,
+	ARRAY_INT64,
+	ARRAY_FLOAT32,
+	ARRAY_INT32
+} arrayType_t;
+
+#define isFloatArray(t) ((t) == ARRAY_FLOAT64 || (t) == ARRAY_FLOAT32)
+
+typedef struct array_t {
+	REFCOUNT;
+	uint8_t   kind;     //arrayType_t
+	uint8_t   readOnly; //set for host memory wrapped as read only, and views of it
+	size_t    length;
+	ptrdiff_t stride;
+	unsigned char *data; //first element
+	struct array_t *base; //array owning the buffer of a view, counted, NULL if it's its own
+	
+	//Host memory, called when the array is freed
+	void (*release)(void *user, void *data);
+	void *user;
+} array_t;
+
+//Bytes of one element
+static inline size_t _winter_arrayWidth(arrayType_t kind) {
+	return kind == ARRAY_FLOAT64 || kind == ARRAY_INT64 ? 8 : 4;
+}
+
+//Returns a contiguous array of zeros
+array_t *_winter_arrayAlloc(winterState_t *state, arrayType_t kind, size_t length);
+//Returns a view of 'length' elements starting at 'start' and 'step' apart
+array_t *_winter_arrayView(winterState_t *state, array_t *array, size_t start, size_t length, ptrdiff_t step);
+void _winter_arrayFree(winterState_t *state, array_t *array);
+
+static inline void *_winter_arrayAt(const array_t *array, size_t index) {
+	return array->data + (ptrdiff_t)index * array->stride * (ptrdiff_t)_winter_arrayWidth(array->kind);
+}
+static inline bool_t _winter_arrayContiguous(const array_t *array) {
+	return array->stride == 1 || array->length <= 1;
+}
+
+//The element as an int or float
+object_t _winter_arrayGet(const array_t *array, size_t index);
+//Converts the number to the element type, returns false if it isn't a number
+bool_t _winter_arraySet(array_t *array, size_t index, const object_t *value);
+
+
+#endif
@@ -0,0 +1,319 @@
+#include "channel.h"
+#include "table.h"
+#include "wstring.h"
+#include "index.h"
+#include "frozen.h"
+#include "vm.h"
+#include <string.h>
+
+#define ALIGN(s) (((s) + 7) & ~(size_t)7)
+
+//Encoding
+
+typedef struct encoder_t {
+	winterState_t *state;
+	jmp_buf        jump;
+	index_t        index;
+	object_t      *objects;
+	size_t         numObjects, capacity;
+	shared_t     **shared;
+	size_t         numShared, sharedCapacity;
+} encoder_t;
+
+#define isCopied(t) (isRefCounted(t) && (t) != TYPE_FROZEN)
+
+//Numbers the object the first time it's reached, fails on values that can't be sent
+static void add(encoder_t *e, const object_t *value) {
+	winterState_t *state = e->state;
+	if (value->type == TYPE_FROZEN) {
+		shared_t *shared = ((frozen_t*)value->pointer)->shared;
+		for (size_t i = 0; i < e->numShared; i++) {
+			if (e->shared[i] == shared) return;
+		}
+		if (e->numShared == e->sharedCapacity) {
+			e->sharedCapacity = e->sharedCapacity ? e->sharedCapacity * 2 : 4;
+			e->shared = REALLOC(e->shared, sizeof(shared_t*) * e->sharedCapacity);
+		}
+		e->shared[e->numShared++] = shared;
+		return;
+	} else if (!isRefCounted(value->type) || _winter_indexFind(&e->index, value->pointer) >= 0) {
+		return;
+	} else if (value->type == TYPE_FUNCTION || value->type == TYPE_ARRAY) {
+		longjmp(e->jump, 1);
+	}
+	if (e->numObjects == e->capacity) {
+		e->capacity = e->capacity ? e->capacity * 2 : 16;
+		e->objects  = REALLOC(e->objects, sizeof(object_t) * e->capacity);
+	}
+	_winter_indexInsert(state, &e->index, value->pointer, (uint32_t)e->numObjects);
+	e->objects[e->numObjects++] = *value;
+}
+
+static inline object_t encodeValue(encoder_t *e, const object_t *value) {
+	object_t out = *value;
+	if (isCopied(value->type)) {
+		out.integer = (winterInt_t)_winter_indexFind(&e->index, value->pointer);
+	}
+	return out;
+}
+
+static message_t *encode(encoder_t *e, channel_t *channel, const object_t *value) {
+	add(e, value);
+	for (size_t i = 0; i < e->numObjects; i++) {
+		if (e->objects[i].type == TYPE_TABLE) {
+			table_t *table = e->objects[i].pointer;
+			for (tableIter_t it = {0}; _winter_tableNext(table, &it);) {
+				add(e, it.key);
+				add(e, it.value);
+			}
+		}
+	}
+	
+	size_t header = ALIGN(sizeof(message_t)) + ALIGN(sizeof(messageObject_t) * e->numObjects);
+	size_t size = header + ALIGN(sizeof(shared_t*) * e->numShared);
+	for (size_t i = 0; i < e->numObjects; i++) {
+		object_t *obj = &e->objects[i];
+		if (obj->type == TYPE_TABLE) {
+			size += ALIGN(sizeof(object_t) * 2 * ((table_t*)obj->pointer)->size);
+		} else {
+			size += ALIGN(obj->string->length + 1);
+		}
+	}
+	message_t *message = channel->allocator(NULL, size);
+	if (message == NULL) {
+		return NULL;
+	}
+	
+	unsigned char *base = (unsigned char*)message;
+	messageObject_t *objects = (messageObject_t*)(base + ALIGN(sizeof(message_t)));
+	size_t at = header + ALIGN(sizeof(shared_t*) * e->numShared);
+	message->value      = encodeValue(e, value);
+	message->numObjects = e->numObjects;
+	message->numShared  = e->numShared;
+	//Each block gets a reference for the message, which the receiver takes over
+	shared_t **shared = (shared_t**)(base + header);
+	for (size_t i = 0; i < e->numShared; i++) {
+		shared[i] = e->shared[i];
+		_winter_sharedRetain(shared[i]);
+	}
+	for (size_t i = 0; i < e->numObjects; i++) {
+		object_t *obj = &e->objects[i];
+		messageObject_t *record = &objects[i];
+		record->type = obj->type;
+		record->data = at;
+		if (obj->type == TYPE_TABLE) {
+			table_t *table = obj->pointer;
+			object_t *pairs = (object_t*)(base + at);
+			record->count = 0;
+			record->extra = table->numBuckets;
+			for (tableIter_t it = {0}; _winter_tableNext(table, &it);) {
+				pairs[record->count * 2]     = encodeValue(e, it.key);
+				pairs[record->count * 2 + 1] = encodeValue(e, it.value);
+				record->count++;
+			}
+			at += ALIGN(sizeof(object_t) * 2 * record->count);
+		} else {
+			record->count = (uint32_t)obj->string->length;
+			record->extra = 0;
+			memcpy(base + at, obj->string->data, obj->string->length + 1);
+			at += ALIGN(obj->string->length + 1);
+		}
+	}
+	return message;
+}
+
+//Decoding
+
+static inline object_t decodeValue(object_t *built, const object_t *value) {
+	return isCopied(value->type) ? built[value->integer] : *value;
+}
+
+static inline shared_t **messageShared(const message_t *message) {
+	return (shared_t**)((unsigned char*)message + ALIGN(sizeof(message_t)) + ALIGN(sizeof(messageObject_t) * message->numObjects));
+}
+
+static void freeMessage(channel_t *channel, message_t *message) {
+	shared_t **shared = messageShared(message);
+	for (size_t i = 0; i < message->numShared; i++) {
+		_winter_sharedRelease(shared[i]);
+	}
+	channel->allocator(message, 0);
+}
+
+//Builds every object, then links the tables
+static object_t decode(winterState_t *state, const message_t *message, object_t **built) {
+	const unsigned char *base = (const unsigned char*)message;
+	const messageObject_t *objects = (const messageObject_t*)(base + ALIGN(sizeof(message_t)));
+	shared_t **shared = messageShared(message);
+	for (size_t i = 0; i < message->numShared; i++) {
+		_winter_sharedHold(state, shared[i]);
+	}
+	*built = MALLOC(sizeof(object_t) * message->numObjects);
+	for (size_t i = 0; i < message->numObjects; i++) {
+		const messageObject_t *record = &objects[i];
+		object_t *obj = &(*built)[i];
+		obj->type = record->type;
+		if (record->type == TYPE_TABLE) {
+			obj->pointer = _winter_tableAlloc(state, record->extra);
+		} else {
+			obj->string = _winter_stringCreateSize(state, (const char*)base + record->data, record->count);
+			if (record->type == TYPE_ERROR) {
+				obj->string->_type = TYPE_ERROR;
+				state->memory.strings--;
+				state->memory.errors++;
+			}
+		}
+	}
+	for (size_t i = 0; i < message->numObjects; i++) {
+		const messageObject_t *record = &objects[i];
+		if (record->type == TYPE_TABLE) {
+			const object_t *pairs = (const object_t*)(base + record->data);
+			for (size_t k = 0; k < record->count; k++) {
+				object_t key = decodeValue(*built, &pairs[k * 2]), value = decodeValue(*built, &pairs[k * 2 + 1]);
+				_winter_tableSet(state, (*built)[i].pointer, &key, &value);
+			}
+		}
+	}
+	return decodeValue(*built, &message->value);
+}
+
+//Queue
+
+static bool_t enqueue(channel_t *channel, message_t *message) {
+	size_t position = atomic_load_explicit(&channel->sendPosition, memory_order_relaxed);
+	slot_t *slot;
+	for (;;) {
+		slot = &channel->slots[position & channel->mask];
+		size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+		if (difference == 0) {
+			if (channel->flags & WINTER_SINGLE_PRODUCER) {
+				atomic_store_explicit(&channel->sendPosition, position + 1, memory_order_relaxed);
+				break;
+			} else if (atomic_compare_exchange_weak_explicit(&channel->sendPosition, &position, position + 1,
+															 memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (difference < 0) {
+			return false;
+		} else {
+			position = atomic_load_explicit(&channel->sendPosition, memory_order_relaxed);
+		}
+	}
+	slot->message = message;
+	atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+	return true;
+}
+
+static message_t *dequeue(channel_t *channel) {
+	size_t position = atomic_load_explicit(&channel->receivePosition, memory_order_relaxed);
+	slot_t *slot;
+	for (;;) {
+		slot = &channel->slots[position & channel->mask];
+		size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+		if (difference == 0) {
+			if (channel->flags & WINTER_SINGLE_CONSUMER) {
+				atomic_store_explicit(&channel->receivePosition, position + 1, memory_order_relaxed);
+				break;
+			} else if (atomic_compare_exchange_weak_explicit(&channel->receivePosition, &position, position + 1,
+															 memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (difference < 0) {
+			return NULL;
+		} else {
+			position = atomic_load_explicit(&channel->receivePosition, memory_order_relaxed);
+		}
+	}
+	message_t *message = slot->message;
+	atomic_store_explicit(&slot->sequence, position + channel->mask + 1, memory_order_release);
+	return message;
+}
+
+//Public
+
+winterChannel_t *winterCreateChannel(winterAlloc_t allocator, size_t capacity, int flags) {
+	size_t slots = 2;
+	while (slots < capacity) {
+		slots *= 2;
+	}
+	channel_t *channel = allocator(NULL, sizeof(channel_t) + sizeof(slot_t) * slots);
+	if (channel == NULL) {
+		return NULL;
+	}
+	channel->allocator = allocator;
+	channel->flags     = flags;
+	channel->mask      = slots - 1;
+	atomic_init(&channel->sendPosition, 0);
+	atomic_init(&channel->receivePosition, 0);
+	for (size_t i = 0; i < slots; i++) {
+		atomic_init(&channel->slots[i].sequence, i);
+		channel->slots[i].message = NULL;
+	}
+	return channel;
+}
+
+void winterFreeChannel(winterChannel_t *channel) {
+	message_t *message;
+	while ((message = dequeue(channel)) != NULL) {
+		freeMessage(channel, message);
+	}
+	channel->allocator(channel, 0);
+}
+
+int winterSend(winterState_t *state, winterChannel_t *channel, const winterValue_t *value) {
+	encoder_t e = { state };
+	message_t *volatile message = NULL;
+	jmp_buf *previous = state->errorJump;
+	state->errorJump = &e.jump;
+	if (setjmp(e.jump) == 0) {
+		message = encode(&e, channel, value);
+	}
+	state->errorJump = previous;
+	_winter_indexFree(state, &e.index);
+	if (e.objects != NULL) {
+		FREE(e.objects);
+	}
+	if (e.shared != NULL) {
+		FREE(e.shared);
+	}
+	
+	int status = -1;
+	if (message != NULL) {
+		status = enqueue(channel, message) ? 0 : 1;
+		if (status != 0) {
+			freeMessage(channel, message);
+		}
+	}
+	return status;
+}
+
+const winterValue_t *winterReceive(winterState_t *state, winterChannel_t *channel) {
+	message_t *message = dequeue(channel);
+	if (message == NULL) {
+		return NULL;
+	}
+	if (state->numFrames == 0) {
+		state->top = 0;
+	}
+	
+	//Objects built before running out of memory are left to the zero count table
+	size_t base = state->top;
+	object_t *built = NULL;
+	jmp_buf handler, *previous = state->errorJump;
+	state->errorJump = &handler;
+	if (setjmp(handler) == 0) {
+		_winter_stackPush(state, &(object_t){ TYPE_NULL });
+		state->stack[base] = decode(state, message, &built);
+	} else {
+		state->top = base;
+		_winter_stackPush(state, &(object_t){ TYPE_ERROR, { .string = state->memoryError } });
+	}
+	state->errorJump = previous;
+	if (built != NULL) {
+		FREE(built);
+	}
+	freeMessage(channel, message);
+	return &state->stack[state->top - 1];
+}
@@ -0,0 +1,53 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "wtype.h"
+#include "object.h"
+#include <stdatomic.h>
+
+//Keeps the sending and receiving positions from sharing a cache line
+#define CACHE_LINE 64
+
+//Value copied out of a state with everything it references, in one allocation
+//Values in a message refer to objects by index instead of by pointer, except for frozen
+//tables which are passed as is while the message holds their blocks. What an object's
+//fields hold depends on its type
+//
+//  string, error  count is the length, data the offset of the NUL terminated bytes
+//  table          count key and value pairs at data, extra is the bucket count, 0 for records
+typedef struct messageObject_t {
+	uint32_t type;
+	uint32_t count;
+	size_t   data;
+	size_t   extra;
+} messageObject_t;
+
+typedef struct message_t {
+	object_t value;
+	size_t   numObjects;
+	size_t   numShared;
+	//followed by the objects, the blocks of frozen tables and the data of the objects
+} message_t;
+
+//Bounded queue of messages (Vyukov)
+//A slot's sequence says whether it's ready to be filled or read for a given position.
+//Positions are claimed with a compare and swap, or a plain store when the flags promise a
+//single sender or receiver
+typedef struct slot_t {
+	atomic_size_t sequence;
+	message_t    *message;
+} slot_t;
+
+typedef struct channel_t {
+	winterAlloc_t allocator;
+	int           flags; //winterChannelFlags_t
+	size_t        mask;
+	char          pad0[CACHE_LINE];
+	atomic_size_t sendPosition;
+	char          pad1[CACHE_LINE];
+	atomic_size_t receivePosition;
+	char          pad2[CACHE_LINE];
+	slot_t        slots[];
+} channel_t;
+
+#endif
@@ -0,0 +1,607 @@
+#include "chunk.h"
+#include "wstring.h"
+#include "compiler.h"
+#include "parser.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+//Loading and dumping can run outside of protected calls, so they never raise
+#define RAW_ALLOC(s) (_winter_poolAllocRaw(state, NULL, (s)))
+#define RAW_FREE(p)  (_winter_poolAllocRaw(state, (p), 0))
+
+#define ALIGN(s) (((s) + 3) & ~(size_t)3)
+
+static inline void report(char *error, size_t errorSize, const char *message) {
+	if (error != NULL && errorSize > 0) {
+		snprintf(error, errorSize, "%s", message);
+	}
+}
+
+uint64_t _winter_sourceHash(const char *source, size_t length) {
+	//FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)source[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+void _winter_mappingRelease(winterState_t *state, mapping_t *mapping) {
+	if (--mapping->references > 0) return;
+#ifndef _WIN32
+	if (mapping->mapped) {
+		munmap(mapping->address, mapping->size);
+	} else
+#endif
+	{
+		RAW_FREE(mapping->address);
+	}
+	RAW_FREE(mapping);
+}
+
+//Dumping
+
+typedef struct dump_t {
+	proto_t **protos;     //breadth first
+	uint32_t *firstProto; //index of the first child of each prototype
+	size_t    numProtos;
+	
+	//Constant pool, the values are owned by the prototypes
+	object_t *constants;
+	size_t    numConstants;
+	uint32_t *slots; //open addressing, pool index + 1
+	size_t    numSlots;
+	
+	const char *source; //NULL if it isn't kept
+	size_t      sourceLength;
+} dump_t;
+
+static void count(proto_t *proto, size_t *numProtos, size_t *numConstants) {
+	*numProtos    += 1;
+	*numConstants += proto->numConstants;
+	for (size_t i = 0; i < proto->numProtos; i++) {
+		count(proto->protos[i], numProtos, numConstants);
+	}
+}
+
+//Numbers are compared by their bits so 0.0 and -0.0 stay apart
+static inline bool_t sameConstant(object_t *a, object_t *b) {
+	if (a->type != b->type) {
+		return false;
+	} else if (a->type == TYPE_STRING) {
+		return a->string->length == b->string->length &&
+			   memcmp(a->string->data, b->string->data, a->string->length) == 0;
+	}
+	return a->type == TYPE_NULL || a->integer == b->integer;
+}
+static inline uint64_t constantHash(object_t *obj) {
+	if (obj->type == TYPE_STRING) {
+		return _winter_sourceHash(obj->string->data, obj->string->length);
+	}
+	uint64_t bits = obj->type == TYPE_NULL ? 0 : (uint64_t)obj->integer;
+	bits ^= bits >> 31;
+	bits *= 0x9e3779b97f4a7c15;
+	return bits ^ (bits >> 29) ^ obj->type;
+}
+
+//Returns the pool index of the value, adding it if it's new
+static uint32_t poolIndex(dump_t *d, object_t *value) {
+	size_t mask = d->numSlots - 1;
+	for (size_t i = constantHash(value) & mask;; i = (i + 1) & mask) {
+		if (d->slots[i] == 0) {
+			d->constants[d->numConstants] = *value;
+			d->slots[i] = (uint32_t)++d->numConstants;
+			return d->slots[i] - 1;
+		} else if (sameConstant(&d->constants[d->slots[i] - 1], value)) {
+			return d->slots[i] - 1;
+		}
+	}
+}
+
+static size_t layout(dump_t *d, bool_t strip) {
+	size_t size = sizeof(chunkHeader_t);
+	size_t numStrings = 0;
+	for (size_t i = 0; i < d->numConstants; i++) {
+		if (d->constants[i].type == TYPE_STRING) {
+			size += ALIGN(d->constants[i].string->length + 1);
+			numStrings++;
+		}
+	}
+	size += sizeof(chunkString_t) * numStrings;
+	size += sizeof(chunkConstant_t) * d->numConstants;
+	size += sizeof(chunkProto_t) * d->numProtos;
+	
+	for (size_t i = 0; i < d->numProtos; i++) {
+		proto_t *proto = d->protos[i];
+		bool_t lines = !strip && proto->lines != NULL;
+		size += sizeof(uint32_t) * proto->numCode * (lines ? 2 : 1);
+		size += sizeof(uint32_t) * proto->numConstants;
+		size += ALIGN(sizeof(upvaldesc_t) * proto->numUpvalues);
+	}
+	if (d->source != NULL) {
+		size += ALIGN(d->sourceLength + 1);
+	}
+	return size;
+}
+
+//Copies the data to the cursor and returns where it went
+static inline uint32_t put(unsigned char *out, size_t *at, const void *data, size_t size) {
+	uint32_t offset = (uint32_t)*at;
+	if (size > 0) {
+		memcpy(out + offset, data, size);
+	}
+	*at += ALIGN(size);
+	return offset;
+}
+
+static void fill(dump_t *d, unsigned char *out, size_t size, bool_t strip) {
+	chunkHeader_t *header = (chunkHeader_t*)out;
+	memcpy(header->magic, CHUNK_MAGIC, sizeof(header->magic));
+	header->version      = CHUNK_VERSION;
+	header->flags        = strip ? 0 : CHUNK_LINES;
+	header->byteOrder    = CHUNK_BYTE_ORDER;
+	header->size         = (uint32_t)size;
+	if (d->source != NULL) {
+		header->sourceHash   = _winter_sourceHash(d->source, d->sourceLength);
+		header->sourceLength = d->sourceLength;
+	}
+	header->numConstants = (uint32_t)d->numConstants;
+	header->numProtos    = (uint32_t)d->numProtos;
+	
+	size_t at = sizeof(chunkHeader_t);
+	for (size_t i = 0; i < d->numConstants; i++) {
+		header->numStrings += d->constants[i].type == TYPE_STRING;
+	}
+	header->strings   = (uint32_t)at;
+	header->constants = header->strings + sizeof(chunkString_t) * header->numStrings;
+	header->protos    = header->constants + sizeof(chunkConstant_t) * header->numConstants;
+	at = header->protos + sizeof(chunkProto_t) * header->numProtos;
+	chunkString_t   *strings   = (chunkString_t*)(out + header->strings);
+	chunkConstant_t *constants = (chunkConstant_t*)(out + header->constants);
+	chunkProto_t    *protos    = (chunkProto_t*)(out + header->protos);
+	
+	for (size_t i = 0; i < d->numProtos; i++) {
+		proto_t *proto = d->protos[i];
+		chunkProto_t *record = &protos[i];
+		record->numCode      = (uint32_t)proto->numCode;
+		record->code         = put(out, &at, proto->code, sizeof(uint32_t) * proto->numCode);
+		if (!strip && proto->lines != NULL) {
+			record->lines    = put(out, &at, proto->lines, sizeof(uint32_t) * proto->numCode);
+		}
+		record->numConstants = (uint32_t)proto->numConstants;
+		record->constants    = (uint32_t)at;
+		for (size_t k = 0; k < proto->numConstants; k++) {
+			uint32_t index = poolIndex(d, &proto->constants[k]);
+			put(out, &at, &index, sizeof(index));
+		}
+		if (proto->numUpvalues > 0) {
+			record->upvalues = put(out, &at, proto->upvalues, sizeof(upvaldesc_t) * proto->numUpvalues);
+		}
+		record->firstProto   = d->firstProto[i];
+		record->numProtos    = (uint32_t)proto->numProtos;
+		record->numUpvalues  = proto->numUpvalues;
+		record->numParams    = proto->numParams;
+		record->numRegisters = proto->numRegisters;
+	}
+	
+	uint32_t numStrings = 0;
+	for (size_t i = 0; i < d->numConstants; i++) {
+		object_t *value = &d->constants[i];
+		constants[i].type = value->type;
+		if (value->type == TYPE_STRING) {
+			strings[numStrings].length = (uint32_t)value->string->length;
+			strings[numStrings].offset = put(out, &at, value->string->data, value->string->length + 1);
+			constants[i].value = numStrings++;
+		} else if (value->type != TYPE_NULL) {
+			constants[i].value = (uint64_t)value->integer;
+		}
+	}
+	
+	if (d->source != NULL) {
+		header->source = put(out, &at, d->source, d->sourceLength + 1);
+	}
+}
+
+int _winter_chunkDump(winterState_t *state, proto_t *proto, bool_t strip, const char *source,
+					  size_t sourceLength, winterWriter_t writer, void *user) {
+	size_t numProtos = 0, numConstants = 0;
+	count(proto, &numProtos, &numConstants);
+	
+	dump_t d = {0};
+	d.source       = source;
+	d.sourceLength = sourceLength;
+	d.numSlots = 16;
+	while (d.numSlots < numConstants * 2) {
+		d.numSlots *= 2;
+	}
+	d.protos     = RAW_ALLOC(sizeof(proto_t*) * numProtos);
+	d.firstProto = RAW_ALLOC(sizeof(uint32_t) * numProtos);
+	d.constants  = RAW_ALLOC(sizeof(object_t) * (numConstants + 1));
+	d.slots      = RAW_ALLOC(sizeof(uint32_t) * d.numSlots);
+	
+	int status = -1;
+	if (d.protos != NULL && d.firstProto != NULL && d.constants != NULL && d.slots != NULL) {
+		memset(d.slots, 0, sizeof(uint32_t) * d.numSlots);
+		d.protos[d.numProtos++] = proto;
+		for (size_t i = 0; i < d.numProtos; i++) {
+			proto_t *current = d.protos[i];
+			d.firstProto[i] = (uint32_t)d.numProtos;
+			for (size_t k = 0; k < current->numProtos; k++) {
+				d.protos[d.numProtos++] = current->protos[k];
+			}
+			for (size_t k = 0; k < current->numConstants; k++) {
+				poolIndex(&d, &current->constants[k]);
+			}
+		}
+		
+		size_t size = layout(&d, strip);
+		unsigned char *out = size <= UINT32_MAX ? RAW_ALLOC(size) : NULL;
+		if (out != NULL) {
+			memset(out, 0, size);
+			fill(&d, out, size, strip);
+			status = writer(user, out, size);
+			RAW_FREE(out);
+		}
+	}
+	
+	RAW_FREE(d.protos);
+	RAW_FREE(d.firstProto);
+	RAW_FREE(d.constants);
+	RAW_FREE(d.slots);
+	return status;
+}
+
+//Loading
+
+typedef struct loader_t {
+	const unsigned char *data;
+	size_t         size;
+	chunkHeader_t  header;
+	const chunkString_t   *strings;
+	const chunkConstant_t *constants;
+	const chunkProto_t    *protos;
+	
+	//Released if memory runs out
+	object_t *pool;
+	proto_t **built;
+} loader_t;
+
+//True if 'count' items of 'size' bytes at 'offset' are inside the chunk
+static inline bool_t inside(loader_t *l, uint64_t offset, uint64_t count, uint64_t size) {
+	return offset % 4 == 0 && offset <= l->size && count <= (l->size - offset) / size;
+}
+
+static bool_t validate(loader_t *l) {
+	chunkHeader_t *header = &l->header;
+	if (!inside(l, header->strings, header->numStrings, sizeof(chunkString_t)) ||
+		!inside(l, header->constants, header->numConstants, sizeof(chunkConstant_t)) ||
+		!inside(l, header->protos, header->numProtos, sizeof(chunkProto_t)) ||
+		header->numProtos == 0 || header->constants % 8 != 0) {
+		return false;
+	}
+	l->strings   = (const chunkString_t*)(l->data + header->strings);
+	l->constants = (const chunkConstant_t*)(l->data + header->constants);
+	l->protos    = (const chunkProto_t*)(l->data + header->protos);
+	
+	for (size_t i = 0; i < header->numStrings; i++) {
+		const chunkString_t *string = &l->strings[i];
+		if (!inside(l, string->offset, (uint64_t)string->length + 1, 1) ||
+			l->data[string->offset + string->length] != '\0') {
+			return false;
+		}
+	}
+	if (header->source != 0 && (!inside(l, header->source, header->sourceLength + 1, 1) ||
+								l->data[header->source + header->sourceLength] != '\0')) {
+		return false;
+	}
+	for (size_t i = 0; i < header->numConstants; i++) {
+		const chunkConstant_t *constant = &l->constants[i];
+		if (constant->type == TYPE_STRING ? constant->value >= header->numStrings :
+			constant->type != TYPE_INT && constant->type != TYPE_FLOAT && constant->type != TYPE_NULL) {
+			return false;
+		}
+	}
+	for (size_t i = 0; i < header->numProtos; i++) {
+		const chunkProto_t *proto = &l->protos[i];
+		if (proto->numCode == 0 || !inside(l, proto->code, proto->numCode, sizeof(uint32_t)) ||
+			(proto->lines != 0 && !inside(l, proto->lines, proto->numCode, sizeof(uint32_t))) ||
+			!inside(l, proto->constants, proto->numConstants, sizeof(uint32_t)) ||
+			(proto->numUpvalues > 0 && !inside(l, proto->upvalues, proto->numUpvalues, sizeof(upvaldesc_t))) ||
+			(proto->numProtos > 0 && (proto->firstProto <= i ||
+			(uint64_t)proto->firstProto + proto->numProtos > header->numProtos)) ||
+			proto->numRegisters < proto->numParams || proto->numRegisters == 0 ||
+			proto->numRegisters > MAX_REGISTERS) {
+			return false;
+		}
+		const uint32_t *indices = (const uint32_t*)(l->data + proto->constants);
+		for (size_t k = 0; k < proto->numConstants; k++) {
+			if (indices[k] >= header->numConstants) return false;
+		}
+	}
+	return true;
+}
+
+static void build(winterState_t *state, loader_t *l, mapping_t *mapping, size_t index) {
+	const chunkProto_t *record = &l->protos[index];
+	proto_t *proto = l->built[index] = _winter_protoAlloc(state);
+	proto->mapping = mapping;
+	mapping->references++;
+	
+	proto->code         = (uint32_t*)(l->data + record->code);
+	proto->lines        = record->lines ? (uint32_t*)(l->data + record->lines) : NULL;
+	proto->numCode      = record->numCode;
+	proto->upvalues     = record->numUpvalues ? (upvaldesc_t*)(l->data + record->upvalues) : NULL;
+	proto->numUpvalues  = record->numUpvalues;
+	proto->numParams    = record->numParams;
+	proto->numRegisters = record->numRegisters;
+	
+	if (record->numConstants > 0) {
+		const uint32_t *indices = (const uint32_t*)(l->data + record->constants);
+		proto->constants = MALLOC(sizeof(object_t) * record->numConstants);
+		for (size_t k = 0; k < record->numConstants; k++) {
+			proto->constants[k] = *_winter_objectAddRef(state, &l->pool[indices[k]]);
+		}
+		proto->numConstants = record->numConstants;
+	}
+	if (record->numProtos > 0) {
+		proto->protos = MALLOC(sizeof(proto_t*) * record->numProtos);
+		for (size_t k = 0; k < record->numProtos; k++) {
+			proto->protos[k] = l->built[record->firstProto + k];
+			_winter_protoRetain(proto->protos[k]);
+		}
+		proto->numProtos = record->numProtos;
+	}
+}
+
+proto_t *_winter_chunkLoad(winterState_t *state, mapping_t *mapping, const char **error) {
+	loader_t l = { mapping->address, mapping->size };
+	if (l.size < sizeof(chunkHeader_t)) {
+		*error = "not a binary chunk";
+		return NULL;
+	}
+	memcpy(&l.header, l.data, sizeof(chunkHeader_t));
+	if (memcmp(l.header.magic, CHUNK_MAGIC, sizeof(l.header.magic)) != 0) {
+		*error = "not a binary chunk";
+		return NULL;
+	} else if (l.header.version != CHUNK_VERSION) {
+		*error = "binary chunk was written by an incompatible version";
+		return NULL;
+	} else if (l.header.byteOrder != CHUNK_BYTE_ORDER) {
+		*error = "binary chunk was written with a different byte order";
+		return NULL;
+	} else if (l.header.size != l.size || !validate(&l)) {
+		*error = "corrupt binary chunk";
+		return NULL;
+	}
+	
+	proto_t *volatile out = NULL;
+	jmp_buf handler, *previous = state->errorJump;
+	state->errorJump = &handler;
+	if (setjmp(handler) == 0) {
+		l.pool  = MALLOC(sizeof(object_t) * l.header.numConstants);
+		l.built = MALLOC(sizeof(proto_t*) * l.header.numProtos);
+		memset(l.built, 0, sizeof(proto_t*) * l.header.numProtos);
+		
+		for (size_t i = 0; i < l.header.numConstants; i++) {
+			const chunkConstant_t *constant = &l.constants[i];
+			object_t *value = &l.pool[i];
+			value->type = constant->type;
+			if (constant->type == TYPE_STRING) {
+				const chunkString_t *string = &l.strings[constant->value];
+				value->string = _winter_stringCreateSize(state, (const char*)l.data + string->offset, string->length);
+			} else {
+				value->integer = (winterInt_t)constant->value;
+			}
+		}
+		
+		//Children come after their parents
+		for (size_t i = l.header.numProtos; i-- > 0;) {
+			build(state, &l, mapping, i);
+		}
+		out = l.built[0];
+		l.built[0] = NULL;
+	} else {
+		*error = "out of memory";
+	}
+	state->errorJump = previous;
+	
+	//Every prototype but the main one is held by its parent
+	if (l.built != NULL) {
+		for (size_t i = 0; i < l.header.numProtos; i++) {
+			if (l.built[i] != NULL) {
+				_winter_protoRelease(state, l.built[i]);
+			}
+		}
+		FREE(l.built);
+	}
+	if (l.pool != NULL) {
+		FREE(l.pool);
+	}
+	return out;
+}
+
+//Files
+
+mapping_t *_winter_mapFile(winterState_t *state, const char *path) {
+	mapping_t *mapping = RAW_ALLOC(sizeof(mapping_t));
+	if (mapping == NULL) return NULL;
+	*mapping = (mapping_t){ 1 };
+	
+#ifdef _WIN32
+	FILE *file = fopen(path, "rb");
+	if (file != NULL) {
+		long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+		void *data = size > 0 ? RAW_ALLOC(size) : NULL;
+		if (data != NULL && fseek(file, 0, SEEK_SET) == 0 && fread(data, 1, size, file) == (size_t)size) {
+			mapping->address = data;
+			mapping->size    = size;
+		} else if (data != NULL) {
+			RAW_FREE(data);
+		}
+		fclose(file);
+	}
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void *address = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (address != MAP_FAILED) {
+				mapping->address = address;
+				mapping->size    = info.st_size;
+				mapping->mapped  = true;
+			}
+		}
+		close(fd);
+	}
+#endif
+	
+	if (mapping->address == NULL) {
+		RAW_FREE(mapping);
+		return NULL;
+	}
+	return mapping;
+}
+
+static int fileWriter(void *user, const void *data, size_t size) {
+	return fwrite(data, 1, size, user) == size ? 0 : -1;
+}
+
+//Best effort, the chunk is written next to its final name and moved into place so readers
+//never see a partial file
+static void store(winterState_t *state, proto_t *proto, const char *path, const char *source, size_t length) {
+	char temporary[4096];
+	if (snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(temporary)) {
+		return;
+	}
+	FILE *file = fopen(temporary, "wb");
+	if (file == NULL) return;
+	
+	int status = _winter_chunkDump(state, proto, false, source, length, fileWriter, file);
+	if (fclose(file) != 0) {
+		status = -1;
+	}
+#ifdef _WIN32
+	if (status == 0) {
+		remove(path);
+	}
+#endif
+	if (status != 0 || rename(temporary, path) != 0) {
+		remove(temporary);
+	}
+}
+
+winterChunk_t *winterLoadString(winterState_t *state, const char *source, char *error, size_t errorSize) {
+	ast_node_t *tree = _winter_generateTree(state, source);
+	object_t result;
+	proto_t *proto = _winter_compile(state, tree, &result);
+	if (proto == NULL) {
+		report(error, errorSize, result.string->data);
+	}
+	_winter_freeTree(state, tree);
+	return proto;
+}
+
+winterChunk_t *winterLoadChunk(winterState_t *state, const void *data, size_t size, char *error, size_t errorSize) {
+	mapping_t *mapping = RAW_ALLOC(sizeof(mapping_t));
+	void *copy = RAW_ALLOC(size);
+	if (mapping == NULL || copy == NULL) {
+		RAW_FREE(mapping);
+		RAW_FREE(copy);
+		report(error, errorSize, "out of memory");
+		return NULL;
+	}
+	memcpy(copy, data, size);
+	*mapping = (mapping_t){ 1, copy, size, false };
+	
+	const char *message = NULL;
+	proto_t *proto = _winter_chunkLoad(state, mapping, &message);
+	_winter_mappingRelease(state, mapping);
+	if (proto == NULL) {
+		report(error, errorSize, message);
+	}
+	return proto;
+}
+
+winterChunk_t *winterMapChunk(winterState_t *state, const char *path, char *error, size_t errorSize) {
+	mapping_t *mapping = _winter_mapFile(state, path);
+	if (mapping == NULL) {
+		report(error, errorSize, "can't read the file");
+		return NULL;
+	}
+	
+	const char *message = NULL;
+	proto_t *proto = _winter_chunkLoad(state, mapping, &message);
+	_winter_mappingRelease(state, mapping);
+	if (proto == NULL) {
+		report(error, errorSize, message);
+	}
+	return proto;
+}
+
+winterChunk_t *winterLoadCached(winterState_t *state, const char *source, const char *cacheDir, char *error, size_t errorSize) {
+	size_t length = strlen(source);
+	uint64_t hash = _winter_sourceHash(source, length);
+	char path[4096];
+	if (snprintf(path, sizeof(path), "%s/%016" PRIx64 CHUNK_EXTENSION, cacheDir, hash) >= (int)sizeof(path)) {
+		return winterLoadString(state, source, error, errorSize);
+	}
+	
+	//Stale, corrupt or colliding entries are compiled again and replaced. The hash only
+	//names the file, entries are used when the source kept in them is the same
+	mapping_t *mapping = _winter_mapFile(state, path);
+	if (mapping != NULL) {
+		chunkHeader_t header;
+		proto_t *proto = NULL;
+		const char *message;
+		if (mapping->size >= sizeof(header)) {
+			memcpy(&header, mapping->address, sizeof(header));
+			if (header.sourceHash == hash && header.sourceLength == length && header.source != 0 &&
+				header.source <= mapping->size && length < mapping->size - header.source &&
+				memcmp((const char*)mapping->address + header.source, source, length) == 0) {
+				proto = _winter_chunkLoad(state, mapping, &message);
+			}
+		}
+		_winter_mappingRelease(state, mapping);
+		if (proto != NULL) {
+			return proto;
+		}
+	}
+	
+	proto_t *proto = winterLoadString(state, source, error, errorSize);
+	if (proto != NULL) {
+		store(state, proto, path, source, length);
+	}
+	return proto;
+}
+
+int winterDumpChunk(winterState_t *state, winterChunk_t *chunk, int strip, winterWriter_t writer, void *user) {
+	return _winter_chunkDump(state, chunk, strip != 0, NULL, 0, writer, user);
+}
+
+void winterFreeChunk(winterState_t *state, winterChunk_t *chunk) {
+	_winter_protoRelease(state, chunk);
+}
+
+winterChunk_t *winterShareChunk(winterState_t *state, winterChunk_t *chunk) {
+	if (chunk->shared != NULL) {
+		return winterRetainChunk(chunk);
+	}
+	return _winter_protoShare(state, chunk);
+}
+winterChunk_t *winterRetainChunk(winterChunk_t *chunk) {
+	_winter_protoRetain(chunk);
+	return chunk;
+}
@@ -0,0 +1,91 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include "wtype.h"
+#include "proto.h"
+
+//Binary chunk format, written by winterDumpChunk and loaded by winterLoadFile
+//
+//A chunk is a header followed by sections addressed by offsets from the start of the
+//data, so it works wherever it is mapped. Integers are in the byte order of the machine
+//that wrote the chunk and other machines reject it. Instructions, line tables and upvalue
+//descriptors are used in place, only the constants are turned into values when loading.
+//Chunks are trusted, the instructions aren't verified
+//
+//  header     chunkHeader_t
+//  strings    numStrings chunkString_t, the bytes are NUL terminated
+//  constants  numConstants chunkConstant_t, deduplicated across every function
+//  protos     numProtos chunkProto_t in breadth first order, the first one is the main
+//             function and the children of each function are consecutive
+//  source     the script it was compiled from, NUL terminated, only kept by the cache
+//
+//Each function points at its code, its optional line table, its upvalue descriptors and
+//an array of u32 indices into the constants. Every section is 4 byte aligned
+//Bump CHUNK_VERSION whenever the instruction set or the layout changes
+#define CHUNK_MAGIC      "WBC"
+#define CHUNK_VERSION    4
+#define CHUNK_BYTE_ORDER 0x01020304
+#define CHUNK_EXTENSION  ".wbc"
+
+typedef enum chunk_flags_t {
+	CHUNK_LINES = 1
+} chunk_flags_t;
+
+typedef struct chunkHeader_t {
+	char     magic[4];
+	uint16_t version;
+	uint16_t flags;
+	uint32_t byteOrder;
+	uint32_t size;
+	uint64_t sourceHash; //of the script it was compiled from, 0 if unknown
+	uint64_t sourceLength;
+	uint32_t numStrings,   strings;
+	uint32_t numConstants, constants;
+	uint32_t numProtos,    protos;
+	uint32_t source, unused; //offset of the script's text, 0 if it isn't kept
+} chunkHeader_t;
+
+typedef struct chunkString_t {
+	uint32_t offset;
+	uint32_t length;
+} chunkString_t;
+
+typedef struct chunkConstant_t {
+	uint32_t type; //object_type_t
+	uint32_t unused;
+	uint64_t value; //integer or float bits, index of a string
+} chunkConstant_t;
+
+typedef struct chunkProto_t {
+	uint32_t code, lines, numCode;
+	uint32_t constants, numConstants;
+	uint32_t firstProto, numProtos;
+	uint32_t upvalues;
+	uint8_t  numUpvalues, numParams, numRegisters, unused;
+} chunkProto_t;
+
+//Memory holding a loaded chunk, every prototype using it holds a reference
+typedef struct mapping_t {
+	uint32_t references;
+	void    *address;
+	size_t   size;
+	bool_t   mapped; //false when the chunk was copied into memory
+} mapping_t;
+
+//Maps the file read only, or reads it into memory where that isn't supported
+//Returns NULL if the file can't be read
+mapping_t *_winter_mapFile(winterState_t *state, const char *path);
+void _winter_mappingRelease(winterState_t *state, mapping_t *mapping);
+
+//Keys the chunk cache
+uint64_t _winter_sourceHash(const char *source, size_t length);
+
+//Keeps the source in the chunk unless it's NULL, so the cache can check it's the same script
+//Returns the writer's first nonzero result, or -1 if memory runs out
+int _winter_chunkDump(winterState_t *state, proto_t *proto, bool_t strip, const char *source,
+					  size_t sourceLength, winterWriter_t writer, void *user);
+//The prototypes reference the mapping, the caller keeps its own reference
+//Returns NULL and points 'error' at a message if the mapping doesn't hold a valid chunk
+proto_t *_winter_chunkLoad(winterState_t *state, mapping_t *mapping, const char **error);
+
+#endif
@@ -0,0 +1,605 @@
+#include "compiler.h"
+#include "wstring.h"
+#include <setjmp.h>
+#include <string.h>
+
+#define COMPILE_ERROR 2
+
+typedef struct local_t {
+	wstring_t *name;
+	uint8_t    reg;
+	int        depth;
+	bool_t     captured; //the scope has to close it
+} local_t;
+
+typedef struct funcState_t {
+	struct funcState_t *parent;
+	proto_t *proto;
+	size_t   codeCapacity;
+	size_t   constantCapacity;
+	size_t   protoCapacity;
+	
+	local_t locals[MAX_REGISTERS];
+	size_t  numLocals;
+	size_t  numCaches; //inline caches of the field instructions
+	int     depth;
+	int     freeReg; //first register not holding a local or temporary
+	
+	wstring_t  *upvalueNames[MAX_UPVALUES];
+	upvaldesc_t upvalues[MAX_UPVALUES];
+} funcState_t;
+
+typedef struct compiler_t {
+	winterState_t *state;
+	funcState_t   *current;
+	jmp_buf        jump;
+	object_t       error;
+	size_t         line; //of the node being compiled
+} compiler_t;
+
+static void compileError(compiler_t *c, const char *format, const char *detail) {
+	_winter_objectNewError(c->state, &c->error, format, detail);
+	longjmp(c->jump, COMPILE_ERROR);
+}
+
+static inline void *grow(compiler_t *c, void *array, size_t *capacity, size_t count, size_t size) {
+	winterState_t *state = c->state;
+	if (count == *capacity) {
+		*capacity = *capacity ? *capacity * 2 : 8;
+		array = REALLOC(array, *capacity * size);
+	}
+	return array;
+}
+
+static inline size_t emit(compiler_t *c, funcState_t *fs, uint32_t instruction) {
+	winterState_t *state = c->state;
+	proto_t *proto = fs->proto;
+	if (proto->numCode == fs->codeCapacity) {
+		fs->codeCapacity = fs->codeCapacity ? fs->codeCapacity * 2 : 8;
+		proto->code  = REALLOC(proto->code, fs->codeCapacity * sizeof(uint32_t));
+		proto->lines = REALLOC(proto->lines, fs->codeCapacity * sizeof(uint32_t));
+	}
+	proto->code[proto->numCode]  = instruction;
+	proto->lines[proto->numCode] = (uint32_t)c->line;
+	return proto->numCode++;
+}
+
+//Points the jump at 'pc' to the next instruction emitted
+static inline void patch(compiler_t *c, funcState_t *fs, size_t pc) {
+	int offset = (int)(fs->proto->numCode - pc - 1);
+	if (offset > SBX_BIAS) {
+		compileError(c, "%s", "function is too large");
+	}
+	uint32_t jump = fs->proto->code[pc];
+	fs->proto->code[pc] = CODE_SBX(GET_OP(jump), GET_A(jump), offset);
+}
+
+//Identical constants share a slot
+static int constant(compiler_t *c, funcState_t *fs, object_t *value) {
+	proto_t *proto = fs->proto;
+	for (size_t i = 0; i < proto->numConstants; i++) {
+		if (proto->constants[i].type == value->type && _winter_objectComp(&proto->constants[i], value)) {
+			return (int)i;
+		}
+	}
+	if (proto->numConstants > MAX_BX) {
+		compileError(c, "%s", "function has too many constants");
+	}
+	proto->constants = grow(c, proto->constants, &fs->constantCapacity, proto->numConstants, sizeof(object_t));
+	proto->constants[proto->numConstants] = *_winter_objectAddRef(c->state, value);
+	return (int)proto->numConstants++;
+}
+
+//Registers above every local only hold temporaries
+static inline bool_t isTemporary(funcState_t *fs, int reg) {
+	return fs->numLocals == 0 || fs->locals[fs->numLocals - 1].reg < reg;
+}
+
+static inline int reserve(compiler_t *c, funcState_t *fs, int count) {
+	int reg = fs->freeReg;
+	fs->freeReg += count;
+	if (fs->freeReg > MAX_REGISTERS) {
+		compileError(c, "%s", "function needs too many registers");
+	}
+	if (fs->freeReg > fs->proto->numRegisters) {
+		fs->proto->numRegisters = (uint8_t)fs->freeReg;
+	}
+	return reg;
+}
+
+//Statements in the outermost scope of the chunk work on globals
+static inline bool_t isGlobalScope(funcState_t *fs) {
+	return fs->parent == NULL && fs->depth == 0;
+}
+
+static inline int findLocal(funcState_t *fs, wstring_t *name) {
+	for (size_t i = fs->numLocals; i > 0; i--) {
+		if (_winter_stringCompare(fs->locals[i - 1].name, name)) {
+			return (int)i - 1;
+		}
+	}
+	return -1;
+}
+static int declareLocal(compiler_t *c, funcState_t *fs, wstring_t *name, int reg) {
+	for (size_t i = fs->numLocals; i > 0 && fs->locals[i - 1].depth == fs->depth; i--) {
+		if (_winter_stringCompare(fs->locals[i - 1].name, name)) {
+			compileError(c, "multiple declarations of '%s'", name->data);
+		}
+	}
+	fs->locals[fs->numLocals] = (local_t){ name, (uint8_t)reg, fs->depth, false };
+	return (int)fs->numLocals++;
+}
+
+//Only variables a function actually uses become its upvalues, those of enclosing
+//functions are threaded through every function in between
+static int findUpvalue(compiler_t *c, funcState_t *fs, wstring_t *name) {
+	for (int i = 0; i < fs->proto->numUpvalues; i++) {
+		if (_winter_stringCompare(fs->upvalueNames[i], name)) {
+			return i;
+		}
+	}
+	if (fs->parent == NULL) {
+		return -1;
+	}
+	
+	upvaldesc_t desc;
+	int local = findLocal(fs->parent, name);
+	if (local >= 0) {
+		fs->parent->locals[local].captured = true;
+		desc = (upvaldesc_t){ true, fs->parent->locals[local].reg };
+	} else {
+		int upvalue = findUpvalue(c, fs->parent, name);
+		if (upvalue < 0) {
+			return -1;
+		}
+		desc = (upvaldesc_t){ false, (uint8_t)upvalue };
+	}
+	
+	if (fs->proto->numUpvalues == MAX_UPVALUES) {
+		compileError(c, "%s", "function captures too many variables");
+	}
+	fs->upvalueNames[fs->proto->numUpvalues] = name;
+	fs->upvalues[fs->proto->numUpvalues] = desc;
+	return fs->proto->numUpvalues++;
+}
+
+static void expression(compiler_t *c, funcState_t *fs, ast_node_t *node, int target);
+static bool_t statement(compiler_t *c, funcState_t *fs, ast_node_t *node);
+static void block(compiler_t *c, funcState_t *fs, ast_node_t *node);
+
+//Returns the register holding the value, locals are used in place
+static int anyRegister(compiler_t *c, funcState_t *fs, ast_node_t *node) {
+	if (node->type == AST_IDENT) {
+		int local = findLocal(fs, node->value.string);
+		if (local >= 0) {
+			return fs->locals[local].reg;
+		}
+	}
+	int reg = reserve(c, fs, 1);
+	expression(c, fs, node, reg);
+	return reg;
+}
+
+static void identifier(compiler_t *c, funcState_t *fs, ast_node_t *node, int target) {
+	int index = findLocal(fs, node->value.string);
+	if (index >= 0) {
+		if (fs->locals[index].reg != target) {
+			emit(c, fs, CODE_ABC(OP_MOVE, target, fs->locals[index].reg, 0));
+		}
+	} else if ((index = findUpvalue(c, fs, node->value.string)) >= 0) {
+		emit(c, fs, CODE_ABC(OP_GETUPVAL, target, index, 0));
+	} else {
+		emit(c, fs, CODE_ABX(OP_GETGLOBAL, target, constant(c, fs, &node->value)));
+	}
+}
+
+//String keys known when compiling are accessed through an inline cache, returns the
+//constant of the key or -1 if it has to be in a register
+static int fieldKey(compiler_t *c, funcState_t *fs, ast_node_t *key) {
+	if (key->type != AST_VALUE || key->value.type != TYPE_STRING || fs->numCaches > MAX_BX) {
+		return -1;
+	}
+	int index = constant(c, fs, &key->value);
+	return index <= 0xff ? index : -1;
+}
+static inline void emitField(compiler_t *c, funcState_t *fs, uint32_t instruction) {
+	emit(c, fs, instruction);
+	emit(c, fs, CODE_ABX(OP_EXTRA, 0, fs->numCaches++));
+}
+
+static void subscript(compiler_t *c, funcState_t *fs, ast_node_t *node, int target) {
+	int saved = fs->freeReg;
+	int table = anyRegister(c, fs, node->children[0]);
+	int field = fieldKey(c, fs, node->children[1]);
+	if (field >= 0) {
+		emitField(c, fs, CODE_ABC(OP_GETFIELD, target, table, field));
+	} else {
+		int key = anyRegister(c, fs, node->children[1]);
+		emit(c, fs, CODE_ABC(OP_GETINDEX, target, table, key));
+	}
+	fs->freeReg = saved;
+}
+
+//Fields are set on a temporary so their values can still read the target
+//Children are pairs of the field name and its value
+static void record(compiler_t *c, funcState_t *fs, ast_node_t *node, int target) {
+	int saved = fs->freeReg;
+	int table = (target == fs->freeReg - 1 && isTemporary(fs, target)) ? target : reserve(c, fs, 1);
+	int fields = fs->freeReg;
+	emit(c, fs, CODE_ABC(OP_NEWTABLE, table, 0, 0));
+	for (size_t i = 0; i < node->numNodes; i += 2) {
+		int field = fieldKey(c, fs, node->children[i]);
+		int key   = field < 0 ? anyRegister(c, fs, node->children[i]) : 0;
+		int value = anyRegister(c, fs, node->children[i + 1]);
+		if (field >= 0) {
+			emitField(c, fs, CODE_ABC(OP_SETFIELD, table, field, value));
+		} else {
+			emit(c, fs, CODE_ABC(OP_SETINDEX, table, key, value));
+		}
+		fs->freeReg = fields;
+	}
+	if (table != target) {
+		emit(c, fs, CODE_ABC(OP_MOVE, target, table, 0));
+	}
+	fs->freeReg = saved;
+}
+
+static void assignment(compiler_t *c, funcState_t *fs, ast_node_t *node, int target) {
+	ast_node_t *variable = node->children[0];
+	int saved = fs->freeReg;
+	if (variable->type == AST_INDEX) {
+		int table = anyRegister(c, fs, variable->children[0]);
+		int field = fieldKey(c, fs, variable->children[1]);
+		int key   = field < 0 ? anyRegister(c, fs, variable->children[1]) : 0;
+		int reg   = anyRegister(c, fs, node->children[1]);
+		if (field >= 0) {
+			emitField(c, fs, CODE_ABC(OP_SETFIELD, table, field, reg));
+		} else {
+			emit(c, fs, CODE_ABC(OP_SETINDEX, table, key, reg));
+		}
+		if (reg != target) {
+			emit(c, fs, CODE_ABC(OP_MOVE, target, reg, 0));
+		}
+		fs->freeReg = saved;
+		return;
+	} else if (variable->type != AST_IDENT) {
+		compileError(c, "%s", "invalid assignment target");
+	}
+	
+	int index = findLocal(fs, variable->value.string);
+	if (index >= 0) {
+		int reg = fs->locals[index].reg;
+		expression(c, fs, node->children[1], reg);
+		if (reg != target) {
+			emit(c, fs, CODE_ABC(OP_MOVE, target, reg, 0));
+		}
+	} else {
+		int reg = anyRegister(c, fs, node->children[1]);
+		if ((index = findUpvalue(c, fs, variable->value.string)) >= 0) {
+			emit(c, fs, CODE_ABC(OP_SETUPVAL, reg, index, 0));
+		} else {
+			emit(c, fs, CODE_ABX(OP_SETGLOBAL, reg, constant(c, fs, &variable->value)));
+		}
+		if (reg != target) {
+			emit(c, fs, CODE_ABC(OP_MOVE, target, reg, 0));
+		}
+	}
+	fs->freeReg = saved;
+}
+
+static opcode_t operatorCode(compiler_t *c, ast_node_type_t type) {
+	switch (type) {
+		case AST_ADD:     return OP_ADD;
+		case AST_SUB:     return OP_SUB;
+		case AST_MUL:     return OP_MUL;
+		case AST_DIV:     return OP_DIV;
+		case AST_MOD:     return OP_MOD;
+		case AST_POW:     return OP_POW;
+		case AST_EQ:      return OP_EQ;
+		case AST_NOTEQ:   return OP_NOTEQ;
+		case AST_LESS:    return OP_LESS;
+		case AST_LEQ:     return OP_LEQ;
+		case AST_GREATER: return OP_GREATER;
+		case AST_GEQ:     return OP_GEQ;
+		case AST_NEGATE:  return OP_NEGATE;
+		
+		default:
+			compileError(c, "%s", "operator not implemented");
+			return OP_MOVE;
+	}
+}
+
+static void operator(compiler_t *c, funcState_t *fs, ast_node_t *node, int target) {
+	if (node->type == AST_ASSIGN) {
+		assignment(c, fs, node, target);
+		return;
+	}
+	
+	opcode_t op = operatorCode(c, node->type);
+	int saved = fs->freeReg;
+	int b = anyRegister(c, fs, node->children[0]);
+	int operand = isUnary(node->type) ? 0 : anyRegister(c, fs, node->children[1]);
+	emit(c, fs, CODE_ABC(op, target, b, operand));
+	fs->freeReg = saved;
+}
+
+//The function and its arguments take consecutive registers, starting at the target when
+//it is the last temporary so the result needs no move
+static void call(compiler_t *c, funcState_t *fs, ast_node_t *node, int target, bool_t tail) {
+	int saved = fs->freeReg;
+	int base = (target == fs->freeReg - 1 && isTemporary(fs, target)) ? target : reserve(c, fs, 1);
+	expression(c, fs, node->children[0], base);
+	
+	int argc = (int)node->numNodes - 1;
+	for (int i = 1; i <= argc; i++) {
+		expression(c, fs, node->children[i], reserve(c, fs, 1));
+	}
+	//Native functions write their result over the arguments
+	if (argc == 0) {
+		reserve(c, fs, 1);
+	}
+	
+	emit(c, fs, CODE_ABC(tail ? OP_TAILCALL : OP_CALL, base, argc, 0));
+	fs->freeReg = saved;
+	if (!tail && base != target) {
+		emit(c, fs, CODE_ABC(OP_MOVE, target, base, 0));
+	}
+}
+
+static void yield(compiler_t *c, funcState_t *fs, ast_node_t *node, int target) {
+	if (node->numNodes > 0) {
+		expression(c, fs, node->children[0], target);
+	}
+	emit(c, fs, CODE_ABC(OP_YIELD, target, node->numNodes > 0, 0));
+}
+
+static void function(compiler_t *c, funcState_t *fs, ast_node_t *node, int target) {
+	winterState_t *state = c->state;
+	funcState_t *child = MALLOC(sizeof(funcState_t));
+	*child = (funcState_t){0};
+	child->parent = fs;
+	child->proto  = _winter_protoAlloc(state);
+	child->depth  = 1;
+	c->current = child;
+	
+	size_t numParams = node->numNodes - 2;
+	if (numParams > MAX_REGISTERS) {
+		compileError(c, "%s", "function has too many parameters");
+	}
+	for (size_t i = 0; i < numParams; i++) {
+		declareLocal(c, child, node->children[i + 2]->value.string, reserve(c, child, 1));
+	}
+	child->proto->numParams = (uint8_t)numParams;
+	
+	//The body shares the scope of the parameters, returning closes everything
+	ast_node_t *body = node->children[1];
+	for (size_t i = 0; i < body->numNodes; i++) {
+		statement(c, child, body->children[i]);
+	}
+	emit(c, child, CODE_ABC(OP_RETURN, 0, 0, 0));
+	
+	proto_t *proto = child->proto;
+	if (proto->numUpvalues > 0) {
+		proto->upvalues = MALLOC(sizeof(upvaldesc_t) * proto->numUpvalues);
+		memcpy(proto->upvalues, child->upvalues, sizeof(upvaldesc_t) * proto->numUpvalues);
+	}
+	c->current = fs;
+	FREE(child);
+	
+	if (fs->proto->numProtos > MAX_BX) {
+		_winter_protoRelease(state, proto);
+		compileError(c, "%s", "function has too many nested functions");
+	}
+	fs->proto->protos = grow(c, fs->proto->protos, &fs->protoCapacity, fs->proto->numProtos, sizeof(proto_t*));
+	fs->proto->protos[fs->proto->numProtos] = proto;
+	emit(c, fs, CODE_ABX(OP_CLOSURE, target, fs->proto->numProtos++));
+}
+
+static void expression(compiler_t *c, funcState_t *fs, ast_node_t *node, int target) {
+	size_t line = c->line;
+	if (node->line != 0) {
+		c->line = node->line;
+	}
+	
+	switch (node->type) {
+		case AST_VALUE:
+			if (node->value.type == TYPE_NULL) {
+				emit(c, fs, CODE_ABC(OP_LOADNULL, target, 0, 0));
+			} else {
+				emit(c, fs, CODE_ABX(OP_LOADK, target, constant(c, fs, &node->value)));
+			}
+			break;
+		
+		case AST_IDENT: identifier(c, fs, node, target); break;
+		case AST_PASS:  expression(c, fs, node->children[0], target); break;
+		case AST_CALL:  call(c, fs, node, target, false); break;
+		case AST_INDEX: subscript(c, fs, node, target); break;
+		case AST_TABLE: record(c, fs, node, target); break;
+		case AST_YIELD: yield(c, fs, node, target); break;
+		case AST_FN:    function(c, fs, node, target); break;
+		
+		default:
+			if (isOperator(node->type)) {
+				operator(c, fs, node, target);
+			} else {
+				compileError(c, "%s", "expected an expression");
+			}
+			break;
+	}
+	c->line = line;
+}
+
+static void let(compiler_t *c, funcState_t *fs, ast_node_t *node) {
+	for (size_t i = 0; i < node->numNodes; i++) {
+		ast_node_t *child = node->children[i];
+		ast_node_t *value = NULL;
+		if (child->type == AST_ASSIGN) {
+			value = child->children[1];
+			child = child->children[0];
+		}
+		
+		//The value is compiled before the name is in scope
+		int reg = reserve(c, fs, 1);
+		if (value != NULL) {
+			expression(c, fs, value, reg);
+		} else {
+			emit(c, fs, CODE_ABC(OP_LOADNULL, reg, 0, 0));
+		}
+		
+		if (isGlobalScope(fs)) {
+			emit(c, fs, CODE_ABX(OP_DEFGLOBAL, reg, constant(c, fs, &child->value)));
+			fs->freeReg = reg;
+		} else {
+			declareLocal(c, fs, child->value.string, reg);
+		}
+	}
+}
+
+static void declaration(compiler_t *c, funcState_t *fs, ast_node_t *node) {
+	object_t *name = &node->children[0]->value;
+	int reg = reserve(c, fs, 1);
+	if (isGlobalScope(fs)) {
+		function(c, fs, node, reg);
+		emit(c, fs, CODE_ABX(OP_DEFGLOBAL, reg, constant(c, fs, name)));
+		fs->freeReg = reg;
+	} else {
+		//Declared first so the function can call itself
+		declareLocal(c, fs, name->string, reg);
+		function(c, fs, node, reg);
+	}
+}
+
+static void ret(compiler_t *c, funcState_t *fs, ast_node_t *node) {
+	int saved = fs->freeReg;
+	if (node->numNodes == 0) {
+		emit(c, fs, CODE_ABC(OP_RETURN, 0, 0, 0));
+	} else if (node->children[0]->type == AST_CALL) {
+		call(c, fs, node->children[0], reserve(c, fs, 1), true);
+	} else {
+		emit(c, fs, CODE_ABC(OP_RETURN, anyRegister(c, fs, node->children[0]), 1, 0));
+	}
+	fs->freeReg = saved;
+}
+
+static void branch(compiler_t *c, funcState_t *fs, ast_node_t *node) {
+	int saved = fs->freeReg;
+	int condition = anyRegister(c, fs, node->children[0]);
+	fs->freeReg = saved;
+	
+	size_t skipBody = emit(c, fs, CODE_SBX(OP_JMPIFNOT, condition, 0));
+	block(c, fs, node->children[1]);
+	if (node->children[2] != NULL) {
+		size_t skipElse = emit(c, fs, CODE_SBX(OP_JMP, 0, 0));
+		patch(c, fs, skipBody);
+		if (node->children[2]->type == AST_IF) {
+			branch(c, fs, node->children[2]);
+		} else {
+			block(c, fs, node->children[2]);
+		}
+		patch(c, fs, skipElse);
+	} else {
+		patch(c, fs, skipBody);
+	}
+}
+
+static void block(compiler_t *c, funcState_t *fs, ast_node_t *node) {
+	size_t numLocals = fs->numLocals;
+	int freeReg = fs->freeReg;
+	
+	fs->depth++;
+	for (size_t i = 0; i < node->numNodes; i++) {
+		statement(c, fs, node->children[i]);
+	}
+	fs->depth--;
+	
+	//Captured variables leaving scope move to the heap
+	for (size_t i = numLocals; i < fs->numLocals; i++) {
+		if (fs->locals[i].captured) {
+			emit(c, fs, CODE_ABC(OP_CLOSE, fs->locals[i].reg, 0, 0));
+			break;
+		}
+	}
+	fs->numLocals = numLocals;
+	fs->freeReg   = freeReg;
+}
+
+//Returns true for expression statements, whose value is left in register 0 of the chunk
+static bool_t statement(compiler_t *c, funcState_t *fs, ast_node_t *node) {
+	if (node->line != 0) {
+		c->line = node->line;
+	}
+	switch (node->type) {
+		case AST_LET:    let(c, fs, node);         return false;
+		case AST_RETURN: ret(c, fs, node);         return false;
+		case AST_IF:     branch(c, fs, node);      return false;
+		case AST_BLOCK:  block(c, fs, node);       return false;
+		
+		case AST_FN:
+			if (node->children[0] != NULL) {
+				declaration(c, fs, node);
+				return false;
+			}
+			//fallthrough
+		
+		default: {
+			int saved = fs->freeReg;
+			expression(c, fs, node, isGlobalScope(fs) ? 0 : reserve(c, fs, 1));
+			fs->freeReg = saved;
+			return true;
+		}
+	}
+}
+
+proto_t *_winter_compile(winterState_t *state, ast_node_t *tree, object_t *error) {
+	if (tree != NULL && tree->type == AST_ERROR) {
+		*error = tree->value;
+		return NULL;
+	}
+	
+	compiler_t c = { state };
+	funcState_t *main = MALLOC(sizeof(funcState_t));
+	*main = (funcState_t){0};
+	main->proto = _winter_protoAlloc(state);
+	c.current = main;
+	
+	//Running out of memory unwinds to the same place as errors
+	jmp_buf *previous = state->errorJump;
+	state->errorJump = &c.jump;
+	
+	int status = setjmp(c.jump);
+	if (status == 0) {
+		//Register 0 holds the result
+		reserve(&c, main, 1);
+		bool_t result = false;
+		if (tree != NULL && tree->type == AST_BLOCK) {
+			for (size_t i = 0; i < tree->numNodes; i++) {
+				result = statement(&c, main, tree->children[i]);
+			}
+		} else if (tree != NULL) {
+			result = statement(&c, main, tree);
+		}
+		if (!result) {
+			emit(&c, main, CODE_ABC(OP_LOADNULL, 0, 0, 0));
+		}
+		emit(&c, main, CODE_ABC(OP_RETURN, 0, 1, 0));
+		
+		state->errorJump = previous;
+		proto_t *proto = main->proto;
+		FREE(main);
+		return proto;
+	}
+	
+	state->errorJump = previous;
+	for (funcState_t *fs = c.current; fs != NULL;) {
+		funcState_t *parent = fs->parent;
+		_winter_protoRelease(state, fs->proto);
+		FREE(fs);
+		fs = parent;
+	}
+	if (status == COMPILE_ERROR) {
+		*error = c.error;
+	} else {
+		*error = (object_t){ TYPE_ERROR, { .string = state->memoryError } };
+	}
+	return NULL;
+}
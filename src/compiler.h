@@ -0,0 +1,13 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "wtype.h"
+#include "parser.h"
+#include "proto.h"
+
+//Compiles the tree into a prototype taking no arguments that returns the value of the
+//last statement. Returns NULL and stores the error in 'error' if the tree can't be compiled
+//Statements at the top level of the tree declare globals, nested ones declare locals
+proto_t *_winter_compile(winterState_t *state, ast_node_t *tree, object_t *error);
+
+#endif
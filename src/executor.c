@@ -0,0 +1,361 @@
+#include "executor.h"
+#include "frozen.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+//Deque
+
+static bool_t dequePush(deque_t *deque, job_t *job) {
+	size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	size_t top    = atomic_load_explicit(&deque->top, memory_order_acquire);
+	if (bottom - top >= DEQUE_SIZE) {
+		return false;
+	}
+	atomic_store_explicit(&deque->jobs[bottom % DEQUE_SIZE], job, memory_order_relaxed);
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+	return true;
+}
+
+static job_t *dequeTake(deque_t *deque) {
+	size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	size_t top    = atomic_load_explicit(&deque->top, memory_order_relaxed);
+	if (top >= bottom) {
+		return NULL;
+	}
+	bottom--;
+	atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+	
+	job_t *job = NULL;
+	if (top <= bottom) {
+		job = atomic_load_explicit(&deque->jobs[bottom % DEQUE_SIZE], memory_order_relaxed);
+		if (top == bottom) {
+			//Last job, race the thieves for it
+			if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+														 memory_order_seq_cst, memory_order_relaxed)) {
+				job = NULL;
+			}
+			atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+		}
+	} else {
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+	}
+	return job;
+}
+
+static job_t *dequeSteal(deque_t *deque) {
+	size_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+	if (top >= bottom) {
+		return NULL;
+	}
+	job_t *job = atomic_load_explicit(&deque->jobs[top % DEQUE_SIZE], memory_order_relaxed);
+	if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+												 memory_order_seq_cst, memory_order_relaxed)) {
+		return NULL;
+	}
+	return job;
+}
+
+static inline bool_t dequeEmpty(deque_t *deque) {
+	return atomic_load_explicit(&deque->top, memory_order_acquire) >=
+		   atomic_load_explicit(&deque->bottom, memory_order_acquire);
+}
+
+//Workers
+
+//Tries every other worker once, starting from a random one
+static job_t *steal(worker_t *worker) {
+	executor_t *executor = worker->executor;
+	worker->seed = worker->seed * 1103515245 + 12345;
+	int start = (int)((worker->seed >> 16) % (unsigned)executor->numWorkers);
+	for (int i = 0; i < executor->numWorkers; i++) {
+		worker_t *victim = &executor->workers[(start + i) % executor->numWorkers];
+		if (victim != worker) {
+			job_t *job = dequeSteal(&victim->deque);
+			if (job != NULL) return job;
+		}
+	}
+	return NULL;
+}
+
+//Takes a share of the injector, queueing all but the first job in the worker's deque
+//Waits for work, returns NULL once the executor is stopping or a steal fails after waking
+static job_t *inject(worker_t *worker) {
+	executor_t *executor = worker->executor;
+	mtx_lock(&executor->lock);
+	while (executor->head == NULL) {
+		if (executor->stopping) {
+			mtx_unlock(&executor->lock);
+			return NULL;
+		}
+		//Batches are queued while holding the lock, so none can be missed before waiting
+		bool_t queued = false;
+		for (int i = 0; i < executor->numWorkers && !queued; i++) {
+			queued = !dequeEmpty(&executor->workers[i].deque);
+		}
+		if (!queued) {
+			cnd_wait(&executor->wake, &executor->lock);
+		}
+		if (executor->head == NULL) {
+			mtx_unlock(&executor->lock);
+			return steal(worker);
+		}
+	}
+	
+	size_t batch = executor->queued / (size_t)executor->numWorkers + 1;
+	job_t *job = executor->head;
+	executor->head = job->next;
+	executor->queued--;
+	size_t moved = 0;
+	while (moved + 1 < batch && executor->head != NULL) {
+		//Once it's in the deque the job can be stolen and finished at any time
+		job_t *next = executor->head->next;
+		if (!dequePush(&worker->deque, executor->head)) break;
+		executor->head = next;
+		executor->queued--;
+		moved++;
+	}
+	if (executor->head == NULL) {
+		executor->tail = NULL;
+	}
+	if (moved > 0) {
+		cnd_broadcast(&executor->wake);
+	}
+	mtx_unlock(&executor->lock);
+	return job;
+}
+
+static void runJob(worker_t *worker, job_t *job) {
+	winterState_t *state = worker->state;
+	const winterValue_t *result = NULL;
+	if (job->task != NULL) {
+		job->task(job->user, state);
+		worker->executor->allocator(job, 0);
+		return;
+	}
+	
+	bool_t loaded = false;
+	for (size_t i = 0; i < worker->numLoaded && !loaded; i++) {
+		loaded = worker->loaded[i] == job->chunk;
+	}
+	if (job->name == NULL || !loaded) {
+		result = winterRun(state, job->chunk);
+		if (result->type != TYPE_ERROR && !loaded) {
+			proto_t **grown = _winter_poolAllocRaw(state, worker->loaded, sizeof(proto_t*) * (worker->numLoaded + 1));
+			if (grown != NULL) {
+				worker->loaded = grown;
+				worker->loaded[worker->numLoaded++] = job->chunk;
+			}
+		}
+	}
+	if (job->name != NULL && (result == NULL || result->type != TYPE_ERROR)) {
+		result = winterCall(state, job->name, job->args, job->argc);
+	}
+	
+	if (job->done != NULL) {
+		job->done(job->user, state, result);
+	}
+	//The state holds the blocks of frozen arguments once it's called with them
+	for (int i = 0; i < job->argc; i++) {
+		if (job->args[i].type == TYPE_FROZEN) {
+			_winter_sharedRelease(((frozen_t*)job->args[i].pointer)->shared);
+		}
+	}
+	winterFreeChunk(state, job->chunk);
+	worker->executor->allocator(job, 0);
+}
+
+static int work(void *arg) {
+	worker_t *worker = arg;
+	executor_t *executor = worker->executor;
+	for (;;) {
+		job_t *job = dequeTake(&worker->deque);
+		if (job == NULL) job = steal(worker);
+		if (job == NULL) job = inject(worker);
+		if (job == NULL) {
+			mtx_lock(&executor->lock);
+			bool_t stopping = executor->stopping && executor->head == NULL;
+			mtx_unlock(&executor->lock);
+			if (stopping && dequeEmpty(&worker->deque)) break;
+			continue;
+		}
+		
+		runJob(worker, job);
+		if (atomic_fetch_sub_explicit(&executor->pending, 1, memory_order_acq_rel) == 1) {
+			mtx_lock(&executor->lock);
+			cnd_broadcast(&executor->idle);
+			mtx_unlock(&executor->lock);
+		}
+	}
+	return 0;
+}
+
+static int processorCount(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
+static void freeWorkers(executor_t *executor, int count) {
+	for (int i = 0; i < count; i++) {
+		worker_t *worker = &executor->workers[i];
+		if (worker->loaded != NULL) {
+			_winter_poolAllocRaw(worker->state, worker->loaded, 0);
+		}
+		winterFreeState(worker->state);
+	}
+	executor->allocator(executor->workers, 0);
+}
+
+//Stops the first 'threads' workers and frees everything
+static void stop(executor_t *executor, int threads) {
+	mtx_lock(&executor->lock);
+	executor->stopping = true;
+	cnd_broadcast(&executor->wake);
+	mtx_unlock(&executor->lock);
+	
+	for (int i = 0; i < threads; i++) {
+		thrd_join(executor->workers[i].thread, NULL);
+	}
+	cnd_destroy(&executor->wake);
+	cnd_destroy(&executor->idle);
+	mtx_destroy(&executor->lock);
+	freeWorkers(executor, executor->numWorkers);
+	executor->allocator(executor, 0);
+}
+
+//Hands the job to the workers
+static void enqueue(executor_t *executor, job_t *job) {
+	atomic_fetch_add_explicit(&executor->pending, 1, memory_order_relaxed);
+	mtx_lock(&executor->lock);
+	if (executor->tail != NULL) {
+		executor->tail->next = job;
+	} else {
+		executor->head = job;
+	}
+	executor->tail = job;
+	executor->queued++;
+	cnd_signal(&executor->wake);
+	mtx_unlock(&executor->lock);
+}
+
+//Public
+
+winterExecutor_t *winterCreateExecutor(winterAlloc_t allocator, int numWorkers, winterWorkerInit_t init, void *user) {
+	if (numWorkers <= 0) {
+		numWorkers = processorCount();
+	}
+	executor_t *executor = allocator(NULL, sizeof(executor_t));
+	if (executor == NULL) {
+		return NULL;
+	}
+	*executor = (executor_t){ allocator };
+	executor->workers = allocator(NULL, sizeof(worker_t) * numWorkers);
+	if (executor->workers == NULL) {
+		allocator(executor, 0);
+		return NULL;
+	}
+	
+	int created = 0;
+	for (; created < numWorkers; created++) {
+		worker_t *worker = &executor->workers[created];
+		*worker = (worker_t){ executor };
+		atomic_init(&worker->deque.top, 0);
+		atomic_init(&worker->deque.bottom, 0);
+		worker->seed  = (unsigned)created * 2654435761u + 1;
+		worker->state = winterCreateState(allocator);
+		if (worker->state == NULL) break;
+		if (init != NULL) {
+			init(user, worker->state);
+		}
+	}
+	if (created < numWorkers || mtx_init(&executor->lock, mtx_plain) != thrd_success) {
+		freeWorkers(executor, created);
+		allocator(executor, 0);
+		return NULL;
+	}
+	cnd_init(&executor->wake);
+	cnd_init(&executor->idle);
+	atomic_init(&executor->pending, 0);
+	executor->numWorkers = numWorkers;
+	
+	int started = 0;
+	while (started < numWorkers && thrd_create(&executor->workers[started].thread, work, &executor->workers[started]) == thrd_success) {
+		started++;
+	}
+	if (started < numWorkers) {
+		stop(executor, started);
+		return NULL;
+	}
+	return executor;
+}
+
+int winterSubmit(winterExecutor_t *executor, winterChunk_t *chunk, const char *name, const winterValue_t *args, int argc,
+				 winterJobDone_t done, void *user) {
+	//Values belong to a state, only those that aren't counted and frozen tables can cross over
+	if (chunk->shared == NULL || argc < 0 || argc > MAX_JOB_ARGS) {
+		return -1;
+	}
+	for (int i = 0; i < argc; i++) {
+		if (isRefCounted(args[i].type) && args[i].type != TYPE_FROZEN) return -1;
+	}
+	
+	size_t length = name ? strlen(name) + 1 : 0;
+	job_t *job = executor->allocator(NULL, sizeof(job_t) + length);
+	if (job == NULL) {
+		return -1;
+	}
+	job->next  = NULL;
+	job->task  = NULL;
+	job->chunk = winterRetainChunk(chunk);
+	job->name  = name ? memcpy(job + 1, name, length) : NULL;
+	job->done  = done;
+	job->user  = user;
+	job->argc  = argc;
+	for (int i = 0; i < argc; i++) {
+		job->args[i] = args[i];
+		if (args[i].type == TYPE_FROZEN) {
+			_winter_sharedRetain(((frozen_t*)args[i].pointer)->shared);
+		}
+	}
+	enqueue(executor, job);
+	return 0;
+}
+
+void winterWait(winterExecutor_t *executor) {
+	mtx_lock(&executor->lock);
+	while (atomic_load_explicit(&executor->pending, memory_order_acquire) > 0) {
+		cnd_wait(&executor->idle, &executor->lock);
+	}
+	mtx_unlock(&executor->lock);
+}
+
+void winterFreeExecutor(winterExecutor_t *executor) {
+	winterWait(executor);
+	stop(executor, executor->numWorkers);
+}
+
+//Internal
+
+int _winter_executorTask(executor_t *executor, jobTask_t task, void *user) {
+	job_t *job = executor->allocator(NULL, sizeof(job_t));
+	if (job == NULL) {
+		return -1;
+	}
+	*job = (job_t){ .task = task, .user = user };
+	enqueue(executor, job);
+	return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "wtype.h"
+#include "object.h"
+#include "proto.h"
+#include <stdatomic.h>
+#include <threads.h>
+
+//Jobs a worker can queue for itself, at most this many are taken from the injector at once
+#define DEQUE_SIZE 256
+#define MAX_JOB_ARGS 16
+
+//Runs on a worker with its state, see _winter_executorTask
+typedef void (*jobTask_t)(void *user, winterState_t *state);
+
+//Call submitted with winterSubmit, the name is stored after the arguments
+typedef struct job_t {
+	struct job_t   *next; //in the injector
+	jobTask_t       task; //set instead of the chunk for internal jobs
+	proto_t        *chunk;
+	const char     *name; //NULL to run the chunk itself
+	winterJobDone_t done;
+	void           *user;
+	int             argc;
+	object_t        args[MAX_JOB_ARGS];
+} job_t;
+
+//Chase-Lev work stealing deque
+//Only the owning worker pushes and takes at the bottom, other workers steal from the top
+typedef struct deque_t {
+	atomic_size_t top;
+	atomic_size_t bottom;
+	_Atomic(job_t*) jobs[DEQUE_SIZE];
+} deque_t;
+
+typedef struct worker_t {
+	struct executor_t *executor;
+	thrd_t         thread;
+	winterState_t *state;
+	deque_t        deque;
+	unsigned       seed; //picks the first victim to steal from
+	
+	//Shared chunks that have been run in the state
+	proto_t **loaded;
+	size_t    numLoaded;
+} worker_t;
+
+typedef struct executor_t {
+	winterAlloc_t allocator;
+	worker_t     *workers;
+	int           numWorkers;
+	
+	//Submitted jobs wait in the injector until a worker takes a batch of them
+	mtx_t  lock;
+	cnd_t  wake; //work was submitted or queued in a deque, or the executor is stopping
+	cnd_t  idle; //every job has finished
+	job_t *head, *tail;
+	size_t queued;
+	bool_t stopping;
+	
+	atomic_size_t pending; //submitted jobs that haven't finished
+} executor_t;
+
+//Queues a call of the task on any worker, returns -1 if the allocator fails
+int _winter_executorTask(executor_t *executor, jobTask_t task, void *user);
+
+#endif
@@ -0,0 +1,217 @@
+#include "frozen.h"
+#include "table.h"
+#include "wstring.h"
+#include "index.h"
+#include <string.h>
+
+//Strings use their cached hash, everything else is mixed so sequential keys spread out
+static inline hash_t hashKey(const object_t *key) {
+	uint64_t x;
+	switch (key->type) {
+		case TYPE_STRING: return _winter_stringHash(key->string);
+		case TYPE_INT:    x = (uint64_t)key->integer; break;
+		case TYPE_FLOAT:  x = 0; if (key->floating != 0.0) memcpy(&x, &key->floating, sizeof(x)); break;
+		case TYPE_NULL:   x = 0; break;
+		default:          x = (uintptr_t)key->pointer; break;
+	}
+	x ^= (uint64_t)key->type << 56;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	return (hash_t)x;
+}
+
+static inline bool_t keyEqual(const object_t *a, const object_t *b) {
+	if (a->type != b->type) {
+		return false;
+	} else if (a->type == TYPE_STRING) {
+		return a->string == b->string || (a->string->length == b->string->length &&
+			   memcmp(a->string->data, b->string->data, a->string->length) == 0);
+	} else if (a->type == TYPE_INT) {
+		return a->integer == b->integer;
+	} else if (a->type == TYPE_FLOAT) {
+		return a->floating == b->floating;
+	} else if (a->type == TYPE_NULL) {
+		return true;
+	}
+	return a->pointer == b->pointer;
+}
+
+const object_t *_winter_frozenGet(const frozen_t *frozen, const object_t *key) {
+	if (key->type == TYPE_REFERENCE) {
+		key = key->pointer;
+	}
+	hash_t hash = hashKey(key);
+	for (size_t i = hash & frozen->mask;; i = (i + 1) & frozen->mask) {
+		const frozenEntry_t *entry = &frozen->entries[i];
+		if (entry->key.type == TYPE_UNKNOWN) {
+			return NULL;
+		} else if (entry->hash == hash && keyEqual(&entry->key, key)) {
+			return &entry->value;
+		}
+	}
+}
+
+//Freezing
+
+typedef struct freezer_t {
+	winterState_t *state;
+	index_t        index;
+	object_t      *objects; //originals in the order they were reached
+	object_t      *copies;
+	size_t         numObjects, capacity;
+	shared_t      *shared; //until the state holds it
+} freezer_t;
+
+static inline size_t slotsFor(size_t size) {
+	size_t slots = 2;
+	while (slots < size * FROZEN_LOAD) {
+		slots *= 2;
+	}
+	return slots;
+}
+
+//Numbers the object the first time it's reached, fails on functions and arrays
+static bool_t add(freezer_t *f, const object_t *value) {
+	winterState_t *state = f->state;
+	if (!isRefCounted(value->type) || _winter_indexFind(&f->index, value->pointer) >= 0) {
+		return true;
+	} else if (value->type == TYPE_FUNCTION || value->type == TYPE_ARRAY) {
+		return false;
+	}
+	if (f->numObjects == f->capacity) {
+		f->capacity = f->capacity ? f->capacity * 2 : 16;
+		f->objects  = REALLOC(f->objects, sizeof(object_t) * f->capacity);
+	}
+	_winter_indexInsert(state, &f->index, value->pointer, (uint32_t)f->numObjects);
+	f->objects[f->numObjects++] = *value;
+	return true;
+}
+
+static inline object_t copyOf(freezer_t *f, const object_t *value) {
+	if (isRefCounted(value->type)) {
+		return f->copies[_winter_indexFind(&f->index, value->pointer)];
+	}
+	return *value;
+}
+
+static void insert(frozen_t *frozen, const object_t *key, const object_t *value) {
+	hash_t hash = hashKey(key);
+	size_t i = hash & frozen->mask;
+	while (frozen->entries[i].key.type != TYPE_UNKNOWN) {
+		i = (i + 1) & frozen->mask;
+	}
+	frozen->entries[i] = (frozenEntry_t){ hash, *key, *value };
+	frozen->size++;
+}
+
+//Gathers the graph, sizes the block, places every object, then fills in the tables once
+//every copy has its address
+static bool_t freeze(freezer_t *f, const object_t *value, object_t *out) {
+	winterState_t *state = f->state;
+	if (!add(f, value)) {
+		return false;
+	}
+	for (size_t i = 0; i < f->numObjects; i++) {
+		object_t *obj = &f->objects[i];
+		if (obj->type == TYPE_TABLE) {
+			for (tableIter_t it = {0}; _winter_tableNext(obj->pointer, &it);) {
+				if (!add(f, it.key) || !add(f, it.value)) return false;
+			}
+		} else if (obj->type == TYPE_FROZEN) {
+			frozen_t *frozen = obj->pointer;
+			for (size_t k = 0; k <= frozen->mask; k++) {
+				if (frozen->entries[k].key.type == TYPE_UNKNOWN) continue;
+				if (!add(f, &frozen->entries[k].key) || !add(f, &frozen->entries[k].value)) return false;
+			}
+		}
+	}
+	
+	size_t size = 0;
+	for (size_t i = 0; i < f->numObjects; i++) {
+		object_t *obj = &f->objects[i];
+		if (obj->type == TYPE_TABLE || obj->type == TYPE_FROZEN) {
+			size_t count = obj->type == TYPE_TABLE ? ((table_t*)obj->pointer)->size : ((frozen_t*)obj->pointer)->size;
+			size += SHARED_ALIGN(sizeof(frozen_t) + sizeof(frozenEntry_t) * slotsFor(count));
+		} else {
+			size += SHARED_STRING_SIZE(obj->string->length);
+		}
+	}
+	f->copies = MALLOC(sizeof(object_t) * (f->numObjects ? f->numObjects : 1));
+	unsigned char *at;
+	shared_t *shared = f->shared = _winter_sharedAlloc(state, size, &at);
+	if (shared == NULL) {
+		return false;
+	}
+	
+	for (size_t i = 0; i < f->numObjects; i++) {
+		object_t *obj = &f->objects[i];
+		if (obj->type == TYPE_TABLE || obj->type == TYPE_FROZEN) {
+			size_t count = obj->type == TYPE_TABLE ? ((table_t*)obj->pointer)->size : ((frozen_t*)obj->pointer)->size;
+			size_t slots = slotsFor(count);
+			frozen_t *frozen = _winter_sharedTake(&at, NULL, sizeof(frozen_t) + sizeof(frozenEntry_t) * slots);
+			frozen->_refcount = REF_PERSISTENT;
+			frozen->_zct      = false;
+			frozen->_type     = TYPE_FROZEN;
+			frozen->_mark     = false;
+			frozen->shared    = shared;
+			frozen->size      = 0;
+			frozen->mask      = slots - 1;
+			memset(frozen->entries, 0, sizeof(frozenEntry_t) * slots);
+			f->copies[i] = (object_t){ TYPE_FROZEN, { .pointer = frozen } };
+		} else {
+			f->copies[i] = (object_t){ obj->type, { .string = _winter_sharedString(&at, obj->string) } };
+		}
+	}
+	for (size_t i = 0; i < f->numObjects; i++) {
+		object_t *obj = &f->objects[i];
+		frozen_t *frozen = f->copies[i].pointer;
+		if (obj->type == TYPE_TABLE) {
+			for (tableIter_t it = {0}; _winter_tableNext(obj->pointer, &it);) {
+				object_t key = copyOf(f, it.key), value = copyOf(f, it.value);
+				insert(frozen, &key, &value);
+			}
+		} else if (obj->type == TYPE_FROZEN) {
+			const frozen_t *source = obj->pointer;
+			for (size_t k = 0; k <= source->mask; k++) {
+				if (source->entries[k].key.type == TYPE_UNKNOWN) continue;
+				object_t key = copyOf(f, &source->entries[k].key), value = copyOf(f, &source->entries[k].value);
+				insert(frozen, &key, &value);
+			}
+		}
+	}
+	*out = copyOf(f, value);
+	
+	//The state takes over the block's first reference
+	_winter_sharedHold(state, shared);
+	_winter_sharedRelease(shared);
+	f->shared = NULL;
+	return true;
+}
+
+bool_t _winter_freeze(winterState_t *state, const object_t *value, object_t *out) {
+	const object_t *volatile source = value->type == TYPE_REFERENCE ? value->pointer : value;
+	freezer_t f = { state };
+	volatile bool_t frozen = false;
+	jmp_buf handler, *previous = state->errorJump;
+	state->errorJump = &handler;
+	if (setjmp(handler) == 0) {
+		frozen = freeze(&f, source, out);
+	}
+	state->errorJump = previous;
+	_winter_indexFree(state, &f.index);
+	if (f.objects != NULL) FREE(f.objects);
+	if (f.copies != NULL)  FREE(f.copies);
+	if (f.shared != NULL)  _winter_sharedRelease(f.shared);
+	return frozen;
+}
+
+int winterFreeze(winterState_t *state, winterValue_t *value) {
+	return _winter_freeze(state, value, value) ? 0 : -1;
+}
+int winterIsFrozen(const winterValue_t *value) {
+	if (value->type == TYPE_REFERENCE) {
+		value = value->pointer;
+	}
+	return value->type == TYPE_FROZEN;
+}
@@ -0,0 +1,45 @@
+#ifndef FROZEN_H
+#define FROZEN_H
+
+#include "wtype.h"
+#include "object.h"
+#include "shared.h"
+
+//Slots are at most half full so probe sequences stay short
+#define FROZEN_LOAD 2
+
+typedef struct frozenEntry_t {
+	hash_t   hash;
+	object_t key; //TYPE_UNKNOWN in empty slots
+	object_t value;
+} frozenEntry_t;
+
+//Read only table that states on any thread can read at once
+//Freezing copies a table and everything it reaches into one shared block (see shared.h).
+//Each table is open addressed with linear probing over a power of two number of slots,
+//with the hash of each key stored next to it, so a lookup only touches contiguous memory.
+//Frozen tables are persistent, scripts see them as tables that can't be modified
+typedef struct frozen_t {
+	REFCOUNT;
+	shared_t     *shared;
+	size_t        size;
+	size_t        mask; //number of slots - 1
+	frozenEntry_t entries[];
+} frozen_t;
+
+//Copies the value into a new block held by the state, tables and frozen tables reached
+//from it become frozen tables of the block. Values that aren't counted are copied as is.
+//Returns false if a function is reached or the allocator fails
+bool_t _winter_freeze(winterState_t *state, const object_t *value, object_t *out);
+//Returns NULL if the key isn't in the table
+const object_t *_winter_frozenGet(const frozen_t *frozen, const object_t *key);
+
+//Values handed to the state by the host may be frozen tables of another state, whose block
+//the state must hold
+static inline void _winter_frozenHold(winterState_t *state, const object_t *value) {
+	if (value->type == TYPE_FROZEN) {
+		_winter_sharedHold(state, ((frozen_t*)value->pointer)->shared);
+	}
+}
+
+#endif
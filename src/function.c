@@ -0,0 +1,183 @@
+#include "function.h"
+#include "wstring.h"
+#include "table.h"
+#include "gc.h"
+
+//The public type numbers are the internal ones
+_Static_assert((int)WINTER_NULL == (int)TYPE_NULL && (int)WINTER_ERROR == (int)TYPE_ERROR, "public types out of sync");
+
+static inline function_t *functionAlloc(winterState_t *state, size_t numUpvalues) {
+	function_t *out = MALLOC(sizeof(function_t) + sizeof(upvalue_t*) * numUpvalues);
+	out->_refcount   = 0;
+	out->_zct        = false;
+	out->_type       = TYPE_FUNCTION;
+	out->_mark       = false;
+	out->_color      = GC_BLACK;
+	out->_buffered   = false;
+	out->native      = NULL;
+	out->arity       = 0;
+	out->proto       = NULL;
+	out->numUpvalues = numUpvalues;
+	out->upvalues    = (upvalue_t**)(out + 1);
+	state->memory.functions++;
+	_winter_zctPush(state, TYPE_FUNCTION, out);
+	return out;
+}
+
+function_t *_winter_functionAlloc(winterState_t *state, winterCFunction_t native, int arity) {
+	function_t *out = functionAlloc(state, 0);
+	out->native = native;
+	out->arity  = arity;
+	return out;
+}
+function_t *_winter_closureAlloc(winterState_t *state, proto_t *proto) {
+	function_t *out = functionAlloc(state, proto->numUpvalues);
+	out->numUpvalues = 0;
+	out->arity = proto->numParams;
+	out->proto = proto;
+	_winter_protoRetain(proto);
+	return out;
+}
+void _winter_functionFree(winterState_t *state, function_t *function) {
+	_winter_functionRelease(state, function, true);
+	state->memory.functions--;
+	FREE(function);
+}
+void _winter_functionRelease(winterState_t *state, function_t *function, bool_t cyclic) {
+	if (cyclic) {
+		for (size_t i = 0; i < function->numUpvalues; i++) {
+			object_t upvalue = { TYPE_UPVALUE, { .pointer = function->upvalues[i] } };
+			_winter_objectDelRef(state, &upvalue);
+		}
+	}
+	function->numUpvalues = 0;
+	if (function->proto != NULL) {
+		_winter_protoRelease(state, function->proto);
+		function->proto = NULL;
+	}
+}
+
+static inline upvalue_t *upvalueAlloc(winterState_t *state) {
+	upvalue_t *out = MALLOC(sizeof(upvalue_t));
+	out->_refcount = 0;
+	out->_zct      = false;
+	out->_type     = TYPE_UPVALUE;
+	out->_mark     = false;
+	out->_color    = GC_BLACK;
+	out->_buffered = false;
+	out->open      = false;
+	out->index     = 0;
+	out->closed    = (object_t){ TYPE_NULL };
+	out->next      = NULL;
+	return out;
+}
+
+upvalue_t *_winter_upvalueFind(winterState_t *state, size_t index) {
+	upvalue_t **link = &state->openUpvalues;
+	while (*link != NULL && (*link)->index > index) {
+		link = &(*link)->next;
+	}
+	if (*link != NULL && (*link)->index == index) {
+		return *link;
+	}
+	
+	upvalue_t *out = upvalueAlloc(state);
+	out->open  = true;
+	out->index = index;
+	out->next  = *link;
+	*link = out;
+	
+	//The open list holds a reference until the upvalue is closed
+	object_t obj = { TYPE_UPVALUE, { .pointer = out } };
+	_winter_objectAddRef(state, &obj);
+	_winter_zctPush(state, TYPE_UPVALUE, out);
+	return out;
+}
+upvalue_t *_winter_upvalueClosed(winterState_t *state) {
+	upvalue_t *out = upvalueAlloc(state);
+	_winter_zctPush(state, TYPE_UPVALUE, out);
+	return out;
+}
+void _winter_upvalueClose(winterState_t *state, size_t index) {
+	while (state->openUpvalues != NULL && state->openUpvalues->index >= index) {
+		upvalue_t *upvalue = state->openUpvalues;
+		state->openUpvalues = upvalue->next;
+		upvalue->closed = *_winter_objectAddRef(state, &state->stack[upvalue->index]);
+		upvalue->open   = false;
+		upvalue->next   = NULL;
+		
+		object_t obj = { TYPE_UPVALUE, { .pointer = upvalue } };
+		_winter_objectDelRef(state, &obj);
+	}
+}
+void _winter_upvalueRelease(winterState_t *state, upvalue_t *upvalue, bool_t cyclic) {
+	if (cyclic || !isCollectable(upvalue->closed.type)) {
+		_winter_objectDelRef(state, &upvalue->closed);
+	}
+	upvalue->closed = (object_t){ TYPE_NULL };
+}
+
+void winterRegister(winterState_t *state, const char *name, winterCFunction_t function, int arity) {
+	object_t key   = { TYPE_STRING,   { .string  = _winter_stringCreate(state, name) } };
+	object_t value = { TYPE_FUNCTION, { .pointer = _winter_functionAlloc(state, function, arity) } };
+	//Heap images find natives by the name they were registered under
+	_winter_tableSet(state, state->natives, &key, &value);
+	_winter_tableSet(state, state->globals, &key, &value);
+}
+
+object_t *_winter_nativeFind(winterState_t *state, object_t *name) {
+	return _winter_tableGetObject(state->natives, name);
+}
+const object_t *_winter_nativeName(winterState_t *state, function_t *function) {
+	for (tableIter_t it = {0}; _winter_tableNext(state->natives, &it);) {
+		if (it.value->pointer == function) {
+			return it.key;
+		}
+	}
+	return NULL;
+}
+
+winterType_t winterTypeOf(const winterValue_t *value) {
+	if (value->type == TYPE_REFERENCE) {
+		value = value->pointer;
+	}
+	return value->type == TYPE_FROZEN ? WINTER_TABLE : (winterType_t)value->type;
+}
+
+winterInt_t winterToInt(const winterValue_t *value) {
+	return _winter_castInt(value);
+}
+winterFloat_t winterToFloat(const winterValue_t *value) {
+	return _winter_castFloat(value);
+}
+const char *winterToString(const winterValue_t *value, size_t *length) {
+	if (value->type == TYPE_REFERENCE) {
+		value = value->pointer;
+	}
+	if (value->type != TYPE_STRING && value->type != TYPE_ERROR) {
+		return NULL;
+	}
+	if (length != NULL) {
+		*length = value->string->length;
+	}
+	return value->string->data;
+}
+
+void winterSetNull(winterValue_t *value) {
+	*value = (object_t){ TYPE_NULL };
+}
+void winterSetInt(winterValue_t *value, winterInt_t integer) {
+	*value = (object_t){ TYPE_INT, { .integer = integer } };
+}
+void winterSetFloat(winterValue_t *value, winterFloat_t floating) {
+	*value = (object_t){ TYPE_FLOAT, { .floating = floating } };
+}
+void winterSetString(winterState_t *state, winterValue_t *value, const char *string, size_t length) {
+	*value = (object_t){ TYPE_STRING, { .string = _winter_stringCreateSize(state, string, length) } };
+}
+void winterSetError(winterState_t *state, winterValue_t *value, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	_winter_objectNewErrorV(state, value, format, args);
+	va_end(args);
+}
@@ -0,0 +1,63 @@
+#ifndef FUNCTION_H
+#define FUNCTION_H
+
+#include "wtype.h"
+#include "object.h"
+#include "proto.h"
+
+//Accepts any number of arguments
+#define ARITY_VARIADIC -1
+
+//Variable captured by closures
+//While open the variable still lives in a register of a running function, once that
+//function returns or the variable leaves scope its value is moved into 'closed'
+typedef struct upvalue_t {
+	GCHEADER;
+	bool_t   open;
+	size_t   index; //stack index while open
+	object_t closed;
+	struct upvalue_t *next; //open upvalues, by decreasing index
+} upvalue_t;
+
+//Native function or closure, closures only hold the upvalues their prototype uses
+typedef struct function_t {
+	GCHEADER;
+	winterCFunction_t native; //NULL for closures
+	int arity;
+	proto_t *proto;
+	size_t numUpvalues;
+	upvalue_t **upvalues;
+} function_t;
+
+function_t *_winter_functionAlloc(winterState_t *state, winterCFunction_t native, int arity);
+//Has room for every upvalue of the prototype, the caller adds them one at a time
+function_t *_winter_closureAlloc(winterState_t *state, proto_t *proto);
+void _winter_functionFree(winterState_t *state, function_t *function);
+//Drops the upvalues and prototype, see _winter_tableRelease
+void _winter_functionRelease(winterState_t *state, function_t *function, bool_t cyclic);
+
+//Returns the open upvalue for the stack slot, creating it if needed
+upvalue_t *_winter_upvalueFind(winterState_t *state, size_t index);
+//Closes every open upvalue at or above the stack index
+void _winter_upvalueClose(winterState_t *state, size_t index);
+void _winter_upvalueRelease(winterState_t *state, upvalue_t *upvalue, bool_t cyclic);
+//Creates a closed upvalue holding null
+upvalue_t *_winter_upvalueClosed(winterState_t *state);
+
+//Registered native functions, NULL if there is none
+object_t       *_winter_nativeFind(winterState_t *state, object_t *name);
+const object_t *_winter_nativeName(winterState_t *state, function_t *function);
+
+static inline object_t *_winter_upvalueGet(winterState_t *state, upvalue_t *upvalue) {
+	return upvalue->open ? &state->stack[upvalue->index] : &upvalue->closed;
+}
+
+//Calls the function on the 'argc' values starting at 'args', the result is left in args[0]
+//'args' must have room for at least one value even when 'argc' is 0
+static inline void _winter_functionCall(winterState_t *state, function_t *function, object_t *args, int argc) {
+	if (function->native(state, args, argc) <= 0) {
+		args[0] = (object_t){ TYPE_NULL };
+	}
+}
+
+#endif
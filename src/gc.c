@@ -0,0 +1,405 @@
+#include "gc.h"
+#include "table.h"
+#include "wstring.h"
+#include "function.h"
+#include "array.h"
+#include <string.h>
+
+#define header(o) ((gcheader_t*)(o)->pointer)
+#define isTraced(o) (isCollectable((o)->type) && header(o)->_refcount != REF_PERSISTENT)
+
+typedef void (*visit_t)(winterState_t *state, object_t *child);
+
+//Calls 'visit' on every collectable object referenced by 'obj'
+static inline void forEachChild(winterState_t *state, object_t *obj, visit_t visit) {
+	switch (obj->type) {
+		case TYPE_TABLE: {
+			table_t *table = obj->pointer;
+			for (tableIter_t it = {0}; _winter_tableNext(table, &it);) {
+				if (isTraced(it.key)) {
+					visit(state, it.key);
+				}
+				if (isTraced(it.value)) {
+					visit(state, it.value);
+				}
+			}
+		} break;
+		
+		case TYPE_FUNCTION: {
+			function_t *function = obj->pointer;
+			for (size_t i = 0; i < function->numUpvalues; i++) {
+				object_t upvalue = { TYPE_UPVALUE, { .pointer = function->upvalues[i] } };
+				visit(state, &upvalue);
+			}
+		} break;
+		
+		case TYPE_UPVALUE: {
+			//Open upvalues point at the stack, which is never traced
+			upvalue_t *upvalue = obj->pointer;
+			if (!upvalue->open && isTraced(&upvalue->closed)) {
+				visit(state, &upvalue->closed);
+			}
+		} break;
+		
+		default: break;
+	}
+}
+
+//Frees the object, 'cyclic' controls whether references to collectable children are dropped
+static inline void freeObject(winterState_t *state, object_t *obj, bool_t cyclic, bool_t keepHeader) {
+	switch (obj->type) {
+		case TYPE_ERROR:
+		case TYPE_STRING:
+			_winter_stringFree(state, obj->pointer);
+			break;
+		
+		case TYPE_FUNCTION:
+			_winter_functionRelease(state, obj->pointer, cyclic);
+			if (!keepHeader) {
+				state->memory.functions--;
+				FREE(obj->pointer);
+			}
+			break;
+		
+		case TYPE_UPVALUE:
+			_winter_upvalueRelease(state, obj->pointer, cyclic);
+			if (!keepHeader) {
+				FREE(obj->pointer);
+			}
+			break;
+		
+		case TYPE_TABLE:
+			_winter_tableRelease(state, obj->pointer, cyclic);
+			if (!keepHeader) {
+				state->memory.tables--;
+				FREE(obj->pointer);
+			}
+			break;
+		
+		case TYPE_ARRAY:
+			_winter_arrayFree(state, obj->pointer);
+			break;
+		
+		default: break;
+	}
+}
+
+static inline void listPush(winterState_t *state, gclist_t *list, object_type_t type, void *pointer) {
+	if (list->size == list->capacity) {
+		size_t capacity = list->capacity ? list->capacity * 2 : GC_DEFAULT_BUDGET;
+		//Growing must not raise, the object would be lost
+		object_t *objects = _winter_poolAllocRaw(state, list->objects, sizeof(object_t) * capacity);
+		if (objects == NULL) {
+			_winter_memoryError(state);
+			return;
+		}
+		list->objects  = objects;
+		list->capacity = capacity;
+	}
+	list->objects[list->size++] = (object_t){ type, { .pointer = pointer } };
+}
+static inline void listFree(winterState_t *state, gclist_t *list) {
+	if (list->objects != NULL) {
+		FREE(list->objects);
+	}
+	*list = (gclist_t){0};
+}
+
+void _winter_gcInit(winterState_t *state) {
+	state->zct      = (gclist_t){0};
+	state->zctLimit = ZCT_DEFAULT_LIMIT;
+	state->gcRoots    = (gclist_t){0};
+	state->gcDeferred = (gclist_t){0};
+	state->gcWhite    = (gclist_t){0};
+	state->gcWork     = (gclist_t){0};
+	state->gcBudget   = GC_DEFAULT_BUDGET;
+}
+static void rebuffer(winterState_t *state);
+void _winter_gcFree(winterState_t *state) {
+	//Freeing garbage can release more objects
+	while (state->zct.size > 0 || state->gcRoots.size > 0 || state->gcDeferred.size > 0) {
+		rebuffer(state);
+		_winter_gcCollect(state, 0);
+	}
+	listFree(state, &state->zct);
+	listFree(state, &state->gcRoots);
+	listFree(state, &state->gcDeferred);
+	listFree(state, &state->gcWhite);
+	listFree(state, &state->gcWork);
+}
+
+//Stack values hold an uncounted reference, they are counted while the heap is inspected
+static inline void retainStack(winterState_t *state) {
+	for (size_t i = 0; i < state->top; i++) {
+		object_t *obj = &state->stack[i];
+		if (isRefCounted(obj->type)) {
+			refcount_t *ref = obj->pointer;
+			if (ref->_refcount != REF_PERSISTENT) {
+				ref->_refcount++;
+			}
+		}
+	}
+}
+static inline void releaseStack(winterState_t *state) {
+	for (size_t i = 0; i < state->top; i++) {
+		object_t *obj = &state->stack[i];
+		if (isRefCounted(obj->type)) {
+			refcount_t *ref = obj->pointer;
+			if (ref->_refcount != REF_PERSISTENT && --ref->_refcount == 0 && !ref->_zct) {
+				_winter_zctPush(state, obj->type, obj->pointer);
+			}
+		}
+	}
+}
+
+void _winter_zctPush(winterState_t *state, object_type_t type, void *pointer) {
+	((refcount_t*)pointer)->_zct = true;
+	listPush(state, &state->zct, type, pointer);
+}
+
+void _winter_reconcile(winterState_t *state) {
+	retainStack(state);
+	
+	//Freeing objects can push more entries, so the table is walked by index
+	for (size_t i = 0; i < state->zct.size; i++) {
+		object_t obj = state->zct.objects[i];
+		refcount_t *ref = obj.pointer;
+		ref->_zct = false;
+		if (ref->_refcount == 0) {
+			if (isCollectable(obj.type)) {
+				//Buffered objects are freed once the collector reaches them
+				gcheader_t *gc = obj.pointer;
+				gc->_color = GC_BLACK;
+				freeObject(state, &obj, true, gc->_buffered);
+			} else {
+				freeObject(state, &obj, true, false);
+			}
+		} else if (isCollectable(obj.type) && ref->_refcount != REF_PERSISTENT) {
+			//New objects never had their count decremented, so they could be in a cycle
+			_winter_gcPossibleRoot(state, &obj);
+		}
+	}
+	state->zct.size = 0;
+	
+	releaseStack(state);
+	
+	//Values left on the stack would make every scan reconcile again
+	state->zctLimit = ZCT_DEFAULT_LIMIT;
+	if (state->zct.size * 2 > state->zctLimit) {
+		state->zctLimit = state->zct.size * 2;
+	}
+}
+
+void _winter_zctCheck(winterState_t *state) {
+	if (state->zct.size >= state->zctLimit) {
+		_winter_reconcile(state);
+		rebuffer(state);
+	}
+}
+
+void _winter_gcPossibleRoot(winterState_t *state, object_t *obj) {
+	gcheader_t *gc = header(obj);
+	if (gc->_color != GC_PURPLE) {
+		gc->_color = GC_PURPLE;
+		if (!gc->_buffered) {
+			gc->_buffered = true;
+			listPush(state, &state->gcRoots, obj->type, obj->pointer);
+		}
+	}
+}
+
+//The walks below keep the objects left to visit in state->gcWork instead of recursing, so
+//long chains can't overflow the C stack. Each one pops back down to where it started
+static void workPush(winterState_t *state, object_t *obj) {
+	listPush(state, &state->gcWork, obj->type, obj->pointer);
+}
+static inline bool_t workPop(gclist_t *work, size_t base, object_t *obj) {
+	if (work->size == base) {
+		return false;
+	}
+	*obj = work->objects[--work->size];
+	return true;
+}
+
+static void markGrayChild(winterState_t *state, object_t *child) {
+	header(child)->_refcount--;
+	workPush(state, child);
+}
+//Returns the number of objects traced
+static size_t markGray(winterState_t *state, object_t *root) {
+	size_t base = state->gcWork.size, traced = 0;
+	workPush(state, root);
+	for (object_t obj; workPop(&state->gcWork, base, &obj);) {
+		if (header(&obj)->_color != GC_GRAY) {
+			header(&obj)->_color = GC_GRAY;
+			forEachChild(state, &obj, markGrayChild);
+			traced++;
+		}
+	}
+	return traced;
+}
+
+static void scanBlackChild(winterState_t *state, object_t *child) {
+	header(child)->_refcount++;
+	if (header(child)->_color != GC_BLACK) {
+		header(child)->_color = GC_BLACK;
+		workPush(state, child);
+	}
+}
+static void scanBlack(winterState_t *state, object_t *root) {
+	size_t base = state->gcWork.size;
+	header(root)->_color = GC_BLACK;
+	workPush(state, root);
+	for (object_t obj; workPop(&state->gcWork, base, &obj);) {
+		forEachChild(state, &obj, scanBlackChild);
+	}
+}
+
+static void scan(winterState_t *state, object_t *root) {
+	size_t base = state->gcWork.size;
+	workPush(state, root);
+	for (object_t obj; workPop(&state->gcWork, base, &obj);) {
+		gcheader_t *gc = header(&obj);
+		if (gc->_color == GC_GRAY) {
+			if (gc->_refcount > 0) {
+				scanBlack(state, &obj);
+			} else {
+				gc->_color = GC_WHITE;
+				forEachChild(state, &obj, workPush);
+			}
+		}
+	}
+}
+
+//Stack values aren't counted, so what only the stack keeps is white after scanning and is
+//made black again here. Roots it keeps are set aside instead of dropped: a stale register
+//decrements nothing once it's overwritten, so nothing would buffer them again
+static void scanStack(winterState_t *state, size_t count) {
+	object_t *roots = state->gcRoots.objects;
+	size_t base = state->gcWhite.size;
+	for (size_t i = 0; i < count; i++) {
+		if (roots[i].type != TYPE_UNKNOWN && header(&roots[i])->_color == GC_WHITE) {
+			listPush(state, &state->gcWhite, roots[i].type, roots[i].pointer);
+		}
+	}
+	for (size_t i = 0; i < state->top; i++) {
+		object_t *obj = &state->stack[i];
+		if (isTraced(obj) && header(obj)->_color == GC_WHITE) {
+			scanBlack(state, obj);
+		}
+	}
+	for (size_t i = base; i < state->gcWhite.size; i++) {
+		object_t *obj = &state->gcWhite.objects[i];
+		if (header(obj)->_color == GC_BLACK) {
+			listPush(state, &state->gcDeferred, obj->type, obj->pointer);
+		}
+	}
+	state->gcWhite.size = base;
+}
+//Deferred roots keep their buffered flag, so they're only ever in one of the lists
+static void rebuffer(winterState_t *state) {
+	for (size_t i = 0; i < state->gcDeferred.size; i++) {
+		object_t *obj = &state->gcDeferred.objects[i];
+		//Ones freed since keep their header for the collector
+		if (header(obj)->_refcount > 0) {
+			header(obj)->_color = GC_PURPLE;
+		}
+		listPush(state, &state->gcRoots, obj->type, obj->pointer);
+	}
+	state->gcDeferred.size = 0;
+}
+
+//Garbage is only freed once the whole slice is traced so no freed header is read
+static void collectWhite(winterState_t *state, object_t *root) {
+	size_t base = state->gcWork.size;
+	workPush(state, root);
+	for (object_t obj; workPop(&state->gcWork, base, &obj);) {
+		gcheader_t *gc = header(&obj);
+		if (gc->_color == GC_WHITE) {
+			gc->_color = GC_BLACK;
+			gc->_refcount = 0;
+			listPush(state, &state->gcWhite, obj.type, obj.pointer);
+			forEachChild(state, &obj, workPush);
+		}
+	}
+}
+
+size_t _winter_gcCollect(winterState_t *state, size_t budget) {
+	//Objects in the zero count table must not be traced
+	_winter_reconcile(state);
+	
+	//Mark roots until the budget of traced objects is spent, anything no longer purple is
+	//dropped from the slice. Roots an earlier one reached are gray and cost nothing, so they
+	//join the slice past the budget. Freeing a dropped root can buffer new ones, which moves
+	//the list. Only the stack holds the ones in the zero count table, which frees them
+	size_t count = 0;
+	for (size_t traced = 0; count < state->gcRoots.size; count++) {
+		object_t root = state->gcRoots.objects[count];
+		gcheader_t *gc = header(&root);
+		if (budget != 0 && traced >= budget && gc->_color != GC_GRAY) {
+			break;
+		} else if (gc->_color == GC_GRAY || (gc->_color == GC_PURPLE && gc->_refcount > 0)) {
+			traced += markGray(state, &root);
+		} else {
+			gc->_buffered = false;
+			if (gc->_color == GC_BLACK && gc->_refcount == 0 && !gc->_zct) {
+				freeObject(state, &root, true, false);
+			}
+			state->gcRoots.objects[count].type = TYPE_UNKNOWN;
+			traced++;
+		}
+	}
+	
+	object_t *roots = state->gcRoots.objects;
+	for (size_t i = 0; i < count; i++) {
+		if (roots[i].type != TYPE_UNKNOWN) {
+			scan(state, &roots[i]);
+		}
+	}
+	scanStack(state, count);
+	
+	//Every root in the slice must be unbuffered before any are freed, deferred ones stay buffered
+	for (size_t i = 0; i < count; i++) {
+		if (roots[i].type != TYPE_UNKNOWN) {
+			header(&roots[i])->_buffered = false;
+		}
+	}
+	for (size_t i = 0; i < state->gcDeferred.size; i++) {
+		header(&state->gcDeferred.objects[i])->_buffered = true;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (roots[i].type != TYPE_UNKNOWN) {
+			collectWhite(state, &roots[i]);
+		}
+	}
+	
+	//Roots outside of the current slice keep their header until the collector reaches them
+	for (size_t i = 0; i < state->gcWhite.size; i++) {
+		object_t *obj = &state->gcWhite.objects[i];
+		freeObject(state, obj, false, header(obj)->_buffered);
+	}
+	state->gcWhite.size = 0;
+	
+	if (count > 0) {
+		state->gcRoots.size -= count;
+		memmove(roots, roots + count, sizeof(object_t) * state->gcRoots.size);
+	}
+	return state->gcRoots.size;
+}
+
+void _winter_gcCheck(winterState_t *state) {
+	if (state->gcRoots.size >= state->gcBudget) {
+		_winter_gcCollect(state, state->gcBudget);
+	}
+}
+
+void winterCollect(winterState_t *state) {
+	rebuffer(state);
+	_winter_gcCollect(state, 0);
+}
+size_t winterCollectStep(winterState_t *state) {
+	return _winter_gcCollect(state, state->gcBudget);
+}
+void winterSetCollectBudget(winterState_t *state, size_t objects) {
+	state->gcBudget = objects ? objects : GC_DEFAULT_BUDGET;
+}
@@ -0,0 +1,44 @@
+#ifndef GC_H
+#define GC_H
+
+#include "wtype.h"
+#include "object.h"
+
+//Number of objects traced per collection slice by default
+#define GC_DEFAULT_BUDGET 64
+//Number of zero count objects that triggers a stack scan by default
+#define ZCT_DEFAULT_LIMIT 256
+
+//Synchronous cycle collector (Bacon-Rajan trial deletion)
+typedef enum gc_color_t {
+	GC_BLACK = 0, //in use or free
+	GC_GRAY,      //possible member of a cycle
+	GC_WHITE,     //member of a garbage cycle
+	GC_PURPLE     //possible root of a cycle
+} gc_color_t;
+
+//True if the type can reference other objects and form cycles
+#define isCollectable(t) ((t) == TYPE_TABLE || (t) == TYPE_FUNCTION || (t) == TYPE_UPVALUE)
+
+void _winter_gcInit(winterState_t *state);
+void _winter_gcFree(winterState_t *state);
+
+//Deferred reference counting
+//New objects and objects whose count drops to zero are added to the zero count table,
+//reconciling scans the stack and frees every one of them the stack doesn't hold
+void _winter_zctPush(winterState_t *state, object_type_t type, void *pointer);
+void _winter_reconcile(winterState_t *state);
+//Reconciles once the table is full, only call when every live value is on the stack
+//Roots a collection set aside because only the stack kept them are buffered again
+void _winter_zctCheck(winterState_t *state);
+
+//Buffers an object whose reference count was decremented to nonzero
+void _winter_gcPossibleRoot(winterState_t *state, object_t *obj);
+
+//Processes candidate roots until 'budget' objects are traced (0 for all roots), returns
+//number of roots still buffered. The objects a root reaches are traced in the same slice
+size_t _winter_gcCollect(winterState_t *state, size_t budget);
+//Runs a slice once enough roots are buffered, only call when no unowned pointers are held
+void _winter_gcCheck(winterState_t *state);
+
+#endif
@@ -0,0 +1,628 @@
+#include "image.h"
+#include "chunk.h"
+#include "table.h"
+#include "wstring.h"
+#include "function.h"
+#include "index.h"
+#include <stdio.h>
+#include <string.h>
+
+//Sections are 8 byte aligned so values can be read in place
+#define ALIGN(s) (((s) + 7) & ~(size_t)7)
+#define AT(type, offset) ((type*)(s->out + (offset)))
+
+//Saving
+
+typedef struct saver_t {
+	winterState_t *state;
+	jmp_buf        jump;
+	
+	index_t    objectIndex;
+	object_t  *objects;
+	size_t     numObjects, objectCapacity;
+	index_t    protoIndex;
+	proto_t  **protos;
+	size_t     numProtos, protoCapacity;
+	
+	unsigned char *out;
+	size_t         size, capacity;
+} saver_t;
+
+static inline void *grow(saver_t *s, void *array, size_t *capacity, size_t count, size_t size) {
+	winterState_t *state = s->state;
+	if (count == *capacity) {
+		array = REALLOC(array, (*capacity ? *capacity * 2 : 64) * size);
+		*capacity = *capacity ? *capacity * 2 : 64;
+	}
+	return array;
+}
+
+//Returns the index of the object, adding it if it's new
+static uint32_t addObject(saver_t *s, const object_t *obj) {
+	int64_t index = _winter_indexFind(&s->objectIndex, obj->pointer);
+	if (index >= 0) {
+		return (uint32_t)index;
+	} else if (obj->type == TYPE_FROZEN || obj->type == TYPE_ARRAY) {
+		//Frozen tables belong to a shared block, not to the state, arrays aren't saved yet
+		longjmp(s->jump, 1);
+	}
+	s->objects = grow(s, s->objects, &s->objectCapacity, s->numObjects, sizeof(object_t));
+	s->objects[s->numObjects] = *obj;
+	_winter_indexInsert(s->state, &s->objectIndex, obj->pointer, (uint32_t)s->numObjects);
+	return (uint32_t)s->numObjects++;
+}
+static uint32_t addProto(saver_t *s, proto_t *proto) {
+	int64_t index = _winter_indexFind(&s->protoIndex, proto);
+	if (index >= 0) {
+		return (uint32_t)index;
+	}
+	s->protos = grow(s, s->protos, &s->protoCapacity, s->numProtos, sizeof(proto_t*));
+	s->protos[s->numProtos] = proto;
+	_winter_indexInsert(s->state, &s->protoIndex, proto, (uint32_t)s->numProtos);
+	return (uint32_t)s->numProtos++;
+}
+static inline void addValue(saver_t *s, const object_t *value) {
+	if (isRefCounted(value->type)) {
+		addObject(s, value);
+	}
+}
+
+//Adds everything the object references
+static void gather(saver_t *s, object_t obj) {
+	switch (obj.type) {
+		case TYPE_TABLE: {
+			table_t *table = obj.pointer;
+			for (tableIter_t it = {0}; _winter_tableNext(table, &it);) {
+				addValue(s, it.key);
+				addValue(s, it.value);
+			}
+		} break;
+		
+		case TYPE_FUNCTION: {
+			function_t *function = obj.pointer;
+			if (function->native != NULL) {
+				const object_t *name = _winter_nativeName(s->state, function);
+				if (name == NULL) {
+					longjmp(s->jump, 1);
+				}
+				addObject(s, name);
+			} else {
+				addProto(s, function->proto);
+				for (size_t i = 0; i < function->numUpvalues; i++) {
+					addObject(s, &(object_t){ TYPE_UPVALUE, { .pointer = function->upvalues[i] } });
+				}
+			}
+		} break;
+		
+		case TYPE_UPVALUE:
+			addValue(s, &((upvalue_t*)obj.pointer)->closed);
+			break;
+		
+		default: break;
+	}
+}
+static void gatherProto(saver_t *s, proto_t *proto) {
+	for (size_t i = 0; i < proto->numConstants; i++) {
+		addValue(s, &proto->constants[i]);
+	}
+	for (size_t i = 0; i < proto->numProtos; i++) {
+		addProto(s, proto->protos[i]);
+	}
+}
+
+//Returns the offset of 'size' bytes copied from 'data', or zeroed if it's NULL
+static uint32_t append(saver_t *s, const void *data, size_t size) {
+	winterState_t *state = s->state;
+	size_t offset = s->size;
+	if (offset + ALIGN(size) > UINT32_MAX) {
+		longjmp(s->jump, 1);
+	}
+	if (offset + ALIGN(size) > s->capacity) {
+		size_t capacity = s->capacity ? s->capacity : 4096;
+		while (capacity < offset + ALIGN(size)) {
+			capacity *= 2;
+		}
+		s->out = REALLOC(s->out, capacity);
+		s->capacity = capacity;
+	}
+	if (data != NULL) {
+		memcpy(s->out + offset, data, size);
+		memset(s->out + offset + size, 0, ALIGN(size) - size);
+	} else {
+		memset(s->out + offset, 0, ALIGN(size));
+	}
+	s->size += ALIGN(size);
+	return (uint32_t)offset;
+}
+
+static inline imageValue_t toValue(saver_t *s, const object_t *value) {
+	imageValue_t out = { value->type };
+	if (isRefCounted(value->type)) {
+		out.value = (uint64_t)_winter_indexFind(&s->objectIndex, value->pointer);
+	} else if (value->type != TYPE_NULL) {
+		out.value = (uint64_t)value->integer;
+	}
+	return out;
+}
+
+static void emitObject(saver_t *s, size_t index, uint32_t objects) {
+	object_t *obj = &s->objects[index];
+	imageObject_t record = { obj->type };
+	switch (obj->type) {
+		case TYPE_STRING:
+		case TYPE_ERROR:
+			record.count = (uint32_t)obj->string->length;
+			record.data  = append(s, obj->string->data, obj->string->length + 1);
+			break;
+		
+		case TYPE_TABLE: {
+			table_t *table = obj->pointer;
+			for (tableIter_t it = {0}; _winter_tableNext(table, &it);) {
+				record.count++;
+			}
+			record.data  = append(s, NULL, sizeof(imageValue_t) * 2 * record.count);
+			record.extra = (uint32_t)table->numBuckets;
+			imageValue_t *pairs = AT(imageValue_t, record.data);
+			for (tableIter_t it = {0}; _winter_tableNext(table, &it);) {
+				*pairs++ = toValue(s, it.key);
+				*pairs++ = toValue(s, it.value);
+			}
+		} break;
+		
+		case TYPE_FUNCTION: {
+			function_t *function = obj->pointer;
+			if (function->native != NULL) {
+				record.count = IMAGE_NATIVE;
+				record.data  = (uint32_t)_winter_indexFind(&s->objectIndex, _winter_nativeName(s->state, function)->pointer);
+				record.extra = (uint32_t)function->arity;
+			} else {
+				record.count = (uint32_t)function->numUpvalues;
+				record.data  = append(s, NULL, sizeof(uint32_t) * function->numUpvalues);
+				record.extra = (uint32_t)_winter_indexFind(&s->protoIndex, function->proto);
+				for (size_t i = 0; i < function->numUpvalues; i++) {
+					AT(uint32_t, record.data)[i] = (uint32_t)_winter_indexFind(&s->objectIndex, function->upvalues[i]);
+				}
+			}
+		} break;
+		
+		case TYPE_UPVALUE: {
+			imageValue_t closed = toValue(s, &((upvalue_t*)obj->pointer)->closed);
+			record.data = append(s, &closed, sizeof(closed));
+		} break;
+		
+		default: break;
+	}
+	AT(imageObject_t, objects)[index] = record;
+}
+
+static void emitProto(saver_t *s, size_t index, uint32_t protos) {
+	proto_t *proto = s->protos[index];
+	imageProto_t record = {0};
+	record.numCode      = (uint32_t)proto->numCode;
+	record.code         = append(s, proto->code, sizeof(uint32_t) * proto->numCode);
+	if (proto->lines != NULL) {
+		record.lines    = append(s, proto->lines, sizeof(uint32_t) * proto->numCode);
+	}
+	record.numConstants = (uint32_t)proto->numConstants;
+	record.constants    = append(s, NULL, sizeof(imageValue_t) * proto->numConstants);
+	for (size_t i = 0; i < proto->numConstants; i++) {
+		AT(imageValue_t, record.constants)[i] = toValue(s, &proto->constants[i]);
+	}
+	record.numProtos    = (uint32_t)proto->numProtos;
+	record.protos       = append(s, NULL, sizeof(uint32_t) * proto->numProtos);
+	for (size_t i = 0; i < proto->numProtos; i++) {
+		AT(uint32_t, record.protos)[i] = (uint32_t)_winter_indexFind(&s->protoIndex, proto->protos[i]);
+	}
+	if (proto->numUpvalues > 0) {
+		record.upvalues = append(s, proto->upvalues, sizeof(upvaldesc_t) * proto->numUpvalues);
+	}
+	record.numUpvalues  = proto->numUpvalues;
+	record.numParams    = proto->numParams;
+	record.numRegisters = proto->numRegisters;
+	AT(imageProto_t, protos)[index] = record;
+}
+
+static void save(saver_t *s) {
+	table_t *globals = s->state->globals;
+	uint32_t numGlobals = 0;
+	for (tableIter_t it = {0}; _winter_tableNext(globals, &it);) {
+		addValue(s, it.key);
+		addValue(s, it.value);
+		numGlobals++;
+	}
+	
+	//Gathering can add more of either
+	size_t objectsDone = 0, protosDone = 0;
+	while (objectsDone < s->numObjects || protosDone < s->numProtos) {
+		while (objectsDone < s->numObjects) {
+			gather(s, s->objects[objectsDone++]);
+		}
+		while (protosDone < s->numProtos) {
+			gatherProto(s, s->protos[protosDone++]);
+		}
+	}
+	
+	append(s, NULL, sizeof(imageHeader_t));
+	uint32_t objects = append(s, NULL, sizeof(imageObject_t) * s->numObjects);
+	uint32_t protos  = append(s, NULL, sizeof(imageProto_t) * s->numProtos);
+	uint32_t pairs   = append(s, NULL, sizeof(imageValue_t) * 2 * numGlobals);
+	imageValue_t *pair = AT(imageValue_t, pairs);
+	for (tableIter_t it = {0}; _winter_tableNext(globals, &it);) {
+		*pair++ = toValue(s, it.key);
+		*pair++ = toValue(s, it.value);
+	}
+	for (size_t i = 0; i < s->numObjects; i++) {
+		emitObject(s, i, objects);
+	}
+	for (size_t i = 0; i < s->numProtos; i++) {
+		emitProto(s, i, protos);
+	}
+	
+	imageHeader_t *header = AT(imageHeader_t, 0);
+	memcpy(header->magic, IMAGE_MAGIC, sizeof(header->magic));
+	header->version    = IMAGE_VERSION;
+	header->byteOrder  = IMAGE_BYTE_ORDER;
+	header->size       = (uint32_t)s->size;
+	header->numObjects = (uint32_t)s->numObjects;
+	header->objects    = objects;
+	header->numProtos  = (uint32_t)s->numProtos;
+	header->protos     = protos;
+	header->numGlobals = numGlobals;
+	header->globals    = pairs;
+}
+
+int winterSaveImage(winterState_t *state, winterWriter_t writer, void *user) {
+	//Open upvalues and registers of running functions can't be saved
+	if (state->numFrames > 0) {
+		return -1;
+	}
+	
+	saver_t s = { state };
+	volatile int status = -1;
+	jmp_buf *previous = state->errorJump;
+	state->errorJump = &s.jump;
+	if (setjmp(s.jump) == 0) {
+		save(&s);
+		status = 0;
+	}
+	state->errorJump = previous;
+	
+	if (status == 0) {
+		status = writer(user, s.out, s.size);
+	}
+	_winter_indexFree(state, &s.objectIndex);
+	_winter_indexFree(state, &s.protoIndex);
+	if (s.objects)          FREE(s.objects);
+	if (s.protos)           FREE(s.protos);
+	if (s.out)              FREE(s.out);
+	return status;
+}
+
+//Loading
+
+typedef struct restore_t {
+	const unsigned char *data;
+	size_t        size;
+	imageHeader_t header;
+	const imageObject_t *objects;
+	const imageProto_t  *protos;
+	const imageValue_t  *globals;
+	
+	jmp_buf       jump;
+	const char   *missing; //name of a native function that isn't registered
+	object_t     *values;  //by object index
+	proto_t     **built;
+	object_t     *pairs;   //globals, set together once everything is built
+} restore_t;
+
+static inline bool_t inside(restore_t *r, uint64_t offset, uint64_t count, uint64_t size, uint64_t align) {
+	return offset % align == 0 && offset <= r->size && count <= (r->size - offset) / size;
+}
+
+static inline bool_t validValue(restore_t *r, const imageValue_t *value) {
+	switch (value->type) {
+		case TYPE_NULL:
+		case TYPE_INT:
+		case TYPE_FLOAT:
+			return true;
+		
+		case TYPE_STRING:
+		case TYPE_ERROR:
+		case TYPE_TABLE:
+		case TYPE_FUNCTION:
+			return value->value < r->header.numObjects && r->objects[value->value].type == value->type;
+		
+		default: return false;
+	}
+}
+static inline bool_t validValues(restore_t *r, uint32_t offset, uint64_t count) {
+	if (!inside(r, offset, count, sizeof(imageValue_t), 8)) {
+		return false;
+	}
+	const imageValue_t *values = (const imageValue_t*)(r->data + offset);
+	for (size_t i = 0; i < count; i++) {
+		if (!validValue(r, &values[i])) return false;
+	}
+	return true;
+}
+static inline bool_t validIndices(restore_t *r, uint32_t offset, uint64_t count, uint32_t limit) {
+	if (!inside(r, offset, count, sizeof(uint32_t), 4)) {
+		return false;
+	}
+	const uint32_t *indices = (const uint32_t*)(r->data + offset);
+	for (size_t i = 0; i < count; i++) {
+		if (indices[i] >= limit) return false;
+	}
+	return true;
+}
+
+static bool_t validObject(restore_t *r, const imageObject_t *object) {
+	imageHeader_t *header = &r->header;
+	switch (object->type) {
+		case TYPE_STRING:
+		case TYPE_ERROR:
+			return inside(r, object->data, (uint64_t)object->count + 1, 1, 1) &&
+				   r->data[object->data + object->count] == '\0';
+		
+		case TYPE_TABLE:
+			return object->extra <= (uint64_t)object->count * 2 + 8 &&
+				   validValues(r, object->data, (uint64_t)object->count * 2);
+		
+		case TYPE_FUNCTION:
+			if (object->count == IMAGE_NATIVE) {
+				return object->data < header->numObjects && r->objects[object->data].type == TYPE_STRING;
+			} else if (object->extra >= header->numProtos || object->count != r->protos[object->extra].numUpvalues ||
+					   !validIndices(r, object->data, object->count, header->numObjects)) {
+				return false;
+			} else {
+				const uint32_t *upvalues = (const uint32_t*)(r->data + object->data);
+				for (size_t i = 0; i < object->count; i++) {
+					if (r->objects[upvalues[i]].type != TYPE_UPVALUE) return false;
+				}
+				return true;
+			}
+		
+		case TYPE_UPVALUE:
+			return validValues(r, object->data, 1);
+		
+		default: return false;
+	}
+}
+
+static bool_t validProto(restore_t *r, const imageProto_t *proto) {
+	return proto->numCode > 0 && inside(r, proto->code, proto->numCode, sizeof(uint32_t), 4) &&
+		   (proto->lines == 0 || inside(r, proto->lines, proto->numCode, sizeof(uint32_t), 4)) &&
+		   validValues(r, proto->constants, proto->numConstants) &&
+		   validIndices(r, proto->protos, proto->numProtos, r->header.numProtos) &&
+		   (proto->numUpvalues == 0 || inside(r, proto->upvalues, proto->numUpvalues, sizeof(upvaldesc_t), 1)) &&
+		   proto->numRegisters >= proto->numParams && proto->numRegisters > 0 && proto->numRegisters <= MAX_REGISTERS;
+}
+
+static bool_t validate(restore_t *r) {
+	imageHeader_t *header = &r->header;
+	if (!inside(r, header->objects, header->numObjects, sizeof(imageObject_t), 4) ||
+		!inside(r, header->protos, header->numProtos, sizeof(imageProto_t), 4)) {
+		return false;
+	}
+	r->objects = (const imageObject_t*)(r->data + header->objects);
+	r->protos  = (const imageProto_t*)(r->data + header->protos);
+	r->globals = (const imageValue_t*)(r->data + header->globals);
+	
+	for (size_t i = 0; i < header->numObjects; i++) {
+		if (!validObject(r, &r->objects[i])) return false;
+	}
+	for (size_t i = 0; i < header->numProtos; i++) {
+		if (!validProto(r, &r->protos[i])) return false;
+	}
+	return validValues(r, header->globals, (uint64_t)header->numGlobals * 2);
+}
+
+static inline object_t toObject(restore_t *r, const imageValue_t *value) {
+	if (isRefCounted(value->type)) {
+		return r->values[value->value];
+	}
+	object_t out = { value->type };
+	out.integer = (winterInt_t)value->value;
+	return out;
+}
+
+//Allocates every object, then resolves the indices between them
+static void restore(winterState_t *state, restore_t *r, mapping_t *mapping) {
+	imageHeader_t *header = &r->header;
+	r->values = MALLOC(sizeof(object_t) * header->numObjects);
+	r->built  = MALLOC(sizeof(proto_t*) * header->numProtos);
+	if (r->built != NULL) {
+		memset(r->built, 0, sizeof(proto_t*) * header->numProtos);
+	}
+	
+	for (size_t i = 0; i < header->numObjects; i++) {
+		const imageObject_t *object = &r->objects[i];
+		object_t *value = &r->values[i];
+		*value = (object_t){ object->type };
+		switch (object->type) {
+			case TYPE_STRING:
+			case TYPE_ERROR:
+				value->string = _winter_stringCreateSize(state, (const char*)r->data + object->data, object->count);
+				if (object->type == TYPE_ERROR) {
+					value->string->_type = TYPE_ERROR;
+					state->memory.strings--;
+					state->memory.errors++;
+				}
+				break;
+			
+			case TYPE_TABLE:   value->pointer = _winter_tableAlloc(state, object->extra); break;
+			case TYPE_UPVALUE: value->pointer = _winter_upvalueClosed(state); break;
+			default: break;
+		}
+	}
+	for (size_t i = 0; i < header->numObjects; i++) {
+		const imageObject_t *object = &r->objects[i];
+		if (object->type == TYPE_FUNCTION && object->count == IMAGE_NATIVE) {
+			object_t *native = _winter_nativeFind(state, &r->values[object->data]);
+			if (native == NULL) {
+				r->missing = r->values[object->data].string->data;
+				longjmp(r->jump, 1);
+			}
+			r->values[i] = *native;
+		}
+	}
+	
+	for (size_t i = 0; i < header->numProtos; i++) {
+		const imageProto_t *record = &r->protos[i];
+		proto_t *proto = r->built[i] = _winter_protoAlloc(state);
+		proto->mapping = mapping;
+		mapping->references++;
+		proto->code         = (uint32_t*)(r->data + record->code);
+		proto->lines        = record->lines ? (uint32_t*)(r->data + record->lines) : NULL;
+		proto->numCode      = record->numCode;
+		proto->upvalues     = record->numUpvalues ? (upvaldesc_t*)(r->data + record->upvalues) : NULL;
+		proto->numUpvalues  = record->numUpvalues;
+		proto->numParams    = record->numParams;
+		proto->numRegisters = record->numRegisters;
+	}
+	for (size_t i = 0; i < header->numProtos; i++) {
+		const imageProto_t *record = &r->protos[i];
+		proto_t *proto = r->built[i];
+		if (record->numConstants > 0) {
+			const imageValue_t *constants = (const imageValue_t*)(r->data + record->constants);
+			proto->constants = MALLOC(sizeof(object_t) * record->numConstants);
+			for (size_t k = 0; k < record->numConstants; k++) {
+				proto->constants[k] = toObject(r, &constants[k]);
+				_winter_objectAddRef(state, &proto->constants[k]);
+			}
+			proto->numConstants = record->numConstants;
+		}
+		if (record->numProtos > 0) {
+			const uint32_t *children = (const uint32_t*)(r->data + record->protos);
+			proto->protos = MALLOC(sizeof(proto_t*) * record->numProtos);
+			for (size_t k = 0; k < record->numProtos; k++) {
+				proto->protos[k] = r->built[children[k]];
+				_winter_protoRetain(proto->protos[k]);
+			}
+			proto->numProtos = record->numProtos;
+		}
+	}
+	
+	for (size_t i = 0; i < header->numObjects; i++) {
+		const imageObject_t *object = &r->objects[i];
+		if (object->type == TYPE_FUNCTION && object->count != IMAGE_NATIVE) {
+			r->values[i].pointer = _winter_closureAlloc(state, r->built[object->extra]);
+		}
+	}
+	for (size_t i = 0; i < header->numObjects; i++) {
+		const imageObject_t *object = &r->objects[i];
+		object_t *value = &r->values[i];
+		if (object->type == TYPE_TABLE) {
+			const imageValue_t *pairs = (const imageValue_t*)(r->data + object->data);
+			for (size_t k = 0; k < object->count; k++) {
+				object_t key = toObject(r, &pairs[k * 2]), field = toObject(r, &pairs[k * 2 + 1]);
+				_winter_tableSet(state, value->pointer, &key, &field);
+			}
+		} else if (object->type == TYPE_FUNCTION && object->count != IMAGE_NATIVE) {
+			function_t *closure = value->pointer;
+			const uint32_t *upvalues = (const uint32_t*)(r->data + object->data);
+			for (size_t k = 0; k < object->count; k++) {
+				object_t upvalue = r->values[upvalues[k]];
+				_winter_objectAddRef(state, &upvalue);
+				closure->upvalues[closure->numUpvalues++] = upvalue.pointer;
+			}
+		} else if (object->type == TYPE_UPVALUE) {
+			upvalue_t *upvalue = value->pointer;
+			upvalue->closed = toObject(r, (const imageValue_t*)(r->data + object->data));
+			_winter_objectAddRef(state, &upvalue->closed);
+		}
+	}
+	
+	//A failed load leaves the globals as they were
+	if (header->numGlobals > 0) {
+		r->pairs = MALLOC(sizeof(object_t) * 2 * header->numGlobals);
+		for (size_t i = 0; i < (size_t)header->numGlobals * 2; i++) {
+			r->pairs[i] = toObject(r, &r->globals[i]);
+		}
+		_winter_tableSetAll(state, state->globals, r->pairs, header->numGlobals);
+	}
+}
+
+//Objects left unreferenced by a failed load are freed by the next reconcile
+static int load(winterState_t *state, mapping_t *mapping, char *error, size_t errorSize) {
+	restore_t r = { mapping->address, mapping->size };
+	const char *volatile message = NULL;
+	if (r.size < sizeof(imageHeader_t)) {
+		message = "not a heap image";
+	} else {
+		memcpy(&r.header, r.data, sizeof(imageHeader_t));
+		if (memcmp(r.header.magic, IMAGE_MAGIC, sizeof(r.header.magic)) != 0) {
+			message = "not a heap image";
+		} else if (r.header.version != IMAGE_VERSION) {
+			message = "heap image was written by an incompatible version";
+		} else if (r.header.byteOrder != IMAGE_BYTE_ORDER) {
+			message = "heap image was written with a different byte order";
+		} else if (r.header.size != r.size || !validate(&r)) {
+			message = "corrupt heap image";
+		}
+	}
+	
+	if (message == NULL) {
+		jmp_buf *previous = state->errorJump;
+		state->errorJump = &r.jump;
+		if (setjmp(r.jump) == 0) {
+			restore(state, &r, mapping);
+		} else {
+			message = r.missing ? "native function '%s' isn't registered" : "out of memory";
+		}
+		state->errorJump = previous;
+		
+		//Prototypes are held by their closures and parents
+		if (r.built != NULL) {
+			for (size_t i = 0; i < r.header.numProtos; i++) {
+				if (r.built[i] != NULL) {
+					_winter_protoRelease(state, r.built[i]);
+				}
+			}
+			FREE(r.built);
+		}
+		if (r.values != NULL) {
+			FREE(r.values);
+		}
+		if (r.pairs != NULL) {
+			FREE(r.pairs);
+		}
+	}
+	
+	if (message != NULL && error != NULL && errorSize > 0) {
+		snprintf(error, errorSize, message, r.missing);
+	}
+	return message != NULL ? -1 : 0;
+}
+
+int winterLoadImage(winterState_t *state, const void *data, size_t size, char *error, size_t errorSize) {
+	mapping_t *mapping = _winter_poolAllocRaw(state, NULL, sizeof(mapping_t));
+	void *copy = _winter_poolAllocRaw(state, NULL, size);
+	if (mapping == NULL || copy == NULL) {
+		_winter_poolAllocRaw(state, mapping, 0);
+		_winter_poolAllocRaw(state, copy, 0);
+		if (error != NULL && errorSize > 0) {
+			snprintf(error, errorSize, "out of memory");
+		}
+		return -1;
+	}
+	memcpy(copy, data, size);
+	*mapping = (mapping_t){ 1, copy, size, false };
+	
+	int status = load(state, mapping, error, errorSize);
+	_winter_mappingRelease(state, mapping);
+	return status;
+}
+
+int winterMapImage(winterState_t *state, const char *path, char *error, size_t errorSize) {
+	mapping_t *mapping = _winter_mapFile(state, path);
+	if (mapping == NULL) {
+		if (error != NULL && errorSize > 0) {
+			snprintf(error, errorSize, "can't read the file");
+		}
+		return -1;
+	}
+	int status = load(state, mapping, error, errorSize);
+	_winter_mappingRelease(state, mapping);
+	return status;
+}
@@ -0,0 +1,63 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "wtype.h"
+
+//Heap image format, written by winterSaveImage and loaded by winterLoadImage
+//
+//Like binary chunks (see chunk.h) an image is addressed by offsets from its start and uses
+//the byte order of the machine that wrote it. Objects refer to each other by their index
+//in the object list, loading allocates every object and then resolves the indices.
+//Prototype code, lines and upvalue descriptors are used in place like in chunks
+//
+//  header   imageHeader_t
+//  objects  numObjects imageObject_t
+//  protos   numProtos imageProto_t
+//  globals  numGlobals key and value pairs of imageValue_t
+//
+//What an object's fields hold depends on its type
+//
+//  string, error  count is the length, data the offset of the NUL terminated bytes
+//  table          count key and value pairs at data, extra is the bucket count, 0 for records
+//  closure        count upvalue indices (u32) at data, extra is the prototype index
+//  native         count is IMAGE_NATIVE, data the index of its registered name, extra the arity
+//  upvalue        one imageValue_t at data, the closed value
+#define IMAGE_MAGIC      "WHI"
+#define IMAGE_VERSION    3
+#define IMAGE_BYTE_ORDER 0x01020304
+#define IMAGE_NATIVE     0xffffffff
+
+typedef struct imageHeader_t {
+	char     magic[4];
+	uint16_t version;
+	uint16_t unused;
+	uint32_t byteOrder;
+	uint32_t size;
+	uint32_t numObjects, objects;
+	uint32_t numProtos,  protos;
+	uint32_t numGlobals, globals;
+} imageHeader_t;
+
+typedef struct imageValue_t {
+	uint32_t type; //object_type_t
+	uint32_t unused;
+	uint64_t value; //integer or float bits, object index
+} imageValue_t;
+
+typedef struct imageObject_t {
+	uint32_t type;
+	uint32_t count;
+	uint32_t data;
+	uint32_t extra;
+} imageObject_t;
+
+//Constants are imageValue_t, children are u32 prototype indices
+typedef struct imageProto_t {
+	uint32_t code, lines, numCode;
+	uint32_t constants, numConstants;
+	uint32_t protos, numProtos;
+	uint32_t upvalues;
+	uint8_t  numUpvalues, numParams, numRegisters, unused;
+} imageProto_t;
+
+#endif
@@ -0,0 +1,49 @@
+#include "index.h"
+#include <string.h>
+
+static inline size_t slotOf(const void *key, size_t capacity) {
+	uint64_t bits = (uintptr_t)key * 0x9e3779b97f4a7c15;
+	return (size_t)(bits >> 32) & (capacity - 1);
+}
+
+int64_t _winter_indexFind(index_t *index, const void *key) {
+	if (index->capacity == 0) return -1;
+	for (size_t i = slotOf(key, index->capacity);; i = (i + 1) & (index->capacity - 1)) {
+		if (index->keys[i] == NULL) {
+			return -1;
+		} else if (index->keys[i] == key) {
+			return index->values[i];
+		}
+	}
+}
+
+void _winter_indexInsert(winterState_t *state, index_t *index, const void *key, uint32_t value) {
+	if ((index->size + 1) * 2 > index->capacity) {
+		//Keys and values share one allocation so growing can't leak half of it
+		size_t capacity = index->capacity ? index->capacity * 2 : 64;
+		const void **keys = MALLOC((sizeof(void*) + sizeof(uint32_t)) * capacity);
+		index_t grown = { keys, (uint32_t*)(keys + capacity), capacity, 0 };
+		memset(keys, 0, sizeof(void*) * capacity);
+		for (size_t i = 0; i < index->capacity; i++) {
+			if (index->keys[i] != NULL) {
+				_winter_indexInsert(state, &grown, index->keys[i], index->values[i]);
+			}
+		}
+		_winter_indexFree(state, index);
+		*index = grown;
+	}
+	size_t i = slotOf(key, index->capacity);
+	while (index->keys[i] != NULL) {
+		i = (i + 1) & (index->capacity - 1);
+	}
+	index->keys[i]   = key;
+	index->values[i] = value;
+	index->size++;
+}
+
+void _winter_indexFree(winterState_t *state, index_t *index) {
+	if (index->keys != NULL) {
+		FREE(index->keys);
+	}
+	*index = (index_t){0};
+}
@@ -0,0 +1,20 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "wtype.h"
+
+//Maps pointers to indices, used to number the objects of a graph while copying it
+typedef struct index_t {
+	const void **keys;
+	uint32_t    *values;
+	size_t       capacity;
+	size_t       size;
+} index_t;
+
+//Returns -1 if the pointer isn't in the index
+int64_t _winter_indexFind(index_t *index, const void *key);
+//The key must not be in the index yet
+void _winter_indexInsert(winterState_t *state, index_t *index, const void *key, uint32_t value);
+void _winter_indexFree(winterState_t *state, index_t *index);
+
+#endif
@@ -0,0 +1,477 @@
+#include "jit.h"
+#include "table.h"
+#include <string.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+//Compiling can happen outside of protected calls and just gives up when memory runs out
+#define RAW_ALLOC(p, s) (_winter_poolAllocRaw(state, (p), (s)))
+#define RAW_FREE(p)     (_winter_poolAllocRaw(state, (p), 0))
+
+//The code keeps the registers of the frame in RBX and its constants in RBP, the state is
+//on top of the native stack
+enum { RAX = 0, RCX = 1, RDX = 2, REGS = 3, CONSTANTS = 5 };
+enum { XMM0 = 0, XMM1 = 1 };
+//Condition codes of jcc and setcc
+enum { CC_AE = 0x3, CC_A = 0x7, CC_E = 0x4, CC_NE = 0x5, CC_P = 0xa, CC_NP = 0xb, CC_L = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G = 0xf };
+
+#define REG(x)   ((int32_t)sizeof(object_t) * (x))
+#define VALUE(x) (REG(x) + (int32_t)offsetof(object_t, integer))
+
+//Jumps to the label of an instruction or out to the interpreter, patched once every
+//instruction has been emitted
+typedef struct fixup_t {
+	uint32_t at;     //of the rel32
+	uint32_t target; //instruction index
+	bool_t   exit;
+} fixup_t;
+
+typedef struct emitter_t {
+	winterState_t *state;
+	uint8_t *code;
+	size_t   size, capacity;
+	fixup_t *fixups;
+	size_t   numFixups, fixupCapacity;
+	object_t **globals; //caches of global loads
+	size_t     numGlobals;
+	bool_t   failed;
+} emitter_t;
+
+//Encoding
+
+static void emit(emitter_t *e, const uint8_t *bytes, size_t length) {
+	winterState_t *state = e->state;
+	if (e->size + length > e->capacity) {
+		size_t capacity = e->capacity ? e->capacity * 2 : 1024;
+		uint8_t *code = e->failed ? NULL : RAW_ALLOC(e->code, capacity);
+		if (code == NULL) {
+			e->failed = true;
+			e->size   = 0;
+			return;
+		}
+		e->code     = code;
+		e->capacity = capacity;
+	}
+	memcpy(e->code + e->size, bytes, length);
+	e->size += length;
+}
+#define EMIT(...) emit(e, (const uint8_t[]){ __VA_ARGS__ }, sizeof((const uint8_t[]){ __VA_ARGS__ }))
+
+static void emit32(emitter_t *e, uint32_t value) {
+	EMIT(value, value >> 8, value >> 16, value >> 24);
+}
+
+//Opcode with a [base + disp32] operand, 'reg' goes in the ModRM reg field
+static void memory(emitter_t *e, const uint8_t *opcode, size_t length, int reg, int base, int32_t disp) {
+	emit(e, opcode, length);
+	EMIT(0x80 | reg << 3 | base);
+	emit32(e, (uint32_t)disp);
+}
+#define MEMORY(reg, base, disp, ...) memory(e, (const uint8_t[]){ __VA_ARGS__ }, sizeof((const uint8_t[]){ __VA_ARGS__ }), reg, base, disp)
+
+#define LOAD(reg, base, disp)  MEMORY(reg, base, disp, 0x48, 0x8b) //mov reg, [base + disp]
+#define STORE(reg, disp)       MEMORY(reg, REGS,  disp, 0x48, 0x89) //mov [rdi + disp], reg
+#define LOADSD(xmm, disp)      MEMORY(xmm, REGS,  disp, 0xf2, 0x0f, 0x10)
+#define STORESD(xmm, disp)     MEMORY(xmm, REGS,  disp, 0xf2, 0x0f, 0x11)
+
+static void storeType(emitter_t *e, int x, object_type_t type) {
+	MEMORY(0, REGS, REG(x), 0xc7); //mov dword [rdi + disp], imm32
+	emit32(e, type);
+}
+static void compareType(emitter_t *e, int x, object_type_t type) {
+	MEMORY(7, REGS, REG(x), 0x83); //cmp dword [rdi + disp], imm8
+	EMIT(type);
+}
+static void copy(emitter_t *e, int to, int from, int base) {
+	LOAD(RAX, base, REG(from));
+	LOAD(RCX, base, REG(from) + 8);
+	STORE(RAX, REG(to));
+	STORE(RCX, REG(to) + 8);
+}
+
+//Jumps within a template, returns the rel32 to patch once the target is reached
+static size_t jcc(emitter_t *e, int cc) {
+	EMIT(0x0f, 0x80 | cc, 0, 0, 0, 0);
+	return e->size - 4;
+}
+static size_t jmp(emitter_t *e) {
+	EMIT(0xe9, 0, 0, 0, 0);
+	return e->size - 4;
+}
+static void patch(emitter_t *e, size_t at) {
+	if (e->failed) return;
+	uint32_t rel = (uint32_t)(e->size - (at + 4));
+	memcpy(e->code + at, &rel, 4);
+}
+
+static void fixup(emitter_t *e, size_t at, uint32_t target, bool_t exit) {
+	winterState_t *state = e->state;
+	if (e->failed) {
+		return;
+	} else if (e->numFixups == e->fixupCapacity) {
+		size_t capacity = e->fixupCapacity ? e->fixupCapacity * 2 : 64;
+		fixup_t *fixups = RAW_ALLOC(e->fixups, sizeof(fixup_t) * capacity);
+		if (fixups == NULL) {
+			e->failed = true;
+			return;
+		}
+		e->fixups = fixups;
+		e->fixupCapacity = capacity;
+	}
+	e->fixups[e->numFixups++] = (fixup_t){ (uint32_t)at, target, exit };
+}
+//Guard failures return to the interpreter at the instruction 'k'
+static void exitIf(emitter_t *e, int cc, uint32_t k) {
+	fixup(e, jcc(e, cc), k, true);
+}
+static void exitTo(emitter_t *e, uint32_t k) {
+	EMIT(0xb8);
+	emit32(e, k);
+	EMIT(0x59, 0x5d, 0x5b, 0xc3); //pop rcx, pop rbp, pop rbx, ret
+}
+
+static void emit64(emitter_t *e, uint64_t value) {
+	emit32(e, (uint32_t)value);
+	emit32(e, (uint32_t)(value >> 32));
+}
+
+//Calls a helper with the state, the registers, the address of a constant, an operand and
+//a pointer, which returns 0 to leave the instruction to the interpreter
+typedef int (*helper_t)(winterState_t *state, object_t *regs, const object_t *constant, uint32_t operand, void *data);
+
+static void call(emitter_t *e, uint32_t k, helper_t helper, uint32_t constant, uint32_t operand, void *data) {
+	uint64_t address;
+	memcpy(&address, &helper, sizeof(address));
+	EMIT(0x48, 0x8b, 0x3c, 0x24);                      //mov rdi, [rsp]
+	EMIT(0x48, 0x89, 0xde);                            //mov rsi, rbx
+	MEMORY(RDX, CONSTANTS, REG(constant), 0x48, 0x8d); //lea rdx, [constant]
+	EMIT(0xb9);                                        //mov ecx, operand
+	emit32(e, operand);
+	EMIT(0x49, 0xb8);                                  //mov r8, data
+	emit64(e, (uint64_t)(uintptr_t)data);
+	EMIT(0x48, 0xb8);                                  //mov rax, helper
+	emit64(e, address);
+	EMIT(0xff, 0xd0);                                  //call rax
+	EMIT(0x85, 0xc0);                                  //test eax, eax
+	exitIf(e, CC_E, k);
+}
+
+//Helpers
+
+//Fills the cache of a global load, buckets stay where they are until the table is freed
+static int getGlobal(winterState_t *state, object_t *regs, const object_t *key, uint32_t a, void *data) {
+	object_t *value = _winter_tableGetObject(state->globals, (object_t*)key);
+	if (value == NULL) {
+		return 0;
+	}
+	*(object_t**)data = value;
+	regs[a] = *value;
+	return 1;
+}
+
+//Templates
+
+static void arithmetic(emitter_t *e, uint32_t k, uint32_t i) {
+	int a = GET_A(i), b = GET_B(i), c = GET_C(i);
+	size_t floats = 0, done = 0;
+	if (GET_OP(i) != OP_DIV) {
+		compareType(e, b, TYPE_INT);
+		floats = jcc(e, CC_NE);
+		compareType(e, c, TYPE_INT);
+		exitIf(e, CC_NE, k);
+		LOAD(RAX, REGS, VALUE(b));
+		switch (GET_OP(i)) {
+			case OP_ADD: MEMORY(RAX, REGS, VALUE(c), 0x48, 0x03); break;       //add rax, [c]
+			case OP_SUB: MEMORY(RAX, REGS, VALUE(c), 0x48, 0x2b); break;       //sub rax, [c]
+			default:     MEMORY(RAX, REGS, VALUE(c), 0x48, 0x0f, 0xaf); break; //imul rax, [c]
+		}
+		STORE(RAX, VALUE(a));
+		storeType(e, a, TYPE_INT);
+		done = jmp(e);
+		patch(e, floats);
+	}
+	compareType(e, b, TYPE_FLOAT);
+	exitIf(e, CC_NE, k);
+	compareType(e, c, TYPE_FLOAT);
+	exitIf(e, CC_NE, k);
+	LOADSD(XMM0, VALUE(b));
+	switch (GET_OP(i)) {
+		case OP_ADD: MEMORY(XMM0, REGS, VALUE(c), 0xf2, 0x0f, 0x58); break;
+		case OP_SUB: MEMORY(XMM0, REGS, VALUE(c), 0xf2, 0x0f, 0x5c); break;
+		case OP_MUL: MEMORY(XMM0, REGS, VALUE(c), 0xf2, 0x0f, 0x59); break;
+		default:     MEMORY(XMM0, REGS, VALUE(c), 0xf2, 0x0f, 0x5e); break;
+	}
+	STORESD(XMM0, VALUE(a));
+	storeType(e, a, TYPE_FLOAT);
+	if (GET_OP(i) != OP_DIV) {
+		patch(e, done);
+	}
+}
+
+//Compares the operands like the interpreter, integers with a signed compare and floats with
+//one that's false when either is NaN
+static void comparison(emitter_t *e, uint32_t k, uint32_t i) {
+	int a = GET_A(i), b = GET_B(i), c = GET_C(i), op = GET_OP(i);
+	compareType(e, b, TYPE_INT);
+	size_t floats = jcc(e, CC_NE);
+	compareType(e, c, TYPE_INT);
+	exitIf(e, CC_NE, k);
+	LOAD(RAX, REGS, VALUE(b));
+	MEMORY(RAX, REGS, VALUE(c), 0x48, 0x3b); //cmp rax, [c]
+	int cc;
+	switch (op) {
+		case OP_EQ:      cc = CC_E;  break;
+		case OP_NOTEQ:   cc = CC_NE; break;
+		case OP_LESS:    cc = CC_L;  break;
+		case OP_LEQ:     cc = CC_LE; break;
+		case OP_GREATER: cc = CC_G;  break;
+		default:         cc = CC_GE; break;
+	}
+	EMIT(0x0f, 0x90 | cc, 0xc0); //setcc al
+	size_t done = jmp(e);
+	
+	//NaN is unordered, which sets every flag, so only != is true. 'above' is false then,
+	//so less than compares the operands the other way around
+	patch(e, floats);
+	compareType(e, b, TYPE_FLOAT);
+	exitIf(e, CC_NE, k);
+	compareType(e, c, TYPE_FLOAT);
+	exitIf(e, CC_NE, k);
+	LOADSD(XMM0, VALUE(b));
+	LOADSD(XMM1, VALUE(c));
+	if (op == OP_LESS || op == OP_LEQ) {
+		EMIT(0x66, 0x0f, 0x2e, 0xc8); //ucomisd xmm1, xmm0
+	} else {
+		EMIT(0x66, 0x0f, 0x2e, 0xc1); //ucomisd xmm0, xmm1
+	}
+	switch (op) {
+		case OP_EQ:
+			EMIT(0x0f, 0x90 | CC_E, 0xc0);  //sete al
+			EMIT(0x0f, 0x90 | CC_NP, 0xc2); //setnp dl
+			EMIT(0x20, 0xd0);               //and al, dl
+			break;
+		case OP_NOTEQ:
+			EMIT(0x0f, 0x90 | CC_NE, 0xc0); //setne al
+			EMIT(0x0f, 0x90 | CC_P, 0xc2);  //setp dl
+			EMIT(0x08, 0xd0);               //or al, dl
+			break;
+		case OP_LESS: case OP_GREATER:
+			EMIT(0x0f, 0x90 | CC_A, 0xc0);  //seta al
+			break;
+		default:
+			EMIT(0x0f, 0x90 | CC_AE, 0xc0); //setae al
+			break;
+	}
+	
+	patch(e, done);
+	EMIT(0x0f, 0xb6, 0xc0); //movzx eax, al
+	STORE(RAX, VALUE(a));
+	storeType(e, a, TYPE_INT);
+}
+
+static void negate(emitter_t *e, uint32_t k, uint32_t i) {
+	int a = GET_A(i), b = GET_B(i);
+	compareType(e, b, TYPE_INT);
+	size_t floats = jcc(e, CC_NE);
+	LOAD(RAX, REGS, VALUE(b));
+	EMIT(0x48, 0xf7, 0xd8); //neg rax
+	STORE(RAX, VALUE(a));
+	storeType(e, a, TYPE_INT);
+	size_t done = jmp(e);
+	
+	patch(e, floats);
+	compareType(e, b, TYPE_FLOAT);
+	exitIf(e, CC_NE, k);
+	LOAD(RAX, REGS, VALUE(b));
+	EMIT(0x48, 0x0f, 0xba, 0xf8, 0x3f); //btc rax, 63
+	STORE(RAX, VALUE(a));
+	storeType(e, a, TYPE_FLOAT);
+	patch(e, done);
+}
+
+//Same truthiness as _winter_objectTruthy
+static void branch(emitter_t *e, uint32_t target, uint32_t i) {
+	int a = GET_A(i);
+	compareType(e, a, TYPE_NULL);
+	fixup(e, jcc(e, CC_E), target, false);
+	compareType(e, a, TYPE_INT);
+	size_t notInt = jcc(e, CC_NE);
+	MEMORY(7, REGS, VALUE(a), 0x48, 0x83); //cmp qword [a], 0
+	EMIT(0);
+	fixup(e, jcc(e, CC_E), target, false);
+	size_t done = jmp(e);
+	
+	patch(e, notInt);
+	compareType(e, a, TYPE_FLOAT);
+	size_t notFloat = jcc(e, CC_NE);
+	LOADSD(XMM0, VALUE(a));
+	EMIT(0x66, 0x0f, 0x57, 0xc9); //xorpd xmm1, xmm1
+	EMIT(0x66, 0x0f, 0x2e, 0xc1); //ucomisd xmm0, xmm1
+	size_t nan = jcc(e, CC_P);
+	fixup(e, jcc(e, CC_E), target, false);
+	patch(e, done);
+	patch(e, notFloat);
+	patch(e, nan);
+}
+
+//A tail call of the running closure to itself becomes a jump back to the start, the
+//closure sits just below the registers
+static void tailcall(emitter_t *e, uint32_t k, uint32_t i, const proto_t *proto) {
+	int a = GET_A(i), argc = GET_B(i);
+	compareType(e, a, TYPE_FUNCTION);
+	exitIf(e, CC_NE, k);
+	LOAD(RAX, REGS, VALUE(a));
+	MEMORY(RAX, REGS, VALUE(-1), 0x48, 0x3b); //cmp rax, [closure]
+	exitIf(e, CC_NE, k);
+	for (int j = 0; j < argc; j++) {
+		copy(e, j, a + 1 + j, REGS);
+	}
+	for (int j = argc; j < proto->numRegisters; j++) {
+		storeType(e, j, TYPE_NULL);
+	}
+	fixup(e, jmp(e), 0, false);
+}
+
+//Loads the global through its cache once it's been found
+static void global(emitter_t *e, uint32_t k, uint32_t i) {
+	int a = GET_A(i);
+	object_t **cache = &e->globals[e->numGlobals++];
+	EMIT(0x48, 0xb8);             //mov rax, cache
+	emit64(e, (uint64_t)(uintptr_t)cache);
+	EMIT(0x48, 0x8b, 0x00);       //mov rax, [rax]
+	EMIT(0x48, 0x85, 0xc0);       //test rax, rax
+	size_t miss = jcc(e, CC_E);
+	EMIT(0x48, 0x8b, 0x08);       //mov rcx, [rax]
+	EMIT(0x48, 0x8b, 0x50, 0x08); //mov rdx, [rax + 8]
+	STORE(RCX, REG(a));
+	STORE(RDX, REG(a) + 8);
+	size_t done = jmp(e);
+	patch(e, miss);
+	call(e, k, getGlobal, GET_BX(i), a, cache);
+	patch(e, done);
+}
+
+//Without closures the prototype can't have open upvalues, which a tail call would close
+static bool_t canLoop(const proto_t *proto, uint32_t i) {
+	if (GET_B(i) != proto->numParams) {
+		return false;
+	}
+	for (size_t k = 0; k < proto->numCode; k++) {
+		if (GET_OP(proto->code[k]) == OP_CLOSURE) return false;
+	}
+	return true;
+}
+
+//Emits the instruction, returns false if it's left to the interpreter
+static bool_t instruction(emitter_t *e, const proto_t *proto, uint32_t k) {
+	uint32_t i = proto->code[k];
+	switch (GET_OP(i)) {
+		case OP_MOVE:     copy(e, GET_A(i), GET_B(i), REGS); return true;
+		case OP_LOADK:    copy(e, GET_A(i), GET_BX(i), CONSTANTS); return true;
+		case OP_LOADNULL: storeType(e, GET_A(i), TYPE_NULL); return true;
+		case OP_GETGLOBAL: global(e, k, i); return true;
+		
+		case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+			arithmetic(e, k, i);
+			return true;
+		case OP_EQ: case OP_NOTEQ: case OP_LESS: case OP_LEQ: case OP_GREATER: case OP_GEQ:
+			comparison(e, k, i);
+			return true;
+		case OP_NEGATE:
+			negate(e, k, i);
+			return true;
+		
+		case OP_JMP:
+		case OP_JMPIFNOT: {
+			int64_t target = (int64_t)k + 1 + GET_SBX(i);
+			if (target < 0 || target >= (int64_t)proto->numCode) {
+				return false;
+			} else if (GET_OP(i) == OP_JMP) {
+				fixup(e, jmp(e), (uint32_t)target, false);
+			} else {
+				branch(e, (uint32_t)target, i);
+			}
+			return true;
+		}
+		
+		case OP_TAILCALL:
+			if (!canLoop(proto, i)) return false;
+			tailcall(e, k, i, proto);
+			return true;
+		
+		default:
+			return false;
+	}
+}
+
+//Public
+
+void _winter_jitCompile(winterState_t *state, proto_t *proto) {
+	emitter_t emitter = { state }, *e = &emitter;
+	size_t count = proto->numCode, globals = 0;
+	for (size_t k = 0; k < count; k++) {
+		globals += GET_OP(proto->code[k]) == OP_GETGLOBAL;
+	}
+	//The caches, offsets and flags are stored after the jit_t
+	size_t size = sizeof(jit_t) + sizeof(object_t*) * globals + sizeof(uint32_t) * count * 2 + count;
+	jit_t *jit = RAW_ALLOC(NULL, size);
+	if (jit == NULL) {
+		return;
+	}
+	memset(jit, 0, size);
+	e->globals = (object_t**)(jit + 1);
+	uint32_t *offsets = (uint32_t*)(e->globals + globals);
+	uint32_t *exits = offsets + count;
+	uint8_t *compiled = (uint8_t*)(exits + count);
+	
+	EMIT(0x53, 0x55, 0x51); //push rbx, push rbp, push rcx
+	EMIT(0x48, 0x89, 0xfb); //mov rbx, rdi
+	EMIT(0x48, 0x89, 0xf5); //mov rbp, rsi
+	EMIT(0xff, 0xe2);       //jmp rdx
+	for (uint32_t k = 0; k < count; k++) {
+		offsets[k]  = (uint32_t)e->size;
+		compiled[k] = instruction(e, proto, k);
+		if (!compiled[k]) {
+			exitTo(e, k);
+		}
+	}
+	for (uint32_t k = 0; k < count; k++) {
+		exits[k] = (uint32_t)e->size;
+		if (compiled[k]) {
+			exitTo(e, k);
+		}
+	}
+	for (size_t f = 0; f < e->numFixups && !e->failed; f++) {
+		fixup_t *fix = &e->fixups[f];
+		uint32_t target = fix->exit ? exits[fix->target] : offsets[fix->target];
+		uint32_t rel = target - (fix->at + 4);
+		memcpy(e->code + fix->at, &rel, 4);
+	}
+	
+	uint8_t *memory = e->failed ? MAP_FAILED : mmap(NULL, e->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory != MAP_FAILED) {
+		memcpy(memory, e->code, e->size);
+		if (mprotect(memory, e->size, PROT_READ | PROT_EXEC) == 0) {
+			*jit = (jit_t){ memory, NULL, e->size, proto->code, offsets, compiled, e->globals };
+			//ISO C has no conversion from object to function pointers
+			memcpy(&jit->entry, &memory, sizeof(memory));
+			proto->jit = jit;
+		} else {
+			munmap(memory, e->size);
+		}
+	}
+	if (proto->jit == NULL) {
+		RAW_FREE(jit);
+	}
+	if (e->code != NULL) {
+		RAW_FREE(e->code);
+	}
+	if (e->fixups != NULL) {
+		RAW_FREE(e->fixups);
+	}
+}
+
+void _winter_jitFree(winterState_t *state, jit_t *jit) {
+	munmap(jit->memory, jit->size);
+	RAW_FREE(jit);
+}
@@ -0,0 +1,44 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "wtype.h"
+#include "object.h"
+#include "proto.h"
+
+//Baseline JIT for x86-64 Linux, built with WINTER_JIT
+//
+//A prototype is compiled once closures of it have been entered JIT_THRESHOLD times, by
+//stitching together a machine code template for each instruction. Moves, global
+//loads, arithmetic, comparisons, jumps and tail calls of the running closure to itself are
+//compiled, every other instruction returns to the interpreter. Arithmetic and comparisons are specialized
+//for two integers or two floats and guard the types of their operands, any other types
+//return to the interpreter at the instruction, which runs it the generic way.
+//The interpreter enters the code again at the next compiled instruction
+#define JIT_THRESHOLD 64
+
+//Runs compiled instructions starting at 'at', returns the index of the instruction the
+//interpreter carries on from
+typedef uint32_t (*jitEntry_t)(object_t *regs, const object_t *constants, const uint8_t *at, winterState_t *state);
+
+typedef struct jit_t {
+	uint8_t        *memory;   //executable, starts with the entry stub
+	jitEntry_t      entry;    //the same address
+	size_t          size;
+	const uint32_t *code;     //bytecode it was compiled from
+	uint32_t       *offsets;  //in memory of each instruction
+	uint8_t        *compiled; //set for instructions the code can be entered at
+	object_t      **globals;  //values of the globals it loads, filled on first use
+} jit_t;
+
+//Leaves the prototype interpreted if it can't be compiled
+void _winter_jitCompile(winterState_t *state, proto_t *proto);
+void _winter_jitFree(winterState_t *state, jit_t *jit);
+
+static inline bool_t _winter_jitCompiled(const jit_t *jit, const uint32_t *pc) {
+	return jit->compiled[pc - jit->code];
+}
+static inline const uint32_t *_winter_jitRun(winterState_t *state, const jit_t *jit, object_t *regs, const object_t *constants, const uint32_t *pc) {
+	return jit->code + jit->entry(regs, constants, jit->memory + jit->offsets[pc - jit->code], state);
+}
+
+#endif
@@ -0,0 +1,1008 @@
+#include "json.h"
+#include "array.h"
+#include "frozen.h"
+#include "table.h"
+#include "vm.h"
+#include "wstring.h"
+#include "winter.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(WINTER_NO_SIMD)
+#define JSON_AVX2
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+//Bit masks of one block, bit i is byte i
+typedef struct block_t {
+	uint64_t quote, backslash, op, space, control;
+} block_t;
+
+//JSON whitespace, which is narrower than isSpace
+static inline bool_t isBlank(unsigned char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+static inline bool_t isOp(unsigned char c) {
+	return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+}
+
+static void classify(const unsigned char *p, block_t *b) {
+	*b = (block_t){0};
+	for (int i = 0; i < 64; i++) {
+		uint64_t bit = (uint64_t)1 << i;
+		unsigned char c = p[i];
+		if (c == '"')   b->quote     |= bit;
+		if (c == '\\')  b->backslash |= bit;
+		if (isOp(c))    b->op        |= bit;
+		if (isBlank(c)) b->space     |= bit;
+		if (c < 0x20)   b->control   |= bit;
+	}
+}
+
+#ifdef JSON_AVX2
+#define BYTES(c) _mm256_set1_epi8(c)
+#define EQ(v, c) _mm256_cmpeq_epi8(v, BYTES(c))
+#define BITS(m)  ((uint64_t)(uint32_t)_mm256_movemask_epi8(m))
+
+AVX2 static void classifyAvx2(const unsigned char *p, block_t *b) {
+	*b = (block_t){0};
+	for (int half = 0; half < 64; half += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(p + half));
+		//Setting bit 5 turns [ and ] into { and }
+		__m256i lower = _mm256_or_si256(v, BYTES(0x20));
+		__m256i op = _mm256_or_si256(_mm256_or_si256(EQ(lower, '{'), EQ(lower, '}')), _mm256_or_si256(EQ(v, ':'), EQ(v, ',')));
+		__m256i space = _mm256_or_si256(_mm256_or_si256(EQ(v, ' '), EQ(v, '\t')), _mm256_or_si256(EQ(v, '\n'), EQ(v, '\r')));
+		__m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, BYTES(0x1f)), v);
+		b->quote     |= BITS(EQ(v, '"'))  << half;
+		b->backslash |= BITS(EQ(v, '\\')) << half;
+		b->op        |= BITS(op)          << half;
+		b->space     |= BITS(space)       << half;
+		b->control   |= BITS(control)     << half;
+	}
+}
+#endif
+
+//Carry of the previous block into the next one
+typedef struct carry_t {
+	uint64_t escaped;  //the first byte is escaped
+	uint64_t inString; //all ones if the block starts inside a string
+	uint64_t scalar;   //the last byte was part of a value that isn't a string
+} carry_t;
+
+//Bits set from each quote up to the next one, the opening quote included
+static inline uint64_t prefixXor(uint64_t x) {
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+//Returns the structural bits of the block, the operators outside of strings, opening
+//quotes and the first bytes of numbers and literals. 'strings' gets the bytes in strings
+static uint64_t structurals(const block_t *b, carry_t *carry, uint64_t *strings) {
+	//A run of backslashes escapes the byte after it if it's odd, found from where runs
+	//starting on odd bits end after adding them, like simdjson
+	const uint64_t even = 0x5555555555555555ull;
+	uint64_t backslash = b->backslash & ~carry->escaped;
+	uint64_t follows = backslash << 1 | carry->escaped;
+	uint64_t oddStarts = backslash & ~even & ~follows;
+	uint64_t sum = oddStarts + backslash;
+	carry->escaped = sum < oddStarts;
+	uint64_t escaped = (even ^ (sum << 1)) & follows;
+	
+	uint64_t quote = b->quote & ~escaped;
+	uint64_t inString = prefixXor(quote) ^ carry->inString;
+	carry->inString = (uint64_t)((int64_t)inString >> 63);
+	*strings = inString;
+	
+	uint64_t scalar = ~(b->op | b->space);
+	uint64_t nonquote = scalar & ~quote;
+	uint64_t start = scalar & ~(nonquote << 1 | carry->scalar);
+	carry->scalar = nonquote >> 63;
+	return (b->op | start) & ~(inString ^ quote);
+}
+
+typedef struct parser_t {
+	winterState_t *state;
+	const char    *json;
+	size_t         length;
+	
+	uint32_t *index; //offsets of the structurals
+	size_t    count, next;
+	
+	//Entries of the unfinished objects and arrays as key and value pairs
+	object_t *pairs;
+	size_t    top, capacity;
+	int       depth;
+	
+	wstring_t *keys[256]; //by hash, the last key seen
+	
+	const char *error;
+	size_t      at;
+} parser_t;
+
+static bool_t fail(parser_t *p, const char *error, size_t at) {
+	if (p->error == NULL) {
+		p->error = error;
+		p->at    = at;
+	}
+	return false;
+}
+
+static bool_t indexStructurals(parser_t *p) {
+	winterState_t *state = p->state;
+	const unsigned char *json = (const unsigned char*)p->json;
+	//Grown as it fills, text has far fewer structurals than bytes
+	size_t capacity = p->length / 8 + 64;
+	p->index = MALLOC(sizeof(uint32_t) * capacity);
+	carry_t carry = {0};
+#ifdef JSON_AVX2
+	bool_t avx2 = __builtin_cpu_supports("avx2");
+#endif
+	
+	for (size_t at = 0; at < p->length; at += 64) {
+		//The last block is padded with spaces, which are never structural
+		unsigned char tail[64];
+		const unsigned char *bytes = json + at;
+		if (p->length - at < 64) {
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, bytes, p->length - at);
+			bytes = tail;
+		}
+		block_t b;
+#ifdef JSON_AVX2
+		if (avx2) classifyAvx2(bytes, &b);
+		else
+#endif
+		classify(bytes, &b);
+		
+		if (p->count + 64 > capacity) {
+			capacity *= 2;
+			p->index = REALLOC(p->index, sizeof(uint32_t) * capacity);
+		}
+		uint64_t strings, bits = structurals(&b, &carry, &strings);
+		if (b.control & strings) {
+			return fail(p, "control character in a string", at + (size_t)__builtin_ctzll(b.control & strings));
+		}
+		while (bits != 0) {
+			p->index[p->count++] = (uint32_t)(at + (size_t)__builtin_ctzll(bits));
+			bits &= bits - 1;
+		}
+	}
+	if (carry.inString) {
+		return fail(p, "unterminated string", p->length);
+	}
+	return true;
+}
+
+static inline int peek(parser_t *p) {
+	return p->next < p->count ? p->json[p->index[p->next]] : 0;
+}
+//Offset of the current structural, or the end of the text
+static inline size_t here(parser_t *p) {
+	return p->next < p->count ? p->index[p->next] : p->length;
+}
+
+static void push(parser_t *p, const object_t *value) {
+	winterState_t *state = p->state;
+	if (p->top == p->capacity) {
+		p->capacity = p->capacity == 0 ? 64 : p->capacity * 2;
+		p->pairs = REALLOC(p->pairs, sizeof(object_t) * p->capacity);
+	}
+	p->pairs[p->top++] = *value;
+}
+
+static bool_t parseValue(parser_t *p, object_t *out);
+
+//Appends the code point as UTF-8
+static char *utf8(char *out, uint32_t c) {
+	if (c < 0x80) {
+		*out++ = (char)c;
+	} else if (c < 0x800) {
+		*out++ = (char)(0xc0 | c >> 6);
+		*out++ = (char)(0x80 | (c & 0x3f));
+	} else if (c < 0x10000) {
+		*out++ = (char)(0xe0 | c >> 12);
+		*out++ = (char)(0x80 | (c >> 6 & 0x3f));
+		*out++ = (char)(0x80 | (c & 0x3f));
+	} else {
+		*out++ = (char)(0xf0 | c >> 18);
+		*out++ = (char)(0x80 | (c >> 12 & 0x3f));
+		*out++ = (char)(0x80 | (c >> 6 & 0x3f));
+		*out++ = (char)(0x80 | (c & 0x3f));
+	}
+	return out;
+}
+
+static bool_t hex4(const char *s, uint32_t *out) {
+	*out = 0;
+	for (int i = 0; i < 4; i++) {
+		char c = s[i];
+		if (!isHex(c)) return false;
+		*out = *out << 4 | (uint32_t)(isNumber(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+	}
+	return true;
+}
+
+//Unescapes into 'out', which has room for 'size' bytes since escapes only get shorter
+static bool_t unescape(parser_t *p, const char *s, size_t size, wstring_t *out) {
+	const char *end = s + size;
+	char *o = out->data;
+	while (s < end) {
+		const char *backslash = memchr(s, '\\', (size_t)(end - s));
+		if (backslash == NULL) backslash = end;
+		memcpy(o, s, (size_t)(backslash - s));
+		o += backslash - s;
+		s = backslash;
+		if (s == end) break;
+		
+		size_t at = (size_t)(s - p->json);
+		//The index guarantees a byte after the backslash, the closing quote at least
+		switch (s[1]) {
+			case '"':  *o++ = '"';  break;
+			case '\\': *o++ = '\\'; break;
+			case '/':  *o++ = '/';  break;
+			case 'b':  *o++ = '\b'; break;
+			case 'f':  *o++ = '\f'; break;
+			case 'n':  *o++ = '\n'; break;
+			case 'r':  *o++ = '\r'; break;
+			case 't':  *o++ = '\t'; break;
+			case 'u': {
+				uint32_t c, low;
+				if (end - s < 6 || !hex4(s + 2, &c)) {
+					return fail(p, "invalid unicode escape", at);
+				}
+				if (c >= 0xd800 && c < 0xdc00) {
+					//A high surrogate needs the low one after it
+					if (end - s < 12 || s[6] != '\\' || s[7] != 'u' || !hex4(s + 8, &low) || low < 0xdc00 || low >= 0xe000) {
+						return fail(p, "invalid surrogate pair", at);
+					}
+					c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+					s += 6;
+				} else if (c >= 0xdc00 && c < 0xe000) {
+					return fail(p, "invalid surrogate pair", at);
+				}
+				o = utf8(o, c);
+				s += 4;
+			} break;
+			default:
+				return fail(p, "invalid escape", at);
+		}
+		s += 2;
+	}
+	out->length = (size_t)(o - out->data);
+	*o = '\0';
+	return true;
+}
+
+//The string at 'at' ends at the quote before the next structural, past any whitespace
+static bool_t parseString(parser_t *p, size_t at, bool_t key, object_t *out) {
+	winterState_t *state = p->state;
+	size_t end = here(p);
+	while (end > at + 1 && isBlank((unsigned char)p->json[end - 1])) {
+		end--;
+	}
+	if (end <= at + 1 || p->json[end - 1] != '"') {
+		return fail(p, "invalid string", at);
+	}
+	const char *s = p->json + at + 1;
+	size_t size = end - 1 - (at + 1);
+	
+	wstring_t *string;
+	if (memchr(s, '\\', size) != NULL) {
+		string = _winter_stringAlloc(state, size + 1);
+		if (!unescape(p, s, size, string)) return false;
+	} else if (key) {
+		//Same hash as _winter_stringHash, so it's stored with the string
+		hash_t hash = 5381;
+		for (size_t i = 0; i < size && s[i] != '\0'; i++) {
+			hash = ((hash << 5) + hash) + (unsigned char)s[i];
+		}
+		hash = hash == 0 ? 1 : hash;
+		wstring_t **cached = &p->keys[(hash ^ hash >> 8) & 255];
+		if (*cached != NULL && (*cached)->length == size && memcmp((*cached)->data, s, size) == 0) {
+			string = *cached;
+		} else {
+			string = *cached = _winter_stringCreateSize(state, s, size);
+			string->hash = hash;
+		}
+	} else {
+		string = _winter_stringCreateSize(state, s, size);
+	}
+	*out = (object_t){ TYPE_STRING, { .string = string } };
+	return true;
+}
+
+//Exact powers of ten as doubles
+static const double powers[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool_t parseNumber(parser_t *p, size_t at, object_t *out) {
+	const char *s = p->json + at, *c = s, *end = p->json + p->length;
+	bool_t negative = c < end && *c == '-';
+	c += negative;
+	if (c == end || !isNumber(*c) || (*c == '0' && c + 1 < end && isNumber(c[1]))) {
+		return fail(p, "invalid value", at);
+	}
+	
+	//Up to 19 significant digits fit in the mantissa, the rest only move the exponent
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool_t isFloat = false, truncated = false;
+	for (; c < end && isNumber(*c); c++) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (uint64_t)(*c - '0');
+			digits += mantissa != 0;
+		} else {
+			exponent++;
+			truncated = true;
+		}
+	}
+	if (c < end && *c == '.') {
+		isFloat = true;
+		if (++c == end || !isNumber(*c)) {
+			return fail(p, "invalid number", at);
+		}
+		for (; c < end && isNumber(*c); c++) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (uint64_t)(*c - '0');
+				digits += mantissa != 0;
+				exponent--;
+			} else {
+				truncated = true;
+			}
+		}
+	}
+	if (c < end && (*c | 0x20) == 'e') {
+		isFloat = true;
+		bool_t below = ++c < end && *c == '-';
+		c += c < end && (*c == '-' || *c == '+');
+		if (c == end || !isNumber(*c)) {
+			return fail(p, "invalid number", at);
+		}
+		int e = 0;
+		for (; c < end && isNumber(*c); c++) {
+			e = e < 100000 ? e * 10 + (*c - '0') : e;
+		}
+		exponent += below ? -e : e;
+	}
+	if (c < end && !isBlank((unsigned char)*c) && !isOp((unsigned char)*c)) {
+		return fail(p, "invalid number", at);
+	}
+	
+	if (!isFloat && !truncated && mantissa <= (uint64_t)INT64_MAX + negative) {
+		*out = (object_t){ TYPE_INT, { .integer = negative ? (winterInt_t)(0 - mantissa) : (winterInt_t)mantissa } };
+		return true;
+	}
+	double value;
+	if (!truncated && mantissa <= (uint64_t)1 << 53 && exponent >= -22 && exponent <= 22) {
+		//Both are exact, so the one rounding gives the closest double
+		value = exponent < 0 ? (double)mantissa / powers[-exponent] : (double)mantissa * powers[exponent];
+		value = negative ? -value : value;
+	} else {
+		//strtod needs the number to end, which the text may not
+		char buffer[64], *copy = buffer;
+		size_t size = (size_t)(c - s);
+		winterState_t *state = p->state;
+		if (size >= sizeof(buffer)) {
+			copy = MALLOC(size + 1);
+		}
+		memcpy(copy, s, size);
+		copy[size] = '\0';
+		value = strtod(copy, NULL);
+		if (copy != buffer) {
+			FREE(copy);
+		}
+	}
+	*out = (object_t){ TYPE_FLOAT, { .floating = value } };
+	return true;
+}
+
+static bool_t parseLiteral(parser_t *p, size_t at, const char *literal, object_t value, object_t *out) {
+	size_t size = strlen(literal);
+	if (p->length - at < size || memcmp(p->json + at, literal, size) != 0 ||
+		(at + size < p->length && !isBlank((unsigned char)p->json[at + size]) && !isOp((unsigned char)p->json[at + size]))) {
+		return fail(p, "invalid value", at);
+	}
+	*out = value;
+	return true;
+}
+
+static bool_t parseObject(parser_t *p, object_t *out) {
+	size_t base = p->top;
+	if (peek(p) == '}') {
+		p->next++;
+	} else while (true) {
+		object_t key, value;
+		if (peek(p) != '"') {
+			return fail(p, "expected a string key", here(p));
+		}
+		size_t keyAt = p->index[p->next++];
+		if (!parseString(p, keyAt, true, &key)) return false;
+		if (peek(p) != ':') {
+			return fail(p, "expected ':'", here(p));
+		}
+		p->next++;
+		if (!parseValue(p, &value)) return false;
+		push(p, &key);
+		push(p, &value);
+		
+		int c = peek(p);
+		if (c != ',' && c != '}') {
+			return fail(p, "expected ',' or '}'", here(p));
+		}
+		p->next++;
+		if (c == '}') break;
+	}
+	table_t *table = _winter_tableFrom(p->state, &p->pairs[base], (p->top - base) / 2);
+	p->top = base;
+	*out = (object_t){ TYPE_TABLE, { .pointer = table } };
+	return true;
+}
+
+static bool_t parseArray(parser_t *p, object_t *out) {
+	size_t base = p->top;
+	if (peek(p) == ']') {
+		p->next++;
+		//Scripts make empty tables as records, one with buckets encodes as [] again
+		*out = (object_t){ TYPE_TABLE, { .pointer = _winter_tableReserve(p->state, 0, false) } };
+		return true;
+	} else for (winterInt_t i = 0;; i++) {
+		object_t value;
+		if (!parseValue(p, &value)) return false;
+		push(p, &(object_t){ TYPE_INT, { .integer = i } });
+		push(p, &value);
+		
+		int c = peek(p);
+		if (c != ',' && c != ']') {
+			return fail(p, "expected ',' or ']'", here(p));
+		}
+		p->next++;
+		if (c == ']') break;
+	}
+	table_t *table = _winter_tableFrom(p->state, &p->pairs[base], (p->top - base) / 2);
+	p->top = base;
+	*out = (object_t){ TYPE_TABLE, { .pointer = table } };
+	return true;
+}
+
+static bool_t parseValue(parser_t *p, object_t *out) {
+	if (p->next == p->count) {
+		return fail(p, "unexpected end", p->length);
+	}
+	size_t at = p->index[p->next++];
+	bool_t parsed;
+	switch (p->json[at]) {
+		case '{':
+		case '[':
+			if (p->depth == JSON_MAX_DEPTH) {
+				return fail(p, "nesting too deep", at);
+			}
+			p->depth++;
+			parsed = p->json[at] == '{' ? parseObject(p, out) : parseArray(p, out);
+			p->depth--;
+			return parsed;
+		case '"': return parseString(p, at, false, out);
+		case 't': return parseLiteral(p, at, "true",  (object_t){ TYPE_INT, { .integer = 1 } }, out);
+		case 'f': return parseLiteral(p, at, "false", (object_t){ TYPE_INT, { .integer = 0 } }, out);
+		case 'n': return parseLiteral(p, at, "null",  (object_t){ TYPE_NULL }, out);
+		case '-':
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			return parseNumber(p, at, out);
+		default:
+			return fail(p, "unexpected character", at);
+	}
+}
+
+bool_t _winter_jsonDecode(winterState_t *state, const char *json, size_t length, object_t *out) {
+	parser_t p = { state, json, length };
+	volatile bool_t decoded = false;
+	if (length >= UINT32_MAX) {
+		fail(&p, "text too long", 0);
+	} else {
+		//Values built before running out of memory are left to the zero count table
+		jmp_buf handler, *previous = state->errorJump;
+		state->errorJump = &handler;
+		if (setjmp(handler) == 0) {
+			decoded = indexStructurals(&p) && parseValue(&p, out);
+			if (decoded && p.next != p.count) {
+				decoded = fail(&p, "unexpected data after the value", here(&p));
+			}
+		} else {
+			p.error = NULL;
+		}
+		state->errorJump = previous;
+	}
+	if (p.index != NULL) FREE(p.index);
+	if (p.pairs != NULL) FREE(p.pairs);
+	
+	if (decoded) {
+		return true;
+	} else if (p.error == NULL) {
+		*out = (object_t){ TYPE_ERROR, { .string = state->memoryError } };
+	} else {
+		_winter_objectNewError(state, out, "jsondecode: %s at byte %zu", p.error, p.at);
+	}
+	return false;
+}
+
+//Text is collected in 'data', which grows, or is flushed to the writer when it's full
+typedef struct output_t {
+	winterState_t *state;
+	winterWriter_t writer;
+	void          *user;
+	int            status; //first nonzero result of the writer
+	
+	char  *data;
+	size_t size, capacity;
+	int    depth;
+	const char *error;
+} output_t;
+
+static void flush(output_t *o) {
+	if (o->size > 0 && o->status == 0) {
+		o->status = o->writer(o->user, o->data, o->size);
+	}
+	o->size = 0;
+}
+
+static void append(output_t *o, const char *data, size_t size) {
+	if (o->size + size > o->capacity) {
+		winterState_t *state = o->state;
+		if (o->writer != NULL) {
+			flush(o);
+			if (size > o->capacity) {
+				if (o->status == 0) o->status = o->writer(o->user, data, size);
+				return;
+			}
+		} else {
+			o->capacity = o->capacity * 2 > o->size + size ? o->capacity * 2 : o->size + size;
+			o->data = REALLOC(o->data, o->capacity);
+		}
+	}
+	memcpy(o->data + o->size, data, size);
+	o->size += size;
+}
+
+static inline void put(output_t *o, char c) {
+	if (o->size < o->capacity) {
+		o->data[o->size++] = c;
+	} else {
+		append(o, &c, 1);
+	}
+}
+
+//Escape letters by byte, 'u' for \u00XX and 0 for bytes copied as they are
+static const char escapes[256] = {
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	['"'] = '"', ['\\'] = '\\'
+};
+
+//True if one of the 8 bytes is a quote, a backslash or a control character
+static inline bool_t needsEscape(uint64_t x) {
+	const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+	uint64_t quote = x ^ (ones * '"'), backslash = x ^ (ones * '\\');
+	uint64_t zero = ((quote - ones) & ~quote) | ((backslash - ones) & ~backslash);
+	uint64_t control = (x - ones * 0x20) & ~x;
+	return ((zero | control) & highs) != 0;
+}
+
+static void encodeString(output_t *o, const char *s, size_t size) {
+	put(o, '"');
+	size_t run = 0, i = 0;
+	while (i < size) {
+		uint64_t word;
+		if (size - i >= 8 && (memcpy(&word, s + i, 8), !needsEscape(word))) {
+			i += 8;
+			continue;
+		}
+		char escape = escapes[(unsigned char)s[i]];
+		if (escape != 0) {
+			append(o, s + run, i - run);
+			char buffer[6] = { '\\', escape, '0', '0', "0123456789abcdef"[(unsigned char)s[i] >> 4], "0123456789abcdef"[s[i] & 0xf] };
+			append(o, buffer, escape == 'u' ? 6 : 2);
+			run = i + 1;
+		}
+		i++;
+	}
+	append(o, s + run, size - run);
+	put(o, '"');
+}
+
+//Shortest digits of a double by Grisu2, which always reads back the same and is the
+//shortest in nearly every case, without the printing and parsing of trying precisions
+typedef struct diyfp_t {
+	uint64_t f;
+	int      e;
+} diyfp_t;
+
+//10^k for k = -348, -340, ... 340, normalized
+static const diyfp_t cachedPowers[] = {
+	{ 0xfa8fd5a0081c0288ull, -1220 }, { 0xbaaee17fa23ebf76ull, -1193 }, { 0x8b16fb203055ac76ull, -1166 },
+	{ 0xcf42894a5dce35eaull, -1140 }, { 0x9a6bb0aa55653b2dull, -1113 }, { 0xe61acf033d1a45dfull, -1087 },
+	{ 0xab70fe17c79ac6caull, -1060 }, { 0xff77b1fcbebcdc4full, -1034 }, { 0xbe5691ef416bd60cull, -1007 },
+	{ 0x8dd01fad907ffc3cull,  -980 }, { 0xd3515c2831559a83ull,  -954 }, { 0x9d71ac8fada6c9b5ull,  -927 },
+	{ 0xea9c227723ee8bcbull,  -901 }, { 0xaecc49914078536dull,  -874 }, { 0x823c12795db6ce57ull,  -847 },
+	{ 0xc21094364dfb5637ull,  -821 }, { 0x9096ea6f3848984full,  -794 }, { 0xd77485cb25823ac7ull,  -768 },
+	{ 0xa086cfcd97bf97f4ull,  -741 }, { 0xef340a98172aace5ull,  -715 }, { 0xb23867fb2a35b28eull,  -688 },
+	{ 0x84c8d4dfd2c63f3bull,  -661 }, { 0xc5dd44271ad3cdbaull,  -635 }, { 0x936b9fcebb25c996ull,  -608 },
+	{ 0xdbac6c247d62a584ull,  -582 }, { 0xa3ab66580d5fdaf6ull,  -555 }, { 0xf3e2f893dec3f126ull,  -529 },
+	{ 0xb5b5ada8aaff80b8ull,  -502 }, { 0x87625f056c7c4a8bull,  -475 }, { 0xc9bcff6034c13053ull,  -449 },
+	{ 0x964e858c91ba2655ull,  -422 }, { 0xdff9772470297ebdull,  -396 }, { 0xa6dfbd9fb8e5b88full,  -369 },
+	{ 0xf8a95fcf88747d94ull,  -343 }, { 0xb94470938fa89bcfull,  -316 }, { 0x8a08f0f8bf0f156bull,  -289 },
+	{ 0xcdb02555653131b6ull,  -263 }, { 0x993fe2c6d07b7facull,  -236 }, { 0xe45c10c42a2b3b06ull,  -210 },
+	{ 0xaa242499697392d3ull,  -183 }, { 0xfd87b5f28300ca0eull,  -157 }, { 0xbce5086492111aebull,  -130 },
+	{ 0x8cbccc096f5088ccull,  -103 }, { 0xd1b71758e219652cull,   -77 }, { 0x9c40000000000000ull,   -50 },
+	{ 0xe8d4a51000000000ull,   -24 }, { 0xad78ebc5ac620000ull,     3 }, { 0x813f3978f8940984ull,    30 },
+	{ 0xc097ce7bc90715b3ull,    56 }, { 0x8f7e32ce7bea5c70ull,    83 }, { 0xd5d238a4abe98068ull,   109 },
+	{ 0x9f4f2726179a2245ull,   136 }, { 0xed63a231d4c4fb27ull,   162 }, { 0xb0de65388cc8ada8ull,   189 },
+	{ 0x83c7088e1aab65dbull,   216 }, { 0xc45d1df942711d9aull,   242 }, { 0x924d692ca61be758ull,   269 },
+	{ 0xda01ee641a708deaull,   295 }, { 0xa26da3999aef774aull,   322 }, { 0xf209787bb47d6b85ull,   348 },
+	{ 0xb454e4a179dd1877ull,   375 }, { 0x865b86925b9bc5c2ull,   402 }, { 0xc83553c5c8965d3dull,   428 },
+	{ 0x952ab45cfa97a0b3ull,   455 }, { 0xde469fbd99a05fe3ull,   481 }, { 0xa59bc234db398c25ull,   508 },
+	{ 0xf6c69a72a3989f5cull,   534 }, { 0xb7dcbf5354e9beceull,   561 }, { 0x88fcf317f22241e2ull,   588 },
+	{ 0xcc20ce9bd35c78a5ull,   614 }, { 0x98165af37b2153dfull,   641 }, { 0xe2a0b5dc971f303aull,   667 },
+	{ 0xa8d9d1535ce3b396ull,   694 }, { 0xfb9b7cd9a4a7443cull,   720 }, { 0xbb764c4ca7a44410ull,   747 },
+	{ 0x8bab8eefb6409c1aull,   774 }, { 0xd01fef10a657842cull,   800 }, { 0x9b10a4e5e9913129ull,   827 },
+	{ 0xe7109bfba19c0c9dull,   853 }, { 0xac2820d9623bf429ull,   880 }, { 0x80444b5e7aa7cf85ull,   907 },
+	{ 0xbf21e44003acdd2dull,   933 }, { 0x8e679c2f5e44ff8full,   960 }, { 0xd433179d9c8cb841ull,   986 },
+	{ 0x9e19db92b4e31ba9ull,  1013 }, { 0xeb96bf6ebadf77d9ull,  1039 }, { 0xaf87023b9bf0ee6bull,  1066 }
+};
+
+static const uint64_t tens[] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+	1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+	100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+	1000000000000000000ull, 10000000000000000000ull
+};
+
+//The rounded upper 64 bits of the product
+static inline diyfp_t diyMultiply(diyfp_t x, diyfp_t y) {
+	const uint64_t low = 0xffffffffull;
+	uint64_t a = x.f >> 32, b = x.f & low, c = y.f >> 32, d = y.f & low;
+	uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	uint64_t middle = (bd >> 32) + (ad & low) + (bc & low) + (1ull << 31);
+	return (diyfp_t){ ac + (ad >> 32) + (bc >> 32) + (middle >> 32), x.e + y.e + 64 };
+}
+static inline diyfp_t diyNormalize(diyfp_t x) {
+	while (!(x.f & 1ull << 63)) {
+		x.f <<= 1;
+		x.e--;
+	}
+	return x;
+}
+
+//Moves the last digit down while that stays in the interval and gets closer to the value
+static void grisuRound(char *digits, int size, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance) {
+	while (rest < distance && delta - rest >= tenKappa &&
+		(rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+		digits[size - 1]--;
+		rest += tenKappa;
+	}
+}
+
+//Writes the digits of a finite, nonzero, positive double, returns their number and sets
+//'exponent' so the value is digits * 10^exponent
+static int grisu2(double value, char *digits, int *exponent) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	int biased = (int)(bits >> 52 & 0x7ff);
+	uint64_t fraction = bits & ((1ull << 52) - 1);
+	diyfp_t v = biased != 0 ? (diyfp_t){ fraction | 1ull << 52, biased - 1075 } : (diyfp_t){ fraction, -1074 };
+	
+	//Boundaries halfway to the neighbouring doubles, the lower one is closer at a power of two
+	diyfp_t plus = diyNormalize((diyfp_t){ (v.f << 1) + 1, v.e - 1 });
+	diyfp_t minus = v.f == 1ull << 52 && biased > 1 ? (diyfp_t){ (v.f << 2) - 1, v.e - 2 } : (diyfp_t){ (v.f << 1) - 1, v.e - 1 };
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+	
+	//A power of ten that brings the upper boundary's exponent to -60 to -32
+	double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+	int k = (int)dk;
+	k += dk - k > 0.0;
+	int index = (k >> 3) + 1;
+	diyfp_t power = cachedPowers[index];
+	*exponent = 348 - index * 8;
+	
+	diyfp_t w = diyMultiply(diyNormalize(v), power);
+	diyfp_t high = diyMultiply(plus, power), low = diyMultiply(minus, power);
+	high.f--;
+	low.f++;
+	uint64_t delta = high.f - low.f, distance = high.f - w.f;
+	
+	//Integer and fraction parts of the upper boundary, digits are taken until the rest
+	//of it is within the interval
+	int shift = -high.e;
+	uint64_t one = 1ull << shift;
+	uint32_t integer = (uint32_t)(high.f >> shift);
+	uint64_t rest = high.f & (one - 1);
+	int kappa = 1, size = 0;
+	while (kappa < 10 && integer >= tens[kappa]) {
+		kappa++;
+	}
+	while (kappa > 0) {
+		uint32_t digit = (uint32_t)(integer / tens[kappa - 1]);
+		integer %= (uint32_t)tens[kappa - 1];
+		if (digit != 0 || size != 0) {
+			digits[size++] = (char)('0' + digit);
+		}
+		kappa--;
+		uint64_t remainder = ((uint64_t)integer << shift) + rest;
+		if (remainder <= delta) {
+			*exponent += kappa;
+			grisuRound(digits, size, delta, remainder, tens[kappa] << shift, distance);
+			return size;
+		}
+	}
+	while (true) {
+		rest *= 10;
+		delta *= 10;
+		char digit = (char)(rest >> shift);
+		if (digit != 0 || size != 0) {
+			digits[size++] = (char)('0' + digit);
+		}
+		rest &= one - 1;
+		kappa--;
+		if (rest < delta) {
+			*exponent += kappa;
+			grisuRound(digits, size, delta, rest, one, -kappa < 20 ? distance * tens[-kappa] : 0);
+			return size;
+		}
+	}
+}
+
+static void encodeInt(output_t *o, winterInt_t value) {
+	char buffer[24], *c = buffer + sizeof(buffer);
+	uint64_t x = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+	do {
+		*--c = (char)('0' + x % 10);
+		x /= 10;
+	} while (x != 0);
+	if (value < 0) {
+		*--c = '-';
+	}
+	append(o, c, (size_t)(buffer + sizeof(buffer) - c));
+}
+
+//The shortest digits that read back the same, laid out like "%.15g" would, with a fraction
+//or an exponent so it decodes as a float again. NaN and the infinities have no JSON form
+static void encodeFloat(output_t *o, double value) {
+	char buffer[40], digits[20], *c = buffer;
+	if (!isfinite(value)) {
+		append(o, "null", 4);
+		return;
+	}
+	if (signbit(value)) {
+		*c++ = '-';
+		value = -value;
+	}
+	if (value == 0) {
+		memcpy(c, "0.0", 3);
+		append(o, buffer, (size_t)(c + 3 - buffer));
+		return;
+	}
+	int exponent, size = grisu2(value, digits, &exponent);
+	int point = size + exponent; //digits before the decimal point
+	if (point - 1 < -4 || point - 1 >= (size > 15 ? size : 15)) {
+		*c++ = digits[0];
+		if (size > 1) {
+			*c++ = '.';
+			memcpy(c, digits + 1, (size_t)size - 1);
+			c += size - 1;
+		}
+		int e = point - 1;
+		c += snprintf(c, 6, "e%c%02d", e < 0 ? '-' : '+', e < 0 ? -e : e);
+	} else if (point <= 0) {
+		memcpy(c, "0.", 2);
+		memset(c + 2, '0', (size_t)-point);
+		c += 2 - point;
+		memcpy(c, digits, (size_t)size);
+		c += size;
+	} else if (point >= size) {
+		memcpy(c, digits, (size_t)size);
+		memset(c + size, '0', (size_t)(point - size));
+		c += point;
+		memcpy(c, ".0", 2);
+		c += 2;
+	} else {
+		memcpy(c, digits, (size_t)point);
+		c[point] = '.';
+		memcpy(c + point + 1, digits + point, (size_t)(size - point));
+		c += size + 1;
+	}
+	append(o, buffer, (size_t)(c - buffer));
+}
+
+static bool_t encodeValue(output_t *o, const object_t *value);
+
+static bool_t encodeKey(output_t *o, const object_t *key) {
+	if (key->type == TYPE_STRING) {
+		encodeString(o, key->string->data, key->string->length);
+	} else if (key->type == TYPE_INT) {
+		put(o, '"');
+		encodeInt(o, key->integer);
+		put(o, '"');
+	} else {
+		o->error = "jsonencode: object keys must be strings or ints";
+		return false;
+	}
+	put(o, ':');
+	return true;
+}
+
+//Tables with the keys 0 to n-1 are arrays, other tables are objects. Empty tables are
+//objects unless they have buckets, which only decoding [] leaves
+static bool_t encodeTable(output_t *o, table_t *table) {
+	bool_t sequence = table->size > 0 || table->shape == NULL;
+	tableIter_t it = {0};
+	while (sequence && _winter_tableNext(table, &it)) {
+		sequence = it.key->type == TYPE_INT && it.key->integer >= 0 && (uint64_t)it.key->integer < table->size;
+	}
+	if (sequence) {
+		put(o, '[');
+		for (size_t i = 0; i < table->size; i++) {
+			if (i > 0) put(o, ',');
+			if (!encodeValue(o, _winter_tableGetObject(table, &(object_t){ TYPE_INT, { .integer = (winterInt_t)i } }))) return false;
+		}
+		put(o, ']');
+		return true;
+	}
+	put(o, '{');
+	bool_t first = true;
+	for (it = (tableIter_t){0}; _winter_tableNext(table, &it); first = false) {
+		if (!first) put(o, ',');
+		if (!encodeKey(o, it.key) || !encodeValue(o, it.value)) return false;
+	}
+	put(o, '}');
+	return true;
+}
+
+static bool_t encodeFrozen(output_t *o, const frozen_t *frozen) {
+	bool_t sequence = frozen->size > 0;
+	for (size_t i = 0; i <= frozen->mask && sequence; i++) {
+		const object_t *key = &frozen->entries[i].key;
+		sequence = key->type == TYPE_UNKNOWN || (key->type == TYPE_INT && key->integer >= 0 && (uint64_t)key->integer < frozen->size);
+	}
+	if (sequence) {
+		put(o, '[');
+		for (size_t i = 0; i < frozen->size; i++) {
+			if (i > 0) put(o, ',');
+			if (!encodeValue(o, _winter_frozenGet(frozen, &(object_t){ TYPE_INT, { .integer = (winterInt_t)i } }))) return false;
+		}
+		put(o, ']');
+		return true;
+	}
+	put(o, '{');
+	bool_t first = true;
+	for (size_t i = 0; i <= frozen->mask; i++) {
+		const frozenEntry_t *entry = &frozen->entries[i];
+		if (entry->key.type == TYPE_UNKNOWN) continue;
+		if (!first) put(o, ',');
+		if (!encodeKey(o, &entry->key) || !encodeValue(o, &entry->value)) return false;
+		first = false;
+	}
+	put(o, '}');
+	return true;
+}
+
+static bool_t encodeValue(output_t *o, const object_t *value) {
+	if (value->type == TYPE_REFERENCE) {
+		value = value->pointer;
+	}
+	switch (value->type) {
+		case TYPE_NULL:   append(o, "null", 4);                                 return true;
+		case TYPE_INT:    encodeInt(o, value->integer);                         return true;
+		case TYPE_FLOAT:  encodeFloat(o, value->floating);                      return true;
+		case TYPE_STRING: encodeString(o, value->string->data, value->string->length); return true;
+		case TYPE_ARRAY: {
+			const array_t *array = value->pointer;
+			put(o, '[');
+			for (size_t i = 0; i < array->length; i++) {
+				if (i > 0) put(o, ',');
+				object_t element = _winter_arrayGet(array, i);
+				if (!encodeValue(o, &element)) return false;
+			}
+			put(o, ']');
+			return true;
+		}
+		case TYPE_TABLE:
+		case TYPE_FROZEN: {
+			if (o->depth == JSON_MAX_DEPTH) {
+				o->error = "jsonencode: nesting too deep, or the value has a cycle";
+				return false;
+			}
+			o->depth++;
+			bool_t encoded = value->type == TYPE_TABLE ? encodeTable(o, value->pointer) : encodeFrozen(o, value->pointer);
+			o->depth--;
+			return encoded;
+		}
+		default:
+			o->error = "jsonencode can only encode null, numbers, strings, tables and arrays";
+			return false;
+	}
+}
+
+int _winter_jsonEncode(winterState_t *state, const object_t *value, winterWriter_t writer, void *user, object_t *out) {
+	char buffer[4096];
+	output_t o = { state, writer, user };
+	if (writer != NULL) {
+		o.data     = buffer;
+		o.capacity = sizeof(buffer);
+	}
+	bool_t encoded = false;
+	jmp_buf handler, *previous = state->errorJump;
+	state->errorJump = &handler;
+	if (setjmp(handler) == 0) {
+		encoded = encodeValue(&o, value);
+		if (encoded && writer != NULL) {
+			flush(&o);
+		} else if (encoded) {
+			*out = (object_t){ TYPE_STRING, { .string = _winter_stringCreateSize(state, o.data != NULL ? o.data : "", o.size) } };
+		}
+	} else {
+		o.error = NULL;
+		encoded = false;
+	}
+	state->errorJump = previous;
+	if (writer == NULL && o.data != NULL) {
+		FREE(o.data);
+	}
+	
+	if (!encoded) {
+		if (out == NULL) {
+			return -1;
+		} else if (o.error == NULL) {
+			*out = (object_t){ TYPE_ERROR, { .string = state->memoryError } };
+		} else {
+			_winter_objectNewError(state, out, "%s", o.error);
+		}
+		return -1;
+	}
+	return o.status;
+}
+
+//jsondecode(s) returns the value of the JSON text
+static int jsonDecode(winterState_t *state, winterValue_t *args, int argc) {
+	if (args[0].type != TYPE_STRING) {
+		_winter_objectNewError(state, &args[0], "jsondecode expects a string");
+		return 1;
+	}
+	wstring_t *text = args[0].string;
+	_winter_jsonDecode(state, text->data, text->length, &args[0]);
+	return 1;
+}
+
+//jsonencode(v) returns the value as JSON text
+static int jsonEncode(winterState_t *state, winterValue_t *args, int argc) {
+	_winter_jsonEncode(state, &args[0], NULL, NULL, &args[0]);
+	return 1;
+}
+
+void winterOpenJson(winterState_t *state) {
+	winterRegister(state, "jsondecode", jsonDecode, 1);
+	winterRegister(state, "jsonencode", jsonEncode, 1);
+}
+
+const winterValue_t *winterDecodeJson(winterState_t *state, const char *json, size_t length) {
+	if (state->numFrames == 0) {
+		state->top = 0;
+	}
+	object_t value;
+	_winter_jsonDecode(state, json, length, &value);
+	return _winter_stackPush(state, &value);
+}
+
+int winterEncodeJson(winterState_t *state, const winterValue_t *value, winterWriter_t writer, void *user) {
+	return _winter_jsonEncode(state, value, writer, user, NULL);
+}
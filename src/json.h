@@ -0,0 +1,28 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "wtype.h"
+#include "object.h"
+
+//JSON text to tables and back, see winterOpenJson
+//
+//Decoding makes two passes. The first reads the text 64 bytes at a time, with AVX2 when
+//the CPU has it, into bit masks of quotes, backslashes, operators and whitespace, works
+//out which bytes are inside strings from those without branching, and writes the offsets
+//of the operators and of the first byte of every other value to an index. The second walks
+//the index, so it never scans a string for its end or skips whitespace, and builds each
+//object or array once all of its entries are known, with room for them up front. Object
+//keys that repeat share one string
+//
+//Encoding appends to one buffer, or flushes it to a writer every 4096 bytes
+
+//Deepest nesting of arrays and objects, which also stops encoding a cycle
+#define JSON_MAX_DEPTH 512
+
+//Decodes into 'out', or returns false with an error value there
+bool_t _winter_jsonDecode(winterState_t *state, const char *json, size_t length, object_t *out);
+//Encodes to the writer, or to a new string in 'out' when 'writer' is NULL. Returns 0, the
+//writer's result if it fails, or -1 with an error value in 'out'
+int _winter_jsonEncode(winterState_t *state, const object_t *value, winterWriter_t writer, void *user, object_t *out);
+
+#endif
@@ -0,0 +1,603 @@
+#include "kernel.h"
+#include "sort.h"
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(WINTER_NO_SIMD)
+#define KERNEL_AVX2
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+//The vector version runs first and returns how many elements it did
+#define SIMD(call) (__builtin_cpu_supports("avx2") ? (call) : 0)
+#else
+#define SIMD(call) 0
+#endif
+
+//Scalar versions, 'step' is 0 when b is one repeated value
+#define EACH(T, expr) for (size_t i = 0; i < n; i++) { T p = x[i], q = y[i * step]; o[i] = (expr); }
+
+#define FLOAT_ARITH(name, T)                                                              \
+static void name(kernelOp_t op, T *o, const T *x, const T *y, size_t step, size_t n) {    \
+	switch (op) {                                                                         \
+		case KERNEL_ADD: EACH(T, p + q) break;                                            \
+		case KERNEL_SUB: EACH(T, p - q) break;                                            \
+		case KERNEL_MUL: EACH(T, p * q) break;                                            \
+		case KERNEL_DIV: EACH(T, p / q) break;                                            \
+		case KERNEL_MIN: EACH(T, p < q ? p : q) break;                                    \
+		case KERNEL_MAX: EACH(T, p > q ? p : q) break;                                    \
+	}                                                                                     \
+}
+//Unsigned so overflow wraps instead of being undefined
+#define INT_ARITH(name, T, U)                                                             \
+static void name(kernelOp_t op, T *o, const T *x, const T *y, size_t step, size_t n) {    \
+	switch (op) {                                                                         \
+		case KERNEL_ADD: EACH(T, (T)((U)p + (U)q)) break;                                 \
+		case KERNEL_SUB: EACH(T, (T)((U)p - (U)q)) break;                                 \
+		case KERNEL_MUL: EACH(T, (T)((U)p * (U)q)) break;                                 \
+		case KERNEL_MIN: EACH(T, p < q ? p : q) break;                                    \
+		case KERNEL_MAX: EACH(T, p > q ? p : q) break;                                    \
+		default: break;                                                                   \
+	}                                                                                     \
+}
+#define COMPARE(name, T)                                                                  \
+static void name(kernelCompare_t op, int32_t *o, const T *x, const T *y, size_t step, size_t n) { \
+	switch (op) {                                                                         \
+		case KERNEL_EQ: EACH(T, p == q) break;                                            \
+		case KERNEL_NE: EACH(T, p != q) break;                                            \
+		case KERNEL_LT: EACH(T, p <  q) break;                                            \
+		case KERNEL_LE: EACH(T, p <= q) break;                                            \
+		case KERNEL_GT: EACH(T, p >  q) break;                                            \
+		case KERNEL_GE: EACH(T, p >= q) break;                                            \
+	}                                                                                     \
+}
+
+FLOAT_ARITH(arithF64, double)
+FLOAT_ARITH(arithF32, float)
+INT_ARITH(arithI64, int64_t, uint64_t)
+INT_ARITH(arithI32, int32_t, uint32_t)
+COMPARE(compareF64, double)
+COMPARE(compareF32, float)
+COMPARE(compareI64, int64_t)
+COMPARE(compareI32, int32_t)
+
+#ifdef KERNEL_AVX2
+//AVX2 versions, the operation is picked per vector since the branch always goes the same way
+
+AVX2 static inline __m256i notI(__m256i a) {
+	return _mm256_xor_si256(a, _mm256_set1_epi32(-1));
+}
+AVX2 static inline __m256i minI64(__m256i a, __m256i b) {
+	return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+AVX2 static inline __m256i maxI64(__m256i a, __m256i b) {
+	return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+}
+
+AVX2 static inline __m256d opF64(kernelOp_t op, __m256d p, __m256d q) {
+	switch (op) {
+		case KERNEL_ADD: return _mm256_add_pd(p, q);
+		case KERNEL_SUB: return _mm256_sub_pd(p, q);
+		case KERNEL_MUL: return _mm256_mul_pd(p, q);
+		case KERNEL_DIV: return _mm256_div_pd(p, q);
+		case KERNEL_MIN: return _mm256_min_pd(p, q);
+		default:         return _mm256_max_pd(p, q);
+	}
+}
+AVX2 static inline __m256 opF32(kernelOp_t op, __m256 p, __m256 q) {
+	switch (op) {
+		case KERNEL_ADD: return _mm256_add_ps(p, q);
+		case KERNEL_SUB: return _mm256_sub_ps(p, q);
+		case KERNEL_MUL: return _mm256_mul_ps(p, q);
+		case KERNEL_DIV: return _mm256_div_ps(p, q);
+		case KERNEL_MIN: return _mm256_min_ps(p, q);
+		default:         return _mm256_max_ps(p, q);
+	}
+}
+//Multiplies are left to the scalar version
+AVX2 static inline __m256i opI64(kernelOp_t op, __m256i p, __m256i q) {
+	switch (op) {
+		case KERNEL_ADD: return _mm256_add_epi64(p, q);
+		case KERNEL_SUB: return _mm256_sub_epi64(p, q);
+		case KERNEL_MIN: return minI64(p, q);
+		default:         return maxI64(p, q);
+	}
+}
+AVX2 static inline __m256i opI32(kernelOp_t op, __m256i p, __m256i q) {
+	switch (op) {
+		case KERNEL_ADD: return _mm256_add_epi32(p, q);
+		case KERNEL_SUB: return _mm256_sub_epi32(p, q);
+		case KERNEL_MUL: return _mm256_mullo_epi32(p, q);
+		case KERNEL_MIN: return _mm256_min_epi32(p, q);
+		default:         return _mm256_max_epi32(p, q);
+	}
+}
+
+#define VECTOR_ARITH(name, T, V, width, op, load, store, set1)                            \
+AVX2 static size_t name(kernelOp_t k, T *o, const T *x, const T *y, size_t step, size_t n) { \
+	size_t i = 0;                                                                         \
+	V q = set1(y[0]);                                                                     \
+	for (; i + width <= n; i += width) {                                                  \
+		store(o + i, op(k, load(x + i), step ? load(y + i) : q));                         \
+	}                                                                                     \
+	return i;                                                                             \
+}
+#define LOADI(p)     _mm256_loadu_si256((const __m256i*)(p))
+#define STOREI(p, v) _mm256_storeu_si256((__m256i*)(p), (v))
+
+VECTOR_ARITH(arithF64Avx2, double,  __m256d, 4, opF64, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd)
+VECTOR_ARITH(arithF32Avx2, float,   __m256,  8, opF32, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps)
+VECTOR_ARITH(arithI64Avx2, int64_t, __m256i, 4, opI64, LOADI, STOREI, _mm256_set1_epi64x)
+VECTOR_ARITH(arithI32Avx2, int32_t, __m256i, 8, opI32, LOADI, STOREI, _mm256_set1_epi32)
+
+//Lanes of all ones or zeros, compared as integers
+AVX2 static inline __m256i compareF64v(kernelCompare_t op, __m256d p, __m256d q) {
+	switch (op) {
+		case KERNEL_EQ: return _mm256_castpd_si256(_mm256_cmp_pd(p, q, _CMP_EQ_OQ));
+		case KERNEL_NE: return _mm256_castpd_si256(_mm256_cmp_pd(p, q, _CMP_NEQ_UQ));
+		case KERNEL_LT: return _mm256_castpd_si256(_mm256_cmp_pd(p, q, _CMP_LT_OQ));
+		case KERNEL_LE: return _mm256_castpd_si256(_mm256_cmp_pd(p, q, _CMP_LE_OQ));
+		case KERNEL_GT: return _mm256_castpd_si256(_mm256_cmp_pd(p, q, _CMP_GT_OQ));
+		default:        return _mm256_castpd_si256(_mm256_cmp_pd(p, q, _CMP_GE_OQ));
+	}
+}
+AVX2 static inline __m256i compareF32v(kernelCompare_t op, __m256 p, __m256 q) {
+	switch (op) {
+		case KERNEL_EQ: return _mm256_castps_si256(_mm256_cmp_ps(p, q, _CMP_EQ_OQ));
+		case KERNEL_NE: return _mm256_castps_si256(_mm256_cmp_ps(p, q, _CMP_NEQ_UQ));
+		case KERNEL_LT: return _mm256_castps_si256(_mm256_cmp_ps(p, q, _CMP_LT_OQ));
+		case KERNEL_LE: return _mm256_castps_si256(_mm256_cmp_ps(p, q, _CMP_LE_OQ));
+		case KERNEL_GT: return _mm256_castps_si256(_mm256_cmp_ps(p, q, _CMP_GT_OQ));
+		default:        return _mm256_castps_si256(_mm256_cmp_ps(p, q, _CMP_GE_OQ));
+	}
+}
+AVX2 static inline __m256i compareI64v(kernelCompare_t op, __m256i p, __m256i q) {
+	switch (op) {
+		case KERNEL_EQ: return _mm256_cmpeq_epi64(p, q);
+		case KERNEL_NE: return notI(_mm256_cmpeq_epi64(p, q));
+		case KERNEL_LT: return _mm256_cmpgt_epi64(q, p);
+		case KERNEL_LE: return notI(_mm256_cmpgt_epi64(p, q));
+		case KERNEL_GT: return _mm256_cmpgt_epi64(p, q);
+		default:        return notI(_mm256_cmpgt_epi64(q, p));
+	}
+}
+AVX2 static inline __m256i compareI32v(kernelCompare_t op, __m256i p, __m256i q) {
+	switch (op) {
+		case KERNEL_EQ: return _mm256_cmpeq_epi32(p, q);
+		case KERNEL_NE: return notI(_mm256_cmpeq_epi32(p, q));
+		case KERNEL_LT: return _mm256_cmpgt_epi32(q, p);
+		case KERNEL_LE: return notI(_mm256_cmpgt_epi32(p, q));
+		case KERNEL_GT: return _mm256_cmpgt_epi32(p, q);
+		default:        return notI(_mm256_cmpgt_epi32(q, p));
+	}
+}
+
+//64 bit lanes are narrowed to the 32 bit masks by keeping their low halves
+AVX2 static inline void storeMask64(int32_t *o, __m256i m) {
+	__m256i low = _mm256_permutevar8x32_epi32(m, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+	_mm_storeu_si128((__m128i*)o, _mm_and_si128(_mm256_castsi256_si128(low), _mm_set1_epi32(1)));
+}
+AVX2 static inline void storeMask32(int32_t *o, __m256i m) {
+	STOREI(o, _mm256_and_si256(m, _mm256_set1_epi32(1)));
+}
+
+#define VECTOR_COMPARE(name, T, V, width, compare, load, set1, storeMask)                 \
+AVX2 static size_t name(kernelCompare_t k, int32_t *o, const T *x, const T *y, size_t step, size_t n) { \
+	size_t i = 0;                                                                         \
+	V q = set1(y[0]);                                                                     \
+	for (; i + width <= n; i += width) {                                                  \
+		storeMask(o + i, compare(k, load(x + i), step ? load(y + i) : q));                \
+	}                                                                                     \
+	return i;                                                                             \
+}
+
+VECTOR_COMPARE(compareF64Avx2, double,  __m256d, 4, compareF64v, _mm256_loadu_pd, _mm256_set1_pd, storeMask64)
+VECTOR_COMPARE(compareF32Avx2, float,   __m256,  8, compareF32v, _mm256_loadu_ps, _mm256_set1_ps, storeMask32)
+VECTOR_COMPARE(compareI64Avx2, int64_t, __m256i, 4, compareI64v, LOADI, _mm256_set1_epi64x, storeMask64)
+VECTOR_COMPARE(compareI32Avx2, int32_t, __m256i, 8, compareI32v, LOADI, _mm256_set1_epi32, storeMask32)
+#endif
+
+#define DISPATCH(T, scalar, vector) do {                                                  \
+	const T *x = a, *y = b;                                                               \
+	size_t done = SIMD(vector(op, out, x, y, step, n));                                   \
+	scalar(op, (T*)out + done, x + done, y + done * step, step, n - done);                \
+} while (0)
+
+void _winter_kernelArith(arrayType_t kind, kernelOp_t op, void *out, const void *a, const void *b, bool_t scalar, size_t n) {
+	size_t step = scalar ? 0 : 1;
+	if (n == 0) return;
+	switch (kind) {
+		case ARRAY_FLOAT64: DISPATCH(double,  arithF64, arithF64Avx2); break;
+		case ARRAY_FLOAT32: DISPATCH(float,   arithF32, arithF32Avx2); break;
+		case ARRAY_INT64:
+			//AVX2 has no 64 bit multiply
+			if (op == KERNEL_MUL) {
+				arithI64(op, out, a, b, step, n);
+			} else {
+				DISPATCH(int64_t, arithI64, arithI64Avx2);
+			}
+			break;
+		case ARRAY_INT32:   DISPATCH(int32_t, arithI32, arithI32Avx2); break;
+	}
+}
+
+#undef DISPATCH
+#define DISPATCH(T, scalar, vector) do {                                                  \
+	const T *x = a, *y = b;                                                               \
+	size_t done = SIMD(vector(op, mask, x, y, step, n));                                  \
+	scalar(op, mask + done, x + done, y + done * step, step, n - done);                   \
+} while (0)
+
+void _winter_kernelCompare(arrayType_t kind, kernelCompare_t op, int32_t *mask, const void *a, const void *b, bool_t scalar, size_t n) {
+	size_t step = scalar ? 0 : 1;
+	if (n == 0) return;
+	switch (kind) {
+		case ARRAY_FLOAT64: DISPATCH(double,  compareF64, compareF64Avx2); break;
+		case ARRAY_FLOAT32: DISPATCH(float,   compareF32, compareF32Avx2); break;
+		case ARRAY_INT64:   DISPATCH(int64_t, compareI64, compareI64Avx2); break;
+		case ARRAY_INT32:   DISPATCH(int32_t, compareI32, compareI32Avx2); break;
+	}
+}
+
+//Reductions
+
+#ifdef KERNEL_AVX2
+AVX2 static inline double sumLanes(__m256d v) {
+	__m128d half = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+AVX2 static inline int64_t sumLanesI(__m256i v) {
+	int64_t lanes[4];
+	STOREI(lanes, v);
+	return (int64_t)((uint64_t)lanes[0] + (uint64_t)lanes[1] + (uint64_t)lanes[2] + (uint64_t)lanes[3]);
+}
+
+//Floats are added as doubles, like the scalar version
+AVX2 static size_t sumF64Avx2(const double *x, size_t n, double *sum) {
+	__m256d a = _mm256_setzero_pd(), b = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		a = _mm256_add_pd(a, _mm256_loadu_pd(x + i));
+		b = _mm256_add_pd(b, _mm256_loadu_pd(x + i + 4));
+	}
+	*sum = sumLanes(_mm256_add_pd(a, b));
+	return i;
+}
+AVX2 static size_t sumF32Avx2(const float *x, size_t n, double *sum) {
+	__m256d a = _mm256_setzero_pd(), b = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		a = _mm256_add_pd(a, _mm256_cvtps_pd(_mm_loadu_ps(x + i)));
+		b = _mm256_add_pd(b, _mm256_cvtps_pd(_mm_loadu_ps(x + i + 4)));
+	}
+	*sum = sumLanes(_mm256_add_pd(a, b));
+	return i;
+}
+AVX2 static size_t sumI64Avx2(const int64_t *x, size_t n, int64_t *sum) {
+	__m256i a = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		a = _mm256_add_epi64(a, LOADI(x + i));
+	}
+	*sum = sumLanesI(a);
+	return i;
+}
+AVX2 static size_t sumI32Avx2(const int32_t *x, size_t n, int64_t *sum) {
+	__m256i a = _mm256_setzero_si256(), b = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		a = _mm256_add_epi64(a, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(x + i))));
+		b = _mm256_add_epi64(b, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(x + i + 4))));
+	}
+	*sum = sumLanesI(_mm256_add_epi64(a, b));
+	return i;
+}
+
+//Min and max start from the first element, the lanes are folded with the scalar version
+AVX2 static size_t extremeF64Avx2(kernelOp_t op, const double *x, size_t n, double *out) {
+	__m256d m = _mm256_set1_pd(x[0]);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		m = opF64(op, _mm256_loadu_pd(x + i), m);
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, m);
+	*out = lanes[0];
+	for (int k = 1; k < 4; k++) {
+		*out = op == KERNEL_MIN ? (lanes[k] < *out ? lanes[k] : *out) : (lanes[k] > *out ? lanes[k] : *out);
+	}
+	return i;
+}
+AVX2 static size_t extremeF32Avx2(kernelOp_t op, const float *x, size_t n, double *out) {
+	__m256 m = _mm256_set1_ps(x[0]);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		m = opF32(op, _mm256_loadu_ps(x + i), m);
+	}
+	float lanes[8];
+	_mm256_storeu_ps(lanes, m);
+	*out = lanes[0];
+	for (int k = 1; k < 8; k++) {
+		*out = op == KERNEL_MIN ? (lanes[k] < *out ? lanes[k] : *out) : (lanes[k] > *out ? lanes[k] : *out);
+	}
+	return i;
+}
+AVX2 static size_t extremeI64Avx2(kernelOp_t op, const int64_t *x, size_t n, int64_t *out) {
+	__m256i m = _mm256_set1_epi64x(x[0]);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		m = opI64(op, LOADI(x + i), m);
+	}
+	int64_t lanes[4];
+	STOREI(lanes, m);
+	*out = lanes[0];
+	for (int k = 1; k < 4; k++) {
+		*out = op == KERNEL_MIN ? (lanes[k] < *out ? lanes[k] : *out) : (lanes[k] > *out ? lanes[k] : *out);
+	}
+	return i;
+}
+AVX2 static size_t extremeI32Avx2(kernelOp_t op, const int32_t *x, size_t n, int64_t *out) {
+	__m256i m = _mm256_set1_epi32(x[0]);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		m = opI32(op, LOADI(x + i), m);
+	}
+	int32_t lanes[8];
+	STOREI(lanes, m);
+	*out = lanes[0];
+	for (int k = 1; k < 8; k++) {
+		*out = op == KERNEL_MIN ? (lanes[k] < *out ? lanes[k] : *out) : (lanes[k] > *out ? lanes[k] : *out);
+	}
+	return i;
+}
+
+AVX2 static size_t dotF64Avx2(const double *x, const double *y, size_t n, double *sum) {
+	__m256d a = _mm256_setzero_pd(), b = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		a = _mm256_add_pd(a, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		b = _mm256_add_pd(b, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+	}
+	*sum = sumLanes(_mm256_add_pd(a, b));
+	return i;
+}
+AVX2 static size_t dotF32Avx2(const float *x, const float *y, size_t n, double *sum) {
+	__m256d a = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		a = _mm256_add_pd(a, _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i)), _mm256_cvtps_pd(_mm_loadu_ps(y + i))));
+	}
+	*sum = sumLanes(a);
+	return i;
+}
+AVX2 static size_t dotI32Avx2(const int32_t *x, const int32_t *y, size_t n, int64_t *sum) {
+	__m256i a = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i p = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(x + i)));
+		__m256i q = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(y + i)));
+		a = _mm256_add_epi64(a, _mm256_mul_epi32(p, q));
+	}
+	*sum = sumLanesI(a);
+	return i;
+}
+#endif
+
+#define SUM(T, acc, vector) do {                                                          \
+	const T *x = a;                                                                       \
+	size_t done = SIMD(vector(x, n, &acc));                                               \
+	for (size_t i = done; i < n; i++) acc += x[i];                                        \
+} while (0)
+#define SUM_INT(T, vector) do {                                                           \
+	const T *x = a;                                                                       \
+	size_t done = SIMD(vector(x, n, &integer));                                           \
+	for (size_t i = done; i < n; i++) integer = (int64_t)((uint64_t)integer + (uint64_t)x[i]); \
+} while (0)
+#define EXTREME(T, acc, vector) do {                                                      \
+	const T *x = a;                                                                       \
+	size_t done = SIMD(vector(op, x, n, &acc));                                           \
+	if (done == 0) acc = x[0];                                                            \
+	for (size_t i = done; i < n; i++) {                                                   \
+		acc = op == KERNEL_MIN ? (x[i] < acc ? x[i] : acc) : (x[i] > acc ? x[i] : acc);   \
+	}                                                                                     \
+} while (0)
+
+object_t _winter_kernelReduce(arrayType_t kind, kernelOp_t op, const void *a, size_t n) {
+	double  floating = 0;
+	int64_t integer  = 0;
+	if (op == KERNEL_ADD) {
+		switch (kind) {
+			case ARRAY_FLOAT64: SUM(double,  floating, sumF64Avx2); break;
+			case ARRAY_FLOAT32: SUM(float,   floating, sumF32Avx2); break;
+			case ARRAY_INT64:   SUM_INT(int64_t, sumI64Avx2); break;
+			case ARRAY_INT32:   SUM_INT(int32_t, sumI32Avx2); break;
+		}
+	} else {
+		switch (kind) {
+			case ARRAY_FLOAT64: EXTREME(double,  floating, extremeF64Avx2); break;
+			case ARRAY_FLOAT32: EXTREME(float,   floating, extremeF32Avx2); break;
+			case ARRAY_INT64:   EXTREME(int64_t, integer,  extremeI64Avx2); break;
+			case ARRAY_INT32:   EXTREME(int32_t, integer,  extremeI32Avx2); break;
+		}
+	}
+	if (isFloatArray(kind)) {
+		return (object_t){ TYPE_FLOAT, { .floating = floating } };
+	}
+	return (object_t){ TYPE_INT, { .integer = integer } };
+}
+
+object_t _winter_kernelDot(arrayType_t kind, const void *a, const void *b, size_t n) {
+	double  floating = 0;
+	int64_t integer  = 0;
+	size_t  done     = 0;
+	switch (kind) {
+		case ARRAY_FLOAT64: {
+			const double *x = a, *y = b;
+			done = SIMD(dotF64Avx2(x, y, n, &floating));
+			for (size_t i = done; i < n; i++) floating += x[i] * y[i];
+		} break;
+		case ARRAY_FLOAT32: {
+			const float *x = a, *y = b;
+			done = SIMD(dotF32Avx2(x, y, n, &floating));
+			for (size_t i = done; i < n; i++) floating += (double)x[i] * y[i];
+		} break;
+		case ARRAY_INT64: {
+			//AVX2 has no 64 bit multiply
+			const int64_t *x = a, *y = b;
+			for (size_t i = 0; i < n; i++) integer = (int64_t)((uint64_t)integer + (uint64_t)x[i] * (uint64_t)y[i]);
+		} break;
+		case ARRAY_INT32: {
+			const int32_t *x = a, *y = b;
+			done = SIMD(dotI32Avx2(x, y, n, &integer));
+			for (size_t i = done; i < n; i++) integer = (int64_t)((uint64_t)integer + (uint64_t)((int64_t)x[i] * y[i]));
+		} break;
+	}
+	if (isFloatArray(kind)) {
+		return (object_t){ TYPE_FLOAT, { .floating = floating } };
+	}
+	return (object_t){ TYPE_INT, { .integer = integer } };
+}
+
+//Gathers
+
+#ifdef KERNEL_AVX2
+//Indices are checked a vector at a time before they're used, returns SIZE_MAX if one is out of range
+AVX2 static size_t gather64by64(int64_t *o, const int64_t *data, size_t length, const int64_t *indices, size_t n) {
+	__m256i zero = _mm256_setzero_si256(), last = _mm256_set1_epi64x((int64_t)length - 1);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i index = LOADI(indices + i);
+		__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(zero, index), _mm256_cmpgt_epi64(index, last));
+		if (!_mm256_testz_si256(bad, bad)) return SIZE_MAX;
+		STOREI(o + i, _mm256_i64gather_epi64((const long long*)data, index, 8));
+	}
+	return i;
+}
+AVX2 static size_t gather64by32(int64_t *o, const int64_t *data, size_t length, const int32_t *indices, size_t n) {
+	__m128i zero = _mm_setzero_si128(), last = _mm_set1_epi32(length > INT32_MAX ? INT32_MAX : (int32_t)length - 1);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i index = _mm_loadu_si128((const __m128i*)(indices + i));
+		__m128i bad = _mm_or_si128(_mm_cmpgt_epi32(zero, index), _mm_cmpgt_epi32(index, last));
+		if (!_mm_testz_si128(bad, bad)) return SIZE_MAX;
+		STOREI(o + i, _mm256_i32gather_epi64((const long long*)data, index, 8));
+	}
+	return i;
+}
+AVX2 static size_t gather32by64(int32_t *o, const int32_t *data, size_t length, const int64_t *indices, size_t n) {
+	__m256i zero = _mm256_setzero_si256(), last = _mm256_set1_epi64x((int64_t)length - 1);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i index = LOADI(indices + i);
+		__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(zero, index), _mm256_cmpgt_epi64(index, last));
+		if (!_mm256_testz_si256(bad, bad)) return SIZE_MAX;
+		_mm_storeu_si128((__m128i*)(o + i), _mm256_i64gather_epi32((const int*)data, index, 4));
+	}
+	return i;
+}
+AVX2 static size_t gather32by32(int32_t *o, const int32_t *data, size_t length, const int32_t *indices, size_t n) {
+	__m256i zero = _mm256_setzero_si256(), last = _mm256_set1_epi32(length > INT32_MAX ? INT32_MAX : (int32_t)length - 1);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i index = LOADI(indices + i);
+		__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi32(zero, index), _mm256_cmpgt_epi32(index, last));
+		if (!_mm256_testz_si256(bad, bad)) return SIZE_MAX;
+		STOREI(o + i, _mm256_i32gather_epi32((const int*)data, index, 4));
+	}
+	return i;
+}
+#endif
+
+#define GATHER(T, I, vector) do {                                                         \
+	T *o = out;                                                                           \
+	const T *x = data;                                                                    \
+	const I *index = indices;                                                             \
+	size_t done = SIMD(vector(o, x, length, index, n));                                   \
+	if (done == SIZE_MAX) return false;                                                   \
+	for (size_t i = done; i < n; i++) {                                                   \
+		if (index[i] < 0 || (uint64_t)index[i] >= length) return false;                   \
+		o[i] = x[index[i]];                                                               \
+	}                                                                                     \
+} while (0)
+
+bool_t _winter_kernelGather(arrayType_t kind, void *out, const void *data, size_t length, arrayType_t indexKind, const void *indices, size_t n) {
+	//Only the width of the elements matters
+	if (_winter_arrayWidth(kind) == 8) {
+		if (indexKind == ARRAY_INT64) GATHER(int64_t, int64_t, gather64by64);
+		else                          GATHER(int64_t, int32_t, gather64by32);
+	} else {
+		if (indexKind == ARRAY_INT64) GATHER(int32_t, int64_t, gather32by64);
+		else                          GATHER(int32_t, int32_t, gather32by32);
+	}
+	return true;
+}
+
+//Sorting
+//Floats use the branchless quicksort in sort.h once NaNs are moved to the end. Ints are
+//radix sorted a byte at a time from the lowest, skipping bytes every element shares, and
+//short ones use the quicksort too
+#define RADIX_MIN 256
+
+#define NUMBER_LESS(a, b) ((a) < (b))
+SORT_DEFINE(sortF64, double,  NUMBER_LESS, 1)
+SORT_DEFINE(sortF32, float,   NUMBER_LESS, 1)
+SORT_DEFINE(sortI64, int64_t, NUMBER_LESS, 1)
+SORT_DEFINE(sortI32, int32_t, NUMBER_LESS, 1)
+
+//Flipping the sign bit orders the bytes of two's complement ints as unsigned
+#define RADIX(name, T, U)                                                                 \
+static void name(T *data, T *scratch, size_t n) {                                         \
+	size_t counts[sizeof(T)][256] = {{0}};                                                \
+	const U flip = (U)1 << (sizeof(T) * 8 - 1);                                           \
+	for (size_t i = 0; i < n; i++) {                                                      \
+		U key = (U)data[i] ^ flip;                                                        \
+		for (size_t b = 0; b < sizeof(T); b++) counts[b][(key >> (b * 8)) & 255]++;       \
+	}                                                                                     \
+	T *from = data, *to = scratch;                                                        \
+	for (size_t b = 0; b < sizeof(T); b++) {                                              \
+		size_t *count = counts[b], offset = 0;                                            \
+		if (count[(((U)from[0] ^ flip) >> (b * 8)) & 255] == n) continue;                 \
+		for (size_t d = 0; d < 256; d++) {                                                \
+			size_t c = count[d];                                                          \
+			count[d] = offset;                                                            \
+			offset += c;                                                                  \
+		}                                                                                 \
+		for (size_t i = 0; i < n; i++) {                                                  \
+			T value = from[i];                                                            \
+			to[count[(((U)value ^ flip) >> (b * 8)) & 255]++] = value;                    \
+		}                                                                                 \
+		T *swap = from;                                                                   \
+		from = to;                                                                        \
+		to = swap;                                                                        \
+	}                                                                                     \
+	if (from != data) memcpy(data, from, sizeof(T) * n);                                  \
+}
+RADIX(radixI64, int64_t, uint64_t)
+RADIX(radixI32, int32_t, uint32_t)
+
+#define SORT_FLOAT(T, sort) do {                                                          \
+	T *x = data;                                                                          \
+	size_t m = 0;                                                                         \
+	for (size_t i = 0; i < n; i++) {                                                      \
+		if (x[i] == x[i]) {                                                               \
+			T value = x[i];                                                               \
+			x[i] = x[m];                                                                  \
+			x[m++] = value;                                                               \
+		}                                                                                 \
+	}                                                                                     \
+	sort(x, m);                                                                           \
+} while (0)
+
+void _winter_kernelSort(arrayType_t kind, void *data, void *scratch, size_t n) {
+	switch (kind) {
+		case ARRAY_FLOAT64: SORT_FLOAT(double, sortF64); break;
+		case ARRAY_FLOAT32: SORT_FLOAT(float,  sortF32); break;
+		case ARRAY_INT64:
+			if (n < RADIX_MIN) sortI64(data, n);
+			else               radixI64(data, scratch, n);
+			break;
+		case ARRAY_INT32:
+			if (n < RADIX_MIN) sortI32(data, n);
+			else               radixI32(data, scratch, n);
+			break;
+	}
+}
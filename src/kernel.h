@@ -0,0 +1,45 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include "wtype.h"
+#include "object.h"
+#include "array.h"
+
+//Loops over contiguous buffers of one element type for the array functions, see array.h
+//
+//On x86-64 with GCC or Clang every kernel has an AVX2 version, picked when the CPU has it,
+//which leaves the last few elements to the scalar version. Integers wrap around on
+//overflow. Float sums and dot products add in a different order with AVX2, so their last
+//bits can differ from the scalar result. Build with WINTER_NO_SIMD for the scalar versions only
+typedef enum kernelOp_t {
+	KERNEL_ADD,
+	KERNEL_SUB,
+	KERNEL_MUL,
+	KERNEL_DIV, //floats only
+	KERNEL_MIN,
+	KERNEL_MAX
+} kernelOp_t;
+
+typedef enum kernelCompare_t {
+	KERNEL_EQ,
+	KERNEL_NE,
+	KERNEL_LT,
+	KERNEL_LE,
+	KERNEL_GT,
+	KERNEL_GE
+} kernelCompare_t;
+
+//out[i] = a[i] op b[i], or a[i] op b[0] when 'scalar' is set
+void _winter_kernelArith(arrayType_t kind, kernelOp_t op, void *out, const void *a, const void *b, bool_t scalar, size_t n);
+//mask[i] = a[i] op b[i] as 1 or 0, b is read the same way
+void _winter_kernelCompare(arrayType_t kind, kernelCompare_t op, int32_t *mask, const void *a, const void *b, bool_t scalar, size_t n);
+//Folds with KERNEL_ADD, KERNEL_MIN or KERNEL_MAX into an int or a float, 'n' can only be 0 for sums
+object_t _winter_kernelReduce(arrayType_t kind, kernelOp_t op, const void *a, size_t n);
+object_t _winter_kernelDot(arrayType_t kind, const void *a, const void *b, size_t n);
+//out[i] = data[indices[i]] for int32 or int64 indices, returns false if one is outside of
+//'length', 'out' may be partly written then
+bool_t _winter_kernelGather(arrayType_t kind, void *out, const void *data, size_t length, arrayType_t indexKind, const void *indices, size_t n);
+//Sorts ascending with NaNs last, 'scratch' has room for 'n' elements and is only used for ints
+void _winter_kernelSort(arrayType_t kind, void *data, void *scratch, size_t n);
+
+#endif
@@ -0,0 +1,680 @@
+#define _GNU_SOURCE
+#include "loop.h"
+#include "table.h"
+#include "wstring.h"
+#include "function.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+//Suspending operations are script functions that yield whatever the native they call set
+//up, the loop resumes them with the result and iocheck raises it if it's an error
+static const char *prelude =
+	"fn read(fd, size) { return iocheck(yield(ioread(fd, size))); }"
+	"fn write(fd, data) { return iocheck(yield(iowrite(fd, data))); }"
+	"fn accept(fd) { return iocheck(yield(ioaccept(fd))); }"
+	"fn connect(address, port) { return iocheck(yield(ioconnect(address, port))); }"
+	"fn sleep(ms) { return iocheck(yield(iosleep(ms))); }";
+
+static uint64_t now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+//Turns milliseconds from now into a deadline, returns false unless it's a number that isn't
+//negative or NaN. Longer than LOOP_MAX_SLEEP is cut down to it
+static bool_t toDeadline(const object_t *ms, uint64_t *deadline) {
+	double value;
+	if (ms->type == TYPE_INT) {
+		value = (double)ms->integer;
+	} else if (ms->type == TYPE_FLOAT) {
+		value = ms->floating;
+	} else {
+		return false;
+	}
+	if (!(value >= 0)) {
+		return false;
+	}
+	if (value > LOOP_MAX_SLEEP) {
+		value = LOOP_MAX_SLEEP;
+	}
+	*deadline = now() + (uint64_t)(value * 1000000);
+	return true;
+}
+
+static void setResult(winterState_t *state, task_t *task, object_t *result) {
+	_winter_objectDelRef(state, &task->result);
+	task->result = *_winter_objectAddRef(state, result);
+}
+
+static void setErrno(winterState_t *state, task_t *task, const char *operation) {
+	object_t error;
+	_winter_objectNewError(state, &error, "%s failed: %s", operation, strerror(errno));
+	setResult(state, task, &error);
+}
+
+static void ready(loop_t *loop, task_t *task) {
+	task->op   = IO_NONE;
+	task->next = NULL;
+	if (loop->tail != NULL) {
+		loop->tail->next = task;
+	} else {
+		loop->head = task;
+	}
+	loop->tail = task;
+}
+
+//Timers
+
+static void armTimer(loop_t *loop) {
+	struct itimerspec spec = {0};
+	if (loop->numTimers > 0) {
+		uint64_t deadline = loop->timers[0]->deadline;
+		spec.it_value.tv_sec  = (time_t)(deadline / 1000000000u);
+		spec.it_value.tv_nsec = (long)(deadline % 1000000000u);
+	}
+	timerfd_settime(loop->timer, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+static void timerPush(loop_t *loop, task_t *task) {
+	winterState_t *state = loop->state;
+	if (loop->numTimers == loop->timerCapacity) {
+		loop->timerCapacity = loop->timerCapacity ? loop->timerCapacity * 2 : 16;
+		loop->timers = REALLOC(loop->timers, sizeof(task_t*) * loop->timerCapacity);
+	}
+	size_t i = loop->numTimers++;
+	while (i > 0 && loop->timers[(i - 1) / 2]->deadline > task->deadline) {
+		loop->timers[i] = loop->timers[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	loop->timers[i] = task;
+	if (i == 0) {
+		armTimer(loop);
+	}
+}
+
+static task_t *timerPop(loop_t *loop) {
+	task_t *top = loop->timers[0], *last = loop->timers[--loop->numTimers];
+	size_t i = 0, child;
+	while ((child = i * 2 + 1) < loop->numTimers) {
+		if (child + 1 < loop->numTimers && loop->timers[child + 1]->deadline < loop->timers[child]->deadline) {
+			child++;
+		}
+		if (last->deadline <= loop->timers[child]->deadline) break;
+		loop->timers[i] = loop->timers[child];
+		i = child;
+	}
+	loop->timers[i] = last;
+	return top;
+}
+
+static void expire(loop_t *loop) {
+	uint64_t count;
+	if (read(loop->timer, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		return;
+	}
+	uint64_t time = now();
+	while (loop->numTimers > 0 && loop->timers[0]->deadline <= time) {
+		ready(loop, timerPop(loop));
+	}
+	armTimer(loop);
+}
+
+//Descriptors
+
+//Performs the operation without blocking, returns false if it has to wait
+static bool_t attempt(loop_t *loop, task_t *task) {
+	winterState_t *state = loop->state;
+	object_t result = { TYPE_NULL };
+	switch (task->op) {
+		case IO_READ: {
+			//Nothing is allocated until there's data, so waiting readers hold no buffer and
+			//the string is the size of what was read
+			char buffer[LOOP_READ_SIZE];
+			ssize_t count = read(task->fd, buffer, task->size < sizeof(buffer) ? task->size : sizeof(buffer));
+			if (count < 0) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+				setErrno(state, task, "read");
+			} else {
+				result = (object_t){ TYPE_STRING, { .string = _winter_stringCreateSize(state, buffer, (size_t)count) } };
+				setResult(state, task, &result);
+			}
+			break;
+		}
+		case IO_WRITE: {
+			wstring_t *string = task->buffer.string;
+			while (task->size < string->length) {
+				ssize_t count = write(task->fd, string->data + task->size, string->length - task->size);
+				if (count < 0) break;
+				task->size += (size_t)count;
+			}
+			if (task->size < string->length) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+				setErrno(state, task, "write");
+			} else {
+				result = (object_t){ TYPE_INT, { .integer = (winterInt_t)task->size } };
+				setResult(state, task, &result);
+			}
+			break;
+		}
+		case IO_ACCEPT: {
+			int fd = accept4(task->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+				setErrno(state, task, "accept");
+			} else {
+				result = (object_t){ TYPE_INT, { .integer = fd } };
+				setResult(state, task, &result);
+			}
+			break;
+		}
+		case IO_CONNECT: {
+			int error = 0;
+			socklen_t length = sizeof(error);
+			getsockopt(task->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+			if (error == EINPROGRESS) {
+				return false;
+			} else if (error != 0) {
+				errno = error;
+				setErrno(state, task, "connect");
+				close(task->fd);
+			} else {
+				result = (object_t){ TYPE_INT, { .integer = task->fd } };
+				setResult(state, task, &result);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	_winter_objectDelRef(state, &task->buffer);
+	task->buffer = (object_t){ TYPE_NULL };
+	return true;
+}
+
+static watch_t *watchFind(loop_t *loop, int fd) {
+	return fd >= 0 && (size_t)fd < loop->numWatches ? &loop->watches[fd] : NULL;
+}
+
+//Registers what the watchers of the descriptor wait for
+static int watchUpdate(loop_t *loop, int fd, watch_t *watch) {
+	struct epoll_event event = { 0, { .fd = fd } };
+	event.events = (watch->reader ? EPOLLIN : 0) | (watch->writer ? EPOLLOUT : 0);
+	int status = 0;
+	if (event.events == 0) {
+		if (watch->events != 0) epoll_ctl(loop->epoll, EPOLL_CTL_DEL, fd, NULL);
+	} else if (event.events != watch->events) {
+		status = epoll_ctl(loop->epoll, watch->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event);
+	}
+	watch->events = status == 0 ? event.events : watch->events;
+	return status;
+}
+
+static void watchAdd(loop_t *loop, task_t *task) {
+	winterState_t *state = loop->state;
+	if ((size_t)task->fd >= loop->numWatches) {
+		size_t size = loop->numWatches ? loop->numWatches : 16;
+		while (size <= (size_t)task->fd) {
+			size *= 2;
+		}
+		loop->watches = REALLOC(loop->watches, sizeof(watch_t) * size);
+		memset(loop->watches + loop->numWatches, 0, sizeof(watch_t) * (size - loop->numWatches));
+		loop->numWatches = size;
+	}
+	watch_t *watch = &loop->watches[task->fd];
+	task_t **slot = task->op == IO_READ || task->op == IO_ACCEPT ? &watch->reader : &watch->writer;
+	if (*slot != NULL) {
+		errno = EBUSY;
+	} else {
+		*slot = task;
+		if (watchUpdate(loop, task->fd, watch) == 0) return;
+		*slot = NULL;
+	}
+	setErrno(state, task, "wait");
+	_winter_objectDelRef(state, &task->buffer);
+	task->buffer = (object_t){ TYPE_NULL };
+	ready(loop, task);
+}
+
+static void dispatch(loop_t *loop, int fd, uint32_t events) {
+	watch_t *watch = watchFind(loop, fd);
+	if (watch == NULL) return;
+	//Errors and hang ups wake both sides, the operation reports them
+	if (events & (EPOLLERR | EPOLLHUP)) {
+		events |= EPOLLIN | EPOLLOUT;
+	}
+	if ((events & EPOLLIN) && watch->reader != NULL && attempt(loop, watch->reader)) {
+		ready(loop, watch->reader);
+		watch->reader = NULL;
+	}
+	if ((events & EPOLLOUT) && watch->writer != NULL && attempt(loop, watch->writer)) {
+		ready(loop, watch->writer);
+		watch->writer = NULL;
+	}
+	watchUpdate(loop, fd, watch);
+}
+
+//Tasks
+
+static void finish(loop_t *loop, task_t *task) {
+	winterState_t *state = loop->state;
+	_winter_objectDelRef(state, &task->buffer);
+	_winter_objectDelRef(state, &task->result);
+	winterFreeCoroutine(state, task->coroutine);
+	FREE(task);
+	loop->numTasks--;
+}
+
+static void step(loop_t *loop, task_t *task) {
+	winterState_t *state = loop->state;
+	loop->current = task;
+	const winterValue_t *out = winterResume(state, task->coroutine, &task->result);
+	loop->current = NULL;
+	_winter_objectDelRef(state, &task->result);
+	task->result = (object_t){ TYPE_NULL };
+	
+	if (winterCoroutineStatus(task->coroutine) == WINTER_FINISHED) {
+		if (task->done != NULL) {
+			task->done(task->user, state, out);
+		}
+		finish(loop, task);
+	} else if (task->op == IO_SLEEP) {
+		timerPush(loop, task);
+	} else if (task->op == IO_NONE || attempt(loop, task)) {
+		ready(loop, task);
+	} else {
+		watchAdd(loop, task);
+	}
+}
+
+void _winter_loopTasks(loop_t *loop, taskVisit_t visit, void *user) {
+	//Every task is either running, ready, sleeping or watching a descriptor
+	if (loop->current != NULL) {
+		visit(user, loop->current);
+	}
+	for (task_t *task = loop->head; task != NULL; task = task->next) {
+		visit(user, task);
+	}
+	for (size_t i = 0; i < loop->numTimers; i++) {
+		visit(user, loop->timers[i]);
+	}
+	for (size_t i = 0; i < loop->numWatches; i++) {
+		if (loop->watches[i].reader != NULL) visit(user, loop->watches[i].reader);
+		if (loop->watches[i].writer != NULL) visit(user, loop->watches[i].writer);
+	}
+}
+
+static task_t *spawn(loop_t *loop, const char *name, const object_t *args, int argc, winterJobDone_t done, void *user) {
+	winterState_t *state = loop->state;
+	winterCoroutine_t *coroutine = winterCreateCoroutine(state, name, args, argc);
+	if (coroutine == NULL) {
+		return NULL;
+	}
+	task_t *task = _winter_poolTryAlloc(state, NULL, sizeof(task_t));
+	if (task == NULL) {
+		winterFreeCoroutine(state, coroutine);
+		_winter_memoryError(state);
+		return NULL;
+	}
+	*task = (task_t){ NULL };
+	task->coroutine = coroutine;
+	task->done      = done;
+	task->user      = user;
+	task->buffer    = (object_t){ TYPE_NULL };
+	task->result    = (object_t){ TYPE_NULL };
+	loop->numTasks++;
+	return task;
+}
+
+//Natives
+
+//Returns the task calling the native, or NULL with an error in args[0]
+static task_t *running(winterState_t *state, object_t *args) {
+	if (state->loop == NULL || state->loop->current == NULL) {
+		_winter_objectNewError(state, &args[0], "not running in an event loop");
+		return NULL;
+	}
+	return state->loop->current;
+}
+
+static bool_t isDescriptor(const object_t *value) {
+	return value->type == TYPE_INT && value->integer >= 0 && value->integer <= INT32_MAX;
+}
+
+static void nonblocking(int fd) {
+	int flags = fcntl(fd, F_GETFL);
+	if (flags >= 0 && !(flags & O_NONBLOCK)) {
+		fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+	}
+}
+
+static int ioRead(winterState_t *state, winterValue_t *args, int argc) {
+	task_t *task = running(state, args);
+	if (task == NULL) {
+		return 1;
+	} else if (!isDescriptor(&args[0]) || args[1].type != TYPE_INT || args[1].integer <= 0) {
+		_winter_objectNewError(state, &args[0], "read expects a descriptor and a size");
+		return 1;
+	}
+	task->op   = IO_READ;
+	task->fd   = (int)args[0].integer;
+	task->size = (size_t)args[1].integer;
+	nonblocking(task->fd);
+	args[0] = (object_t){ TYPE_NULL };
+	return 1;
+}
+
+static int ioWrite(winterState_t *state, winterValue_t *args, int argc) {
+	task_t *task = running(state, args);
+	if (task == NULL) {
+		return 1;
+	} else if (!isDescriptor(&args[0]) || args[1].type != TYPE_STRING) {
+		_winter_objectNewError(state, &args[0], "write expects a descriptor and a string");
+		return 1;
+	}
+	task->op     = IO_WRITE;
+	task->fd     = (int)args[0].integer;
+	task->size   = 0;
+	task->buffer = *_winter_objectAddRef(state, &args[1]);
+	nonblocking(task->fd);
+	args[0] = (object_t){ TYPE_NULL };
+	return 1;
+}
+
+static int ioAccept(winterState_t *state, winterValue_t *args, int argc) {
+	task_t *task = running(state, args);
+	if (task == NULL) {
+		return 1;
+	} else if (!isDescriptor(&args[0])) {
+		_winter_objectNewError(state, &args[0], "accept expects a descriptor");
+		return 1;
+	}
+	task->op = IO_ACCEPT;
+	task->fd = (int)args[0].integer;
+	args[0] = (object_t){ TYPE_NULL };
+	return 1;
+}
+
+//Starts connecting straight away, the loop waits for the socket to become writable
+static int ioConnect(winterState_t *state, winterValue_t *args, int argc) {
+	task_t *task = running(state, args);
+	if (task == NULL) {
+		return 1;
+	}
+	struct sockaddr_in address = { AF_INET };
+	if (args[0].type != TYPE_STRING || args[1].type != TYPE_INT || args[1].integer < 0 || args[1].integer > 65535 ||
+		inet_pton(AF_INET, args[0].string->data, &address.sin_addr) != 1) {
+		_winter_objectNewError(state, &args[0], "connect expects an IPv4 address and a port");
+		return 1;
+	}
+	address.sin_port = htons((uint16_t)args[1].integer);
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0 || (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS)) {
+		_winter_objectNewError(state, &args[0], "connect failed: %s", strerror(errno));
+		if (fd >= 0) close(fd);
+		return 1;
+	}
+	task->op = IO_CONNECT;
+	task->fd = fd;
+	args[0] = (object_t){ TYPE_NULL };
+	return 1;
+}
+
+static int ioSleep(winterState_t *state, winterValue_t *args, int argc) {
+	task_t *task = running(state, args);
+	if (task == NULL) {
+		return 1;
+	}
+	uint64_t deadline;
+	if (!toDeadline(&args[0], &deadline)) {
+		_winter_objectNewError(state, &args[0], "sleep expects a positive number of milliseconds");
+		return 1;
+	}
+	task->op       = IO_SLEEP;
+	task->deadline = deadline;
+	args[0] = (object_t){ TYPE_NULL };
+	return 1;
+}
+
+//Returning the error raises it
+static int ioCheck(winterState_t *state, winterValue_t *args, int argc) {
+	return 1;
+}
+
+static int ioListen(winterState_t *state, winterValue_t *args, int argc) {
+	if (args[0].type != TYPE_INT || args[0].integer < 0 || args[0].integer > 65535) {
+		_winter_objectNewError(state, &args[0], "listen expects a port");
+		return 1;
+	}
+	struct sockaddr_in address = { AF_INET };
+	address.sin_port        = htons((uint16_t)args[0].integer);
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), on = 1;
+	if (fd >= 0) {
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	}
+	if (fd < 0 || bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+		_winter_objectNewError(state, &args[0], "listen failed: %s", strerror(errno));
+		if (fd >= 0) close(fd);
+		return 1;
+	}
+	args[0] = (object_t){ TYPE_INT, { .integer = fd } };
+	return 1;
+}
+
+static int ioPort(winterState_t *state, winterValue_t *args, int argc) {
+	struct sockaddr_in address;
+	socklen_t length = sizeof(address);
+	if (!isDescriptor(&args[0]) || getsockname((int)args[0].integer, (struct sockaddr*)&address, &length) < 0) {
+		_winter_objectNewError(state, &args[0], "port expects a socket");
+		return 1;
+	}
+	args[0] = (object_t){ TYPE_INT, { .integer = ntohs(address.sin_port) } };
+	return 1;
+}
+
+//Returns a table with the read end at 0 and the write end at 1
+static int ioPipe(winterState_t *state, winterValue_t *args, int argc) {
+	int fds[2];
+	if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+		_winter_objectNewError(state, &args[0], "pipe failed: %s", strerror(errno));
+		return 1;
+	}
+	args[0] = (object_t){ TYPE_TABLE, { .pointer = _winter_tableAlloc(state, 2) } };
+	for (int i = 0; i < 2; i++) {
+		object_t key = { TYPE_INT, { .integer = i } }, value = { TYPE_INT, { .integer = fds[i] } };
+		_winter_tableSet(state, args[0].pointer, &key, &value);
+	}
+	return 1;
+}
+
+//Coroutines waiting on the descriptor are resumed with an error
+static int ioClose(winterState_t *state, winterValue_t *args, int argc) {
+	if (!isDescriptor(&args[0])) {
+		_winter_objectNewError(state, &args[0], "close expects a descriptor");
+		return 1;
+	}
+	int fd = (int)args[0].integer;
+	loop_t *loop = state->loop;
+	watch_t *watch = loop ? watchFind(loop, fd) : NULL;
+	if (watch != NULL) {
+		task_t *tasks[2] = { watch->reader, watch->writer };
+		watch->reader = watch->writer = NULL;
+		watchUpdate(loop, fd, watch);
+		for (int i = 0; i < 2; i++) {
+			if (tasks[i] == NULL) continue;
+			errno = EBADF;
+			setErrno(state, tasks[i], "wait");
+			_winter_objectDelRef(state, &tasks[i]->buffer);
+			tasks[i]->buffer = (object_t){ TYPE_NULL };
+			ready(loop, tasks[i]);
+		}
+	}
+	if (close(fd) < 0) {
+		_winter_objectNewError(state, &args[0], "close failed: %s", strerror(errno));
+	} else {
+		args[0] = (object_t){ TYPE_NULL };
+	}
+	return 1;
+}
+
+static int ioNow(winterState_t *state, winterValue_t *args, int argc) {
+	args[0] = (object_t){ TYPE_INT, { .integer = (winterInt_t)(now() / 1000000u) } };
+	return 1;
+}
+
+//Starts a coroutine calling the global 'name' with the arguments after it
+static task_t *spawnNamed(winterState_t *state, winterValue_t *args, int argc, const char *usage) {
+	if (state->loop == NULL) {
+		_winter_objectNewError(state, &args[0], "not running in an event loop");
+		return NULL;
+	} else if (argc < 1 || args[0].type != TYPE_STRING) {
+		_winter_objectNewError(state, &args[0], usage);
+		return NULL;
+	}
+	task_t *task = spawn(state->loop, args[0].string->data, args + 1, argc - 1, state->loop->done, state->loop->user);
+	args[0] = (object_t){ TYPE_NULL };
+	return task;
+}
+
+static int ioSpawn(winterState_t *state, winterValue_t *args, int argc) {
+	task_t *task = spawnNamed(state, args, argc, "spawn expects a function name");
+	if (task != NULL) {
+		ready(state->loop, task);
+	}
+	return 1;
+}
+
+//Like spawn, but the coroutine starts once the milliseconds pass
+static int ioAfter(winterState_t *state, winterValue_t *args, int argc) {
+	uint64_t deadline;
+	if (argc < 1 || !toDeadline(&args[0], &deadline)) {
+		_winter_objectNewError(state, &args[0], "after expects milliseconds and a function name");
+		return 1;
+	}
+	task_t *task = spawnNamed(state, args + 1, argc - 1, "after expects milliseconds and a function name");
+	if (task != NULL) {
+		task->deadline = deadline;
+		timerPush(state->loop, task);
+	}
+	args[0] = args[1];
+	return 1;
+}
+
+//Public
+
+winterLoop_t *winterCreateLoop(winterState_t *state, winterJobDone_t done, void *user) {
+	if (state->loop != NULL) {
+		return NULL;
+	}
+	loop_t *loop = MALLOC(sizeof(loop_t));
+	if (loop == NULL) {
+		return NULL;
+	}
+	*loop = (loop_t){ state };
+	loop->done = done;
+	loop->user = user;
+	loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+	loop->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	struct epoll_event event = { EPOLLIN, { .fd = loop->timer } };
+	if (loop->epoll < 0 || loop->timer < 0 || epoll_ctl(loop->epoll, EPOLL_CTL_ADD, loop->timer, &event) < 0) {
+		if (loop->epoll >= 0) close(loop->epoll);
+		if (loop->timer >= 0) close(loop->timer);
+		FREE(loop);
+		return NULL;
+	}
+	
+	winterRegister(state, "ioread",    ioRead,    2);
+	winterRegister(state, "iowrite",   ioWrite,   2);
+	winterRegister(state, "ioaccept",  ioAccept,  1);
+	winterRegister(state, "ioconnect", ioConnect, 2);
+	winterRegister(state, "iosleep",   ioSleep,   1);
+	winterRegister(state, "iocheck",   ioCheck,   1);
+	winterRegister(state, "listen",    ioListen,  1);
+	winterRegister(state, "port",      ioPort,    1);
+	winterRegister(state, "pipe",      ioPipe,    0);
+	winterRegister(state, "close",     ioClose,   1);
+	winterRegister(state, "now",       ioNow,     0);
+	winterRegister(state, "spawn",     ioSpawn,  -1);
+	winterRegister(state, "after",     ioAfter,  -1);
+	winterChunk_t *chunk = winterLoadString(state, prelude, NULL, 0);
+	if (chunk != NULL) {
+		winterRun(state, chunk);
+		winterFreeChunk(state, chunk);
+	}
+	state->loop = loop;
+	return loop;
+}
+
+int winterSpawn(winterLoop_t *loop, const char *name, const winterValue_t *args, int argc, winterJobDone_t done, void *user) {
+	task_t *task = spawn(loop, name, args, argc, done, user);
+	if (task == NULL) {
+		return -1;
+	}
+	ready(loop, task);
+	return 0;
+}
+
+int winterRunLoop(winterLoop_t *loop) {
+	struct epoll_event events[LOOP_EVENTS];
+	while (loop->numTasks > 0) {
+		while (loop->head != NULL) {
+			task_t *task = loop->head;
+			loop->head = task->next;
+			if (loop->head == NULL) {
+				loop->tail = NULL;
+			}
+			step(loop, task);
+		}
+		if (loop->numTasks == 0) break;
+		
+		int count = epoll_wait(loop->epoll, events, LOOP_EVENTS, -1);
+		if (count < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		for (int i = 0; i < count; i++) {
+			if (events[i].data.fd == loop->timer) {
+				expire(loop);
+			} else {
+				dispatch(loop, events[i].data.fd, events[i].events);
+			}
+		}
+	}
+	return 0;
+}
+
+void winterFreeLoop(winterLoop_t *loop) {
+	winterState_t *state = loop->state;
+	//Every task is either ready, sleeping or watching a descriptor
+	while (loop->head != NULL) {
+		task_t *task = loop->head;
+		loop->head = task->next;
+		finish(loop, task);
+	}
+	for (size_t i = 0; i < loop->numTimers; i++) {
+		finish(loop, loop->timers[i]);
+	}
+	for (size_t i = 0; i < loop->numWatches; i++) {
+		if (loop->watches[i].reader != NULL) finish(loop, loop->watches[i].reader);
+		if (loop->watches[i].writer != NULL) finish(loop, loop->watches[i].writer);
+	}
+	if (loop->timers != NULL) {
+		FREE(loop->timers);
+	}
+	if (loop->watches != NULL) {
+		FREE(loop->watches);
+	}
+	close(loop->epoll);
+	close(loop->timer);
+	state->loop = NULL;
+	FREE(loop);
+}
@@ -0,0 +1,70 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include "wtype.h"
+#include "object.h"
+#include "vm.h"
+
+//Linux only, built with WINTER_EVENT_LOOP
+#define LOOP_EVENTS 64
+//Largest read done at once, reads land on the native stack and are copied into a string
+#define LOOP_READ_SIZE (64 * 1024)
+//Longest sleep, about 31 years, keeps deadlines in nanoseconds from overflowing
+#define LOOP_MAX_SLEEP 1e12
+
+//What a coroutine is suspended on, set by the native its prelude function calls
+typedef enum ioOp_t {
+	IO_NONE, //plain yield, resumed on the next turn
+	IO_READ,
+	IO_WRITE,
+	IO_ACCEPT,
+	IO_CONNECT,
+	IO_SLEEP
+} ioOp_t;
+
+typedef struct task_t {
+	struct task_t     *next; //in the ready queue
+	winterCoroutine_t *coroutine;
+	winterJobDone_t    done;
+	void              *user;
+	
+	ioOp_t   op;
+	int      fd;
+	size_t   size;     //bytes to read, or written so far
+	object_t buffer;   //string being written from, counted
+	uint64_t deadline; //monotonic nanoseconds
+	object_t result;   //passed to the coroutine when it's resumed, counted
+} task_t;
+
+//Coroutines waiting on a descriptor, at most one reading and one writing
+typedef struct watch_t {
+	task_t  *reader, *writer;
+	uint32_t events; //registered with epoll
+} watch_t;
+
+typedef struct loop_t {
+	winterState_t *state;
+	int     epoll;
+	int     timer;   //timerfd armed for the earliest deadline
+	task_t *current; //task being resumed
+	winterJobDone_t done; //for coroutines started by scripts
+	void           *user;
+	size_t  numTasks;
+	
+	//Tasks that can be resumed
+	task_t *head, *tail;
+	
+	//Indexed by descriptor
+	watch_t *watches;
+	size_t   numWatches;
+	
+	//Min heap of sleeping tasks by deadline
+	task_t **timers;
+	size_t   numTimers, timerCapacity;
+} loop_t;
+
+//Calls 'visit' on every task that hasn't finished
+typedef void (*taskVisit_t)(void *user, task_t *task);
+void _winter_loopTasks(loop_t *loop, taskVisit_t visit, void *user);
+
+#endif
@@ -1,10 +1,12 @@
 #include "object.h"
 #include "wstring.h"
 #include "table.h"
+#include "gc.h"
 
 #include <math.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 #define typeof(o) ((o)->type)
 #define isNumeric(o) ((o)->type == TYPE_INT || (o)->type == TYPE_FLOAT)
@@ -31,33 +33,44 @@ hash_t _winter_hashCStr(const char *string) {
 }
 
 hash_t _winter_hashObjet(object_t *obj) {
-	hash_t out = 1;
+	uint64_t x;
+	obj = deref(obj);
 	switch (obj->type) {
-		case TYPE_STRING:
-			out = _winter_stringHash(obj->pointer);
-			break;
-		
-		default: break;
+		case TYPE_STRING: return _winter_stringHash(obj->pointer);
+		case TYPE_INT:    x = (uint64_t)obj->integer; break;
+		case TYPE_FLOAT:  x = 0; if (obj->floating != 0.0) memcpy(&x, &obj->floating, sizeof(x)); break;
+		case TYPE_NULL:   return 1;
+		default:          x = (uintptr_t)obj->pointer; break;
 	}
-	return out;
+	//Mixed so keys counting up spread over the buckets
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	return (hash_t)x;
 }
 
 void _winter_objectNewError(winterState_t *state, object_t *dest, const char *format, ...) {
 	va_list args;
 	va_start(args, format);
-	size_t size = vsnprintf(NULL, 0, format, args);
+	_winter_objectNewErrorV(state, dest, format, args);
 	va_end(args);
+}
+void _winter_objectNewErrorV(winterState_t *state, object_t *dest, const char *format, va_list args) {
+	va_list copy;
+	va_copy(copy, args);
+	size_t size = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
 	
 	wstring_t *string = _winter_stringAlloc(state, size + 1);
 	string->length = size;
-	
-	va_start(args, format);
 	vsnprintf(string->data, size + 1, format, args);
-	va_end(args);
+	
+	string->_type = TYPE_ERROR;
+	state->memory.strings--;
+	state->memory.errors++;
 	
 	dest->type = TYPE_ERROR;
 	dest->string = string;
-	_winter_objectAddRef(state, dest);
 }
 
 object_t *_winter_objectAddRef(winterState_t *state, object_t *obj) {
@@ -75,13 +88,13 @@ object_t *_winter_objectDelRef(winterState_t *state, object_t *obj) {
 		if (ref->_refcount != REF_PERSISTENT) {
 			ref->_refcount -= 1;
 			if (ref->_refcount == 0) {
-				switch (obj->type) {
-					case TYPE_ERROR:
-					case TYPE_STRING: _winter_stringFree(state, obj->pointer); break;
-					case TYPE_TABLE:  _winter_tableFree(state, obj->pointer); break;
-					default: break;
+				//Freed once the stack is scanned
+				if (!ref->_zct) {
+					_winter_zctPush(state, obj->type, obj->pointer);
 				}
 				return NULL;
+			} else if (isCollectable(obj->type)) {
+				_winter_gcPossibleRoot(state, obj);
 			}
 		}
 	}
@@ -186,17 +199,12 @@ int _winter_objectAdd(winterState_t *state, object_t *a, object_t *b) {
 		if (typeof(a) > TYPE_STRING || typeof(b) > TYPE_STRING) {
 			//error
 			return OBJECT_ERROR_TYPE;
-			
+		
 		//TODO: temporary until object to string conversions are made
 		// } else if (typeof(a) == TYPE_STRING || typeof(b) == TYPE_STRING) {
 		} else if (typeof(a) == TYPE_STRING && typeof(b) == TYPE_STRING) {
-			object_t temp;
-			temp.type = TYPE_STRING;
-			temp.pointer = _winter_stringCat(state, a->string, b->string);
-			if (out == a) {
-				_winter_objectDelRef(state, a);
-			}
-			*out = *_winter_objectAddRef(state, &temp);
+			out->pointer = _winter_stringCat(state, a->string, b->string);
+			out->type = TYPE_STRING;
 			return OBJECT_OK;
 		} else if (typeof(a) == TYPE_FLOAT || typeof(b) == TYPE_FLOAT) {
 			out->floating = _winter_castFloat(a) + _winter_castFloat(b);
@@ -263,7 +271,11 @@ int _winter_objectDiv(winterState_t *state, object_t *a, object_t *b) {
 			out->type = TYPE_FLOAT;
 			return OBJECT_OK;
 		} else if (typeof(a) == TYPE_INT && typeof(b) == TYPE_INT) {
-			out->integer = a->integer / b->integer;
+			if (b->integer == 0) {
+				return OBJECT_ERROR_ZERO;
+			}
+			//The smallest integer divided by -1 wraps around like the other operators
+			out->integer = b->integer == -1 ? (winterInt_t)(0 - (uint64_t)a->integer) : a->integer / b->integer;
 			out->type = TYPE_INT;
 			return OBJECT_OK;
 		}
@@ -279,11 +291,14 @@ int _winter_objectMod(winterState_t *state, object_t *a, object_t *b) {
 			//error
 			return OBJECT_ERROR_TYPE;
 		} else if (typeof(a) == TYPE_FLOAT || typeof(b) == TYPE_FLOAT) {
-			out->floating = 0.0;
+			out->floating = fmod(_winter_castFloat(a), _winter_castFloat(b));
 			out->type = TYPE_FLOAT;
 			return OBJECT_OK;
 		} else if (typeof(a) == TYPE_INT && typeof(b) == TYPE_INT) {
-			out->integer = a->integer % b->integer;
+			if (b->integer == 0) {
+				return OBJECT_ERROR_ZERO;
+			}
+			out->integer = b->integer == -1 ? 0 : a->integer % b->integer;
 			out->type = TYPE_INT;
 			return OBJECT_OK;
 		}
@@ -295,7 +310,17 @@ int _winter_objectPow(winterState_t *state, object_t *a, object_t *b) {
 	a = deref(a);
 	b = deref(b);
 	if (typeof(a) == TYPE_INT && typeof(b) == TYPE_INT) {
-		out->integer = (winterInt_t)(pow(_winter_castFloat(a), _winter_castFloat(b)) + 0.5);
+		//Squaring is exact and wraps around, negative powers truncate like division
+		uint64_t base = (uint64_t)a->integer, power = 1;
+		winterInt_t exponent = b->integer;
+		if (exponent < 0) {
+			power = a->integer == 1 ? 1 : a->integer == -1 ? (exponent & 1 ? base : 1) : 0;
+		}
+		for (; exponent > 0; exponent >>= 1) {
+			if (exponent & 1) power *= base;
+			base *= base;
+		}
+		out->integer = (winterInt_t)power;
 		out->type = TYPE_INT;
 		return OBJECT_OK;
 	} else if (isNumeric(a) && isNumeric(b)) {
@@ -306,13 +331,77 @@ int _winter_objectPow(winterState_t *state, object_t *a, object_t *b) {
 	return OBJECT_ERROR_TYPE;
 }
 
+//Orders numbers and strings, sets 'order' to a negative, zero or positive value, or to
+//ORDER_NONE when a float is NaN, which only != is true for
+#define ORDER_NONE 2
+static inline int compare(object_t *a, object_t *b, int *order) {
+	a = deref(a);
+	b = deref(b);
+	if (isNumeric(a) && isNumeric(b)) {
+		if (typeof(a) == TYPE_INT && typeof(b) == TYPE_INT) {
+			*order = (a->integer > b->integer) - (a->integer < b->integer);
+		} else {
+			winterFloat_t x = _winter_castFloat(a), y = _winter_castFloat(b);
+			*order = x == x && y == y ? (x > y) - (x < y) : ORDER_NONE;
+		}
+		return OBJECT_OK;
+	} else if (typeof(a) == TYPE_STRING && typeof(b) == TYPE_STRING) {
+		*order = _winter_stringOrder(a->string, b->string);
+		return OBJECT_OK;
+	}
+	return OBJECT_ERROR_TYPE;
+}
+static inline void setBool(object_t *out, bool_t value) {
+	out->type    = TYPE_INT;
+	out->integer = value ? 1 : 0;
+}
+
+int _winter_objectEq(winterState_t *state, object_t *a, object_t *b) {
+	int order;
+	if (compare(a, b, &order) == OBJECT_OK) {
+		setBool(a, order == 0);
+	} else {
+		setBool(a, _winter_objectComp(a, b));
+	}
+	return OBJECT_OK;
+}
+int _winter_objectNotEq(winterState_t *state, object_t *a, object_t *b) {
+	_winter_objectEq(state, a, b);
+	a->integer = !a->integer;
+	return OBJECT_OK;
+}
+int _winter_objectLess(winterState_t *state, object_t *a, object_t *b) {
+	int order;
+	if (compare(a, b, &order) != OBJECT_OK) return OBJECT_ERROR_TYPE;
+	setBool(a, order < 0);
+	return OBJECT_OK;
+}
+int _winter_objectLessEq(winterState_t *state, object_t *a, object_t *b) {
+	int order;
+	if (compare(a, b, &order) != OBJECT_OK) return OBJECT_ERROR_TYPE;
+	setBool(a, order <= 0 && order != ORDER_NONE);
+	return OBJECT_OK;
+}
+int _winter_objectGreater(winterState_t *state, object_t *a, object_t *b) {
+	int order;
+	if (compare(a, b, &order) != OBJECT_OK) return OBJECT_ERROR_TYPE;
+	setBool(a, order > 0 && order != ORDER_NONE);
+	return OBJECT_OK;
+}
+int _winter_objectGreaterEq(winterState_t *state, object_t *a, object_t *b) {
+	int order;
+	if (compare(a, b, &order) != OBJECT_OK) return OBJECT_ERROR_TYPE;
+	setBool(a, order >= 0 && order != ORDER_NONE);
+	return OBJECT_OK;
+}
+
 int _winter_objectAssign(winterState_t *state, object_t *a, object_t *b) {
 	if (a->type == TYPE_REFERENCE) {
 		object_t *ptr = a->pointer;
 		b = deref(b);
 		object_t tempRef = *ptr;
 		*ptr = *_winter_objectAddRef(state, b);
-		*a   = *_winter_objectAddRef(state, ptr);
+		*a   = *ptr;
 		_winter_objectDelRef(state, &tempRef);
 		return OBJECT_OK;
 	}
@@ -3,21 +3,32 @@
 
 #include "wtype.h"
 #include "lexer.h"
+#include <stdarg.h>
 
 //Object related error:
 #define OBJECT_OK          0
 #define OBJECT_ERROR_TYPE -1
+#define OBJECT_ERROR_ZERO -2 //integer division or modulo by zero
 
 #define isRefCounted(t) ((t) >= TYPE_STRING)
 
 //Add to beginning of all ref counted types
-#define REFCOUNT uint32_t _refcount
+//_zct is set while the object is in the zero count table, _type holds its object_type_t
+//and _mark is used by traversals that must visit each object once
+#define REFCOUNT uint32_t _refcount; uint8_t _zct; uint8_t _type; uint8_t _mark
 #define REF_PERSISTENT 0xffffffff
 
 typedef struct refcount_t {
 	REFCOUNT;
 } refcount_t;
 
+//Add to beginning of ref counted types that can form cycles
+#define GCHEADER REFCOUNT; uint8_t _color; uint8_t _buffered
+
+typedef struct gcheader_t {
+	GCHEADER;
+} gcheader_t;
+
 typedef enum object_type_t {
 	TYPE_UNKNOWN = 0,
 	TYPE_REFERENCE,
@@ -27,19 +38,21 @@ typedef enum object_type_t {
 	TYPE_STRING,
 	TYPE_TABLE,
 	TYPE_FUNCTION,
-	TYPE_ERROR
+	TYPE_ERROR,
+	
+	//Internal, never held by scripts
+	TYPE_UPVALUE,
+	
+	//Read only table shared between states, scripts see it as a table, see frozen.h
+	TYPE_FROZEN,
+	
+	//Typed numeric array, see array.h
+	TYPE_ARRAY,
+	
+	TYPE_COUNT //number of types, not a type
 } object_type_t;
 
-typedef struct wstring_t wstring_t;
-typedef struct object_t {
-	object_type_t type;
-	union {
-		winterInt_t integer;
-		winterFloat_t floating;
-		void *pointer;
-		wstring_t *string;
-	};
-} object_t;
+//object_t is defined in winter.h so hosts can declare values, 'type' holds an object_type_t
 
 typedef unsigned long hash_t;
 hash_t _winter_hashCStr(const char *string);
@@ -51,7 +64,10 @@ winterInt_t   _winter_castInt(const object_t *object);
 winterFloat_t _winter_castFloat(const object_t *object);
 
 void _winter_objectNewError(winterState_t *state, object_t *dest, const char *format, ...);
+void _winter_objectNewErrorV(winterState_t *state, object_t *dest, const char *format, va_list args);
 
+//Only references held by the heap (tables, the syntax tree) are counted, values on
+//the stack are found by scanning it once a count reaches zero, see gc.h
 object_t *_winter_objectAddRef(winterState_t *state, object_t *obj);
 object_t *_winter_objectDelRef(winterState_t *state, object_t *obj);
 
@@ -66,6 +82,24 @@ int _winter_objectDiv(winterState_t *state, object_t *a, object_t *b);
 int _winter_objectMod(winterState_t *state, object_t *a, object_t *b);
 int _winter_objectPow(winterState_t *state, object_t *a, object_t *b);
 
+//Comparisons store 1 or 0 in a
+int _winter_objectEq(winterState_t *state, object_t *a, object_t *b);
+int _winter_objectNotEq(winterState_t *state, object_t *a, object_t *b);
+int _winter_objectLess(winterState_t *state, object_t *a, object_t *b);
+int _winter_objectLessEq(winterState_t *state, object_t *a, object_t *b);
+int _winter_objectGreater(winterState_t *state, object_t *a, object_t *b);
+int _winter_objectGreaterEq(winterState_t *state, object_t *a, object_t *b);
+
+//False for null and zero, true for everything else
+static inline bool_t _winter_objectTruthy(const object_t *obj) {
+	switch (obj->type) {
+		case TYPE_NULL:  return false;
+		case TYPE_INT:   return obj->integer != 0;
+		case TYPE_FLOAT: return obj->floating != 0.0;
+		default:         return true;
+	}
+}
+
 int _winter_objectAssign(winterState_t *state, object_t *a, object_t *b);
 
 int _winter_objectNegate(winterState_t *state, object_t *a);
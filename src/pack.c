@@ -0,0 +1,496 @@
+#include "pack.h"
+#include "array.h"
+#include "frozen.h"
+#include "index.h"
+#include "table.h"
+#include "vm.h"
+#include "wstring.h"
+#include "winter.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+//Encoding
+
+//Bytes past 'size' are counted but not written
+typedef struct packer_t {
+	winterState_t *state;
+	jmp_buf        jump;
+	unsigned char *buffer;
+	size_t         size, at;
+	index_t        index;
+	uint32_t       numShared;
+	int            depth;
+	const char    *error;
+} packer_t;
+
+static inline void putByte(packer_t *p, unsigned char byte) {
+	if (p->at < p->size) {
+		p->buffer[p->at] = byte;
+	}
+	p->at++;
+}
+
+static inline void putBytes(packer_t *p, const void *data, size_t size) {
+	if (p->at + size <= p->size) {
+		memcpy(p->buffer + p->at, data, size);
+	} else if (p->at < p->size) {
+		memcpy(p->buffer + p->at, data, p->size - p->at);
+	}
+	p->at += size;
+}
+
+static inline void putVarint(packer_t *p, uint64_t x) {
+	while (x >= 0x80) {
+		putByte(p, (unsigned char)(x | 0x80));
+		x >>= 7;
+	}
+	putByte(p, (unsigned char)x);
+}
+
+static void fail(packer_t *p, const char *error) {
+	p->error = error;
+	longjmp(p->jump, 1);
+}
+
+//Writes a reference if the object was numbered before, else the tag with PACK_SHARED set if
+//it can be reached again or 'always' is set. Returns false if a reference was written
+static bool_t putTag(packer_t *p, int tag, const void *object, bool_t always) {
+	if (!always && ((const refcount_t*)object)->_refcount < 2) {
+		putByte(p, (unsigned char)tag);
+		return true;
+	}
+	int64_t shared = _winter_indexFind(&p->index, object);
+	if (shared >= 0) {
+		putByte(p, PACK_REF);
+		putVarint(p, (uint64_t)shared);
+		return false;
+	}
+	_winter_indexInsert(p->state, &p->index, object, p->numShared++);
+	putByte(p, (unsigned char)(tag | PACK_SHARED));
+	return true;
+}
+
+static void pack(packer_t *p, const object_t *value, bool_t always);
+
+//The keys of records are numbered, since the shapes holding them are shared by tables
+//without counting them again
+static void packTable(packer_t *p, table_t *table, bool_t always) {
+	if (!putTag(p, table->shape != NULL ? PACK_RECORD : PACK_TABLE, table, always)) return;
+	putVarint(p, table->size);
+	for (tableIter_t it = {0}; _winter_tableNext(table, &it);) {
+		pack(p, it.key, table->shape != NULL);
+		pack(p, it.value, false);
+	}
+}
+
+//Frozen tables are decoded as tables
+static void packFrozen(packer_t *p, const frozen_t *frozen, bool_t always) {
+	if (!putTag(p, PACK_TABLE, frozen, always)) return;
+	putVarint(p, frozen->size);
+	for (size_t i = 0; i <= frozen->mask; i++) {
+		if (frozen->entries[i].key.type != TYPE_UNKNOWN) {
+			pack(p, &frozen->entries[i].key, false);
+			pack(p, &frozen->entries[i].value, false);
+		}
+	}
+}
+
+static void packArray(packer_t *p, const array_t *array, bool_t always) {
+	if (!putTag(p, PACK_ARRAY, array, always)) return;
+	size_t width = _winter_arrayWidth(array->kind);
+	putByte(p, array->kind);
+	putVarint(p, array->length);
+	if (_winter_arrayContiguous(array)) {
+		putBytes(p, array->data, array->length * width);
+	} else {
+		for (size_t i = 0; i < array->length; i++) {
+			putBytes(p, _winter_arrayAt(array, i), width);
+		}
+	}
+}
+
+//The root is always numbered, a cycle back to it is its only other reference
+static void pack(packer_t *p, const object_t *value, bool_t always) {
+	if (value->type == TYPE_REFERENCE) {
+		value = value->pointer;
+	}
+	switch (value->type) {
+		case TYPE_NULL:
+			putByte(p, PACK_NULL);
+			break;
+		
+		case TYPE_INT:
+			if (value->integer >= 0 && value->integer < 0x80) {
+				putByte(p, (unsigned char)value->integer);
+			} else {
+				putByte(p, PACK_INT);
+				putVarint(p, ((uint64_t)value->integer << 1) ^ (uint64_t)(value->integer >> 63));
+			}
+			break;
+		
+		case TYPE_FLOAT: {
+			double x = value->floating;
+			if (x != x || x == INFINITY || x == -INFINITY || (x >= -FLT_MAX && x <= FLT_MAX && (double)(float)x == x)) {
+				float single = (float)x;
+				putByte(p, PACK_FLOAT32);
+				putBytes(p, &single, sizeof(single));
+			} else {
+				putByte(p, PACK_FLOAT64);
+				putBytes(p, &value->floating, sizeof(value->floating));
+			}
+		} break;
+		
+		case TYPE_STRING:
+		case TYPE_ERROR:
+			if (putTag(p, value->type == TYPE_STRING ? PACK_STRING : PACK_ERROR, value->string, always)) {
+				putVarint(p, value->string->length);
+				putBytes(p, value->string->data, value->string->length);
+				putByte(p, 0);
+			}
+			break;
+		
+		case TYPE_TABLE:
+		case TYPE_FROZEN:
+			if (p->depth == PACK_MAX_DEPTH) {
+				fail(p, "pack: tables nested too deep");
+			}
+			p->depth++;
+			if (value->type == TYPE_TABLE) packTable(p, value->pointer, always);
+			else                           packFrozen(p, value->pointer, always);
+			p->depth--;
+			break;
+		
+		case TYPE_ARRAY:
+			packArray(p, value->pointer, always);
+			break;
+		
+		default:
+			fail(p, "pack can only encode null, numbers, strings, errors, tables and arrays");
+	}
+}
+
+size_t _winter_pack(winterState_t *state, const object_t *value, unsigned char *buffer, size_t size, object_t *error) {
+	packer_t p = { state };
+	p.buffer = buffer;
+	p.size   = size;
+	volatile size_t out = 0;
+	jmp_buf *previous = state->errorJump;
+	state->errorJump = &p.jump;
+	if (setjmp(p.jump) == 0) {
+		putBytes(&p, PACK_MAGIC, 2);
+		putByte(&p, PACK_VERSION);
+		pack(&p, value, true);
+		out = p.at;
+	}
+	state->errorJump = previous;
+	_winter_indexFree(state, &p.index);
+	if (out == 0) {
+		if (p.error == NULL) {
+			*error = (object_t){ TYPE_ERROR, { .string = state->memoryError } };
+		} else {
+			_winter_objectNewError(state, error, "%s", p.error);
+		}
+	}
+	return out;
+}
+
+//Decoding
+
+typedef struct unpacker_t {
+	winterState_t       *state;
+	jmp_buf              jump;
+	const unsigned char *data;
+	size_t               size, at;
+	bool_t               borrow;
+	int                  depth;
+	const char          *error;
+	
+	//Objects tagged with PACK_SHARED in order
+	object_t *shared;
+	size_t    numShared, capacity;
+	
+	//Entries of the unfinished tables as key and value pairs
+	object_t *pairs;
+	size_t    top, pairsCapacity;
+} unpacker_t;
+
+static void invalid(unpacker_t *u, const char *error) {
+	u->error = error;
+	longjmp(u->jump, 1);
+}
+
+static inline void need(unpacker_t *u, size_t size) {
+	if (u->size - u->at < size) {
+		invalid(u, "truncated data");
+	}
+}
+
+static inline unsigned char getByte(unpacker_t *u) {
+	need(u, 1);
+	return u->data[u->at++];
+}
+
+static uint64_t getVarint(unpacker_t *u) {
+	uint64_t x = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		unsigned char byte = getByte(u);
+		x |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return x;
+	}
+	invalid(u, "invalid varint");
+	return 0;
+}
+
+//The object is numbered before what it holds is read, so references to it inside resolve
+static void share(unpacker_t *u, const object_t *object) {
+	winterState_t *state = u->state;
+	if (u->numShared == u->capacity) {
+		u->capacity = u->capacity ? u->capacity * 2 : 16;
+		u->shared   = REALLOC(u->shared, sizeof(object_t) * u->capacity);
+	}
+	u->shared[u->numShared++] = *object;
+}
+
+static void push(unpacker_t *u, const object_t *value) {
+	winterState_t *state = u->state;
+	if (u->top == u->pairsCapacity) {
+		u->pairsCapacity = u->pairsCapacity ? u->pairsCapacity * 2 : 64;
+		u->pairs = REALLOC(u->pairs, sizeof(object_t) * u->pairsCapacity);
+	}
+	u->pairs[u->top++] = *value;
+}
+
+static object_t unpack(unpacker_t *u);
+
+static object_t unpackString(unpacker_t *u, bool_t error) {
+	winterState_t *state = u->state;
+	uint64_t length = getVarint(u);
+	//The bytes and their NUL, compared so a huge length can't wrap around
+	if (length >= u->size - u->at) {
+		invalid(u, "truncated data");
+	}
+	const char *bytes = (const char*)u->data + u->at;
+	if (bytes[length] != '\0') {
+		invalid(u, "string without a NUL");
+	}
+	u->at += length + 1;
+	object_t out = { TYPE_STRING };
+	out.string = u->borrow ? _winter_stringView(state, bytes, length) : _winter_stringCreateSize(state, bytes, length);
+	if (error) {
+		out.type = TYPE_ERROR;
+		out.string->_type = TYPE_ERROR;
+		state->memory.strings--;
+		state->memory.errors++;
+	}
+	return out;
+}
+
+static object_t unpackTable(unpacker_t *u, bool_t record, bool_t shared) {
+	winterState_t *state = u->state;
+	uint64_t count = getVarint(u);
+	//Every entry takes at least two bytes, which bounds what's reserved up front
+	if (count > (u->size - u->at) / 2) {
+		invalid(u, "truncated data");
+	} else if (u->depth == PACK_MAX_DEPTH) {
+		invalid(u, "tables nested too deep");
+	}
+	//Tables that can be referred to exist before their entries are read, the others are
+	//made from their entries at once
+	object_t out = { TYPE_TABLE };
+	size_t base = u->top;
+	if (shared) {
+		out.pointer = _winter_tableReserve(state, count, record);
+		share(u, &out);
+	}
+	u->depth++;
+	for (uint64_t i = 0; i < count; i++) {
+		object_t key = unpack(u);
+		object_t value = unpack(u);
+		if (key.type == TYPE_NULL) {
+			invalid(u, "null key");
+		} else if (shared) {
+			_winter_tableSet(state, out.pointer, &key, &value);
+		} else {
+			push(u, &key);
+			push(u, &value);
+		}
+	}
+	u->depth--;
+	if (!shared) {
+		out.pointer = _winter_tableFrom(state, &u->pairs[base], count);
+		u->top = base;
+	}
+	return out;
+}
+
+static object_t unpackArray(unpacker_t *u) {
+	winterState_t *state = u->state;
+	unsigned char kind = getByte(u);
+	if (kind > ARRAY_INT32) {
+		invalid(u, "invalid array type");
+	}
+	uint64_t length = getVarint(u);
+	size_t width = _winter_arrayWidth(kind);
+	if (length > (u->size - u->at) / width) {
+		invalid(u, "truncated data");
+	}
+	array_t *array = _winter_arrayAlloc(state, kind, length);
+	memcpy(array->data, u->data + u->at, length * width);
+	u->at += length * width;
+	return (object_t){ TYPE_ARRAY, { .pointer = array } };
+}
+
+static object_t unpack(unpacker_t *u) {
+	unsigned char tag = getByte(u);
+	if (tag < 0x80) {
+		return (object_t){ TYPE_INT, { .integer = tag } };
+	}
+	int kind = tag & ~PACK_SHARED;
+	bool_t shared = tag != kind;
+	if (shared && (kind < PACK_STRING || kind > PACK_ARRAY)) {
+		invalid(u, "invalid tag");
+	}
+	object_t out;
+	switch (kind) {
+		case PACK_NULL:
+			return (object_t){ TYPE_NULL };
+		
+		case PACK_INT: {
+			uint64_t x = getVarint(u);
+			return (object_t){ TYPE_INT, { .integer = (winterInt_t)(x >> 1) ^ -(winterInt_t)(x & 1) } };
+		}
+		case PACK_FLOAT32: {
+			float single;
+			need(u, sizeof(single));
+			memcpy(&single, u->data + u->at, sizeof(single));
+			u->at += sizeof(single);
+			return (object_t){ TYPE_FLOAT, { .floating = single } };
+		}
+		case PACK_FLOAT64:
+			need(u, sizeof(out.floating));
+			out.type = TYPE_FLOAT;
+			memcpy(&out.floating, u->data + u->at, sizeof(out.floating));
+			u->at += sizeof(out.floating);
+			return out;
+		
+		case PACK_STRING:
+		case PACK_ERROR:
+			out = unpackString(u, kind == PACK_ERROR);
+			break;
+		
+		case PACK_TABLE:
+		case PACK_RECORD:
+			//Tables number themselves before their entries
+			return unpackTable(u, kind == PACK_RECORD, shared);
+		
+		case PACK_ARRAY:
+			out = unpackArray(u);
+			break;
+		
+		case PACK_REF: {
+			uint64_t index = getVarint(u);
+			if (index >= u->numShared) {
+				invalid(u, "invalid reference");
+			}
+			return u->shared[index];
+		}
+		default:
+			invalid(u, "invalid tag");
+	}
+	if (shared) {
+		share(u, &out);
+	}
+	return out;
+}
+
+bool_t _winter_unpack(winterState_t *state, const unsigned char *data, size_t size, bool_t borrow, object_t *out) {
+	unpacker_t u = { state };
+	u.data   = data;
+	u.size   = size;
+	u.borrow = borrow;
+	volatile bool_t unpacked = false;
+	//Objects built before failing are left to the zero count table
+	jmp_buf *previous = state->errorJump;
+	state->errorJump = &u.jump;
+	if (setjmp(u.jump) == 0) {
+		if (size < 3 || memcmp(data, PACK_MAGIC, 2) != 0 || data[2] != PACK_VERSION) {
+			invalid(&u, "not packed data of this version");
+		}
+		u.at = 3;
+		*out = unpack(&u);
+		if (u.at != size) {
+			invalid(&u, "data after the value");
+		}
+		unpacked = true;
+	}
+	state->errorJump = previous;
+	if (u.shared != NULL) FREE(u.shared);
+	if (u.pairs != NULL)  FREE(u.pairs);
+	
+	if (!unpacked) {
+		if (u.error == NULL) {
+			*out = (object_t){ TYPE_ERROR, { .string = state->memoryError } };
+		} else {
+			_winter_objectNewError(state, out, "unpack: %s at byte %zu", u.error, u.at);
+		}
+	}
+	return unpacked;
+}
+
+//pack(v) returns the value in the binary form as a string
+static int packNative(winterState_t *state, winterValue_t *args, int argc) {
+	unsigned char buffer[4096];
+	object_t error;
+	size_t size = _winter_pack(state, &args[0], buffer, sizeof(buffer), &error);
+	if (size == 0) {
+		args[0] = error;
+		return 1;
+	}
+	wstring_t *string;
+	if (size <= sizeof(buffer)) {
+		string = _winter_stringCreateSize(state, (const char*)buffer, size);
+	} else {
+		//Encoded again straight into a string of the right size, the zero count table frees
+		//it if that fails
+		string = _winter_stringAlloc(state, size + 1);
+		if (_winter_pack(state, &args[0], (unsigned char*)string->data, size, &error) == 0) {
+			args[0] = error;
+			return 1;
+		}
+		string->data[size] = '\0';
+		string->length = size;
+	}
+	args[0] = (object_t){ TYPE_STRING, { .string = string } };
+	return 1;
+}
+
+//unpack(s) returns the value packed in the string
+static int unpackNative(winterState_t *state, winterValue_t *args, int argc) {
+	if (args[0].type != TYPE_STRING) {
+		_winter_objectNewError(state, &args[0], "unpack expects a string");
+		return 1;
+	}
+	wstring_t *string = args[0].string;
+	_winter_unpack(state, (const unsigned char*)string->data, string->length, false, &args[0]);
+	return 1;
+}
+
+void winterOpenPack(winterState_t *state) {
+	winterRegister(state, "pack",   packNative,   1);
+	winterRegister(state, "unpack", unpackNative, 1);
+}
+
+size_t winterEncodeValue(winterState_t *state, const winterValue_t *value, void *buffer, size_t size) {
+	object_t error;
+	return _winter_pack(state, value, buffer, size, &error);
+}
+
+const winterValue_t *winterDecodeValue(winterState_t *state, const void *data, size_t size, int flags) {
+	if (state->numFrames == 0) {
+		state->top = 0;
+	}
+	object_t value;
+	_winter_unpack(state, data, size, (flags & WINTER_BORROW) != 0, &value);
+	return _winter_stackPush(state, &value);
+}
@@ -0,0 +1,53 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include "wtype.h"
+#include "object.h"
+
+//Binary form of a value, see winterEncodeValue
+//
+//A header of PACK_MAGIC and PACK_VERSION is followed by the value written depth first,
+//each one a tag byte and what the tag says follows. Counts and lengths are varints and
+//fixed size numbers are in the byte order of the host
+//
+//  0x00 - 0x7f         the ints 0 to 127
+//  PACK_NULL
+//  PACK_INT            zigzag varint
+//  PACK_FLOAT32        4 bytes, for floats a float holds exactly
+//  PACK_FLOAT64        8 bytes
+//  PACK_STRING, ERROR  length, the bytes and a NUL, so decoded strings can point at them
+//  PACK_TABLE, RECORD  count, then count keys and values. A record's keys are strings
+//  PACK_ARRAY          element type, length and the elements
+//  PACK_REF            index of an object written before
+//
+//Strings, tables and arrays whose tag has PACK_SHARED set are numbered in the order
+//they're written, for PACK_REF. Only objects that can be reached twice get it, the root and
+//those with more than one reference, so trees are written without numbering anything
+#define PACK_MAGIC   "WP"
+#define PACK_VERSION 1
+#define PACK_SHARED  0x10
+
+enum {
+	PACK_NULL = 0x80,
+	PACK_INT,
+	PACK_FLOAT32,
+	PACK_FLOAT64,
+	PACK_STRING,
+	PACK_ERROR,
+	PACK_TABLE,
+	PACK_RECORD,
+	PACK_ARRAY,
+	PACK_REF
+};
+
+//Deepest nesting of tables, references don't count
+#define PACK_MAX_DEPTH 512
+
+//Returns the size of the encoding, of which at most 'size' bytes are written to 'buffer',
+//or 0 with an error value in 'error'
+size_t _winter_pack(winterState_t *state, const object_t *value, unsigned char *buffer, size_t size, object_t *error);
+//Decodes into 'out', or returns false with an error value there. 'borrow' makes strings
+//point into 'data'
+bool_t _winter_unpack(winterState_t *state, const unsigned char *data, size_t size, bool_t borrow, object_t *out);
+
+#endif
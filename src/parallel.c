@@ -0,0 +1,256 @@
+#include "parallel.h"
+#include "array.h"
+#include "executor.h"
+#include "function.h"
+#include "vm.h"
+#include "wstring.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+//Ranges per worker, smaller ones balance uneven callbacks but take the counter more often
+#define PARALLEL_PARTS 8
+
+typedef struct parallel_t {
+	const char *name;
+	proto_t    *proto; //shared copy of the callback
+	array_t    *input;
+	array_t    *output; //NULL for reductions
+	object_t    extra;  //passed after the element when 'argc' has room for it
+	int         argc;
+	
+	//Maps take 'grain' elements at a time, reductions fold one of 'numParts' ranges each
+	//from 'init' and then the parts in order
+	atomic_size_t next;
+	size_t        grain;
+	object_t      init;
+	object_t     *parts;
+	size_t        numParts;
+	
+	atomic_bool failed;
+	char        error[256]; //written by the first worker to fail
+} parallel_t;
+
+static inline bool_t isScalar(const object_t *value) {
+	return value->type == TYPE_INT || value->type == TYPE_FLOAT;
+}
+
+static void fail(parallel_t *p, const object_t *result) {
+	_Bool expected = false;
+	if (atomic_compare_exchange_strong(&p->failed, &expected, true)) {
+		snprintf(p->error, sizeof(p->error), "%s", result->type == TYPE_ERROR ? result->string->data :
+				 "the callback returned a value that isn't a number");
+	}
+}
+static inline bool_t failed(parallel_t *p) {
+	return atomic_load_explicit(&p->failed, memory_order_relaxed);
+}
+
+//Returns a counted closure of the callback in the worker's state
+static object_t closure(winterState_t *state, parallel_t *p) {
+	_winter_sharedHold(state, p->proto->shared);
+	object_t out = { TYPE_FUNCTION, { .pointer = _winter_closureAlloc(state, p->proto) } };
+	return *_winter_objectAddRef(state, &out);
+}
+
+//Tasks
+
+static void mapTask(void *user, winterState_t *state) {
+	parallel_t *p = user;
+	object_t function = closure(state, p), args[2] = { { TYPE_NULL }, p->extra };
+	size_t length = p->input->length, start;
+	while (!failed(p) && (start = atomic_fetch_add_explicit(&p->next, p->grain, memory_order_relaxed)) < length) {
+		size_t end = length - start < p->grain ? length : start + p->grain;
+		for (size_t i = start; i < end; i++) {
+			args[0] = _winter_arrayGet(p->input, i);
+			const object_t *result = _winter_callValue(state, &function, args, p->argc);
+			if (!_winter_arraySet(p->output, i, result)) {
+				fail(p, result);
+				break;
+			}
+		}
+	}
+	_winter_objectDelRef(state, &function);
+}
+
+//Folds 'count' values into 'acc', taking each from the input or the parts
+static bool_t fold(winterState_t *state, parallel_t *p, object_t *function, object_t *acc, size_t start, size_t count, bool_t parts) {
+	object_t args[3] = { *acc, { TYPE_NULL }, p->extra };
+	for (size_t i = start; i < start + count; i++) {
+		args[1] = parts ? p->parts[i] : _winter_arrayGet(p->input, i);
+		const object_t *result = _winter_callValue(state, function, args, p->argc);
+		if (!isScalar(result)) {
+			fail(p, result);
+			return false;
+		}
+		args[0] = *result;
+	}
+	*acc = args[0];
+	return true;
+}
+
+static void reduceTask(void *user, winterState_t *state) {
+	parallel_t *p = user;
+	object_t function = closure(state, p);
+	size_t length = p->input->length, part;
+	while (!failed(p) && (part = atomic_fetch_add_explicit(&p->next, 1, memory_order_relaxed)) < p->numParts) {
+		size_t start = length / p->numParts * part, end = part + 1 == p->numParts ? length : start + length / p->numParts;
+		object_t acc = p->init;
+		if (!fold(state, p, &function, &acc, start, end - start, false)) break;
+		p->parts[part] = acc;
+	}
+	_winter_objectDelRef(state, &function);
+}
+
+static void combineTask(void *user, winterState_t *state) {
+	parallel_t *p = user;
+	object_t function = closure(state, p);
+	fold(state, p, &function, &p->parts[0], 1, p->numParts - 1, true);
+	_winter_objectDelRef(state, &function);
+}
+
+//Natives
+
+static void workerInit(void *user, winterState_t *worker) {
+	winterState_t *state = user;
+	winterOpenArrays(worker);
+	worker->isWorker = true;
+	if (state->workerInit != NULL) {
+		state->workerInit(state->workerUser, worker);
+	}
+}
+
+//Checks the callback and extra value, shares the callback and starts the workers
+static bool_t prepare(winterState_t *state, parallel_t *p, object_t *function, const object_t *extra) {
+	function_t *closure = function->type == TYPE_FUNCTION ? function->pointer : NULL;
+	if (state->isWorker) {
+		_winter_objectNewError(state, function, "%s can't run inside a parallel callback", p->name);
+		return false;
+	} else if (closure == NULL || closure->native != NULL || closure->proto->numUpvalues > 0) {
+		_winter_objectNewError(state, function, "%s expects a script function that doesn't capture variables", p->name);
+		return false;
+	} else if (extra != NULL && isRefCounted(extra->type) && extra->type != TYPE_FROZEN) {
+		//Like arguments of jobs, only values that aren't counted and frozen tables cross over
+		_winter_objectNewError(state, function, "%s can only pass null, numbers or frozen tables to the callback", p->name);
+		return false;
+	}
+	
+	proto_t *proto = closure->proto;
+	if (proto->shared == NULL && proto->sharedCopy == NULL) {
+		proto->sharedCopy = _winter_protoShare(state, proto);
+	}
+	p->proto = proto->shared != NULL ? proto : proto->sharedCopy;
+	if (state->workers == NULL && p->proto != NULL) {
+		state->workers = winterCreateExecutor(state->allocator, state->numWorkers, workerInit, state);
+	}
+	if (p->proto == NULL || state->workers == NULL) {
+		_winter_objectNewError(state, function, "%s couldn't start its workers", p->name);
+		return false;
+	}
+	p->extra = extra != NULL ? *extra : (object_t){ TYPE_NULL };
+	atomic_init(&p->next, 0);
+	atomic_init(&p->failed, false);
+	return true;
+}
+
+//Runs one task per worker, or one in total, and waits for them
+static bool_t run(winterState_t *state, parallel_t *p, jobTask_t task, int count) {
+	executor_t *executor = state->workers;
+	if (count == 0) {
+		count = executor->numWorkers;
+	}
+	for (int i = 0; i < count; i++) {
+		if (_winter_executorTask(executor, task, p) != 0) {
+			fail(p, &(object_t){ TYPE_ERROR, { .string = state->memoryError } });
+			break;
+		}
+	}
+	winterWait(executor);
+	return !failed(p);
+}
+
+//parallelmap(a, fn[, out[, extra]]) sets out[i] to fn(a[i]) or fn(a[i], extra), 'out' is a
+//new array of the same kind when it's missing or null. Returns the output
+static int parallelMap(winterState_t *state, winterValue_t *args, int argc) {
+	parallel_t p = { "parallelmap" };
+	array_t *input = argc >= 2 && args[0].type == TYPE_ARRAY ? args[0].pointer : NULL, *output = NULL;
+	if (argc >= 3 && args[2].type == TYPE_ARRAY) {
+		output = args[2].pointer;
+	}
+	if (input == NULL || argc > 4 || (argc >= 3 && output == NULL && args[2].type != TYPE_NULL) ||
+		(output != NULL && (output->length != input->length || output->readOnly))) {
+		_winter_objectNewError(state, &args[0], "parallelmap expects an array, a function, an optional writable "
+								"output array of the same length and an optional extra argument");
+		return 1;
+	} else if (!prepare(state, &p, &args[1], argc == 4 ? &args[3] : NULL)) {
+		args[0] = args[1];
+		return 1;
+	}
+	if (output == NULL) {
+		output = _winter_arrayAlloc(state, input->kind, input->length);
+	}
+	
+	size_t workers = (size_t)state->workers->numWorkers;
+	p.input  = input;
+	p.output = output;
+	p.argc   = argc == 4 ? 2 : 1;
+	p.grain  = input->length / (workers * PARALLEL_PARTS) + 1;
+	if (input->length > 0 && !run(state, &p, mapTask, 0)) {
+		_winter_objectNewError(state, &args[0], "parallelmap callback failed: %s", p.error);
+		return 1;
+	}
+	args[0] = (object_t){ TYPE_ARRAY, { .pointer = output } };
+	return 1;
+}
+
+//parallelreduce(a, fn, init[, extra]) folds the elements with acc = fn(acc, a[i]) or
+//fn(acc, a[i], extra). Ranges are folded from 'init' on different workers and then
+//folded together in order, so 'fn' must be associative and 'init' must not change the result
+static int parallelReduce(winterState_t *state, winterValue_t *args, int argc) {
+	parallel_t p = { "parallelreduce" };
+	array_t *input = argc >= 3 && args[0].type == TYPE_ARRAY ? args[0].pointer : NULL;
+	if (input == NULL || argc > 4 || !isScalar(&args[2])) {
+		_winter_objectNewError(state, &args[0], "parallelreduce expects an array, a function, a number and an optional extra argument");
+		return 1;
+	} else if (!prepare(state, &p, &args[1], argc == 4 ? &args[3] : NULL)) {
+		args[0] = args[1];
+		return 1;
+	} else if (input->length == 0) {
+		args[0] = args[2];
+		return 1;
+	}
+	
+	size_t workers = (size_t)state->workers->numWorkers;
+	p.input    = input;
+	p.argc     = argc == 4 ? 3 : 2;
+	p.init     = args[2];
+	p.numParts = input->length < workers * PARALLEL_PARTS ? input->length : workers * PARALLEL_PARTS;
+	p.parts    = MALLOC(sizeof(object_t) * p.numParts);
+	bool_t ok = run(state, &p, reduceTask, 0) && (p.numParts == 1 || run(state, &p, combineTask, 1));
+	args[0] = p.parts[0];
+	FREE(p.parts);
+	if (!ok) {
+		_winter_objectNewError(state, &args[0], "parallelreduce callback failed: %s", p.error);
+	}
+	return 1;
+}
+
+void _winter_parallelOpen(winterState_t *state) {
+	winterRegister(state, "parallelmap",    parallelMap,    -1);
+	winterRegister(state, "parallelreduce", parallelReduce, -1);
+}
+
+void _winter_parallelFree(winterState_t *state) {
+	if (state->workers != NULL) {
+		winterFreeExecutor(state->workers);
+		state->workers = NULL;
+	}
+}
+
+//Public
+
+void winterSetWorkers(winterState_t *state, int numWorkers, winterWorkerInit_t init, void *user) {
+	_winter_parallelFree(state);
+	state->numWorkers = numWorkers > 0 ? numWorkers : 0;
+	state->workerInit = init;
+	state->workerUser = user;
+}
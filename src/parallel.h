@@ -0,0 +1,18 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "wtype.h"
+#include "object.h"
+
+//parallelmap and parallelreduce, registered with the array functions
+//
+//A state starts its own executor (see executor.h) the first time one of them runs. The
+//callback's prototype is copied into a shared block once, and closures of the copy run in
+//the workers' states while the calling state waits, so it can't capture upvalues and only
+//sees its arguments and the globals of the workers. Elements are read from the input and
+//written to the output array in place, each worker taking the next range of them
+void _winter_parallelOpen(winterState_t *state);
+//Stops the workers
+void _winter_parallelFree(winterState_t *state);
+
+#endif
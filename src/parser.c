@@ -1,6 +1,7 @@
 #include "parser.h"
 #include "wstring.h"
 #include "table.h"
+#include "gc.h"
 #include <stdio.h>
 
 //creates or resizes a node
@@ -13,6 +14,10 @@ static inline ast_node_t *allocNode(winterState_t *state, ast_node_t *node, size
 	}
 	
 	ast_node_t *ret = REALLOC(node, sizeof(ast_node_t) + sizeof(ast_node_t*) * size);
+	if (node == NULL) {
+		state->memory.nodes++;
+		ret->line = 0;
+	}
 	ret->numNodes = size;
 	ret->children = (ast_node_t**)(ret + 1);
 	for (size_t i = original; i < size; i++) {
@@ -34,35 +39,40 @@ static inline ast_node_t *createEprNode(winterState_t *state, const token_t *tok
 		}
 		_winter_tokenToObject(state, token, &ret->value);
 	}
+	ret->line = token->cursor.line + 1;
 	return ret;
 }
 
-static inline ast_node_t *createOprNode(winterState_t *state, ast_node_type_t type) {
+static inline ast_node_t *createOprNode(winterState_t *state, ast_node_type_t type, const token_t *token) {
 	size_t size = isUnary(type) ? 1 : 2;
 	ast_node_t *ret = allocNode(state, NULL, size);
 	ret->type = type;
+	ret->line = token->cursor.line + 1;
 	return ret;
 }
 
-static inline ast_node_t *createErrorNode(winterState_t *state) {
+static inline ast_node_t *createErrorNode(winterState_t *state, const char *message) {
 	ast_node_t *ret = allocNode(state, NULL, 0);
 	ret->type = AST_ERROR;
+	_winter_objectNewError(state, &ret->value, "%s", message);
+	//The tree holds a counted reference to its values
+	_winter_objectAddRef(state, &ret->value);
 	return ret;
 }
 
-static inline void freeTree(winterState_t *state, ast_node_t *tree) {
+void _winter_freeTree(winterState_t *state, ast_node_t *tree) {
 	if (tree != NULL) {
 		for (size_t i = 0; i < tree->numNodes; i++) {
-			freeTree(state, tree->children[i]);
+			_winter_freeTree(state, tree->children[i]);
 		}
 		if (isManaged(tree->type)) { 
 			_winter_objectDelRef(state, &tree->value);
 		}
+		state->memory.nodes--;
 		FREE(tree);
 	}
 }
 
-typedef void (*func_ptr_void_t)(void);
 typedef struct opinfo_t {
 	int precedence;
 	enum { left, right } associativity;
@@ -90,20 +100,20 @@ static const opinfo_t opinfo[] = {
 	op(AST_XOREQ,    2, left,  NULL),
 	op(AST_LSHIFT,   2, right, NULL),
 	op(AST_RSHIFT,   2, right, NULL),
-	op(AST_NOTEQ,    2, right, NULL),
-	op(AST_LEQ,      2, right, NULL),
-	op(AST_GEQ,      2, right, NULL),
-	op(AST_EQ,       2, right, NULL),
+	op(AST_NOTEQ,    2, right, _winter_objectNotEq),
+	op(AST_LEQ,      2, right, _winter_objectLessEq),
+	op(AST_GEQ,      2, right, _winter_objectGreaterEq),
+	op(AST_EQ,       2, right, _winter_objectEq),
 	op(AST_DOT,      2, right, NULL),
 	op(AST_COMMA,    2, right, NULL),
 	op(AST_ASSIGN,   1, left,  _winter_objectAssign),
-	op(AST_ADD,      2, right, _winter_objectAdd),
-	op(AST_SUB,      2, right, _winter_objectSub),
-	op(AST_MUL,      3, right, _winter_objectMul),
-	op(AST_DIV,      3, right, _winter_objectDiv),
-	op(AST_MOD,      3, right, _winter_objectMod),
-	op(AST_LESS,     2, right, NULL),
-	op(AST_GREATER,  2, right, NULL),
+	op(AST_ADD,      3, right, _winter_objectAdd),
+	op(AST_SUB,      3, right, _winter_objectSub),
+	op(AST_MUL,      4, right, _winter_objectMul),
+	op(AST_DIV,      4, right, _winter_objectDiv),
+	op(AST_MOD,      4, right, _winter_objectMod),
+	op(AST_LESS,     2, right, _winter_objectLess),
+	op(AST_GREATER,  2, right, _winter_objectGreater),
 	op(AST_BITAND,   2, right, NULL),
 	op(AST_BITOR,    2, right, NULL),
 	op(AST_NOT,      2, right, NULL),
@@ -123,10 +133,202 @@ static inline int precedence(ast_node_type_t operator) {
 static inline int associativity(ast_node_type_t operator) {
 	return opinfo[operator - AST_LSHIFTEQ].associativity;
 }
-static inline func_ptr_void_t function(ast_node_type_t operator) {
+func_ptr_void_t _winter_operatorFunction(ast_node_type_t operator) {
 	return opinfo[operator - AST_LSHIFTEQ].function;
 }
 
+static inline ast_node_t *parseExpression(winterState_t *state, lexState_t *lex);
+static inline ast_node_t *parseBlock(winterState_t *state, lexState_t *lex, token_type_t stop);
+
+//Parses a braced block, the lookahead is left after the closing brace
+static inline ast_node_t *parseBody(winterState_t *state, lexState_t *lex) {
+	if (lex->lookahead.type != TK_LCURLY) {
+		return createErrorNode(state, "expected '{'");
+	}
+	_winter_lexNext(lex);
+	ast_node_t *block = parseBlock(state, lex, TK_RCURLY);
+	if (block == NULL) {
+		block = allocNode(state, NULL, 0);
+		block->type = AST_BLOCK;
+	}
+	return block;
+}
+
+//fn [name](parameters) { body }
+//Children are the name (NULL when anonymous), the body, then the parameters
+static inline ast_node_t *parseFunction(winterState_t *state, lexState_t *lex) {
+	ast_node_t *function = allocNode(state, NULL, 2);
+	function->type = AST_FN;
+	function->line = lex->lookahead.cursor.line + 1;
+	
+	_winter_lexNext(lex);
+	if (lex->lookahead.type == TK_IDENT) {
+		_winter_lexNext(lex);
+		function->children[0] = createEprNode(state, &lex->current);
+	}
+	if (lex->lookahead.type != TK_LPAREN) {
+		_winter_freeTree(state, function);
+		return createErrorNode(state, "expected a parameter list");
+	}
+	
+	_winter_lexNext(lex);
+	while (lex->lookahead.type == TK_IDENT) {
+		_winter_lexNext(lex);
+		function = allocNode(state, function, function->numNodes + 1);
+		function->children[function->numNodes - 1] = createEprNode(state, &lex->current);
+		
+		if (lex->lookahead.type != TK_COMMA) break;
+		_winter_lexNext(lex);
+	}
+	if (lex->lookahead.type != TK_RPAREN) {
+		_winter_freeTree(state, function);
+		return createErrorNode(state, "expected closing parenthesis");
+	}
+	_winter_lexNext(lex);
+	
+	ast_node_t *body = parseBody(state, lex);
+	if (body->type == AST_ERROR) {
+		_winter_freeTree(state, function);
+		return body;
+	}
+	function->children[1] = body;
+	return function;
+}
+
+//Parses the arguments up to the closing parenthesis, which is left as the lookahead
+//The callee is freed along with the call on errors
+static inline ast_node_t *parseCall(winterState_t *state, lexState_t *lex, ast_node_t *callee) {
+	ast_node_t *call = allocNode(state, NULL, 1);
+	call->type = AST_CALL;
+	call->line = callee->line;
+	call->children[0] = callee;
+	
+	_winter_lexNext(lex);
+	if (lex->lookahead.type != TK_RPAREN) {
+		while (1) {
+			ast_node_t *argument = parseExpression(state, lex);
+			if (argument == NULL || argument->type == AST_ERROR) {
+				_winter_freeTree(state, call);
+				return argument ? argument : createErrorNode(state, "expected an expression");
+			}
+			call = allocNode(state, call, call->numNodes + 1);
+			call->children[call->numNodes - 1] = argument;
+			
+			if (lex->lookahead.type != TK_COMMA) break;
+			_winter_lexNext(lex);
+		}
+	}
+	
+	if (lex->lookahead.type != TK_RPAREN) {
+		_winter_freeTree(state, call);
+		return createErrorNode(state, "expected closing parenthesis");
+	}
+	return call;
+}
+
+//Parses the key up to the closing bracket, which is left as the lookahead
+//The table is freed along with the node on errors
+static inline ast_node_t *parseIndex(winterState_t *state, lexState_t *lex, ast_node_t *table) {
+	ast_node_t *node = allocNode(state, NULL, 2);
+	node->type = AST_INDEX;
+	node->line = table->line;
+	node->children[0] = table;
+	
+	_winter_lexNext(lex);
+	ast_node_t *key = parseExpression(state, lex);
+	if (key == NULL || key->type == AST_ERROR) {
+		_winter_freeTree(state, node);
+		return key ? key : createErrorNode(state, "expected an expression");
+	}
+	node->children[1] = key;
+	
+	if (lex->lookahead.type != TK_RBRACKET) {
+		_winter_freeTree(state, node);
+		return createErrorNode(state, "expected closing bracket");
+	}
+	return node;
+}
+
+//.name is indexing with the name as a string, which is left as the lookahead
+//The table is freed on errors
+static inline ast_node_t *parseField(winterState_t *state, lexState_t *lex, ast_node_t *table) {
+	_winter_lexNext(lex);
+	if (lex->lookahead.type != TK_IDENT) {
+		_winter_freeTree(state, table);
+		return createErrorNode(state, "expected a field name");
+	}
+	ast_node_t *node = allocNode(state, NULL, 2);
+	node->type = AST_INDEX;
+	node->line = table->line;
+	node->children[0] = table;
+	node->children[1] = createEprNode(state, &lex->lookahead);
+	node->children[1]->type = AST_VALUE;
+	return node;
+}
+
+//{name = value, ...} with the closing brace left as the lookahead
+static inline ast_node_t *parseRecord(winterState_t *state, lexState_t *lex) {
+	ast_node_t *node = allocNode(state, NULL, 0);
+	node->type = AST_TABLE;
+	node->line = lex->lookahead.cursor.line + 1;
+	
+	_winter_lexNext(lex);
+	while (lex->lookahead.type == TK_IDENT) {
+		_winter_lexNext(lex);
+		node = allocNode(state, node, node->numNodes + 2);
+		node->children[node->numNodes - 2] = createEprNode(state, &lex->current);
+		node->children[node->numNodes - 2]->type = AST_VALUE;
+		
+		if (lex->lookahead.type != TK_ASSIGN) {
+			_winter_freeTree(state, node);
+			return createErrorNode(state, "expected '='");
+		}
+		_winter_lexNext(lex);
+		ast_node_t *value = parseExpression(state, lex);
+		if (value == NULL || value->type == AST_ERROR) {
+			_winter_freeTree(state, node);
+			return value ? value : createErrorNode(state, "expected an expression");
+		}
+		node->children[node->numNodes - 1] = value;
+		
+		if (lex->lookahead.type != TK_COMMA) break;
+		_winter_lexNext(lex);
+	}
+	if (lex->lookahead.type != TK_RCURLY) {
+		_winter_freeTree(state, node);
+		return createErrorNode(state, "expected '}'");
+	}
+	return node;
+}
+
+//yield(value) with the value being optional, the closing parenthesis is left as the lookahead
+static inline ast_node_t *parseYield(winterState_t *state, lexState_t *lex) {
+	ast_node_t *node = allocNode(state, NULL, 0);
+	node->type = AST_YIELD;
+	node->line = lex->lookahead.cursor.line + 1;
+	
+	_winter_lexNext(lex);
+	if (lex->lookahead.type != TK_LPAREN) {
+		_winter_freeTree(state, node);
+		return createErrorNode(state, "expected '('");
+	}
+	_winter_lexNext(lex);
+	if (lex->lookahead.type != TK_RPAREN) {
+		ast_node_t *value = parseExpression(state, lex);
+		if (value == NULL || value->type == AST_ERROR) {
+			_winter_freeTree(state, node);
+			return value ? value : createErrorNode(state, "expected an expression");
+		}
+		node = allocNode(state, node, 1);
+		node->children[0] = value;
+	}
+	if (lex->lookahead.type != TK_RPAREN) {
+		_winter_freeTree(state, node);
+		return createErrorNode(state, "expected closing parenthesis");
+	}
+	return node;
+}
+
 static inline ast_node_t *parseExpression(winterState_t *state, lexState_t *lex) {
 	ast_node_t *tree = NULL;
 	ast_node_t *tail = NULL;
@@ -137,13 +339,49 @@ static inline ast_node_t *parseExpression(winterState_t *state, lexState_t *lex)
 	} expect = expression;
 	
 	//Will either return a proper expression or error
-	if (isExpression(lex->lookahead.type) || isUnarySymbol(lex->lookahead.type)) {
+	if (isExpression(lex->lookahead.type) || isUnarySymbol(lex->lookahead.type) ||
+		lex->lookahead.type == TK_FN || lex->lookahead.type == TK_YIELD || lex->lookahead.type == TK_LCURLY) {
 		while (lex->lookahead.type != TK_EOF) {
 			token_t *token = &lex->lookahead;
 			
 			if (expect == expression) {
 				//expression
-				if (isExpression(token->type)) {
+				if (token->type == TK_FN) {
+					ast_node_t *node = parseFunction(state, lex);
+					if (node->type == AST_ERROR) {
+						_winter_freeTree(state, tree);
+						return node;
+					} else if (node->children[0] != NULL) {
+						//Named functions are declarations
+						if (tree == NULL) {
+							return node;
+						}
+						_winter_freeTree(state, tree);
+						_winter_freeTree(state, node);
+						return createErrorNode(state, "function declarations can't be part of an expression");
+					}
+					
+					if (tree == NULL) {
+						tree = node;
+					} else {
+						tail->children[tail->numNodes - 1] = node;
+					}
+					expect = operator;
+					//Already past the closing brace
+					continue;
+				} else if (token->type == TK_YIELD || token->type == TK_LCURLY) {
+					ast_node_t *node = token->type == TK_YIELD ? parseYield(state, lex) : parseRecord(state, lex);
+					if (node->type == AST_ERROR) {
+						_winter_freeTree(state, tree);
+						return node;
+					}
+					if (tree == NULL) {
+						tree = node;
+					} else {
+						tail->children[tail->numNodes - 1] = node;
+					}
+					expect = operator;
+				} else if (isExpression(token->type)) {
 					//Add expression to bottom of tree
 					ast_node_t *node = createEprNode(state, token);
 					
@@ -154,21 +392,19 @@ static inline ast_node_t *parseExpression(winterState_t *state, lexState_t *lex)
 						
 						//TODO: make this more elegant
 						if (parens == NULL) {
-							ast_node_t *error = createErrorNode(state);
-							_winter_objectNewError(state, &error->value, "expected an expression");
-							freeTree(state, tree);
-							FREE(node);
+							ast_node_t *error = createErrorNode(state, "expected an expression");
+							_winter_freeTree(state, tree);
+							_winter_freeTree(state, node);
 							return error;
 						} else if (parens->type == AST_ERROR) {
-							freeTree(state, tree);
-							FREE(node);
+							_winter_freeTree(state, tree);
+							_winter_freeTree(state, node);
 							return parens;
 						} else if (lex->lookahead.type != TK_RPAREN) {
-							ast_node_t *error = createErrorNode(state);
-							_winter_objectNewError(state, &error->value, "expected closing parenthesis");
-							freeTree(state, tree);
-							freeTree(state, parens);
-							FREE(node);
+							ast_node_t *error = createErrorNode(state, "expected closing parenthesis");
+							_winter_freeTree(state, tree);
+							_winter_freeTree(state, parens);
+							_winter_freeTree(state, node);
 							return error;
 						}
 						
@@ -187,7 +423,7 @@ static inline ast_node_t *parseExpression(winterState_t *state, lexState_t *lex)
 					if (token->type == TK_SUB) {
 						token->type = AST_NEGATE;
 					}
-					ast_node_t *node = createOprNode(state, token->type);
+					ast_node_t *node = createOprNode(state, token->type, token);
 					if (tree == NULL) {
 						tree = node;
 					} else {
@@ -195,23 +431,38 @@ static inline ast_node_t *parseExpression(winterState_t *state, lexState_t *lex)
 					}
 					tail = node;
 					//Don't change 'expect' because we still want an expression next
-					
+				
 				} else {
 					if (tree == NULL) {
 						return NULL;
 					} else {
-						ast_node_t *error = createErrorNode(state);
 						//TODO: line numbers and other debug stuff
-						_winter_objectNewError(state, &error->value, "expected an expression");
-						freeTree(state, tree);
+						ast_node_t *error = createErrorNode(state, "expected an expression");
+						_winter_freeTree(state, tree);
 						return error;
 					}
 				}
-				
+			
 			} else {
 				//operator
-				if (isOperator(token->type)) {
-					ast_node_t *node = createOprNode(state, token->type);
+				//Checked first, AST_NEGATE shares its value with TK_LPAREN
+				if (token->type == TK_LPAREN || token->type == TK_LBRACKET || token->type == TK_DOT) {
+					//Calls and indexing bind tighter than any operator, so they apply to the last expression
+					ast_node_t **last = tail == NULL ? &tree : &tail->children[tail->numNodes - 1];
+					ast_node_t *node;
+					switch (token->type) {
+						case TK_LPAREN:   node = parseCall(state, lex, *last);  break;
+						case TK_LBRACKET: node = parseIndex(state, lex, *last); break;
+						default:          node = parseField(state, lex, *last); break;
+					}
+					if (node->type == AST_ERROR) {
+						*last = NULL;
+						_winter_freeTree(state, tree);
+						return node;
+					}
+					*last = node;
+				} else if (isOperator(token->type)) {
+					ast_node_t *node = createOprNode(state, token->type, token);
 					int priority = precedence(node->type);
 					
 					//operator precedence in place
@@ -251,13 +502,15 @@ static inline ast_node_t *parseLet(winterState_t *state, lexState_t *lex) {
 	size_t size = 0;
 	ast_node_t *ret = NULL;
 	if (lex->lookahead.type == TK_LET) {
+		size_t line = lex->lookahead.cursor.line + 1;
 		_winter_lexNext(lex);
-			
+		
 		while (lex->lookahead.type == TK_IDENT) {
 			_winter_lexNext(lex);
 			//TODO: check out of memory
 			ret = allocNode(state, ret, ++size);
 			ret->type = AST_LET;
+			ret->line = line;
 			ret->children[size - 1] = createEprNode(state, &lex->current);
 			
 			if (lex->lookahead.type == TK_COMMA) {
@@ -265,21 +518,19 @@ static inline ast_node_t *parseLet(winterState_t *state, lexState_t *lex) {
 				continue;
 			} else if (lex->lookahead.type == TK_ASSIGN) {
 				_winter_lexNext(lex);
-				ast_node_t *eq = createOprNode(state, AST_ASSIGN);
+				ast_node_t *eq = createOprNode(state, AST_ASSIGN, &lex->current);
 				eq->children[0] = ret->children[size - 1];
 				ret->children[size - 1] = eq;
 				
 				ast_node_t *expr = parseExpression(state, lex);
 				if (expr == NULL) {
-					freeTree(state, ret);
-					ret = createErrorNode(state);
-					_winter_objectNewError(state, &ret->value, "expected an expression");
+					_winter_freeTree(state, ret);
+					ret = createErrorNode(state, "expected an expression");
 				} else if (expr->type == AST_ERROR) {
-					freeTree(state, ret);
+					_winter_freeTree(state, ret);
 					ret = expr;
 				} else {
 					eq->children[1] = expr;
-					printf("next token thing: %i\n", lex->lookahead.type);
 					if (lex->lookahead.type == TK_COMMA) {
 						_winter_lexNext(lex);
 						continue;
@@ -291,35 +542,97 @@ static inline ast_node_t *parseLet(winterState_t *state, lexState_t *lex) {
 		}
 		
 		//Incorrect let statement
-		freeTree(state, ret);
-		ret = createErrorNode(state);
-		_winter_objectNewError(state, &ret->value, "expected an identifier");
+		_winter_freeTree(state, ret);
+		ret = createErrorNode(state, "expected an identifier");
+	}
+	return ret;
+}
+
+static inline ast_node_t *parseReturn(winterState_t *state, lexState_t *lex) {
+	ast_node_t *ret = NULL;
+	if (lex->lookahead.type == TK_RETURN) {
+		size_t line = lex->lookahead.cursor.line + 1;
+		_winter_lexNext(lex);
+		ast_node_t *value = parseExpression(state, lex);
+		if (value != NULL && value->type == AST_ERROR) {
+			return value;
+		}
+		ret = allocNode(state, NULL, value != NULL ? 1 : 0);
+		ret->type = AST_RETURN;
+		ret->line = line;
+		if (value != NULL) {
+			ret->children[0] = value;
+		}
 	}
 	return ret;
 }
 
+//if condition { ... } else if condition { ... } else { ... }
+//Children are the condition, the body and the else branch (NULL if there is none)
+static inline ast_node_t *parseIf(winterState_t *state, lexState_t *lex) {
+	size_t line = lex->lookahead.cursor.line + 1;
+	_winter_lexNext(lex);
+	ast_node_t *condition = parseExpression(state, lex);
+	if (condition == NULL) {
+		return createErrorNode(state, "expected an expression");
+	} else if (condition->type == AST_ERROR) {
+		return condition;
+	}
+	
+	ast_node_t *node = allocNode(state, NULL, 3);
+	node->type = AST_IF;
+	node->line = line;
+	node->children[0] = condition;
+	
+	ast_node_t *body = parseBody(state, lex);
+	if (body->type == AST_ERROR) {
+		_winter_freeTree(state, node);
+		return body;
+	}
+	node->children[1] = body;
+	
+	if (lex->lookahead.type == TK_ELSE) {
+		_winter_lexNext(lex);
+		body = lex->lookahead.type == TK_IF ? parseIf(state, lex) : parseBody(state, lex);
+		if (body->type == AST_ERROR) {
+			_winter_freeTree(state, node);
+			return body;
+		}
+		node->children[2] = body;
+	}
+	return node;
+}
+
 static inline ast_node_t *parseStatement(winterState_t *state, lexState_t *lex) {
 	ast_node_t *statement = NULL;
 	
+	//Statements ending in a block don't take a semicolon
+	if (lex->lookahead.type == TK_IF) {
+		return parseIf(state, lex);
+	}
+	
 	//TODO: probably just use goto here, this is weird
 	do {
 		statement = parseLet(state, lex);
 		if (statement != NULL) break;
 		
+		statement = parseReturn(state, lex);
+		if (statement != NULL) break;
+		
 		statement = parseExpression(state, lex);
 		if (statement != NULL) break;
 	} while (0);
 	
-	if (statement != NULL && statement->type == AST_ERROR) {
+	if (statement != NULL && (statement->type == AST_ERROR ||
+		(statement->type == AST_FN && statement->children[0] != NULL))) {
 		return statement;
 	}
 	
 	if (lex->lookahead.type == TK_SEMICOLON) {
 		_winter_lexNext(lex);
 	} else {
-		freeTree(state, statement);
-		statement = createErrorNode(state);
-		_winter_objectNewError(state, &statement->value, "expected a semicolon");
+		_winter_freeTree(state, statement);
+		statement = createErrorNode(state, "expected a semicolon");
 	}
 	
 	return statement;
@@ -332,7 +645,7 @@ static inline ast_node_t *parseBlock(winterState_t *state, lexState_t *lex, toke
 		ast_node_t *temp = parseStatement(state, lex);
 		if (temp != NULL) {
 			if (temp->type == AST_ERROR) {
-				freeTree(state, block);
+				_winter_freeTree(state, block);
 				return temp;
 			}
 			
@@ -350,136 +663,3 @@ ast_node_t *_winter_generateTree(winterState_t *state, const char *source) {
 	_winter_lexNext(&lex);
 	return parseBlock(state, &lex, TK_EOF);
 }
-
-//Temporary for testing
-ast_node_t *walkTree(winterState_t *state, ast_node_t *node) {
-	if (node->type == AST_BLOCK) {
-		ast_node_t *result = NULL;
-		for (size_t i = 0; i < node->numNodes; i++) {
-			freeTree(state, result);
-			result = walkTree(state, node->children[i]);
-			node->children[i] = NULL;
-			if (result->type == AST_ERROR) break;
-		}
-		freeTree(state, node);
-		return result;
-	} else if (isOperator(node->type)) {
-		ast_node_t *nodes[2] = {
-			walkTree(state, node->children[0]),
-			NULL
-		};
-		
-		//check if the left side is an error
-		if (nodes[0]->type == AST_ERROR) {
-			node->children[0] = NULL;
-			freeTree(state, node);
-			return nodes[0];
-		}
-		
-		if (node->numNodes == 2) {
-			nodes[1] = walkTree(state, node->children[1]);
-			
-			//check if the right side is an error
-			if (nodes[1]->type == AST_ERROR) {
-				node->children[1] = NULL;
-				freeTree(state, node);
-				return nodes[1];
-			}
-		}
-		
-		typedef int (*binary)(winterState_t *state, object_t *, object_t *);
-		typedef int (*unary) (winterState_t *state, object_t *);
-		
-		int result = OBJECT_OK;
-		
-		//TODO: remove PASS during optimization phase
-		if (nodes[0]->type != AST_PASS) {
-			//DEBUG ONLY
-			if (function(node->type) == NULL) {
-				printf("function not implemented! %i\n", node->type);
-				result = OBJECT_ERROR_TYPE;
-			} else if (isUnary(node->type)) {
-				result = ((unary)function(node->type))(state, &nodes[0]->value);
-			} else {
-				result = ((binary)function(node->type))(state, &nodes[0]->value, &nodes[1]->value);
-			}
-		}
-		
-		if (result != OBJECT_OK) {
-			_winter_objectDelRef(state, &nodes[0]->value);
-			//TODO: better formatting, example: "operator '+' incompatible with types 'table' and 'int'"
-			//Possible line numbers and other debugging stuff
-			_winter_objectNewError(state, &node->value, "incompatible type");
-			node->type = AST_ERROR;
-		} else {
-			node->value = nodes[0]->value;
-			node->type = AST_VALUE;
-		}
-		node->numNodes = 0;
-		
-		FREE(nodes[0]);
-		if (nodes[1] != NULL) {
-			_winter_objectDelRef(state, &nodes[1]->value);
-			FREE(nodes[1]);
-		}
-	} else if (node->type == AST_PASS) {
-		ast_node_t *out = walkTree(state, node->children[0]);
-		FREE(node);
-		node = out;
-	} else if (node->type == AST_LET) {
-		for (size_t i = 0; i < node->numNodes; i++) {
-			ast_node_t *key_node = node->children[i];
-			object_t *key = NULL;
-			object_t *value = NULL;
-			if (key_node->type == AST_ASSIGN) {
-				key = &key_node->children[0]->value;
-				key_node->children[1] = walkTree(state, key_node->children[1]);
-				
-				if (key_node->children[1]->type == AST_ERROR) {
-					ast_node_t *temp = key_node->children[1];
-					key_node->children[1] = NULL;
-					freeTree(state, node);
-					return temp;
-				}
-				
-				value = &(key_node->children[1]->value);
-				
-				if (value->type == TYPE_REFERENCE) {
-					value = value->pointer;
-				}
-			} else {
-				key = &node->value;
-			}
-			object_t *object = _winter_tableGetObject(state->globals, key);
-			if (object != NULL) {
-				_winter_objectNewError(state, &node->value, "multiple declarations of '%s'", key->string->data);
-				freeTree(state, node->children[i]);
-				node->type = AST_ERROR;
-				node->numNodes = 0;
-				return node;
-			} else {
-				_winter_tableInsert(state, state->globals, key, value);
-				freeTree(state, node->children[i]);
-			}
-		}
-		node->type  = AST_VALUE; 
-		node->numNodes = 0;
-		node->value = (object_t){TYPE_NULL};
-	} else if (node->type == AST_IDENT) {
-		object_t *obj = _winter_tableGetObject(state->globals, &node->value);
-		if (obj == NULL) {
-			//Undeclared identifier
-			object_t error;
-			_winter_objectNewError(state, &error, "undeclared identifier '%s'", node->value.string->data);
-			_winter_objectDelRef(state, &node->value);
-			node->type = AST_ERROR;
-			node->value = error;
-		} else {
-			_winter_objectDelRef(state, &node->value);
-			node->type = AST_VALUE;
-			node->value.type = TYPE_REFERENCE;
-			node->value.pointer = obj;
-		}
-	}
-	return node;
-}
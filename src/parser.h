@@ -29,8 +29,18 @@ typedef enum ast_node_type_t {
 	//Simply passes the value through, needed for some precedence
 	AST_PASS,
 	
+	//Function call, the callee followed by the arguments
+	AST_CALL,
+	
+	//Indexing, the table followed by the key
+	AST_INDEX,
+	
+	//Record literal, pairs of a field name and its value
+	AST_TABLE,
+	
 	//Keywords to be used in the AST
-	AST_FOR = TK_FOR, AST_LET = TK_LET,
+	AST_FOR = TK_FOR, AST_IF = TK_IF, AST_LET = TK_LET,
+	AST_FN = TK_FN, AST_RETURN = TK_RETURN, AST_YIELD = TK_YIELD,
 	
 	//Operators, just coppied over except for a few semantics
 	AST_LSHIFTEQ = TK_LSHIFTEQ, AST_RSHIFTEQ = TK_RSHIFTEQ,
@@ -57,11 +67,17 @@ typedef enum ast_node_type_t {
 typedef struct ast_node_t {
 	ast_node_type_t type;
 	object_t value;
+	size_t   line; //first source line of the node, 0 if unknown
 	
 	size_t numNodes;
 	struct ast_node_t **children;
 } ast_node_t;
 
 ast_node_t *_winter_generateTree(winterState_t *state, const char *source);
+void _winter_freeTree(winterState_t *state, ast_node_t *tree);
+
+typedef void (*func_ptr_void_t)(void);
+//Returns the object function implementing an operator, NULL if not implemented yet
+func_ptr_void_t _winter_operatorFunction(ast_node_type_t operator);
 
 #endif
@@ -0,0 +1,332 @@
+#include "pool.h"
+#include "wtype.h"
+#include <string.h>
+#include <stddef.h>
+
+#define BLOCK_SIZE (POOL_PAGE_SIZE * POOL_BLOCK_PAGES)
+#define HOST(p, s) (pool->hostCalls++, state->allocator((p), (s)))
+
+typedef struct page_t {
+	//Pages of the same size class, or free pages
+	struct page_t *next;
+	struct page_t *prev;
+	
+	void *free;  //intrusive list of freed slots
+	char *bump;  //start of the untouched part of the page
+	uint16_t sizeClass;
+	uint16_t objectSize;
+	uint16_t used;
+	uint16_t capacity;
+} page_t;
+
+//Allocations too big for the pool keep their size in front of them
+typedef union large_t {
+	size_t size;
+	max_align_t align;
+} large_t;
+
+//Slots start after the header, kept 16 byte aligned
+#define PAGE_HEADER ((sizeof(page_t) + 15) & ~(size_t)15)
+#define pageOf(p) ((page_t*)((uintptr_t)(p) & ~(uintptr_t)(POOL_PAGE_SIZE - 1)))
+
+static const uint16_t classSizes[POOL_NUM_CLASSES] = {
+	16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512
+};
+//Indexed by size rounded up to a multiple of 16
+static const uint8_t classIndex[POOL_MAX_SMALL / 16 + 1] = {
+	0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+	12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15
+};
+
+static inline void account(winterState_t *state, ptrdiff_t bytes) {
+	winterMemoryStats_t *memory = &state->memory;
+	memory->bytes += bytes;
+	if (memory->bytes > memory->peak) {
+		memory->peak = memory->bytes;
+	}
+}
+
+void _winter_poolInit(winterState_t *state) {
+	state->pool = (pool_t){{0}};
+}
+void _winter_poolFree(winterState_t *state) {
+	pool_t *pool = &state->pool;
+	for (size_t i = 0; i < pool->numBlocks; i++) {
+		HOST(pool->blocks[i].memory, 0);
+	}
+	if (pool->blocks != NULL) {
+		HOST(pool->blocks, 0);
+	}
+	*pool = (pool_t){{0}};
+}
+
+static inline poolblock_t *findBlock(pool_t *pool, void *pointer) {
+	size_t low = 0, high = pool->numBlocks;
+	while (low < high) {
+		size_t mid = (low + high) / 2;
+		poolblock_t *block = &pool->blocks[mid];
+		if ((char*)pointer < block->start) {
+			high = mid;
+		} else if ((char*)pointer >= block->start + BLOCK_SIZE) {
+			low = mid + 1;
+		} else {
+			return block;
+		}
+	}
+	return NULL;
+}
+
+static inline void unlinkPage(page_t **list, page_t *page) {
+	if (page->prev) {
+		page->prev->next = page->next;
+	} else {
+		*list = page->next;
+	}
+	if (page->next) {
+		page->next->prev = page->prev;
+	}
+	page->next = page->prev = NULL;
+}
+static inline void linkPage(page_t **list, page_t *page) {
+	page->prev = NULL;
+	page->next = *list;
+	if (*list) {
+		(*list)->prev = page;
+	}
+	*list = page;
+}
+
+static bool_t newBlock(winterState_t *state) {
+	pool_t *pool = &state->pool;
+	if (pool->numBlocks == pool->blockCapacity) {
+		size_t capacity = pool->blockCapacity ? pool->blockCapacity * 2 : 4;
+		poolblock_t *blocks = HOST(pool->blocks, sizeof(poolblock_t) * capacity);
+		if (blocks == NULL) return false;
+		pool->blocks = blocks;
+		pool->blockCapacity = capacity;
+	}
+	
+	//One extra page to align the block
+	void *memory = HOST(NULL, BLOCK_SIZE + POOL_PAGE_SIZE);
+	if (memory == NULL) return false;
+	char *start = (char*)pageOf((char*)memory + POOL_PAGE_SIZE - 1);
+	
+	size_t index = pool->numBlocks;
+	while (index > 0 && pool->blocks[index - 1].start > start) {
+		pool->blocks[index] = pool->blocks[index - 1];
+		index--;
+	}
+	pool->blocks[index] = (poolblock_t){ memory, start, POOL_BLOCK_PAGES };
+	pool->numBlocks++;
+	
+	for (size_t i = 0; i < POOL_BLOCK_PAGES; i++) {
+		linkPage(&pool->freePages, (page_t*)(start + i * POOL_PAGE_SIZE));
+	}
+	pool->numFreePages += POOL_BLOCK_PAGES;
+	return true;
+}
+
+//Gives the block back to the host once all of its pages are free
+static void releaseBlock(winterState_t *state, poolblock_t *block) {
+	pool_t *pool = &state->pool;
+	for (size_t i = 0; i < POOL_BLOCK_PAGES; i++) {
+		unlinkPage(&pool->freePages, (page_t*)(block->start + i * POOL_PAGE_SIZE));
+	}
+	pool->numFreePages -= POOL_BLOCK_PAGES;
+	HOST(block->memory, 0);
+	
+	size_t index = block - pool->blocks;
+	memmove(block, block + 1, sizeof(poolblock_t) * (pool->numBlocks - index - 1));
+	pool->numBlocks--;
+}
+
+static page_t *newPage(winterState_t *state, int sizeClass) {
+	pool_t *pool = &state->pool;
+	if (pool->freePages == NULL && !newBlock(state)) {
+		return NULL;
+	}
+	page_t *page = pool->freePages;
+	unlinkPage(&pool->freePages, page);
+	pool->numFreePages--;
+	findBlock(pool, page)->freePages--;
+	
+	page->free       = NULL;
+	page->bump       = (char*)page + PAGE_HEADER;
+	page->sizeClass  = sizeClass;
+	page->objectSize = classSizes[sizeClass];
+	page->used       = 0;
+	page->capacity   = (POOL_PAGE_SIZE - PAGE_HEADER) / page->objectSize;
+	pool->slots     += page->capacity;
+	linkPage(&pool->classes[sizeClass], page);
+	return page;
+}
+
+static inline void *allocSmall(winterState_t *state, int sizeClass) {
+	pool_t *pool = &state->pool;
+	page_t *page = pool->classes[sizeClass];
+	if (page == NULL) {
+		page = newPage(state, sizeClass);
+		if (page == NULL) return NULL;
+	}
+	
+	void *out;
+	if (page->free != NULL) {
+		out = page->free;
+		page->free = *(void**)out;
+	} else {
+		out = page->bump;
+		page->bump += page->objectSize;
+	}
+	
+	//Full pages leave the class list until a slot is freed
+	if (++page->used == page->capacity) {
+		unlinkPage(&pool->classes[sizeClass], page);
+	}
+	pool->usedSlots++;
+	pool->usedBytes += page->objectSize;
+	account(state, page->objectSize);
+	return out;
+}
+
+static inline void freeSmall(winterState_t *state, poolblock_t *block, void *pointer) {
+	pool_t *pool = &state->pool;
+	page_t *page = pageOf(pointer);
+	*(void**)pointer = page->free;
+	page->free = pointer;
+	
+	if (page->used-- == page->capacity) {
+		linkPage(&pool->classes[page->sizeClass], page);
+	}
+	pool->usedSlots--;
+	pool->usedBytes -= page->objectSize;
+	account(state, -(ptrdiff_t)page->objectSize);
+	
+	//Empty pages can be reused by any size class
+	if (page->used == 0) {
+		unlinkPage(&pool->classes[page->sizeClass], page);
+		pool->slots -= page->capacity;
+		linkPage(&pool->freePages, page);
+		pool->numFreePages++;
+		if (++block->freePages == POOL_BLOCK_PAGES && pool->numBlocks > 1) {
+			releaseBlock(state, block);
+		}
+	}
+}
+
+static inline void *allocLarge(winterState_t *state, large_t *large, size_t size) {
+	pool_t *pool = &state->pool;
+	size_t oldSize = large ? large->size : 0;
+	large_t *out = HOST(large, sizeof(large_t) + size);
+	if (out == NULL) return NULL;
+	if (large == NULL) {
+		pool->largeAllocs++;
+	}
+	out->size = size;
+	account(state, (ptrdiff_t)size - (ptrdiff_t)oldSize);
+	return out + 1;
+}
+static inline void freeLarge(winterState_t *state, large_t *large) {
+	pool_t *pool = &state->pool;
+	pool->largeAllocs--;
+	account(state, -(ptrdiff_t)large->size);
+	HOST(large, 0);
+}
+
+void *_winter_poolAllocRaw(winterState_t *state, void *pointer, size_t size) {
+	if (pointer == NULL) {
+		if (size == 0) {
+			return NULL;
+		} else if (size <= POOL_MAX_SMALL) {
+			return allocSmall(state, classIndex[(size + 15) >> 4]);
+		}
+		return allocLarge(state, NULL, size);
+	}
+	
+	poolblock_t *block = findBlock(&state->pool, pointer);
+	large_t *large = (large_t*)pointer - 1;
+	if (size == 0) {
+		if (block != NULL) {
+			freeSmall(state, block, pointer);
+		} else {
+			freeLarge(state, large);
+		}
+		return NULL;
+	}
+	
+	if (block != NULL) {
+		size_t objectSize = pageOf(pointer)->objectSize;
+		if (size <= objectSize) {
+			return pointer;
+		}
+		void *out = _winter_poolAllocRaw(state, NULL, size);
+		if (out != NULL) {
+			memcpy(out, pointer, objectSize);
+			freeSmall(state, block, pointer);
+		}
+		return out;
+	} else if (size <= POOL_MAX_SMALL) {
+		//Large allocations are always bigger than any size class
+		void *out = allocSmall(state, classIndex[(size + 15) >> 4]);
+		if (out != NULL) {
+			memcpy(out, pointer, size);
+			freeLarge(state, large);
+		}
+		return out;
+	}
+	return allocLarge(state, large, size);
+}
+
+//Bytes the allocation currently holds
+static inline size_t sizeOf(winterState_t *state, void *pointer) {
+	if (pointer == NULL) {
+		return 0;
+	} else if (findBlock(&state->pool, pointer) != NULL) {
+		return pageOf(pointer)->objectSize;
+	}
+	return ((large_t*)pointer - 1)->size;
+}
+
+void *_winter_poolTryAlloc(winterState_t *state, void *pointer, size_t size) {
+	winterMemoryStats_t *memory = &state->memory;
+	if (memory->limit != 0 && state->errorJump != NULL && size > 0 &&
+		memory->bytes - sizeOf(state, pointer) + size > memory->limit) {
+		return NULL;
+	}
+	return _winter_poolAllocRaw(state, pointer, size);
+}
+void *_winter_poolAlloc(winterState_t *state, void *pointer, size_t size) {
+	void *out = _winter_poolTryAlloc(state, pointer, size);
+	if (out == NULL && size > 0) {
+		_winter_memoryError(state);
+	}
+	return out;
+}
+
+void _winter_memoryError(winterState_t *state) {
+	if (state->errorJump != NULL) {
+		longjmp(*state->errorJump, 1);
+	}
+}
+
+void winterGetPoolStats(winterState_t *state, winterPoolStats_t *stats) {
+	pool_t *pool = &state->pool;
+	stats->blocks      = pool->numBlocks;
+	stats->pages       = pool->numBlocks * POOL_BLOCK_PAGES;
+	stats->freePages   = pool->numFreePages;
+	stats->slots       = pool->slots;
+	stats->usedSlots   = pool->usedSlots;
+	stats->usedBytes   = pool->usedBytes;
+	stats->largeAllocs = pool->largeAllocs;
+	stats->hostCalls   = pool->hostCalls;
+	
+	//Share of assigned page memory not holding live objects
+	size_t assigned = (stats->pages - stats->freePages) * POOL_PAGE_SIZE;
+	stats->fragmentation = assigned ? 1.0 - (double)pool->usedBytes / (double)assigned : 0.0;
+}
+
+void winterGetMemoryStats(winterState_t *state, winterMemoryStats_t *stats) {
+	*stats = state->memory;
+}
+void winterSetMemoryLimit(winterState_t *state, size_t bytes) {
+	state->memory.limit = bytes;
+}
@@ -0,0 +1,55 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "winter.h"
+
+//Size class pool allocator layered over the host allocator
+//Small objects are carved out of pages taken from large host blocks, anything bigger
+//than the largest size class is passed to the host allocator directly
+#define POOL_PAGE_SIZE   (16 * 1024)
+#define POOL_BLOCK_PAGES 64
+#define POOL_MAX_SMALL   512
+#define POOL_NUM_CLASSES 16
+
+typedef struct page_t page_t;
+typedef struct poolblock_t {
+	void  *memory; //pointer returned by the host allocator
+	char  *start;  //first page aligned to POOL_PAGE_SIZE
+	size_t freePages;
+} poolblock_t;
+
+typedef struct pool_t {
+	page_t *classes[POOL_NUM_CLASSES]; //pages with free slots
+	page_t *freePages;                 //pages not assigned to a size class
+
+	//Sorted by address
+	poolblock_t *blocks;
+	size_t       numBlocks;
+	size_t       blockCapacity;
+
+	//Statistics
+	size_t numFreePages;
+	size_t slots;
+	size_t usedSlots;
+	size_t usedBytes;
+	size_t largeAllocs;
+	size_t hostCalls;
+} pool_t;
+
+void _winter_poolInit(winterState_t *state);
+//Releases every block, objects still allocated from the pool are freed with it
+void _winter_poolFree(winterState_t *state);
+
+//Behaves like realloc, inside protected calls running out of memory or going over the
+//memory limit raises an error instead of returning NULL
+void *_winter_poolAlloc(winterState_t *state, void *pointer, size_t size);
+//Never raises and ignores the memory limit, for bookkeeping that can't fail halfway
+void *_winter_poolAllocRaw(winterState_t *state, void *pointer, size_t size);
+//Keeps to the memory limit like _winter_poolAlloc but returns NULL instead of raising, so an
+//object made of several allocations can free the parts it has before raising
+void *_winter_poolTryAlloc(winterState_t *state, void *pointer, size_t size);
+
+//Jumps to the innermost protected call, returns if there is none
+void _winter_memoryError(winterState_t *state);
+
+#endif
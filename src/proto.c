@@ -0,0 +1,126 @@
+#include "proto.h"
+#include "chunk.h"
+#include "wstring.h"
+#include "shape.h"
+#include <string.h>
+
+#ifdef WINTER_JIT
+#include "jit.h"
+#endif
+
+#define ALIGN SHARED_ALIGN
+
+proto_t *_winter_protoAlloc(winterState_t *state) {
+	proto_t *out = MALLOC(sizeof(proto_t));
+	*out = (proto_t){0};
+	out->references = 1;
+	return out;
+}
+
+void _winter_protoRetain(proto_t *proto) {
+	if (proto->shared != NULL) {
+		_winter_sharedRetain(proto->shared);
+	} else {
+		proto->references++;
+	}
+}
+void _winter_protoRelease(winterState_t *state, proto_t *proto) {
+	if (proto->shared != NULL) {
+		_winter_sharedRelease(proto->shared);
+		return;
+	}
+	if (--proto->references > 0) return;
+	
+	for (size_t i = 0; i < proto->numConstants; i++) {
+		_winter_objectDelRef(state, &proto->constants[i]);
+	}
+	for (size_t i = 0; i < proto->numProtos; i++) {
+		_winter_protoRelease(state, proto->protos[i]);
+	}
+	if (proto->mapping != NULL) {
+		_winter_mappingRelease(state, proto->mapping);
+	} else {
+		if (proto->code)     FREE(proto->code);
+		if (proto->lines)    FREE(proto->lines);
+		if (proto->upvalues) FREE(proto->upvalues);
+	}
+	if (proto->constants) FREE(proto->constants);
+	if (proto->protos)    FREE(proto->protos);
+	for (size_t i = 0; i < proto->numCaches; i++) {
+		_winter_cacheRelease(state, &proto->caches[i]);
+	}
+	if (proto->caches)    FREE(proto->caches);
+	if (proto->sharedCopy) _winter_protoRelease(state, proto->sharedCopy);
+#ifdef WINTER_JIT
+	if (proto->jit) _winter_jitFree(state, proto->jit);
+#endif
+	FREE(proto);
+}
+
+//Bytes the prototype and its children take in a shared block
+static size_t sharedSize(const proto_t *proto) {
+	size_t size = ALIGN(sizeof(proto_t));
+	size += ALIGN(sizeof(uint32_t) * proto->numCode) * (proto->lines != NULL ? 2 : 1);
+	size += ALIGN(sizeof(upvaldesc_t) * proto->numUpvalues);
+	size += ALIGN(sizeof(object_t) * proto->numConstants);
+	size += ALIGN(sizeof(proto_t*) * proto->numProtos);
+	for (size_t i = 0; i < proto->numConstants; i++) {
+		if (proto->constants[i].type == TYPE_STRING) {
+			size += SHARED_STRING_SIZE(proto->constants[i].string->length);
+		}
+	}
+	for (size_t i = 0; i < proto->numProtos; i++) {
+		size += sharedSize(proto->protos[i]);
+	}
+	return size;
+}
+
+static proto_t *shareProto(shared_t *shared, const proto_t *proto, unsigned char **at) {
+	proto_t *out = _winter_sharedTake(at, proto, sizeof(proto_t));
+	out->references = 0;
+	out->mapping    = NULL;
+	out->shared     = shared;
+	out->hotness    = 0;
+	out->jit        = NULL;
+	out->caches     = NULL;
+	out->numCaches  = 0;
+	out->sharedCopy = NULL;
+	out->code       = _winter_sharedTake(at, proto->code, sizeof(uint32_t) * proto->numCode);
+	out->lines      = proto->lines ? _winter_sharedTake(at, proto->lines, sizeof(uint32_t) * proto->numCode) : NULL;
+	out->upvalues   = proto->numUpvalues ? _winter_sharedTake(at, proto->upvalues, sizeof(upvaldesc_t) * proto->numUpvalues) : NULL;
+	out->constants  = proto->numConstants ? _winter_sharedTake(at, NULL, sizeof(object_t) * proto->numConstants) : NULL;
+	out->protos     = proto->numProtos ? _winter_sharedTake(at, NULL, sizeof(proto_t*) * proto->numProtos) : NULL;
+	
+	for (size_t i = 0; i < proto->numConstants; i++) {
+		const object_t *constant = &proto->constants[i];
+		out->constants[i] = *constant;
+		if (constant->type == TYPE_STRING) {
+			out->constants[i].string = _winter_sharedString(at, constant->string);
+		}
+	}
+	for (size_t i = 0; i < proto->numProtos; i++) {
+		out->protos[i] = shareProto(shared, proto->protos[i], at);
+	}
+	return out;
+}
+
+void _winter_protoCaches(winterState_t *state, proto_t *proto) {
+	size_t count = 0;
+	for (size_t i = 0; i < proto->numCode; i++) {
+		if (GET_OP(proto->code[i]) == OP_EXTRA && GET_BX(proto->code[i]) >= count) {
+			count = GET_BX(proto->code[i]) + 1;
+		}
+	}
+	proto->caches = MALLOC(sizeof(fieldCache_t) * (count ? count : 1));
+	memset(proto->caches, 0, sizeof(fieldCache_t) * (count ? count : 1));
+	proto->numCaches = count;
+}
+
+proto_t *_winter_protoShare(winterState_t *state, const proto_t *proto) {
+	unsigned char *at;
+	shared_t *shared = _winter_sharedAlloc(state, sharedSize(proto), &at);
+	if (shared == NULL) {
+		return NULL;
+	}
+	return shareProto(shared, proto, &at);
+}
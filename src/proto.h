@@ -0,0 +1,114 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include "wtype.h"
+#include "object.h"
+#include "shared.h"
+
+//Instructions are 32 bits: an 8 bit opcode followed by the operands A, B and C
+//B and C can be read together as Bx, or as sBx for signed jump offsets
+#define GET_OP(i)  ((opcode_t)((i) & 0xff))
+#define GET_A(i)   (((i) >>  8) & 0xff)
+#define GET_B(i)   (((i) >> 16) & 0xff)
+#define GET_C(i)   (((i) >> 24) & 0xff)
+#define GET_BX(i)  ((i) >> 16)
+#define GET_SBX(i) ((int)GET_BX(i) - SBX_BIAS)
+
+#define CODE_ABC(o, a, b, c) ((uint32_t)(o) | ((uint32_t)(a) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 24))
+#define CODE_ABX(o, a, bx)   ((uint32_t)(o) | ((uint32_t)(a) << 8) | ((uint32_t)(bx) << 16))
+#define CODE_SBX(o, a, sbx)  CODE_ABX(o, a, (sbx) + SBX_BIAS)
+
+#define MAX_REGISTERS 250
+#define MAX_UPVALUES  255
+#define MAX_BX        0xffff
+#define SBX_BIAS      0x7fff
+
+//R[x] is a register, K[x] a constant and U[x] an upvalue of the running closure
+typedef enum opcode_t {
+	OP_MOVE,      //A B    R[A] = R[B]
+	OP_LOADK,     //A Bx   R[A] = K[Bx]
+	OP_LOADNULL,  //A      R[A] = null
+	
+	OP_GETGLOBAL, //A Bx   R[A] = globals[K[Bx]]
+	OP_SETGLOBAL, //A Bx   globals[K[Bx]] = R[A], the global must exist
+	OP_DEFGLOBAL, //A Bx   declares globals[K[Bx]] = R[A]
+	OP_GETUPVAL,  //A B    R[A] = U[B]
+	OP_SETUPVAL,  //A B    U[B] = R[A]
+	OP_GETINDEX,  //A B C  R[A] = R[B][R[C]], null if the key isn't in the table
+	OP_SETINDEX,  //A B C  R[A][R[B]] = R[C]
+	
+	//A B C  R[A] = R[B] op R[C]
+	OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW,
+	OP_EQ, OP_NOTEQ, OP_LESS, OP_LEQ, OP_GREATER, OP_GEQ,
+	OP_NEGATE,    //A B    R[A] = -R[B]
+	
+	OP_JMP,       //sBx    pc += sBx
+	OP_JMPIFNOT,  //A sBx  if R[A] is false, pc += sBx
+	
+	OP_CLOSURE,   //A Bx   R[A] = closure of protos[Bx]
+	OP_CLOSE,     //A      closes upvalues of R[A] and above
+	OP_CALL,      //A B    R[A] = R[A](R[A+1], ..., R[A+B])
+	OP_TAILCALL,  //A B    return R[A](R[A+1], ..., R[A+B])
+	OP_YIELD,     //A B    suspends the coroutine passing out R[A] if B is 1, null if B is 0,
+	              //       R[A] = the value it's resumed with
+	OP_RETURN,    //A B    returns R[A] if B is 1, null if B is 0
+	
+	//Field access, followed by an OP_EXTRA with the index of the inline cache, see shape.h
+	OP_GETFIELD,  //A B C  R[A] = R[B][K[C]], the key is a string
+	OP_SETFIELD,  //A B C  R[A][K[B]] = R[C], the key is a string
+	OP_NEWTABLE,  //A      R[A] = a new record
+	OP_EXTRA      //Bx     operand of the previous instruction, never run
+} opcode_t;
+
+//Where a closure finds each upvalue when it is created
+typedef struct upvaldesc_t {
+	uint8_t fromLocal; //register of the enclosing function, otherwise its upvalue
+	uint8_t index;
+} upvaldesc_t;
+
+//Compiled function shared by every closure made from it
+typedef struct proto_t {
+	uint32_t references;
+	
+	uint32_t *code;
+	uint32_t *lines; //source line of each instruction, NULL when stripped
+	size_t    numCode;
+	object_t *constants; //counted references
+	size_t    numConstants;
+	struct proto_t **protos;
+	size_t           numProtos;
+	upvaldesc_t *upvalues;
+	
+	uint8_t numUpvalues;
+	uint8_t numParams;
+	uint8_t numRegisters;
+	
+	//Set when the code, lines and upvalues live in a loaded binary chunk, see chunk.h
+	struct mapping_t *mapping;
+	//Set when the prototype is part of a shared chunk, its whole tree with the code and
+	//constants is one block that states on any thread can run at once, see shared.h
+	shared_t *shared;
+	
+	//Times closures of it were entered, it's compiled once this is high enough, see jit.h
+	uint32_t       hotness;
+	struct jit_t  *jit;
+	
+	//Inline caches of the field instructions, allocated when the first one runs
+	struct fieldCache_t *caches;
+	size_t               numCaches;
+	
+	//Copy in a shared block for running callbacks on worker threads, see parallel.h
+	struct proto_t *sharedCopy;
+} proto_t;
+
+proto_t *_winter_protoAlloc(winterState_t *state);
+void _winter_protoRetain(proto_t *proto);
+//Frees the prototype with its constants once the last reference is gone
+void _winter_protoRelease(winterState_t *state, proto_t *proto);
+//Copies the prototype tree into a shared block with one reference
+//Returns NULL if the allocator fails
+proto_t *_winter_protoShare(winterState_t *state, const proto_t *proto);
+//Allocates the inline caches for the indices the code uses
+void _winter_protoCaches(winterState_t *state, proto_t *proto);
+
+#endif
@@ -0,0 +1,1080 @@
+#include "regex.h"
+#include "array.h"
+#include "wstring.h"
+#include "winter.h"
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+
+#define REGEX_MAX_DEPTH 128    //nested groups
+#define REGEX_MAX_WORK  100000 //nodes written out, repeats of repeats of nothing write none
+
+static inline bool_t inSet(const uint8_t *set, unsigned char byte) {
+	return (set[byte >> 3] >> (byte & 7)) & 1;
+}
+
+static inline void setRange(uint8_t *set, int low, int high) {
+	for (int i = low; i <= high; i++) {
+		set[i >> 3] |= (uint8_t)(1 << (i & 7));
+	}
+}
+
+//Parsing
+
+typedef enum nodeType_t {
+	NODE_EMPTY,
+	NODE_SET,    //x is the set
+	NODE_CAT,    //children from a linked by next
+	NODE_ALT,    //children from a linked by next, tried in order
+	NODE_REPEAT, //of a, min to max times, max -1 for no limit
+	NODE_GROUP,  //a captured as group x
+	NODE_BOL,
+	NODE_EOL
+} nodeType_t;
+
+typedef struct node_t {
+	uint8_t  type;
+	uint8_t  greedy;
+	int32_t  a, next;
+	int32_t  min, max;
+	uint32_t x;
+} node_t;
+
+typedef struct compiler_t {
+	winterState_t *state;
+	jmp_buf        jump;
+	const char    *error;
+	const char    *at, *end;
+	int            depth;
+	size_t         work;
+	regex_t       *regex;
+	node_t        *nodes;
+	uint32_t       numNodes, capacityNodes;
+	uint32_t       capacityCode, capacitySets;
+	int32_t        single[256]; //set of each single byte, -1 until used
+} compiler_t;
+
+static void fail(compiler_t *c, const char *error) {
+	c->error = error;
+	longjmp(c->jump, 1);
+}
+
+static int32_t newNode(compiler_t *c, nodeType_t type) {
+	winterState_t *state = c->state;
+	if (c->numNodes == c->capacityNodes) {
+		c->capacityNodes = c->capacityNodes == 0 ? 32 : c->capacityNodes * 2;
+		c->nodes = REALLOC(c->nodes, c->capacityNodes * sizeof(node_t));
+	}
+	node_t *node = &c->nodes[c->numNodes];
+	memset(node, 0, sizeof(node_t));
+	node->type = type;
+	node->a    = -1;
+	node->next = -1;
+	return (int32_t)c->numNodes++;
+}
+
+static int32_t newSet(compiler_t *c, const uint8_t *set) {
+	winterState_t *state = c->state;
+	regex_t *regex = c->regex;
+	if (regex->numSets == c->capacitySets) {
+		c->capacitySets = c->capacitySets == 0 ? 8 : c->capacitySets * 2;
+		regex->sets = REALLOC(regex->sets, c->capacitySets * sizeof(regex->sets[0]));
+	}
+	memcpy(regex->sets[regex->numSets], set, 32);
+	int32_t node = newNode(c, NODE_SET);
+	c->nodes[node].x = regex->numSets++;
+	return node;
+}
+
+static int32_t newByte(compiler_t *c, unsigned char byte) {
+	if (c->single[byte] >= 0) {
+		int32_t node = newNode(c, NODE_SET);
+		c->nodes[node].x = (uint32_t)c->single[byte];
+		return node;
+	}
+	uint8_t set[32] = { 0 };
+	setRange(set, byte, byte);
+	int32_t node = newSet(c, set);
+	c->single[byte] = (int32_t)c->nodes[node].x;
+	return node;
+}
+
+static void addClass(uint8_t *set, char kind) {
+	uint8_t class[32] = { 0 };
+	switch (kind | 0x20) {
+		case 'd':
+			setRange(class, '0', '9');
+			break;
+		case 'w':
+			setRange(class, '0', '9');
+			setRange(class, 'A', 'Z');
+			setRange(class, 'a', 'z');
+			setRange(class, '_', '_');
+			break;
+		case 's':
+			setRange(class, '\t', '\r');
+			setRange(class, ' ', ' ');
+			break;
+	}
+	bool_t negate = kind >= 'A' && kind <= 'Z';
+	for (int i = 0; i < 32; i++) {
+		set[i] |= negate ? (uint8_t)~class[i] : class[i];
+	}
+}
+
+static int hexDigit(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+//Adds what the escape after a backslash matches to 'set', returns the byte if it's one
+//byte or -1 if it's a class
+static int parseEscape(compiler_t *c, uint8_t *set) {
+	if (c->at == c->end) {
+		fail(c, "trailing backslash");
+	}
+	char e = *c->at++;
+	int byte;
+	switch (e) {
+		case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+			addClass(set, e);
+			return -1;
+		case 'n': byte = '\n'; break;
+		case 't': byte = '\t'; break;
+		case 'r': byte = '\r'; break;
+		case 'f': byte = '\f'; break;
+		case 'v': byte = '\v'; break;
+		case '0': byte = '\0'; break;
+		case 'x': {
+			int high = c->end - c->at >= 2 ? hexDigit(c->at[0]) : -1;
+			int low  = high >= 0 ? hexDigit(c->at[1]) : -1;
+			if (low < 0) {
+				fail(c, "\\x needs two hex digits");
+			}
+			c->at += 2;
+			byte = high << 4 | low;
+			break;
+		}
+		default:
+			if ((e >= 'a' && e <= 'z') || (e >= 'A' && e <= 'Z') || (e >= '0' && e <= '9')) {
+				fail(c, "unknown escape");
+			}
+			byte = (unsigned char)e;
+	}
+	setRange(set, byte, byte);
+	return byte;
+}
+
+//After the '['
+static int32_t parseClass(compiler_t *c) {
+	uint8_t set[32] = { 0 };
+	bool_t negate = c->at < c->end && *c->at == '^';
+	if (negate) c->at++;
+	for (bool_t first = true;; first = false) {
+		if (c->at == c->end) {
+			fail(c, "missing ]");
+		}
+		char ch = *c->at++;
+		if (ch == ']' && !first) {
+			break;
+		}
+		int low = (unsigned char)ch;
+		if (ch == '\\' && (low = parseEscape(c, set)) < 0) {
+			continue;
+		}
+		int high = low;
+		if (c->end - c->at >= 2 && c->at[0] == '-' && c->at[1] != ']') {
+			c->at++;
+			ch   = *c->at++;
+			high = (unsigned char)ch;
+			uint8_t escaped[32];
+			if (ch == '\\' && (high = parseEscape(c, escaped)) < 0) {
+				fail(c, "invalid range");
+			}
+			if (high < low) {
+				fail(c, "invalid range");
+			}
+		}
+		setRange(set, low, high);
+	}
+	if (negate) {
+		for (int i = 0; i < 32; i++) {
+			set[i] = (uint8_t)~set[i];
+		}
+	}
+	return newSet(c, set);
+}
+
+//Reads a counted repeat after the '{', or returns false and reads nothing if it isn't one
+//so the brace is a literal
+static bool_t parseCount(compiler_t *c, int32_t *min, int32_t *max) {
+	const char *at = c->at;
+	int32_t counts[2] = { -1, -1 };
+	int n = 0;
+	for (;;) {
+		if (at == c->end) return false;
+		if (*at >= '0' && *at <= '9') {
+			int32_t count = counts[n] < 0 ? 0 : counts[n];
+			count = count * 10 + (*at++ - '0');
+			counts[n] = count > REGEX_MAX_REPEAT ? REGEX_MAX_REPEAT + 1 : count;
+		} else if (*at == ',' && n == 0) {
+			n = 1;
+			at++;
+		} else if (*at == '}') {
+			at++;
+			break;
+		} else {
+			return false;
+		}
+	}
+	if (counts[0] < 0) return false;
+	*min = counts[0];
+	*max = n == 0 ? counts[0] : counts[1];
+	if (*min > REGEX_MAX_REPEAT || *max > REGEX_MAX_REPEAT) {
+		fail(c, "repeat count too large");
+	}
+	if (*max >= 0 && *max < *min) {
+		fail(c, "invalid repeat count");
+	}
+	c->at = at;
+	return true;
+}
+
+static bool_t parseQuantifier(compiler_t *c, int32_t *min, int32_t *max) {
+	if (c->at == c->end) return false;
+	switch (*c->at) {
+		case '*': *min = 0; *max = -1; break;
+		case '+': *min = 1; *max = -1; break;
+		case '?': *min = 0; *max = 1;  break;
+		case '{':
+			c->at++;
+			if (parseCount(c, min, max)) return true;
+			c->at--;
+			return false;
+		default:
+			return false;
+	}
+	c->at++;
+	return true;
+}
+
+static int32_t parseAlternation(compiler_t *c);
+
+static int32_t parseAtom(compiler_t *c) {
+	char ch = *c->at++;
+	switch (ch) {
+		case '(': {
+			bool_t capture = true;
+			if (c->at < c->end && *c->at == '?') {
+				if (c->end - c->at < 2 || c->at[1] != ':') {
+					fail(c, "unknown group flag");
+				}
+				capture = false;
+				c->at += 2;
+			}
+			if (++c->depth > REGEX_MAX_DEPTH) {
+				fail(c, "groups nested too deeply");
+			}
+			uint32_t group = capture ? c->regex->numGroups++ : 0;
+			int32_t inner = parseAlternation(c);
+			if (c->at == c->end) {
+				fail(c, "missing )");
+			}
+			c->at++;
+			c->depth--;
+			if (!capture) {
+				return inner;
+			}
+			int32_t node = newNode(c, NODE_GROUP);
+			c->nodes[node].a = inner;
+			c->nodes[node].x = group;
+			return node;
+		}
+		case '[':
+			return parseClass(c);
+		case '.': {
+			uint8_t set[32];
+			memset(set, 0xff, sizeof(set));
+			set['\n' >> 3] &= (uint8_t)~(1 << ('\n' & 7));
+			return newSet(c, set);
+		}
+		case '^':
+			return newNode(c, NODE_BOL);
+		case '$':
+			return newNode(c, NODE_EOL);
+		case '\\': {
+			uint8_t set[32] = { 0 };
+			int byte = parseEscape(c, set);
+			return byte >= 0 ? newByte(c, (unsigned char)byte) : newSet(c, set);
+		}
+		case '*': case '+': case '?':
+			fail(c, "nothing to repeat");
+			return -1;
+		default:
+			return newByte(c, (unsigned char)ch);
+	}
+}
+
+static int32_t parseRepeat(compiler_t *c) {
+	int32_t atom = parseAtom(c);
+	int32_t min, max;
+	if (!parseQuantifier(c, &min, &max)) {
+		return atom;
+	}
+	int32_t node = newNode(c, NODE_REPEAT);
+	c->nodes[node].a      = atom;
+	c->nodes[node].min    = min;
+	c->nodes[node].max    = max;
+	c->nodes[node].greedy = true;
+	if (c->at < c->end && *c->at == '?') {
+		c->nodes[node].greedy = false;
+		c->at++;
+	}
+	const char *at = c->at;
+	if (parseQuantifier(c, &min, &max)) {
+		c->at = at;
+		fail(c, "multiple repeat");
+	}
+	return node;
+}
+
+static int32_t parseConcatenation(compiler_t *c) {
+	int32_t head = -1, tail = -1;
+	while (c->at < c->end && *c->at != '|' && *c->at != ')') {
+		int32_t node = parseRepeat(c);
+		if (head < 0) {
+			head = node;
+		} else {
+			c->nodes[tail].next = node;
+		}
+		tail = node;
+	}
+	if (head < 0) {
+		return newNode(c, NODE_EMPTY);
+	}
+	if (head == tail) {
+		return head;
+	}
+	int32_t node = newNode(c, NODE_CAT);
+	c->nodes[node].a = head;
+	return node;
+}
+
+static int32_t parseAlternation(compiler_t *c) {
+	int32_t first = parseConcatenation(c);
+	if (c->at == c->end || *c->at != '|') {
+		return first;
+	}
+	int32_t tail = first;
+	while (c->at < c->end && *c->at == '|') {
+		c->at++;
+		int32_t node = parseConcatenation(c);
+		c->nodes[tail].next = node;
+		tail = node;
+	}
+	int32_t node = newNode(c, NODE_ALT);
+	c->nodes[node].a = first;
+	return node;
+}
+
+//Code
+
+static uint32_t emit(compiler_t *c, regexOp_t op, uint32_t x, uint32_t y) {
+	winterState_t *state = c->state;
+	regex_t *regex = c->regex;
+	if (regex->numCode == REGEX_MAX_CODE) {
+		fail(c, "pattern too large");
+	}
+	if (regex->numCode == c->capacityCode) {
+		c->capacityCode = c->capacityCode == 0 ? 32 : c->capacityCode * 2;
+		regex->code = REALLOC(regex->code, c->capacityCode * sizeof(regexInst_t));
+	}
+	regex->code[regex->numCode] = (regexInst_t){ op, x, y };
+	return regex->numCode++;
+}
+
+//Points the split at 'pc' at 'first' before 'second'
+static void patchSplit(compiler_t *c, uint32_t pc, uint32_t first, uint32_t second, bool_t greedy) {
+	c->regex->code[pc].x = greedy ? first : second;
+	c->regex->code[pc].y = greedy ? second : first;
+}
+
+static void generate(compiler_t *c, int32_t index) {
+	if (++c->work > REGEX_MAX_WORK) {
+		fail(c, "pattern too large");
+	}
+	regex_t *regex = c->regex;
+	node_t node = c->nodes[index];
+	switch ((nodeType_t)node.type) {
+		case NODE_EMPTY:
+			break;
+		case NODE_SET:
+			emit(c, REGEX_BYTE, node.x, 0);
+			break;
+		case NODE_BOL:
+			emit(c, REGEX_BOL, 0, 0);
+			break;
+		case NODE_EOL:
+			emit(c, REGEX_EOL, 0, 0);
+			break;
+		case NODE_CAT:
+			for (int32_t child = node.a; child >= 0; child = c->nodes[child].next) {
+				generate(c, child);
+			}
+			break;
+		case NODE_ALT: {
+			//The jumps to the end are chained through their targets until it's known
+			uint32_t chain = 0;
+			for (int32_t child = node.a; child >= 0; child = c->nodes[child].next) {
+				if (c->nodes[child].next < 0) {
+					generate(c, child);
+					break;
+				}
+				uint32_t split = emit(c, REGEX_SPLIT, 0, 0);
+				generate(c, child);
+				chain = emit(c, REGEX_JMP, chain, 0) + 1;
+				patchSplit(c, split, split + 1, regex->numCode, true);
+			}
+			while (chain != 0) {
+				uint32_t next = regex->code[chain - 1].x;
+				regex->code[chain - 1].x = regex->numCode;
+				chain = next;
+			}
+			break;
+		}
+		case NODE_GROUP:
+			emit(c, REGEX_SAVE, node.x * 2, 0);
+			generate(c, node.a);
+			emit(c, REGEX_SAVE, node.x * 2 + 1, 0);
+			break;
+		case NODE_REPEAT: {
+			int32_t copies = node.max < 0 && node.min > 0 ? node.min - 1 : node.min;
+			for (int32_t i = 0; i < copies; i++) {
+				generate(c, node.a);
+			}
+			if (node.max < 0 && node.min > 0) {
+				//x+ loops back over x
+				uint32_t body = regex->numCode;
+				generate(c, node.a);
+				uint32_t loop = emit(c, REGEX_LOOP, 0, 0);
+				patchSplit(c, loop, body, loop + 1, node.greedy);
+			} else if (node.max < 0) {
+				//x* is x+ behind a split that skips it
+				uint32_t split = emit(c, REGEX_SPLIT, 0, 0);
+				generate(c, node.a);
+				uint32_t loop = emit(c, REGEX_LOOP, 0, 0);
+				patchSplit(c, split, split + 1, loop + 1, node.greedy);
+				patchSplit(c, loop, split + 1, loop + 1, node.greedy);
+			} else {
+				for (int32_t i = node.min; i < node.max; i++) {
+					uint32_t split = emit(c, REGEX_SPLIT, 0, 0);
+					generate(c, node.a);
+					patchSplit(c, split, split + 1, regex->numCode, node.greedy);
+				}
+			}
+			break;
+		}
+	}
+}
+
+//Splits the bytes into classes that every set either holds all of or none of
+static void findClasses(regex_t *regex) {
+	memset(regex->classes, 0, sizeof(regex->classes));
+	regex->numClasses = 1;
+	for (uint32_t s = 0; s < regex->numSets; s++) {
+		int16_t inside[256], outside[256];
+		memset(inside,  0xff, sizeof(inside));
+		memset(outside, 0xff, sizeof(outside));
+		uint32_t count = 0;
+		for (int b = 0; b < 256; b++) {
+			int16_t *map = inSet(regex->sets[s], (unsigned char)b) ? inside : outside;
+			uint8_t old = regex->classes[b];
+			if (map[old] < 0) {
+				map[old] = (int16_t)count++;
+			}
+			regex->classes[b] = (uint8_t)map[old];
+		}
+		regex->numClasses = count;
+	}
+	for (int b = 255; b >= 0; b--) {
+		regex->classByte[regex->classes[b]] = (uint8_t)b;
+	}
+}
+
+//The bytes on the path from the start that has no branches
+static void findPrefix(winterState_t *state, regex_t *regex) {
+	size_t length = 0;
+	char bytes[64];
+	for (uint32_t pc = 0; pc < regex->numCode && length < sizeof(bytes);) {
+		regexInst_t inst = regex->code[pc];
+		if (inst.op == REGEX_SAVE) {
+			pc++;
+			continue;
+		}
+		if (inst.op != REGEX_BYTE) {
+			break;
+		}
+		int found = -1, count = 0;
+		for (int b = 0; b < 256 && count < 2; b++) {
+			if (inSet(regex->sets[inst.x], (unsigned char)b)) {
+				found = b;
+				count++;
+			}
+		}
+		if (count != 1) {
+			break;
+		}
+		bytes[length++] = (char)found;
+		pc++;
+	}
+	if (length > 0) {
+		regex->prefix = MALLOC(length);
+		memcpy(regex->prefix, bytes, length);
+		regex->prefixLength = length;
+	}
+}
+
+void _winter_regexDelete(winterState_t *state, regex_t *regex) {
+	if (regex->pattern != NULL)     FREE(regex->pattern);
+	if (regex->code != NULL)        FREE(regex->code);
+	if (regex->sets != NULL)        FREE(regex->sets);
+	if (regex->prefix != NULL)      FREE(regex->prefix);
+	if (regex->pcs != NULL)         FREE(regex->pcs);
+	if (regex->first != NULL)       FREE(regex->first);
+	if (regex->flags != NULL)       FREE(regex->flags);
+	if (regex->transitions != NULL) FREE(regex->transitions);
+	if (regex->buckets != NULL)     FREE(regex->buckets);
+	if (regex->mark != NULL)        FREE(regex->mark);
+	if (regex->work != NULL)        FREE(regex->work);
+	if (regex->vm != NULL)          FREE(regex->vm);
+	FREE(regex);
+}
+
+regex_t *_winter_regexCompile(winterState_t *state, const char *pattern, size_t length, const char **error) {
+	compiler_t c = { state };
+	c.at  = pattern;
+	c.end = pattern + length;
+	memset(c.single, 0xff, sizeof(c.single));
+	regex_t *volatile out = NULL;
+	jmp_buf *previous = state->errorJump;
+	state->errorJump = &c.jump;
+	if (setjmp(c.jump) == 0) {
+		c.regex = MALLOC(sizeof(regex_t));
+		memset(c.regex, 0, sizeof(regex_t));
+		regex_t *regex = c.regex;
+		regex->numGroups = 1;
+		int32_t root = parseAlternation(&c);
+		if (c.at != c.end) {
+			fail(&c, "unmatched )");
+		}
+		emit(&c, REGEX_SAVE, 0, 0);
+		generate(&c, root);
+		emit(&c, REGEX_SAVE, 1, 0);
+		emit(&c, REGEX_MATCH, 0, 0);
+		
+		findClasses(regex);
+		findPrefix(state, regex);
+		uint32_t pc = 0;
+		while (regex->code[pc].op == REGEX_SAVE) pc++;
+		regex->anchored = regex->code[pc].op == REGEX_BOL;
+		regex->pattern = MALLOC(length + 1);
+		memcpy(regex->pattern, pattern, length);
+		regex->pattern[length] = '\0';
+		regex->length = length;
+		regex->mark = MALLOC(regex->numCode * sizeof(uint32_t));
+		regex->work = MALLOC(regex->numCode * sizeof(uint32_t));
+		memset(regex->mark, 0, regex->numCode * sizeof(uint32_t));
+		regex->buckets = MALLOC(REGEX_MAX_STATES * 2 * sizeof(uint32_t));
+		memset(regex->buckets, 0, REGEX_MAX_STATES * 2 * sizeof(uint32_t));
+		regex->startBegin = -1;
+		regex->startOther = -1;
+		out = regex;
+	}
+	state->errorJump = previous;
+	if (c.nodes != NULL) FREE(c.nodes);
+	if (out == NULL && c.regex != NULL) {
+		_winter_regexDelete(state, c.regex);
+	}
+	*error = c.error;
+	return out;
+}
+
+//Lazy DFA
+
+static void nextGeneration(regex_t *regex) {
+	if (++regex->generation == 0) {
+		memset(regex->mark, 0, regex->numCode * sizeof(uint32_t));
+		regex->generation = 1;
+	}
+}
+
+//Marks the instructions reachable from 'pc' without reading a byte
+static void closure(regex_t *regex, uint32_t from, bool_t atBeginning, bool_t atEnd) {
+	uint32_t *stack = regex->work;
+	uint32_t top = 0;
+	if (regex->mark[from] == regex->generation) {
+		return;
+	}
+	regex->mark[from] = regex->generation;
+	stack[top++] = from;
+	while (top > 0) {
+		uint32_t pc = stack[--top];
+		regexInst_t inst = regex->code[pc];
+		uint32_t next[2], count = 0;
+		switch ((regexOp_t)inst.op) {
+			case REGEX_JMP:   next[count++] = inst.x; break;
+			case REGEX_SPLIT:
+			case REGEX_LOOP:  next[count++] = inst.x; next[count++] = inst.y; break;
+			case REGEX_SAVE:  next[count++] = pc + 1; break;
+			case REGEX_BOL:   if (atBeginning) next[count++] = pc + 1; break;
+			case REGEX_EOL:   if (atEnd) next[count++] = pc + 1; break;
+			default:          break;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			if (regex->mark[next[i]] != regex->generation) {
+				regex->mark[next[i]] = regex->generation;
+				stack[top++] = next[i];
+			}
+		}
+	}
+}
+
+static void resetStates(regex_t *regex) {
+	regex->numStates  = 0;
+	regex->numPcs     = 0;
+	regex->startBegin = -1;
+	regex->startOther = -1;
+	memset(regex->buckets, 0, REGEX_MAX_STATES * 2 * sizeof(uint32_t));
+}
+
+//Returns the state of the instructions marked in this generation that wait for a byte or
+//the end, adding it if it's new, or -1 if the states are full and have been dropped
+static int32_t intern(winterState_t *state, regex_t *regex, bool_t atBeginning) {
+	if (regex->capacityPcs - regex->numPcs < regex->numCode) {
+		regex->capacityPcs = regex->capacityPcs * 2 + regex->numCode;
+		regex->pcs = REALLOC(regex->pcs, regex->capacityPcs * sizeof(uint32_t));
+	}
+	uint32_t *pcs = regex->pcs + regex->numPcs;
+	uint32_t count = 0, hash = 2166136261u;
+	bool_t eol = false;
+	for (uint32_t pc = 0; pc < regex->numCode; pc++) {
+		uint32_t op = regex->code[pc].op;
+		if (regex->mark[pc] == regex->generation && (op == REGEX_BYTE || op == REGEX_EOL || op == REGEX_MATCH)) {
+			pcs[count++] = pc;
+			hash = (hash ^ pc) * 16777619u;
+			eol |= op == REGEX_EOL;
+		}
+	}
+	
+	uint32_t mask = REGEX_MAX_STATES * 2 - 1;
+	uint32_t bucket = hash & mask;
+	for (; regex->buckets[bucket] != 0; bucket = (bucket + 1) & mask) {
+		uint32_t other = regex->buckets[bucket] - 1;
+		uint32_t first = regex->first[other];
+		if (regex->first[other + 1] - first == count &&
+			memcmp(regex->pcs + first, pcs, count * sizeof(uint32_t)) == 0) {
+			return (int32_t)other;
+		}
+	}
+	if (regex->numStates == REGEX_MAX_STATES) {
+		resetStates(regex);
+		return -1;
+	}
+	
+	uint8_t flags = count == 0 ? REGEX_STATE_DEAD : 0;
+	if (count > 0 && regex->code[pcs[count - 1]].op == REGEX_MATCH) {
+		flags = REGEX_STATE_MATCH | REGEX_STATE_MATCH_END;
+	} else if (eol) {
+		nextGeneration(regex);
+		for (uint32_t i = 0; i < count; i++) {
+			if (regex->code[pcs[i]].op == REGEX_EOL) {
+				closure(regex, pcs[i], atBeginning, true);
+			}
+		}
+		if (regex->mark[regex->numCode - 1] == regex->generation) {
+			flags = REGEX_STATE_MATCH_END;
+		}
+	}
+	
+	uint32_t index = regex->numStates;
+	if (index + 1 >= regex->capacityStates) {
+		regex->capacityStates = regex->capacityStates == 0 ? 16 : regex->capacityStates * 2;
+		regex->first       = REALLOC(regex->first,       (regex->capacityStates + 1) * sizeof(uint32_t));
+		regex->flags       = REALLOC(regex->flags,       regex->capacityStates * sizeof(uint8_t));
+		regex->transitions = REALLOC(regex->transitions, regex->capacityStates * regex->numClasses * sizeof(int32_t));
+	}
+	memset(regex->transitions + index * regex->numClasses, 0xff, regex->numClasses * sizeof(int32_t));
+	regex->flags[index]     = flags;
+	regex->first[index]     = regex->numPcs;
+	regex->numPcs          += count;
+	regex->first[index + 1] = regex->numPcs;
+	regex->buckets[bucket]  = index + 1;
+	regex->numStates++;
+	return (int32_t)index;
+}
+
+static int32_t startState(winterState_t *state, regex_t *regex, bool_t atBeginning) {
+	int32_t *start = atBeginning ? &regex->startBegin : &regex->startOther;
+	if (*start < 0) {
+		nextGeneration(regex);
+		closure(regex, 0, atBeginning, false);
+		*start = intern(state, regex, atBeginning);
+		if (*start >= 0 && !atBeginning) {
+			regex->flags[*start] |= REGEX_STATE_START;
+		}
+	}
+	return *start;
+}
+
+//Returns the state after reading a byte of the class, or -1 if the states were dropped
+static int32_t transition(winterState_t *state, regex_t *regex, int32_t from, uint32_t class) {
+	unsigned char byte = regex->classByte[class];
+	nextGeneration(regex);
+	for (uint32_t i = regex->first[from]; i < regex->first[from + 1]; i++) {
+		regexInst_t inst = regex->code[regex->pcs[i]];
+		if (inst.op == REGEX_BYTE && inSet(regex->sets[inst.x], byte)) {
+			closure(regex, regex->pcs[i] + 1, false, false);
+		}
+	}
+	//A match can start at every byte
+	closure(regex, 0, false, false);
+	int32_t to = intern(state, regex, false);
+	if (to >= 0) {
+		regex->transitions[(uint32_t)from * regex->numClasses + class] = to;
+	}
+	return to;
+}
+
+//Offset of the first match of the prefix at or after 'from', or SIZE_MAX
+static size_t nextPrefix(const regex_t *regex, const unsigned char *subject, size_t length, size_t from) {
+	size_t n = regex->prefixLength;
+	while (length >= n && from <= length - n) {
+		const unsigned char *at = memchr(subject + from, (unsigned char)regex->prefix[0], length - n + 1 - from);
+		if (at == NULL) {
+			break;
+		}
+		if (memcmp(at + 1, regex->prefix + 1, n - 1) == 0) {
+			return (size_t)(at - subject);
+		}
+		from = (size_t)(at - subject) + 1;
+	}
+	return SIZE_MAX;
+}
+
+//Returns 1 if there's a match, 0 if not and -1 if the states filled up
+static int search(winterState_t *state, regex_t *regex, const unsigned char *subject, size_t length, size_t start) {
+	int32_t current = startState(state, regex, start == 0);
+	int32_t other   = startState(state, regex, false);
+	if (current < 0 || other < 0) {
+		return -1;
+	}
+	for (size_t i = start;; i++) {
+		uint8_t flags = regex->flags[current];
+		if (flags != 0) {
+			if (flags & REGEX_STATE_MATCH) {
+				return 1;
+			}
+			if (flags & REGEX_STATE_DEAD) {
+				return 0;
+			}
+			if ((flags & REGEX_STATE_START) && regex->prefixLength > 0) {
+				//Threads here all wait for the prefix
+				i = nextPrefix(regex, subject, length, i);
+				if (i == SIZE_MAX) {
+					return 0;
+				}
+			}
+		}
+		if (i == length) {
+			return (flags & REGEX_STATE_MATCH_END) != 0;
+		}
+		uint32_t class = regex->classes[subject[i]];
+		int32_t next = regex->transitions[(uint32_t)current * regex->numClasses + class];
+		if (next < 0 && (next = transition(state, regex, current, class)) < 0) {
+			return -1;
+		}
+		current = next;
+	}
+}
+
+//Pike VM
+
+typedef struct threads_t {
+	uint32_t *dense;  //instructions in the order their threads were added
+	uint32_t *sparse; //position of each instruction in dense
+	int64_t  *caps;   //capture slots of each position
+	uint32_t  count;
+} threads_t;
+
+typedef struct regexVm_t {
+	threads_t lists[2];
+	int64_t  *caps;  //of the thread being added
+	int64_t  *match; //of the best match so far, for callers without their own
+	struct {
+		uint32_t pc;
+		int32_t  slot; //to put 'value' back in, or -1 to add the thread at 'pc'
+		int64_t  value;
+	} *stack;
+} regexVm_t;
+
+static regexVm_t *getVm(winterState_t *state, regex_t *regex) {
+	if (regex->vm == NULL) {
+		size_t n = regex->numCode, slots = regex->numGroups * 2;
+		size_t size = sizeof(regexVm_t) + 2 * (2 * n * sizeof(uint32_t) + n * slots * sizeof(int64_t)) +
+			2 * slots * sizeof(int64_t) + 2 * n * sizeof(regex->vm->stack[0]);
+		regexVm_t *vm = MALLOC(size);
+		memset(vm, 0, size);
+		vm->stack = (void*)(vm + 1);
+		vm->caps  = (int64_t*)(vm->stack + 2 * n);
+		vm->match = vm->caps + slots;
+		unsigned char *at = (unsigned char*)(vm->match + slots);
+		for (int i = 0; i < 2; i++) {
+			vm->lists[i].caps   = (int64_t*)at;
+			at += n * slots * sizeof(int64_t);
+			vm->lists[i].dense  = (uint32_t*)at;
+			at += n * sizeof(uint32_t);
+			vm->lists[i].sparse = (uint32_t*)at;
+			at += n * sizeof(uint32_t);
+		}
+		regex->vm = vm;
+	}
+	return regex->vm;
+}
+
+//Adds the threads at 'pc' and where it leads without reading a byte, lowest priority first,
+//with vm->caps as their captures
+static void addThread(regex_t *regex, regexVm_t *vm, threads_t *list, uint32_t pc, size_t at, size_t length) {
+	size_t slots = regex->numGroups * 2;
+	int64_t *caps = vm->caps;
+	uint32_t top = 0;
+	vm->stack[top].pc   = pc;
+	vm->stack[top].slot = -1;
+	top++;
+	while (top > 0) {
+		top--;
+		if (vm->stack[top].slot >= 0) {
+			caps[vm->stack[top].slot] = vm->stack[top].value;
+			continue;
+		}
+		for (pc = vm->stack[top].pc;;) {
+			uint32_t position = list->sparse[pc];
+			if (position < list->count && list->dense[position] == pc) {
+				if (regex->code[pc].op != REGEX_LOOP) {
+					break;
+				}
+				pc++;
+				continue;
+			}
+			list->sparse[pc] = list->count;
+			list->dense[list->count++] = pc;
+			regexInst_t inst = regex->code[pc];
+			if (inst.op == REGEX_JMP) {
+				pc = inst.x;
+			} else if (inst.op == REGEX_SPLIT || inst.op == REGEX_LOOP) {
+				vm->stack[top].pc   = inst.y;
+				vm->stack[top].slot = -1;
+				top++;
+				pc = inst.x;
+			} else if (inst.op == REGEX_SAVE) {
+				vm->stack[top].slot  = (int32_t)inst.x;
+				vm->stack[top].value = caps[inst.x];
+				top++;
+				caps[inst.x] = (int64_t)at;
+				pc++;
+			} else if ((inst.op == REGEX_BOL && at == 0) || (inst.op == REGEX_EOL && at == length)) {
+				pc++;
+			} else {
+				if (inst.op == REGEX_BYTE || inst.op == REGEX_MATCH) {
+					memcpy(list->caps + (size_t)(list->count - 1) * slots, caps, slots * sizeof(int64_t));
+				}
+				break;
+			}
+		}
+	}
+}
+
+static bool_t run(winterState_t *state, regex_t *regex, const unsigned char *subject, size_t length, size_t start, int64_t *caps) {
+	regexVm_t *vm = getVm(state, regex);
+	size_t slots = regex->numGroups * 2;
+	threads_t *current = &vm->lists[0], *next = &vm->lists[1];
+	current->count = 0;
+	bool_t matched = false;
+	for (size_t i = start;; i++) {
+		if (!matched && (i == 0 || !regex->anchored)) {
+			if (current->count == 0 && regex->prefixLength > 0) {
+				i = nextPrefix(regex, subject, length, i);
+				if (i == SIZE_MAX) {
+					break;
+				}
+			}
+			//A match starting here comes after those that started before
+			for (size_t s = 0; s < slots; s++) {
+				vm->caps[s] = -1;
+			}
+			addThread(regex, vm, current, 0, i, length);
+		}
+		if (current->count == 0) {
+			break;
+		}
+		next->count = 0;
+		for (uint32_t t = 0; t < current->count; t++) {
+			regexInst_t inst = regex->code[current->dense[t]];
+			if (inst.op == REGEX_BYTE) {
+				if (i < length && inSet(regex->sets[inst.x], subject[i])) {
+					memcpy(vm->caps, current->caps + t * slots, slots * sizeof(int64_t));
+					addThread(regex, vm, next, current->dense[t] + 1, i + 1, length);
+				}
+			} else if (inst.op == REGEX_MATCH) {
+				//Threads after this one would give a match of lower priority
+				memcpy(caps, current->caps + t * slots, slots * sizeof(int64_t));
+				matched = true;
+				break;
+			}
+		}
+		if (i == length) {
+			break;
+		}
+		threads_t *swap = current;
+		current = next;
+		next    = swap;
+	}
+	return matched;
+}
+
+bool_t _winter_regexTest(winterState_t *state, regex_t *regex, const char *subject, size_t length, size_t start) {
+	if (start > length) {
+		return false;
+	}
+	int found = search(state, regex, (const unsigned char*)subject, length, start);
+	if (found >= 0) {
+		return found != 0;
+	}
+	int64_t *caps = getVm(state, regex)->match;
+	return run(state, regex, (const unsigned char*)subject, length, start, caps);
+}
+
+bool_t _winter_regexMatch(winterState_t *state, regex_t *regex, const char *subject, size_t length, size_t start, int64_t *caps) {
+	if (start > length) {
+		return false;
+	}
+	if (search(state, regex, (const unsigned char*)subject, length, start) == 0) {
+		return false;
+	}
+	return run(state, regex, (const unsigned char*)subject, length, start, caps);
+}
+
+//Cache
+
+regex_t *_winter_regexGet(winterState_t *state, wstring_t *pattern, object_t *error) {
+	if (state->regexes == NULL) {
+		state->regexes = MALLOC(REGEX_CACHE * sizeof(regex_t*));
+		memset(state->regexes, 0, REGEX_CACHE * sizeof(regex_t*));
+	}
+	regex_t **slot = &state->regexes[_winter_stringHash(pattern) & (REGEX_CACHE - 1)];
+	regex_t *regex = *slot;
+	if (regex != NULL && regex->length == pattern->length && memcmp(regex->pattern, pattern->data, pattern->length) == 0) {
+		return regex;
+	}
+	const char *message;
+	regex = _winter_regexCompile(state, pattern->data, pattern->length, &message);
+	if (regex == NULL) {
+		if (message == NULL) {
+			*error = (object_t){ TYPE_ERROR, { .string = state->memoryError } };
+		} else {
+			_winter_objectNewError(state, error, "invalid pattern: %s", message);
+		}
+		return NULL;
+	}
+	if (*slot != NULL) {
+		_winter_regexDelete(state, *slot);
+	}
+	*slot = regex;
+	return regex;
+}
+
+void _winter_regexFree(winterState_t *state) {
+	if (state->regexes == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < REGEX_CACHE; i++) {
+		if (state->regexes[i] != NULL) {
+			_winter_regexDelete(state, state->regexes[i]);
+		}
+	}
+	FREE(state->regexes);
+	state->regexes = NULL;
+}
+
+//Natives
+
+//Checks the pattern, subject and optional start of a search and returns the pattern
+static regex_t *searchArguments(winterState_t *state, winterValue_t *args, int argc, const char *name, size_t *start) {
+	if (argc < 2 || argc > 3 || args[0].type != TYPE_STRING || args[1].type != TYPE_STRING ||
+		(argc == 3 && (args[2].type != TYPE_INT || args[2].integer < 0))) {
+		_winter_objectNewError(state, &args[0], "%s expects a pattern, a string and optionally a start", name);
+		return NULL;
+	}
+	*start = argc == 3 ? (size_t)args[2].integer : 0;
+	return _winter_regexGet(state, args[0].string, &args[0]);
+}
+
+//match(pattern, s[, start]) returns an int array of the start and end of the match and of
+//each group, or null
+static int matchNative(winterState_t *state, winterValue_t *args, int argc) {
+	size_t start;
+	regex_t *regex = searchArguments(state, args, argc, "match", &start);
+	if (regex == NULL) {
+		return 1;
+	}
+	//The array is only made for a match, once made the zct holds it
+	wstring_t *subject = args[1].string;
+	int64_t *caps = getVm(state, regex)->match;
+	if (_winter_regexMatch(state, regex, subject->data, subject->length, start, caps)) {
+		array_t *spans = _winter_arrayAlloc(state, ARRAY_INT64, regex->numGroups * 2);
+		memcpy(spans->data, caps, regex->numGroups * 2 * sizeof(int64_t));
+		args[0] = (object_t){ TYPE_ARRAY, { .pointer = spans } };
+	} else {
+		args[0] = (object_t){ TYPE_NULL };
+	}
+	return 1;
+}
+
+//matches(pattern, s[, start]) returns 1 if there's a match and 0 if not
+static int matchesNative(winterState_t *state, winterValue_t *args, int argc) {
+	size_t start;
+	regex_t *regex = searchArguments(state, args, argc, "matches", &start);
+	if (regex == NULL) {
+		return 1;
+	}
+	wstring_t *subject = args[1].string;
+	bool_t found = _winter_regexTest(state, regex, subject->data, subject->length, start);
+	args[0] = (object_t){ TYPE_INT, { .integer = found } };
+	return 1;
+}
+
+//substr(s, from[, to]) returns the bytes from 'from' up to 'to', the end by default
+static int substrNative(winterState_t *state, winterValue_t *args, int argc) {
+	if (argc < 2 || argc > 3 || args[0].type != TYPE_STRING || args[1].type != TYPE_INT ||
+		(argc == 3 && args[2].type != TYPE_INT)) {
+		_winter_objectNewError(state, &args[0], "substr expects a string and one or two ints");
+		return 1;
+	}
+	wstring_t *string = args[0].string;
+	winterInt_t from = args[1].integer;
+	winterInt_t to   = argc == 3 ? args[2].integer : (winterInt_t)string->length;
+	if (from < 0 || to < from || (size_t)to > string->length) {
+		_winter_objectNewError(state, &args[0], "substr range out of bounds");
+		return 1;
+	}
+	wstring_t *out = _winter_stringCreateSize(state, string->data + from, (size_t)(to - from));
+	args[0] = (object_t){ TYPE_STRING, { .string = out } };
+	return 1;
+}
+
+void winterOpenRegex(winterState_t *state) {
+	winterRegister(state, "match",   matchNative,   -1);
+	winterRegister(state, "matches", matchesNative, -1);
+	winterRegister(state, "substr",  substrNative,  -1);
+}
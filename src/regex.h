@@ -0,0 +1,98 @@
+#ifndef REGEX_H
+#define REGEX_H
+
+#include "wtype.h"
+#include "object.h"
+
+//Regular expressions, see winterOpenRegex
+//
+//A pattern compiles to a program of the instructions below, a Thompson NFA, which the
+//Pike VM runs with one thread per instruction, all of them a byte at a time, so a match
+//takes time linear in the subject whatever the pattern. Searches that only need to know
+//whether there's a match run on a DFA built lazily from the program instead. Its states
+//are the sets of instructions the threads can be waiting at, found and given transitions
+//the first time a search reaches them, and kept with the pattern for later searches. Bytes
+//no instruction tells apart share a byte class, a column of the transition table. Finding
+//the groups of a match runs the DFA first, so subjects that don't match never reach the VM.
+//When every match starts with the same bytes both skip ahead to them with memchr
+//
+//Compiled patterns are cached per state by their text, in REGEX_CACHE slots picked by hash
+typedef enum regexOp_t {
+	REGEX_BYTE,  //x is the index of a set of bytes
+	REGEX_SPLIT, //x is tried before y
+	REGEX_LOOP,  //a split ending a loop, reached again by an iteration that read nothing it
+	             //goes on to the next instruction, leaving the loop as Python's re does
+	REGEX_JMP,   //to x
+	REGEX_SAVE,  //the position in capture slot x
+	REGEX_BOL,   //start of the subject
+	REGEX_EOL,   //end of the subject
+	REGEX_MATCH
+} regexOp_t;
+
+typedef struct regexInst_t {
+	uint32_t op; //regexOp_t
+	uint32_t x, y;
+} regexInst_t;
+
+#define REGEX_CACHE      64
+#define REGEX_MAX_CODE   4096 //instructions, counted repeats are written out in full
+#define REGEX_MAX_REPEAT 1000
+#define REGEX_MAX_STATES 512  //DFA states before the cache is dropped and the VM used
+
+typedef struct regex_t {
+	char    *pattern;
+	size_t   length;
+	
+	regexInst_t *code;
+	uint32_t     numCode;
+	uint8_t    (*sets)[32];
+	uint32_t     numSets;
+	uint32_t     numGroups; //including the whole match as group 0
+	
+	uint8_t  classes[256];     //byte class of each byte
+	uint8_t  classByte[256];   //a byte of each class
+	uint32_t numClasses;
+	
+	char    *prefix; //bytes every match starts with
+	size_t   prefixLength;
+	bool_t   anchored; //starts with ^
+	
+	//Lazy DFA, the instructions of state i are pcs[first[i]] to pcs[first[i + 1]]
+	uint32_t *pcs;
+	uint32_t *first;
+	uint8_t  *flags;       //REGEX_STATE_* of each state
+	int32_t  *transitions; //numClasses per state, -1 until known
+	uint32_t *buckets;     //state index + 1 by the hash of its instructions, 0 if free
+	uint32_t  numStates, capacityStates;
+	uint32_t  numPcs, capacityPcs;
+	int32_t   startBegin; //at the start of the subject, or -1 until known
+	int32_t   startOther;
+	
+	//Scratch of the searches
+	uint32_t *mark; //generation each instruction was last reached in
+	uint32_t  generation;
+	uint32_t *work;
+	struct regexVm_t *vm; //thread lists of the VM, made on first use
+} regex_t;
+
+enum {
+	REGEX_STATE_MATCH     = 1, //a match ends before the next byte
+	REGEX_STATE_MATCH_END = 2, //a match ends if there's no next byte
+	REGEX_STATE_DEAD      = 4, //no match can end after it
+	REGEX_STATE_START     = 8  //startOther, threads are only where a match starts
+};
+
+//Returns the compiled pattern, or NULL with a message in 'error'
+regex_t *_winter_regexCompile(winterState_t *state, const char *pattern, size_t length, const char **error);
+void _winter_regexDelete(winterState_t *state, regex_t *regex);
+//Returns the cached compiled pattern, compiling it on a miss, or NULL with an error value in 'error'
+regex_t *_winter_regexGet(winterState_t *state, wstring_t *pattern, object_t *error);
+//Whether any match starts at or after 'start'
+bool_t _winter_regexTest(winterState_t *state, regex_t *regex, const char *subject, size_t length, size_t start);
+//Finds the leftmost match starting at or after 'start' and writes the byte offsets of the
+//start and end of every group to 'caps', -1 for the groups that took no part. Returns false
+//if there's no match
+bool_t _winter_regexMatch(winterState_t *state, regex_t *regex, const char *subject, size_t length, size_t start, int64_t *caps);
+void _winter_regexFree(winterState_t *state);
+
+#endif
@@ -0,0 +1,97 @@
+#include "shape.h"
+#include "wstring.h"
+#include <string.h>
+
+static inline shape_t *shapeAlloc(winterState_t *state, shape_t *parent) {
+	uint32_t count = parent != NULL ? parent->count + 1 : 0;
+	shape_t *out = MALLOC(sizeof(shape_t) + sizeof(object_t) * count);
+	out->references = 1;
+	out->count      = count;
+	out->parent     = parent;
+	out->children   = NULL;
+	out->sibling    = NULL;
+	if (parent != NULL) {
+		memcpy(out->keys, parent->keys, sizeof(object_t) * parent->count);
+	}
+	return out;
+}
+
+void _winter_shapeInit(winterState_t *state) {
+	state->shapes = shapeAlloc(state, NULL);
+}
+void _winter_shapeFree(winterState_t *state) {
+	_winter_shapeRelease(state, state->shapes);
+	state->shapes = NULL;
+}
+
+void _winter_shapeRelease(winterState_t *state, shape_t *shape) {
+	if (--shape->references > 0) return;
+	
+	shape_t *parent = shape->parent;
+	if (parent != NULL) {
+		shape_t **link = &parent->children;
+		while (*link != shape) {
+			link = &(*link)->sibling;
+		}
+		*link = shape->sibling;
+		_winter_objectDelRef(state, &shape->keys[shape->count - 1]);
+	}
+	FREE(shape);
+	if (parent != NULL) {
+		_winter_shapeRelease(state, parent);
+	}
+}
+
+int _winter_shapeFind(const shape_t *shape, object_t *key) {
+	//Keys are usually the same string constant, so the pointers are checked first
+	for (uint32_t i = shape->count; i > 0; i--) {
+		if (shape->keys[i - 1].string == key->string) return (int)i - 1;
+	}
+	for (uint32_t i = shape->count; i > 0; i--) {
+		if (_winter_stringCompare(shape->keys[i - 1].string, key->string)) return (int)i - 1;
+	}
+	return -1;
+}
+
+shape_t *_winter_shapeAdd(winterState_t *state, shape_t *shape, object_t *key) {
+	for (shape_t *child = shape->children; child != NULL; child = child->sibling) {
+		if (_winter_stringCompare(child->keys[shape->count].string, key->string)) {
+			_winter_shapeRetain(child);
+			return child;
+		}
+	}
+	shape_t *child = shapeAlloc(state, shape);
+	child->keys[shape->count] = *_winter_objectAddRef(state, key);
+	child->sibling  = shape->children;
+	shape->children = child;
+	_winter_shapeRetain(shape);
+	return child;
+}
+
+void _winter_cacheAdd(winterState_t *state, fieldCache_t *cache, shape_t *shape, shape_t *next, uint32_t slot) {
+	size_t way = 0;
+	while (way < CACHE_WAYS && cache->shapes[way] != NULL) {
+		way++;
+	}
+	if (way == CACHE_WAYS) {
+		//The caller holds the new shapes, so releasing the old ones can't free them
+		way = cache->replace++ % CACHE_WAYS;
+		_winter_shapeRelease(state, cache->shapes[way]);
+		if (cache->next[way] != NULL) {
+			_winter_shapeRelease(state, cache->next[way]);
+		}
+	}
+	_winter_shapeRetain(shape);
+	if (next != NULL) {
+		_winter_shapeRetain(next);
+	}
+	cache->shapes[way] = shape;
+	cache->next[way]   = next;
+	cache->slots[way]  = slot;
+}
+void _winter_cacheRelease(winterState_t *state, fieldCache_t *cache) {
+	for (size_t way = 0; way < CACHE_WAYS; way++) {
+		if (cache->shapes[way] != NULL) _winter_shapeRelease(state, cache->shapes[way]);
+		if (cache->next[way] != NULL)   _winter_shapeRelease(state, cache->next[way]);
+	}
+}
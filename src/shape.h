@@ -0,0 +1,53 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include "wtype.h"
+#include "object.h"
+
+//Layout shared by tables that only have string keys, see table.h
+//
+//Shapes form a tree from the state's empty root, each child adds one key to its parent.
+//Tables that gained the same keys in the same order share a shape and keep their values
+//in key order, so a field is found by comparing the shape and loading a slot. Tables
+//with more than SHAPE_MAX_KEYS keys or any other kind of key go back to buckets
+#define SHAPE_MAX_KEYS 32
+
+//Ways of an inline cache, a site that sees more shapes replaces them in turn
+#define CACHE_WAYS 4
+
+typedef struct shape_t {
+	uint32_t references; //tables, children and inline caches using it
+	uint32_t count;
+	struct shape_t *parent;
+	struct shape_t *children; //shapes adding a key to this one
+	struct shape_t *sibling;
+	object_t keys[];          //in slot order, only the last one is counted
+} shape_t;
+
+//Inline cache of a field instruction, the shapes it saw and the slot each keeps the key in
+//A store that adds the key also records the shape the table moves to
+typedef struct fieldCache_t {
+	shape_t *shapes[CACHE_WAYS]; //counted, NULL if the way is unused
+	shape_t *next[CACHE_WAYS];   //counted, NULL unless the store adds the key
+	uint32_t slots[CACHE_WAYS];
+	uint32_t replace;            //way to use once they're all taken
+} fieldCache_t;
+
+void _winter_shapeInit(winterState_t *state);
+void _winter_shapeFree(winterState_t *state);
+
+static inline void _winter_shapeRetain(shape_t *shape) {
+	shape->references++;
+}
+void _winter_shapeRelease(winterState_t *state, shape_t *shape);
+
+//Slot of the key, -1 if the shape doesn't have it
+int _winter_shapeFind(const shape_t *shape, object_t *key);
+//Returns the shape with the string key added after the others with a reference for the caller
+shape_t *_winter_shapeAdd(winterState_t *state, shape_t *shape, object_t *key);
+
+//Records where a shape keeps the key, 'next' is retained unless it's NULL
+void _winter_cacheAdd(winterState_t *state, fieldCache_t *cache, shape_t *shape, shape_t *next, uint32_t slot);
+void _winter_cacheRelease(winterState_t *state, fieldCache_t *cache);
+
+#endif
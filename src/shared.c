@@ -0,0 +1,60 @@
+#include "shared.h"
+#include "wstring.h"
+#include <string.h>
+
+shared_t *_winter_sharedAlloc(winterState_t *state, size_t size, unsigned char **at) {
+	shared_t *shared = state->allocator(NULL, SHARED_ALIGN(sizeof(shared_t)) + size);
+	if (shared == NULL) {
+		return NULL;
+	}
+	atomic_init(&shared->references, 1);
+	shared->allocator = state->allocator;
+	*at = (unsigned char*)shared + SHARED_ALIGN(sizeof(shared_t));
+	return shared;
+}
+
+void _winter_sharedRetain(shared_t *shared) {
+	atomic_fetch_add_explicit(&shared->references, 1, memory_order_relaxed);
+}
+void _winter_sharedRelease(shared_t *shared) {
+	if (atomic_fetch_sub_explicit(&shared->references, 1, memory_order_acq_rel) == 1) {
+		shared->allocator(shared, 0);
+	}
+}
+
+void _winter_sharedHold(winterState_t *state, shared_t *shared) {
+	for (size_t i = 0; i < state->numShared; i++) {
+		if (state->shared[i] == shared) return;
+	}
+	state->shared = REALLOC(state->shared, sizeof(shared_t*) * (state->numShared + 1));
+	state->shared[state->numShared++] = shared;
+	_winter_sharedRetain(shared);
+}
+void _winter_sharedFree(winterState_t *state) {
+	for (size_t i = 0; i < state->numShared; i++) {
+		_winter_sharedRelease(state->shared[i]);
+	}
+	if (state->shared != NULL) {
+		FREE(state->shared);
+	}
+	state->shared    = NULL;
+	state->numShared = 0;
+}
+
+void *_winter_sharedTake(unsigned char **at, const void *data, size_t size) {
+	void *out = *at;
+	if (data != NULL && size > 0) {
+		memcpy(out, data, size);
+	}
+	*at += SHARED_ALIGN(size);
+	return out;
+}
+
+wstring_t *_winter_sharedString(unsigned char **at, const wstring_t *string) {
+	wstring_t *out = _winter_sharedTake(at, NULL, sizeof(wstring_t));
+	*out = (wstring_t){ REF_PERSISTENT, false, string->_type, false, string->encoding, 0, string->length, 0, NULL, NULL };
+	out->data = _winter_sharedTake(at, string->data, string->length + 1);
+	_winter_stringHash(out);
+	_winter_stringEncoding(out);
+	return out;
+}
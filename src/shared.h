@@ -0,0 +1,38 @@
+#ifndef SHARED_H
+#define SHARED_H
+
+#include "wtype.h"
+#include "object.h"
+#include <stdatomic.h>
+
+//Everything in a shared block is 8 byte aligned
+#define SHARED_ALIGN(s) (((s) + 7) & ~(size_t)7)
+
+//Block of immutable objects from the host allocator that states on any thread can use at
+//once, holding a shared chunk (see proto.h) or frozen tables (see frozen.h). Objects in
+//it count their references in the block and its strings are persistent, so using them
+//never writes to the block
+typedef struct shared_t {
+	atomic_uint   references;
+	winterAlloc_t allocator;
+} shared_t;
+
+//Returns a block with one reference, or NULL if the allocator fails
+//'*at' is pointed at the first byte after the header
+shared_t *_winter_sharedAlloc(winterState_t *state, size_t size, unsigned char **at);
+void _winter_sharedRetain(shared_t *shared);
+void _winter_sharedRelease(shared_t *shared);
+
+//Holds the block for the life of the state, since its values may point into it
+void _winter_sharedHold(winterState_t *state, shared_t *shared);
+//Releases every held block
+void _winter_sharedFree(winterState_t *state);
+
+//Returns the next 'size' bytes of the block, copied from 'data' unless it's NULL
+void *_winter_sharedTake(unsigned char **at, const void *data, size_t size);
+//Bytes a string takes in a block
+#define SHARED_STRING_SIZE(length) (SHARED_ALIGN(sizeof(wstring_t)) + SHARED_ALIGN((length) + 1))
+//Copies a string or error into the block, with its hash computed since it's cached in the string
+wstring_t *_winter_sharedString(unsigned char **at, const wstring_t *string);
+
+#endif
@@ -0,0 +1,439 @@
+#include "snapshot.h"
+#include "wtype.h"
+#include "object.h"
+#include "table.h"
+#include "wstring.h"
+#include "function.h"
+#include "frozen.h"
+#include "array.h"
+#include "pool.h"
+#include "vm.h"
+#ifdef WINTER_EVENT_LOOP
+#include "loop.h"
+#endif
+#include <string.h>
+
+//Records are gathered into a small buffer before they're handed to the writer
+#define BUFFER_SIZE 4096
+
+typedef struct snapshot_t {
+	winterState_t *state;
+	winterWriter_t writer;
+	void  *user;
+	int    error;
+	size_t size;
+	unsigned char buffer[BUFFER_SIZE];
+	
+	//Shared values already written, open addressing
+	const void **shared;
+	size_t numShared, sharedCapacity;
+} snapshot_t;
+
+static inline void flush(snapshot_t *snap) {
+	if (snap->size > 0 && snap->error == 0) {
+		snap->error = snap->writer(snap->user, snap->buffer, snap->size);
+	}
+	snap->size = 0;
+}
+
+static inline void writeBytes(snapshot_t *snap, const void *data, size_t size) {
+	if (snap->size + size > BUFFER_SIZE) {
+		flush(snap);
+	}
+	memcpy(snap->buffer + snap->size, data, size);
+	snap->size += size;
+}
+static inline void writeInt(snapshot_t *snap, uint64_t value, int bytes) {
+	unsigned char out[8];
+	for (int i = 0; i < bytes; i++) {
+		out[i] = (unsigned char)(value >> (i * 8));
+	}
+	writeBytes(snap, out, bytes);
+}
+static inline void writeValue(snapshot_t *snap, const object_t *obj) {
+	uint64_t payload = 0;
+	if (isRefCounted(obj->type)) {
+		payload = (uintptr_t)obj->pointer;
+	} else if (obj->type == TYPE_INT || obj->type == TYPE_FLOAT) {
+		memcpy(&payload, &obj->integer, sizeof(payload));
+	}
+	writeInt(snap, obj->type, 1);
+	writeInt(snap, payload, 8);
+}
+
+static inline size_t sizeOf(const object_t *obj) {
+	switch (obj->type) {
+		case TYPE_ERROR:
+		case TYPE_STRING: {
+			const stringIndex_t *index = obj->string->index;
+			size_t indexSize = index == NULL ? 0 :
+				sizeof(stringIndex_t) + (index->count + STRING_INDEX_STEP - 1) / STRING_INDEX_STEP * sizeof(size_t);
+			return sizeof(wstring_t) + obj->string->capacity + indexSize;
+		}
+		
+		case TYPE_TABLE: {
+			table_t *table = obj->pointer;
+			if (table->shape != NULL) {
+				return sizeof(table_t) + sizeof(object_t) * table->numSlots;
+			}
+			return sizeof(table_t) + sizeof(bucket_t*) * table->numBuckets + sizeof(bucket_t) * table->size;
+		}
+		
+		case TYPE_FUNCTION:
+			return sizeof(function_t) + sizeof(upvalue_t*) * ((function_t*)obj->pointer)->numUpvalues;
+		
+		case TYPE_FROZEN:
+			return sizeof(frozen_t) + sizeof(frozenEntry_t) * (((frozen_t*)obj->pointer)->mask + 1);
+		
+		case TYPE_ARRAY: {
+			//Views don't own their elements
+			array_t *array = obj->pointer;
+			return sizeof(array_t) + (array->base == NULL ? array->length * _winter_arrayWidth(array->kind) : 0);
+		}
+		
+		default: return 0;
+	}
+}
+
+//Values captured by a closure, open upvalues are still on the stack
+static inline object_t *upvalueValue(function_t *function, size_t index) {
+	upvalue_t *upvalue = function->upvalues[index];
+	return upvalue->open ? NULL : &upvalue->closed;
+}
+
+static inline void writeNode(snapshot_t *snap, const object_t *obj) {
+	const char *preview = NULL;
+	size_t length = 0;
+	if (obj->type == TYPE_STRING || obj->type == TYPE_ERROR) {
+		preview = obj->string->data;
+		length  = obj->string->length < SNAPSHOT_PREVIEW ? obj->string->length : SNAPSHOT_PREVIEW;
+	}
+	
+	writeInt(snap, SNAPSHOT_NODE, 1);
+	writeInt(snap, (uintptr_t)obj->pointer, 8);
+	writeInt(snap, obj->type, 1);
+	writeInt(snap, sizeOf(obj), 8);
+	writeInt(snap, length, 4);
+	if (length > 0) {
+		writeBytes(snap, preview, length);
+	}
+}
+
+//Depth first with pointer reversal, so the walk takes no memory however deep the heap is.
+//Every object on the path from the root to the one being visited keeps the object before
+//it and how far through its own entries the walk is, in fields its layout leaves unused
+//until then: the buckets of a record, the slots of a table with buckets and the native of
+//a closure. They're put back once the walk returns to it. Other functions and every other
+//type have no entries to walk. Clearing the marks afterwards takes the same path
+typedef struct walk_t {
+	snapshot_t *snap; //NULL while clearing the marks
+} walk_t;
+
+#define LINK_FUNCTION 1 //tag of a link to a closure, the rest are tables
+_Static_assert(sizeof(winterCFunction_t) == sizeof(uintptr_t), "links are kept in the native of closures");
+
+static inline bool_t isContainer(const object_t *obj) {
+	if (obj->type == TYPE_FUNCTION) {
+		const function_t *function = obj->pointer;
+		return function->native == NULL && function->numUpvalues > 0;
+	}
+	return obj->type == TYPE_TABLE;
+}
+
+//Keeps 'back' and 'position' in the object while it's on the path
+static inline void setLink(object_t *obj, const object_t *back, uintptr_t position) {
+	uintptr_t link = back->type == TYPE_NULL ? 0 : (uintptr_t)back->pointer | (back->type == TYPE_FUNCTION ? LINK_FUNCTION : 0);
+	if (obj->type == TYPE_FUNCTION) {
+		function_t *function = obj->pointer;
+		memcpy(&function->native, &link, sizeof(link));
+		function->arity = (int)position;
+	} else {
+		table_t *table = obj->pointer;
+		if (table->shape != NULL) {
+			table->head       = (bucket_t*)link;
+			table->numBuckets = position;
+		} else {
+			table->slots    = (object_t*)link;
+			table->numSlots = position;
+		}
+	}
+}
+//Returns the object before it on the path and puts the fields back
+static inline object_t takeLink(object_t *obj, uintptr_t *position) {
+	uintptr_t link;
+	if (obj->type == TYPE_FUNCTION) {
+		function_t *function = obj->pointer;
+		memcpy(&link, &function->native, sizeof(link));
+		*position = (uintptr_t)function->arity;
+		function->native = NULL;
+		function->arity  = function->proto->numParams;
+	} else {
+		table_t *table = obj->pointer;
+		if (table->shape != NULL) {
+			link      = (uintptr_t)table->head;
+			*position = table->numBuckets;
+			table->head       = NULL;
+			table->numBuckets = 0;
+		} else {
+			link      = (uintptr_t)table->slots;
+			*position = table->numSlots;
+			table->slots    = NULL;
+			table->numSlots = 0;
+		}
+	}
+	if (link == 0) {
+		return (object_t){ TYPE_NULL };
+	}
+	object_type_t type = link & LINK_FUNCTION ? TYPE_FUNCTION : TYPE_TABLE;
+	return (object_t){ type, { .pointer = (void*)(link & ~(uintptr_t)LINK_FUNCTION) } };
+}
+
+static inline void writeEdges(snapshot_t *snap, const object_t *obj) {
+	if (obj->type == TYPE_TABLE) {
+		for (tableIter_t it = {0}; _winter_tableNext(obj->pointer, &it);) {
+			writeInt(snap, SNAPSHOT_EDGE, 1);
+			writeInt(snap, (uintptr_t)obj->pointer, 8);
+			writeValue(snap, it.key);
+			writeValue(snap, it.value);
+		}
+	} else if (obj->type == TYPE_FUNCTION) {
+		//Upvalues are edges keyed by their index
+		function_t *function = obj->pointer;
+		for (size_t i = 0; i < function->numUpvalues; i++) {
+			object_t *value = upvalueValue(function, i);
+			if (value != NULL) {
+				object_t key = { TYPE_INT, { .integer = (winterInt_t)i } };
+				writeInt(snap, SNAPSHOT_EDGE, 1);
+				writeInt(snap, (uintptr_t)obj->pointer, 8);
+				writeValue(snap, &key);
+				writeValue(snap, value);
+			}
+		}
+	}
+}
+
+static inline size_t hashPointer(const void *pointer, size_t capacity) {
+	return (size_t)(((uintptr_t)pointer >> 4) * 0x9e3779b97f4a7c15ull) & (capacity - 1);
+}
+//Adds the value to the set of shared values written, returns false if it was there already
+//Running out of memory fails the snapshot, the walk still goes on to put the links back
+static bool_t addShared(snapshot_t *snap, const void *pointer) {
+	winterState_t *state = snap->state;
+	if ((snap->numShared + 1) * 2 > snap->sharedCapacity) {
+		size_t capacity = snap->sharedCapacity ? snap->sharedCapacity * 2 : 64;
+		const void **shared = _winter_poolAllocRaw(state, NULL, sizeof(void*) * capacity);
+		if (shared == NULL) {
+			if (snap->error == 0) {
+				snap->error = -1;
+			}
+			return false;
+		}
+		memset(shared, 0, sizeof(void*) * capacity);
+		for (size_t i = 0; i < snap->sharedCapacity; i++) {
+			if (snap->shared[i] != NULL) {
+				size_t slot = hashPointer(snap->shared[i], capacity);
+				while (shared[slot] != NULL) slot = (slot + 1) & (capacity - 1);
+				shared[slot] = snap->shared[i];
+			}
+		}
+		if (snap->shared != NULL) {
+			_winter_poolAllocRaw(state, snap->shared, 0);
+		}
+		snap->shared = shared;
+		snap->sharedCapacity = capacity;
+	}
+	size_t slot = hashPointer(pointer, snap->sharedCapacity);
+	for (; snap->shared[slot] != NULL; slot = (slot + 1) & (snap->sharedCapacity - 1)) {
+		if (snap->shared[slot] == pointer) return false;
+	}
+	snap->shared[slot] = pointer;
+	snap->numShared++;
+	return true;
+}
+
+//Writes the object the first time it's reached, or clears its mark. Returns true if the
+//walk has to go through its entries
+//Persistent strings may be constants of shared chunks and frozen tables may be read by
+//other threads, so they're kept in a set instead of being marked
+static bool_t reach(walk_t *walk, const object_t *obj) {
+	refcount_t *ref = obj->pointer;
+	if (obj->type == TYPE_FROZEN || (obj->type == TYPE_STRING && ref->_refcount == REF_PERSISTENT)) {
+		if (walk->snap != NULL && addShared(walk->snap, obj->pointer)) {
+			writeNode(walk->snap, obj);
+		}
+		return false;
+	}
+	if (walk->snap == NULL) {
+		if (!ref->_mark) return false;
+		ref->_mark = false;
+	} else {
+		if (ref->_mark) return false;
+		ref->_mark = true;
+		writeNode(walk->snap, obj);
+		writeEdges(walk->snap, obj);
+	}
+	return isContainer(obj);
+}
+
+//Reaches the entries after 'position', returns the first that has to be walked through
+static bool_t nextEntry(walk_t *walk, const object_t *obj, uintptr_t *position, object_t *next) {
+	if (obj->type == TYPE_FUNCTION) {
+		function_t *function = obj->pointer;
+		while (*position < function->numUpvalues) {
+			object_t *value = upvalueValue(function, (*position)++);
+			if (value != NULL && isRefCounted(value->type) && reach(walk, value)) {
+				*next = *value;
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	//Records count the keys and values reached, tables with buckets keep the last bucket
+	//with the low bit set once its value is reached
+	table_t *table = obj->pointer;
+	for (;;) {
+		object_t *entry;
+		if (table->shape != NULL) {
+			size_t index = *position >> 1;
+			if (index == table->shape->count) return false;
+			entry = *position & 1 ? &table->slots[index] : &table->shape->keys[index];
+			(*position)++;
+		} else {
+			bucket_t *bucket = (bucket_t*)(*position & ~(uintptr_t)1);
+			if (bucket == NULL || (*position & 1)) {
+				bucket = bucket == NULL ? table->head : bucket->next;
+				if (bucket == NULL) return false;
+				*position = (uintptr_t)bucket;
+				entry = &bucket->key;
+			} else {
+				*position |= 1;
+				entry = &bucket->value;
+			}
+		}
+		if (isRefCounted(entry->type) && reach(walk, entry)) {
+			*next = *entry;
+			return true;
+		}
+	}
+}
+
+static void walk(walk_t *walk, const object_t *root) {
+	if (!isRefCounted(root->type) || !reach(walk, root)) return;
+	object_t current = *root;
+	object_t back = { TYPE_NULL };
+	uintptr_t position = 0;
+	for (;;) {
+		object_t next;
+		if (nextEntry(walk, &current, &position, &next)) {
+			setLink(&current, &back, position);
+			back     = current;
+			current  = next;
+			position = 0;
+		} else if (back.type != TYPE_NULL) {
+			current = back;
+			back    = takeLink(&current, &position);
+		} else {
+			return;
+		}
+	}
+}
+
+//Roots
+
+typedef void (*rootVisit_t)(void *user, snapshot_root_t kind, uint64_t index, const object_t *obj);
+
+static inline void visitStack(rootVisit_t visit, void *user, snapshot_root_t kind, uint64_t index,
+							  const object_t *stack, size_t top) {
+	for (size_t i = 0; i < top; i++) {
+		const object_t *obj = &stack[i];
+		if (obj->type == TYPE_REFERENCE) {
+			obj = obj->pointer;
+		}
+		visit(user, kind, index | i, obj);
+	}
+}
+
+#ifdef WINTER_EVENT_LOOP
+typedef struct taskRoots_t {
+	rootVisit_t visit;
+	void       *user;
+	uint64_t    count;
+} taskRoots_t;
+
+static void visitTask(void *user, task_t *task) {
+	taskRoots_t *roots = user;
+	roots->visit(roots->user, SNAPSHOT_ROOT_TASK, roots->count << 1, &task->buffer);
+	roots->visit(roots->user, SNAPSHOT_ROOT_TASK, roots->count << 1 | 1, &task->result);
+	roots->count++;
+}
+#endif
+
+//Calls 'visit' on the globals, the stacks of the state and its coroutines and the values
+//held by pending event loop tasks
+static void forEachRoot(winterState_t *state, rootVisit_t visit, void *user) {
+	object_t globals = { TYPE_TABLE, { .pointer = state->globals } };
+	visit(user, SNAPSHOT_ROOT_GLOBALS, 0, &globals);
+	
+	//While a coroutine runs its stack is the state's and the state's own is swapped into it
+	coroutine_t *running = state->coroutine;
+	if (running != NULL) {
+		visitStack(visit, user, SNAPSHOT_ROOT_STACK, 0, running->stack, running->top);
+	} else {
+		visitStack(visit, user, SNAPSHOT_ROOT_STACK, 0, state->stack, state->top);
+	}
+	uint64_t count = 0;
+	for (coroutine_t *coroutine = state->coroutines; coroutine != NULL; coroutine = coroutine->next, count++) {
+		if (coroutine == running) {
+			visitStack(visit, user, SNAPSHOT_ROOT_COROUTINE, count << 32, state->stack, state->top);
+		} else if (coroutine->status == WINTER_SUSPENDED) {
+			visitStack(visit, user, SNAPSHOT_ROOT_COROUTINE, count << 32, coroutine->stack, coroutine->top);
+		}
+	}
+	
+#ifdef WINTER_EVENT_LOOP
+	if (state->loop != NULL) {
+		taskRoots_t roots = { visit, user, 0 };
+		_winter_loopTasks(state->loop, visitTask, &roots);
+	}
+#endif
+}
+
+static void writeRoot(void *user, snapshot_root_t kind, uint64_t index, const object_t *obj) {
+	snapshot_t *snap = user;
+	writeInt(snap, SNAPSHOT_ROOT, 1);
+	writeInt(snap, kind, 1);
+	writeInt(snap, index, 8);
+	writeValue(snap, obj);
+}
+static void walkRoot(void *user, snapshot_root_t kind, uint64_t index, const object_t *obj) {
+	walk(user, obj);
+}
+
+int winterHeapSnapshot(winterState_t *state, winterWriter_t writer, void *user) {
+	snapshot_t snap;
+	snap.state  = state;
+	snap.writer = writer;
+	snap.user   = user;
+	snap.error  = 0;
+	snap.size   = 0;
+	snap.shared = NULL;
+	snap.numShared = snap.sharedCapacity = 0;
+	
+	writeBytes(&snap, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC) - 1);
+	writeInt(&snap, SNAPSHOT_VERSION, 1);
+	
+	forEachRoot(state, writeRoot, &snap);
+	
+	walk_t writing = { &snap }, clearing = { NULL };
+	forEachRoot(state, walkRoot, &writing);
+	forEachRoot(state, walkRoot, &clearing);
+	
+	if (snap.shared != NULL) {
+		_winter_poolAllocRaw(state, snap.shared, 0);
+	}
+	
+	writeInt(&snap, SNAPSHOT_END, 1);
+	flush(&snap);
+	return snap.error;
+}
@@ -0,0 +1,35 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+//Heap snapshot format, written by winterHeapSnapshot and read by tools/heapsummary.c
+//
+//The stream starts with SNAPSHOT_MAGIC and a version byte, then a list of records each
+//starting with a record byte. Integers are little endian. A value is a type byte
+//(object_type_t) followed by 8 bytes: the node id for ref counted types, the integer
+//or float bits otherwise.
+//
+//  SNAPSHOT_ROOT  u8 kind, u64 index, value (see snapshot_root_t for the index)
+//  SNAPSHOT_NODE  u64 id, u8 type, u64 size, u32 length, preview bytes
+//  SNAPSHOT_EDGE  u64 from, value key, value
+//  SNAPSHOT_END
+
+#define SNAPSHOT_MAGIC       "WHS"
+#define SNAPSHOT_VERSION     2
+#define SNAPSHOT_PREVIEW     32
+#define SNAPSHOT_VALUE_SIZE  9
+
+typedef enum snapshot_record_t {
+	SNAPSHOT_ROOT = 'R',
+	SNAPSHOT_NODE = 'N',
+	SNAPSHOT_EDGE = 'E',
+	SNAPSHOT_END  = 'Z'
+} snapshot_record_t;
+
+typedef enum snapshot_root_t {
+	SNAPSHOT_ROOT_GLOBALS = 0, //index 0
+	SNAPSHOT_ROOT_STACK,       //slot of the state's own stack
+	SNAPSHOT_ROOT_COROUTINE,   //coroutine << 32 | slot, numbered in the state's list from 0
+	SNAPSHOT_ROOT_TASK         //task << 1 | 0 for its buffer, 1 for its result
+} snapshot_root_t;
+
+#endif
@@ -0,0 +1,236 @@
+#include "sort.h"
+#include "array.h"
+#include "kernel.h"
+#include "table.h"
+#include "vm.h"
+#include "wstring.h"
+#include "winter.h"
+#include <string.h>
+
+//Bytes first, then length, so equal pointers skip the compare
+static inline bool_t stringLess(const wstring_t *a, const wstring_t *b) {
+	if (a == b) return false;
+	int order = memcmp(a->data, b->data, a->length < b->length ? a->length : b->length);
+	return order < 0 || (order == 0 && a->length < b->length);
+}
+//Same order as the < operator, NaNs are moved out first
+static inline bool_t numberLess(const object_t *a, const object_t *b) {
+	if (a->type == TYPE_INT && b->type == TYPE_INT) return a->integer < b->integer;
+	return _winter_castFloat(a) < _winter_castFloat(b);
+}
+typedef wstring_t *stringRef_t; //SORT_DEFINE declares several T at once
+#define STRING_LESS(a, b) stringLess(a, b)
+#define NUMBER_LESS(a, b) numberLess(&(a), &(b))
+SORT_DEFINE(sortStrings, stringRef_t, STRING_LESS, 0)
+SORT_DEFINE(sortNumbers, object_t,    NUMBER_LESS, 0)
+
+//What a table holds decides how it's sorted without a function
+typedef enum contents_t {
+	CONTENTS_INTS,
+	CONTENTS_FLOATS,
+	CONTENTS_NUMBERS, //ints and floats
+	CONTENTS_STRINGS,
+	CONTENTS_OTHER
+} contents_t;
+
+//Tables can be sorted when their keys are the ints 0 to n-1, the values are returned by key
+static bool_t isSequence(table_t *table, contents_t *contents) {
+	bool_t ints = true, floats = true, strings = true;
+	tableIter_t it = {0};
+	while (_winter_tableNext(table, &it)) {
+		if (it.key->type != TYPE_INT || it.key->integer < 0 || (uint64_t)it.key->integer >= table->size) {
+			return false;
+		}
+		ints    &= it.value->type == TYPE_INT;
+		floats  &= it.value->type == TYPE_INT || it.value->type == TYPE_FLOAT;
+		strings &= it.value->type == TYPE_STRING;
+	}
+	*contents = ints ? CONTENTS_INTS : floats ? CONTENTS_NUMBERS : strings ? CONTENTS_STRINGS : CONTENTS_OTHER;
+	if (*contents == CONTENTS_NUMBERS) {
+		it = (tableIter_t){0};
+		bool_t onlyFloats = true;
+		while (_winter_tableNext(table, &it) && onlyFloats) {
+			onlyFloats = it.value->type == TYPE_FLOAT;
+		}
+		*contents = onlyFloats ? CONTENTS_FLOATS : CONTENTS_NUMBERS;
+	}
+	return true;
+}
+
+//Typed arrays are sorted in a contiguous buffer, views are copied into one and back
+static void sortArray(winterState_t *state, array_t *array) {
+	size_t n = array->length, width = _winter_arrayWidth(array->kind);
+	bool_t copy = !_winter_arrayContiguous(array);
+	size_t size = (copy ? n * width : 0) + (!isFloatArray(array->kind) ? n * width : 0);
+	unsigned char *scratch = size > 0 ? MALLOC(size) : NULL, *data = copy ? scratch : array->data;
+	if (copy) {
+		for (size_t i = 0; i < n; i++) {
+			memcpy(data + i * width, _winter_arrayAt(array, i), width);
+		}
+	}
+	_winter_kernelSort(array->kind, data, copy ? scratch + n * width : scratch, n);
+	if (copy) {
+		for (size_t i = 0; i < n; i++) {
+			memcpy(_winter_arrayAt(array, i), data + i * width, width);
+		}
+	}
+	if (scratch != NULL) {
+		FREE(scratch);
+	}
+}
+
+//The values of a sequence are unboxed into one buffer by key and sorted there, and since
+//they're only reordered they go back without touching their counts
+static void sortTable(winterState_t *state, table_t *table, contents_t contents) {
+	size_t n = table->size;
+	tableIter_t it = {0};
+	switch (contents) {
+		case CONTENTS_INTS: {
+			int64_t *data = MALLOC(sizeof(int64_t) * n * 2);
+			while (_winter_tableNext(table, &it)) data[it.key->integer] = it.value->integer;
+			_winter_kernelSort(ARRAY_INT64, data, data + n, n);
+			for (it = (tableIter_t){0}; _winter_tableNext(table, &it);) it.value->integer = data[it.key->integer];
+			FREE(data);
+		} break;
+		case CONTENTS_FLOATS: {
+			double *data = MALLOC(sizeof(double) * n);
+			while (_winter_tableNext(table, &it)) data[it.key->integer] = it.value->floating;
+			_winter_kernelSort(ARRAY_FLOAT64, data, NULL, n);
+			for (it = (tableIter_t){0}; _winter_tableNext(table, &it);) it.value->floating = data[it.key->integer];
+			FREE(data);
+		} break;
+		case CONTENTS_STRINGS: {
+			wstring_t **data = MALLOC(sizeof(wstring_t*) * n);
+			while (_winter_tableNext(table, &it)) data[it.key->integer] = it.value->string;
+			sortStrings(data, n);
+			for (it = (tableIter_t){0}; _winter_tableNext(table, &it);) it.value->string = data[it.key->integer];
+			FREE(data);
+		} break;
+		default: {
+			object_t *data = MALLOC(sizeof(object_t) * n);
+			size_t m = 0, nans = n;
+			while (_winter_tableNext(table, &it)) {
+				//NaNs aren't ordered against anything, so they go last
+				if (it.value->type == TYPE_FLOAT && it.value->floating != it.value->floating) {
+					data[--nans] = *it.value;
+				} else {
+					data[m++] = *it.value;
+				}
+			}
+			sortNumbers(data, m);
+			for (it = (tableIter_t){0}; _winter_tableNext(table, &it);) *it.value = data[it.key->integer];
+			FREE(data);
+		} break;
+	}
+}
+
+//Calls the function on pairs of elements until one raises an error
+typedef struct comparator_t {
+	winterState_t *state;
+	object_t       function;
+	object_t       error; //TYPE_NULL until the function raises one
+} comparator_t;
+
+static bool_t less(comparator_t *c, const object_t *a, const object_t *b) {
+	if (c->error.type != TYPE_NULL) return false;
+	winterState_t *state = c->state;
+	size_t top = state->top;
+	const object_t args[2] = { *a, *b };
+	object_t result = *_winter_callValue(state, &c->function, args, 2);
+	state->top = top;
+	if (result.type == TYPE_ERROR) {
+		c->error = result;
+		return false;
+	}
+	return _winter_objectTruthy(&result);
+}
+
+//Top down merge sort, which skips merging halves that are already in order
+static void mergeSort(comparator_t *c, object_t *data, object_t *scratch, size_t n) {
+	if (n < 2) return;
+	size_t half = n / 2;
+	mergeSort(c, data, scratch, half);
+	mergeSort(c, data + half, scratch, n - half);
+	if (!less(c, &data[half], &data[half - 1])) return;
+	
+	//Only the left half is moved out, the merge never overtakes the right one
+	memcpy(scratch, data, sizeof(object_t) * half);
+	size_t i = 0, j = half, k = 0;
+	while (i < half && j < n) {
+		data[k++] = less(c, &data[j], &scratch[i]) ? data[j++] : scratch[i++];
+	}
+	while (i < half) {
+		data[k++] = scratch[i++];
+	}
+}
+
+//The elements are held while the function runs, since it can modify the table
+static void sortWith(winterState_t *state, object_t *value, comparator_t *c) {
+	array_t *array = value->type == TYPE_ARRAY ? value->pointer : NULL;
+	table_t *table = value->type == TYPE_TABLE ? value->pointer : NULL;
+	size_t n = array != NULL ? array->length : table->size;
+	object_t *data = MALLOC(sizeof(object_t) * (n + n / 2));
+	if (array != NULL) {
+		for (size_t i = 0; i < n; i++) data[i] = _winter_arrayGet(array, i);
+	} else {
+		for (tableIter_t it = {0}; _winter_tableNext(table, &it);) {
+			data[it.key->integer] = *_winter_objectAddRef(state, it.value);
+		}
+	}
+	
+	mergeSort(c, data, data + n, n);
+	if (array != NULL) {
+		for (size_t i = 0; i < n && c->error.type == TYPE_NULL; i++) _winter_arraySet(array, i, &data[i]);
+	} else {
+		//Written through the entries, keys the function added are left alone
+		for (tableIter_t it = {0}; _winter_tableNext(table, &it) && c->error.type == TYPE_NULL;) {
+			if (it.key->type == TYPE_INT && it.key->integer >= 0 && (uint64_t)it.key->integer < n) {
+				object_t previous = *it.value;
+				*it.value = *_winter_objectAddRef(state, &data[it.key->integer]);
+				_winter_objectDelRef(state, &previous);
+			}
+		}
+		for (size_t i = 0; i < n; i++) {
+			_winter_objectDelRef(state, &data[i]);
+		}
+	}
+	FREE(data);
+}
+
+//sort(a[, fn]) sorts a typed array or a table with the keys 0 to n-1 in place and returns
+//it. fn(x, y) returns true if x goes before y, elements it doesn't order keep their order
+static int sort(winterState_t *state, winterValue_t *args, int argc) {
+	array_t *array = argc > 0 && args[0].type == TYPE_ARRAY ? args[0].pointer : NULL;
+	table_t *table = argc > 0 && args[0].type == TYPE_TABLE ? args[0].pointer : NULL;
+	contents_t contents = CONTENTS_OTHER;
+	if ((array == NULL && table == NULL) || argc > 2 || (argc == 2 && args[1].type != TYPE_FUNCTION) ||
+		(table != NULL && !isSequence(table, &contents))) {
+		_winter_objectNewError(state, &args[0], "sort expects an array or a table with the keys 0 to n-1, and an optional function");
+		return 1;
+	} else if (array != NULL && array->readOnly) {
+		_winter_objectNewError(state, &args[0], "attempt to modify a read only array");
+		return 1;
+	} else if (argc == 1 && contents == CONTENTS_OTHER && table != NULL) {
+		_winter_objectNewError(state, &args[0], "sort can only order numbers or strings without a function");
+		return 1;
+	}
+	
+	if (argc == 1) {
+		if (array != NULL) sortArray(state, array);
+		else               sortTable(state, table, contents);
+		return 1;
+	}
+	//The function can move the stack, so the arguments are found again afterwards
+	size_t base = (size_t)(args - state->stack);
+	comparator_t c = { state, args[1], { TYPE_NULL } };
+	sortWith(state, &args[0], &c);
+	args = &state->stack[base];
+	if (c.error.type != TYPE_NULL) {
+		args[0] = c.error;
+	}
+	return 1;
+}
+
+void _winter_sortOpen(winterState_t *state) {
+	winterRegister(state, "sort", sort, -1);
+}
@@ -0,0 +1,267 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include "wtype.h"
+#include "object.h"
+
+//sort(a[, fn]), registered with the array functions
+//
+//Without a function typed arrays and tables holding only ints, only floats or only strings
+//are copied out unboxed and sorted with the kernels in kernel.h, strings by their bytes.
+//With one the elements are merge sorted by calling it, which keeps equal ones in order
+void _winter_sortOpen(winterState_t *state);
+
+//Pattern-defeating quicksort over a buffer of T ordered by LESS(a, b), a macro that may
+//read its arguments more than once. BRANCHLESS partitions a block of comparisons at a time
+//without branching on them, which only pays off when LESS is cheap, e.g. a number compare.
+//Unbalanced partitions shuffle a few elements to break patterns and too many of them fall
+//back to heap sort, so it stays O(n log n). Not stable. T has to be a single name, a pointer
+//type needs a typedef
+#define SORT_INSERTION 24  //ranges shorter than this are insertion sorted
+#define SORT_NINTHER   128 //longer ranges take the pivot from 9 elements instead of 3
+#define SORT_BLOCK     64  //comparisons per block of a branchless partition
+
+#define SORT_DEFINE(name, T, LESS, BRANCHLESS)                                            \
+static inline void name##Swap(T *a, T *b) {                                               \
+	T t = *a; *a = *b; *b = t;                                                            \
+}                                                                                         \
+static inline void name##Sort2(T *a, T *b) {                                              \
+	if (LESS(*b, *a)) name##Swap(a, b);                                                   \
+}                                                                                         \
+static inline void name##Sort3(T *a, T *b, T *c) {                                        \
+	name##Sort2(a, b);                                                                    \
+	name##Sort2(b, c);                                                                    \
+	name##Sort2(a, b);                                                                    \
+}                                                                                         \
+/*Without 'leftmost' the element before 'begin' stops the shifts, it's no greater than any*/ \
+static void name##Insertion(T *begin, T *end, bool_t leftmost) {                          \
+	for (T *cur = begin + 1; cur < end; cur++) {                                          \
+		if (LESS(*cur, cur[-1])) {                                                        \
+			T tmp = *cur, *sift = cur;                                                    \
+			do {                                                                          \
+				*sift = sift[-1];                                                         \
+				sift--;                                                                   \
+			} while ((!leftmost || sift != begin) && LESS(tmp, sift[-1]));                \
+			*sift = tmp;                                                                  \
+		}                                                                                 \
+	}                                                                                     \
+}                                                                                         \
+/*Gives up after moving 8 elements, returns true if the range ended up sorted*/           \
+static bool_t name##Partial(T *begin, T *end) {                                           \
+	size_t moves = 0;                                                                     \
+	for (T *cur = begin + 1; cur < end; cur++) {                                          \
+		if (LESS(*cur, cur[-1])) {                                                        \
+			T tmp = *cur, *sift = cur;                                                    \
+			do {                                                                          \
+				*sift = sift[-1];                                                         \
+				sift--;                                                                   \
+			} while (sift != begin && LESS(tmp, sift[-1]));                               \
+			*sift = tmp;                                                                  \
+			moves += (size_t)(cur - sift);                                                \
+			if (moves > 8) return false;                                                  \
+		}                                                                                 \
+	}                                                                                     \
+	return true;                                                                          \
+}                                                                                         \
+static void name##Sift(T *data, size_t root, size_t n) {                                  \
+	T tmp = data[root];                                                                   \
+	for (size_t child; (child = 2 * root + 1) < n; root = child) {                        \
+		if (child + 1 < n && LESS(data[child], data[child + 1])) child++;                 \
+		if (!LESS(tmp, data[child])) break;                                               \
+		data[root] = data[child];                                                         \
+	}                                                                                     \
+	data[root] = tmp;                                                                     \
+}                                                                                         \
+static void name##Heap(T *data, size_t n) {                                               \
+	for (size_t i = n / 2; i-- > 0;) name##Sift(data, i, n);                              \
+	for (size_t i = n; i-- > 1;) {                                                        \
+		name##Swap(&data[0], &data[i]);                                                   \
+		name##Sift(data, 0, i);                                                           \
+	}                                                                                     \
+}                                                                                         \
+/*Swaps the elements at the offsets from 'first' with those at the offsets back from 'last'*/ \
+static inline void name##Offsets(T *first, T *last, const unsigned char *left,            \
+								 const unsigned char *right, size_t num, bool_t swaps) {  \
+	if (swaps) {                                                                          \
+		/*Equal counts need real swaps so descending input stays linear*/                 \
+		for (size_t i = 0; i < num; i++) name##Swap(first + left[i], last - right[i]);    \
+	} else if (num > 0) {                                                                 \
+		T *l = first + left[0], *r = last - right[0], tmp = *l;                           \
+		*l = *r;                                                                          \
+		for (size_t i = 1; i < num; i++) {                                                \
+			l = first + left[i];                                                          \
+			*r = *l;                                                                      \
+			r = last - right[i];                                                          \
+			*l = *r;                                                                      \
+		}                                                                                 \
+		*r = tmp;                                                                         \
+	}                                                                                     \
+}                                                                                         \
+/*Moves the elements less than the pivot at 'begin' before it and returns where it ends  \
+  up, 'partitioned' is set if nothing had to move*/                                       \
+static T *name##Partition(T *begin, T *end, bool_t *partitioned) {                        \
+	T pivot = *begin, *first = begin, *last = end;                                        \
+	do { first++; } while (LESS(*first, pivot));                                          \
+	if (first - 1 == begin) {                                                             \
+		while (first < last) { last--; if (LESS(*last, pivot)) break; }                   \
+	} else {                                                                              \
+		do { last--; } while (!LESS(*last, pivot));                                       \
+	}                                                                                     \
+	*partitioned = first >= last;                                                         \
+	if (!BRANCHLESS) {                                                                    \
+		while (first < last) {                                                            \
+			name##Swap(first, last);                                                      \
+			do { first++; } while (LESS(*first, pivot));                                  \
+			do { last--; } while (!LESS(*last, pivot));                                   \
+		}                                                                                 \
+	} else if (!*partitioned) {                                                           \
+		name##Swap(first, last);                                                          \
+		first++;                                                                          \
+		/*Offsets of elements on the wrong side, found without branching on LESS*/        \
+		unsigned char left[SORT_BLOCK], right[SORT_BLOCK];                                \
+		size_t numL = 0, numR = 0, startL = 0, startR = 0;                                \
+		while (last - first > 2 * SORT_BLOCK) {                                           \
+			if (numL == 0) {                                                              \
+				startL = 0;                                                               \
+				for (size_t i = 0; i < SORT_BLOCK; i++) {                                 \
+					left[numL] = (unsigned char)i;                                        \
+					numL += !LESS(first[i], pivot);                                       \
+				}                                                                         \
+			}                                                                             \
+			if (numR == 0) {                                                              \
+				startR = 0;                                                               \
+				for (size_t i = 0; i < SORT_BLOCK; i++) {                                 \
+					right[numR] = (unsigned char)(i + 1);                                 \
+					numR += LESS(last[-1 - (ptrdiff_t)i], pivot);                         \
+				}                                                                         \
+			}                                                                             \
+			size_t num = numL < numR ? numL : numR;                                       \
+			name##Offsets(first, last, left + startL, right + startR, num, numL == numR); \
+			numL -= num; numR -= num;                                                     \
+			startL += num; startR += num;                                                 \
+			if (numL == 0) first += SORT_BLOCK;                                           \
+			if (numR == 0) last -= SORT_BLOCK;                                            \
+		}                                                                                 \
+		/*Splits what's left between the blocks that still need offsets*/                \
+		size_t unknown = (size_t)(last - first) - (numL || numR ? SORT_BLOCK : 0);        \
+		size_t sizeL = numR ? unknown : numL ? SORT_BLOCK : unknown / 2;                  \
+		size_t sizeR = numR ? SORT_BLOCK : numL ? unknown : unknown - sizeL;              \
+		if (unknown && !numL) {                                                           \
+			startL = 0;                                                                   \
+			for (size_t i = 0; i < sizeL; i++) {                                          \
+				left[numL] = (unsigned char)i;                                            \
+				numL += !LESS(first[i], pivot);                                           \
+			}                                                                             \
+		}                                                                                 \
+		if (unknown && !numR) {                                                           \
+			startR = 0;                                                                   \
+			for (size_t i = 0; i < sizeR; i++) {                                          \
+				right[numR] = (unsigned char)(i + 1);                                     \
+				numR += LESS(last[-1 - (ptrdiff_t)i], pivot);                             \
+			}                                                                             \
+		}                                                                                 \
+		size_t num = numL < numR ? numL : numR;                                           \
+		name##Offsets(first, last, left + startL, right + startR, num, numL == numR);     \
+		numL -= num; numR -= num;                                                         \
+		startL += num; startR += num;                                                     \
+		if (numL == 0) first += sizeL;                                                    \
+		if (numR == 0) last -= sizeR;                                                     \
+		/*One side is done, the rest of the other swaps in from the far end*/             \
+		if (numL) {                                                                       \
+			while (numL--) name##Swap(first + left[startL + numL], --last);               \
+			first = last;                                                                 \
+		}                                                                                 \
+		if (numR) {                                                                       \
+			while (numR--) name##Swap(last - right[startR + numR], first++);              \
+			last = first;                                                                 \
+		}                                                                                 \
+	}                                                                                     \
+	T *at = first - 1;                                                                    \
+	*begin = *at;                                                                         \
+	*at = pivot;                                                                          \
+	return at;                                                                            \
+}                                                                                         \
+/*Puts the elements equal to the pivot at 'begin' before it, used when the range can't    \
+  hold anything smaller, returns where the pivot ends up*/                                \
+static T *name##PartitionLeft(T *begin, T *end) {                                         \
+	T pivot = *begin, *first = begin, *last = end;                                        \
+	do { last--; } while (LESS(pivot, *last));                                            \
+	if (last + 1 == end) {                                                                \
+		while (first < last) { first++; if (LESS(pivot, *first)) break; }                 \
+	} else {                                                                              \
+		do { first++; } while (!LESS(pivot, *first));                                     \
+	}                                                                                     \
+	while (first < last) {                                                                \
+		name##Swap(first, last);                                                          \
+		do { last--; } while (LESS(pivot, *last));                                        \
+		do { first++; } while (!LESS(pivot, *first));                                     \
+	}                                                                                     \
+	*begin = *last;                                                                       \
+	*last = pivot;                                                                        \
+	return last;                                                                          \
+}                                                                                         \
+static void name##Loop(T *begin, T *end, int bad, bool_t leftmost) {                      \
+	while (true) {                                                                        \
+		size_t size = (size_t)(end - begin), half = size / 2;                             \
+		if (size < SORT_INSERTION) {                                                      \
+			name##Insertion(begin, end, leftmost);                                        \
+			return;                                                                       \
+		}                                                                                 \
+		if (size > SORT_NINTHER) {                                                        \
+			name##Sort3(begin, begin + half, end - 1);                                    \
+			name##Sort3(begin + 1, begin + half - 1, end - 2);                            \
+			name##Sort3(begin + 2, begin + half + 1, end - 3);                            \
+			name##Sort3(begin + half - 1, begin + half, begin + half + 1);                \
+			name##Swap(begin, begin + half);                                              \
+		} else {                                                                          \
+			name##Sort3(begin + half, begin, end - 1);                                    \
+		}                                                                                 \
+		/*A pivot equal to the one before the range means it's the smallest, so the    \
+		  elements equal to it are already in place*/                                     \
+		if (!leftmost && !LESS(begin[-1], *begin)) {                                      \
+			begin = name##PartitionLeft(begin, end) + 1;                                  \
+			continue;                                                                     \
+		}                                                                                 \
+		bool_t partitioned;                                                               \
+		T *pivot = name##Partition(begin, end, &partitioned);                             \
+		size_t sizeL = (size_t)(pivot - begin), sizeR = (size_t)(end - pivot - 1);        \
+		if (sizeL < size / 8 || sizeR < size / 8) {                                       \
+			if (--bad == 0) {                                                             \
+				name##Heap(begin, (size_t)(end - begin));                                 \
+				return;                                                                   \
+			}                                                                             \
+			if (sizeL >= SORT_INSERTION) {                                                \
+				name##Swap(begin, begin + sizeL / 4);                                     \
+				name##Swap(pivot - 1, pivot - sizeL / 4);                                 \
+				if (sizeL > SORT_NINTHER) {                                               \
+					name##Swap(begin + 1, begin + sizeL / 4 + 1);                         \
+					name##Swap(begin + 2, begin + sizeL / 4 + 2);                         \
+					name##Swap(pivot - 2, pivot - sizeL / 4 - 1);                         \
+					name##Swap(pivot - 3, pivot - sizeL / 4 - 2);                         \
+				}                                                                         \
+			}                                                                             \
+			if (sizeR >= SORT_INSERTION) {                                                \
+				name##Swap(pivot + 1, pivot + 1 + sizeR / 4);                             \
+				name##Swap(end - 1, end - sizeR / 4);                                     \
+				if (sizeR > SORT_NINTHER) {                                               \
+					name##Swap(pivot + 2, pivot + 2 + sizeR / 4);                         \
+					name##Swap(pivot + 3, pivot + 3 + sizeR / 4);                         \
+					name##Swap(end - 2, end - 1 - sizeR / 4);                             \
+					name##Swap(end - 3, end - 2 - sizeR / 4);                             \
+				}                                                                         \
+			}                                                                             \
+		} else if (partitioned && name##Partial(begin, pivot) && name##Partial(pivot + 1, end)) { \
+			return;                                                                       \
+		}                                                                                 \
+		name##Loop(begin, pivot, bad, leftmost);                                          \
+		begin = pivot + 1;                                                                \
+		leftmost = false;                                                                 \
+	}                                                                                     \
+}                                                                                         \
+static void name(T *data, size_t n) {                                                     \
+	int bad = 1;                                                                          \
+	while (n >> bad) bad++;                                                               \
+	if (n > 1) name##Loop(data, data + n, bad, true);                                     \
+}
+
+#endif
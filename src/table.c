@@ -1,21 +1,54 @@
 #include "table.h"
+#include "gc.h"
+#include "frozen.h"
 #include <string.h>
 
 table_t *_winter_tableAlloc(winterState_t *state, size_t capacity) {
-	table_t *out = MALLOC(sizeof(table_t));
+	//Both parts are allocated before either is used, running out of memory frees the buckets
+	bucket_t **buckets = capacity > 0 ? MALLOC(sizeof(bucket_t*) * capacity) : NULL;
+	table_t *out = _winter_poolTryAlloc(state, NULL, sizeof(table_t));
+	if (out == NULL) {
+		FREE(buckets);
+		_winter_memoryError(state);
+		return NULL;
+	}
 	out->_refcount  = 0;
-	out->buckets    = MALLOC(sizeof(bucket_t*) * capacity);
-	memset(out->buckets, 0, sizeof(bucket_t*) * capacity);
+	out->_zct       = false;
+	out->_type      = TYPE_TABLE;
+	out->_mark      = false;
+	out->_color     = GC_BLACK;
+	out->_buffered  = false;
+	out->buckets    = buckets;
 	out->head       = NULL;
 	out->numBuckets = capacity;
 	out->size       = 0;
+	out->shape      = NULL;
+	out->slots      = NULL;
+	out->numSlots   = 0;
+	if (capacity > 0) {
+		memset(out->buckets, 0, sizeof(bucket_t*) * capacity);
+	} else {
+		out->shape = state->shapes;
+		_winter_shapeRetain(out->shape);
+	}
+	state->memory.tables++;
+	_winter_zctPush(state, TYPE_TABLE, out);
 	return out;
 }
 void _winter_tableFree(winterState_t *state, table_t *table) {
+	_winter_tableRelease(state, table, true);
+	state->memory.tables--;
+	FREE(table);
+}
+static void releaseBuckets(winterState_t *state, table_t *table, bool_t cyclic) {
 	bucket_t *list = table->head;
 	while (list != NULL) {
-		_winter_objectDelRef(state, &list->key);
-		_winter_objectDelRef(state, &list->value);
+		if (cyclic || !isCollectable(list->key.type)) {
+			_winter_objectDelRef(state, &list->key);
+		}
+		if (cyclic || !isCollectable(list->value.type)) {
+			_winter_objectDelRef(state, &list->value);
+		}
 		bucket_t *temp = list;
 		list = list->next;
 		FREE(temp);
@@ -23,7 +56,30 @@ void _winter_tableFree(winterState_t *state, table_t *table) {
 	if (table->buckets != NULL) {
 		FREE(table->buckets);
 	}
-	FREE(table);
+	table->buckets    = NULL;
+	table->head       = NULL;
+	table->numBuckets = 0;
+}
+static void releaseSlots(winterState_t *state, table_t *table, bool_t cyclic) {
+	if (table->shape != NULL) {
+		for (size_t i = 0; i < table->shape->count; i++) {
+			if (cyclic || !isCollectable(table->slots[i].type)) {
+				_winter_objectDelRef(state, &table->slots[i]);
+			}
+		}
+		_winter_shapeRelease(state, table->shape);
+	}
+	if (table->slots != NULL) {
+		FREE(table->slots);
+	}
+	table->shape    = NULL;
+	table->slots    = NULL;
+	table->numSlots = 0;
+}
+void _winter_tableRelease(winterState_t *state, table_t *table, bool_t cyclic) {
+	releaseBuckets(state, table, cyclic);
+	releaseSlots(state, table, cyclic);
+	table->size = 0;
 }
 
 static inline bucket_t *getBucket(table_t *table, object_t *key) {
@@ -39,38 +95,216 @@ static inline bucket_t *getBucket(table_t *table, object_t *key) {
 	return bucket;
 }
 
+static bucket_t *linkBucket(winterState_t *state, table_t *table, bucket_t *bucket, object_t *key) {
+	bucket->key = *_winter_objectAddRef(state, key);
+	
+	hash_t hash = _winter_hashObjet(key) % table->numBuckets;
+	bucket_t **slot = &table->buckets[hash];
+	
+	if (*slot == NULL) {
+		*slot = bucket;
+		bucket->next = table->head;
+		table->head = bucket;
+	} else {
+		bucket->next = (*slot)->next;
+		(*slot)->next = bucket;
+	}
+	return bucket;
+}
+static inline bucket_t *newBucket(winterState_t *state, table_t *table, object_t *key) {
+	return linkBucket(state, table, MALLOC(sizeof(bucket_t)), key);
+}
+
+//Moves a record's values into buckets
+//They're counted by both until it's done, so running out of memory leaves a usable record
+static void toBuckets(winterState_t *state, table_t *table) {
+	releaseBuckets(state, table, true);
+	size_t capacity = 8;
+	while (capacity < table->shape->count * 2) {
+		capacity *= 2;
+	}
+	table->buckets = MALLOC(sizeof(bucket_t*) * capacity);
+	memset(table->buckets, 0, sizeof(bucket_t*) * capacity);
+	table->numBuckets = capacity;
+	for (size_t i = 0; i < table->shape->count; i++) {
+		newBucket(state, table, &table->shape->keys[i])->value = *_winter_objectAddRef(state, &table->slots[i]);
+	}
+	releaseSlots(state, table, true);
+}
+
+//Makes room for one more slot than the shape has
+static inline void reserveSlot(winterState_t *state, table_t *table) {
+	if (table->shape->count == table->numSlots) {
+		size_t capacity = table->numSlots ? table->numSlots * 2 : 4;
+		table->slots = REALLOC(table->slots, sizeof(object_t) * capacity);
+		table->numSlots = capacity;
+	}
+}
+//Moves the table to a shape adding one key, the table takes over the caller's reference
+static inline object_t *moveTo(winterState_t *state, table_t *table, shape_t *next) {
+	_winter_shapeRelease(state, table->shape);
+	table->shape = next;
+	table->size  = next->count;
+	object_t *slot = &table->slots[next->count - 1];
+	*slot = (object_t){ TYPE_NULL, {0} };
+	return slot;
+}
+
+//Returns the record's slot for the key, which is added if needed
+//Returns NULL if the table had to move to buckets for it
+static object_t *addSlot(winterState_t *state, table_t *table, object_t *key) {
+	if (key->type == TYPE_STRING) {
+		int slot = _winter_shapeFind(table->shape, key);
+		if (slot >= 0) {
+			return &table->slots[slot];
+		} else if (table->shape->count < SHAPE_MAX_KEYS) {
+			reserveSlot(state, table);
+			return moveTo(state, table, _winter_shapeAdd(state, table->shape, key));
+		}
+	}
+	toBuckets(state, table);
+	return NULL;
+}
+
 object_t *_winter_tableInsert(winterState_t *state, table_t *table, object_t *key, object_t *value) {
-	bucket_t *bucket = getBucket(table, key);
-	if (bucket == NULL) {
-		//allocate new bucket for value
-		bucket = MALLOC(sizeof(bucket_t));
-		
-		bucket->key = *_winter_objectAddRef(state, key);
-		
-		hash_t hash = _winter_hashObjet(key) % table->numBuckets;
-		bucket_t **slot = &table->buckets[hash];
-		
-		if (*slot == NULL) {
-			*slot = bucket;
-			bucket->next = table->head;
-			table->head = bucket;
-		} else {
-			bucket->next = (*slot)->next;
-			(*slot)->next = bucket;
+	object_t *slot = table->shape != NULL ? addSlot(state, table, key) : NULL;
+	if (slot == NULL) {
+		bucket_t *bucket = getBucket(table, key);
+		if (bucket == NULL) {
+			//allocate new bucket for value
+			bucket = newBucket(state, table, key);
 		}
+		slot = &bucket->value;
+		table->size++;
 	}
 	
 	if (value != NULL) {
-		bucket->value = *_winter_objectAddRef(state, value);
+		*slot = *_winter_objectAddRef(state, value);
 	} else {
-		bucket->value = (object_t){ TYPE_NULL, {0} };
+		*slot = (object_t){ TYPE_NULL, {0} };
 	}
-	table->size++;
 	
-	return &bucket->value;
+	return slot;
+}
+
+void _winter_tableSet(winterState_t *state, table_t *table, object_t *key, object_t *value) {
+	object_t *slot = _winter_tableGetObject(table, key);
+	if (slot != NULL) {
+		object_t previous = *slot;
+		*slot = *_winter_objectAddRef(state, value);
+		_winter_objectDelRef(state, &previous);
+	} else {
+		_winter_tableInsert(state, table, key, value);
+	}
+}
+
+void _winter_tableSetAll(winterState_t *state, table_t *table, object_t *pairs, size_t count) {
+	if (table->shape != NULL) {
+		toBuckets(state, table);
+	}
+	//Buckets for the new keys are chained through 'next' until they're linked in
+	bucket_t *spare = NULL;
+	for (size_t i = 0; i < count; i++) {
+		if (getBucket(table, &pairs[i * 2]) == NULL) {
+			bucket_t *bucket = _winter_poolTryAlloc(state, NULL, sizeof(bucket_t));
+			if (bucket == NULL) {
+				while (spare != NULL) {
+					bucket_t *next = spare->next;
+					FREE(spare);
+					spare = next;
+				}
+				_winter_memoryError(state);
+				return;
+			}
+			bucket->next = spare;
+			spare = bucket;
+		}
+	}
+	for (size_t i = 0; i < count; i++) {
+		object_t *key = &pairs[i * 2], *value = &pairs[i * 2 + 1];
+		bucket_t *bucket = getBucket(table, key);
+		if (bucket != NULL) {
+			object_t previous = bucket->value;
+			bucket->value = *_winter_objectAddRef(state, value);
+			_winter_objectDelRef(state, &previous);
+		} else {
+			bucket = spare;
+			spare = spare->next;
+			linkBucket(state, table, bucket, key)->value = *_winter_objectAddRef(state, value);
+			table->size++;
+		}
+	}
+	//Keys repeated in the pairs leave buckets over
+	while (spare != NULL) {
+		bucket_t *next = spare->next;
+		FREE(spare);
+		spare = next;
+	}
+}
+
+table_t *_winter_tableReserve(winterState_t *state, size_t count, bool_t record) {
+	if (!record || count > SHAPE_MAX_KEYS) {
+		size_t capacity = 8;
+		while (capacity < count * 2) {
+			capacity *= 2;
+		}
+		return _winter_tableAlloc(state, capacity);
+	}
+	table_t *table = _winter_tableAlloc(state, 0);
+	if (count > 0) {
+		table->slots    = MALLOC(sizeof(object_t) * count);
+		table->numSlots = count;
+	}
+	return table;
+}
+
+table_t *_winter_tableFrom(winterState_t *state, object_t *pairs, size_t count) {
+	bool_t record = count <= SHAPE_MAX_KEYS;
+	for (size_t i = 0; i < count && record; i++) {
+		record = pairs[i * 2].type == TYPE_STRING;
+	}
+	table_t *table = _winter_tableReserve(state, count, record);
+	if (!record) {
+		for (size_t i = 0; i < count; i++) {
+			_winter_tableSet(state, table, &pairs[i * 2], &pairs[i * 2 + 1]);
+		}
+		return table;
+	}
+	//Keys that follow an existing branch of the tree are in it once each, so the branch's
+	//shape is taken whole instead of searching and moving to each shape on the way
+	shape_t *shape = table->shape;
+	size_t same = 0;
+	for (; same < count; same++) {
+		shape_t *child = shape->children;
+		while (child != NULL && !_winter_stringCompare(child->keys[shape->count].string, pairs[same * 2].string)) {
+			child = child->sibling;
+		}
+		if (child == NULL) break;
+		shape = child;
+	}
+	if (same > 0) {
+		_winter_shapeRetain(shape);
+		_winter_shapeRelease(state, table->shape);
+		table->shape = shape;
+		table->size  = same;
+		for (size_t i = 0; i < same; i++) {
+			table->slots[i] = *_winter_objectAddRef(state, &pairs[i * 2 + 1]);
+		}
+	}
+	for (size_t i = same; i < count; i++) {
+		object_t *slot = addSlot(state, table, &pairs[i * 2]);
+		object_t previous = *slot;
+		*slot = *_winter_objectAddRef(state, &pairs[i * 2 + 1]);
+		_winter_objectDelRef(state, &previous);
+	}
+	return table;
 }
 
 object_t *_winter_tableGetObject(table_t *table, object_t *key) {
+	if (table->shape != NULL) {
+		int slot = key->type == TYPE_STRING ? _winter_shapeFind(table->shape, key) : -1;
+		return slot >= 0 ? &table->slots[slot] : NULL;
+	}
 	bucket_t *bucket = getBucket(table, key);
 	if (bucket) {
 		return &bucket->value;
@@ -78,3 +312,73 @@ object_t *_winter_tableGetObject(table_t *table, object_t *key) {
 		return NULL;
 	}
 }
+
+object_t *_winter_tableMissField(winterState_t *state, table_t *table, object_t *key, fieldCache_t *cache) {
+	if (cache != NULL && table->shape != NULL) {
+		int slot = _winter_shapeFind(table->shape, key);
+		if (slot < 0) {
+			return NULL;
+		}
+		_winter_cacheAdd(state, cache, table->shape, NULL, (uint32_t)slot);
+		return &table->slots[slot];
+	}
+	return _winter_tableGetObject(table, key);
+}
+
+void _winter_tableStoreMiss(winterState_t *state, table_t *table, object_t *key, object_t *value, fieldCache_t *cache) {
+	if (cache != NULL && table->shape != NULL) {
+		shape_t *next = NULL;
+		for (size_t way = 0; way < CACHE_WAYS; way++) {
+			if (cache->shapes[way] == table->shape && cache->next[way] != NULL) {
+				next = cache->next[way];
+				break;
+			}
+		}
+		if (next != NULL) {
+			reserveSlot(state, table);
+			_winter_shapeRetain(next);
+		} else {
+			int slot = _winter_shapeFind(table->shape, key);
+			if (slot >= 0) {
+				_winter_cacheAdd(state, cache, table->shape, NULL, (uint32_t)slot);
+			} else if (table->shape->count < SHAPE_MAX_KEYS) {
+				reserveSlot(state, table);
+				next = _winter_shapeAdd(state, table->shape, key);
+				_winter_cacheAdd(state, cache, table->shape, next, next->count - 1);
+			}
+		}
+		if (next != NULL) {
+			*moveTo(state, table, next) = *_winter_objectAddRef(state, value);
+			return;
+		}
+	}
+	_winter_tableSet(state, table, key, value);
+}
+
+void winterSetTable(winterState_t *state, winterValue_t *value) {
+	*value = (object_t){ TYPE_TABLE, { .pointer = _winter_tableAlloc(state, 0) } };
+}
+
+int winterTableSet(winterState_t *state, winterValue_t *table, const winterValue_t *key, const winterValue_t *value) {
+	if (table->type == TYPE_REFERENCE) {
+		table = table->pointer;
+	}
+	if (table->type != TYPE_TABLE) {
+		return -1;
+	}
+	_winter_frozenHold(state, key);
+	_winter_frozenHold(state, value);
+	_winter_tableSet(state, table->pointer, (object_t*)key, (object_t*)value);
+	return 0;
+}
+
+const winterValue_t *winterTableGet(const winterValue_t *table, const winterValue_t *key) {
+	if (table->type == TYPE_REFERENCE) {
+		table = table->pointer;
+	}
+	switch (table->type) {
+		case TYPE_TABLE:  return _winter_tableGetObject(table->pointer, (object_t*)key);
+		case TYPE_FROZEN: return _winter_frozenGet(table->pointer, key);
+		default:          return NULL;
+	}
+}
@@ -6,6 +6,7 @@ typedef struct winterState_t winterState_t;
 
 #include "object.h"
 #include "wstring.h"
+#include "shape.h"
 
 typedef struct bucket_t {
 	object_t key;
@@ -13,18 +14,88 @@ typedef struct bucket_t {
 	struct bucket_t *next;
 } bucket_t;
 
+//Tables made with no buckets are records, their string keys are in a shape and the values
+//in 'slots' until another kind of key is added, see shape.h
 typedef struct table_t {
-	REFCOUNT;
+	GCHEADER;
 	bucket_t **buckets;
 	bucket_t  *head;
 	size_t numBuckets;
 	size_t size;
+	
+	shape_t  *shape; //counted, NULL once the table uses buckets
+	object_t *slots;
+	size_t    numSlots;
 } table_t;
 
+//A capacity of 0 makes a record
 table_t *_winter_tableAlloc(winterState_t *state, size_t capacity);
 void _winter_tableFree(winterState_t *state, table_t *table);
+//Drops every entry and frees the buckets, leaving an empty shell to be freed later
+//If 'cyclic' is false references to collectable values are not released
+void _winter_tableRelease(winterState_t *state, table_t *table, bool_t cyclic);
 
 object_t *_winter_tableInsert(winterState_t *state, table_t *table, object_t *key, object_t *value);
+//Inserts the key or replaces its value, releasing the previous one
+void _winter_tableSet(winterState_t *state, table_t *table, object_t *key, object_t *value);
 object_t *_winter_tableGetObject(table_t *table, object_t *key);
+//Sets each of the 'count' key and value pairs, or none of them if it runs out of memory
+void _winter_tableSetAll(winterState_t *state, table_t *table, object_t *pairs, size_t count);
+//Returns an empty table with room for 'count' entries, a record if the keys will be strings
+table_t *_winter_tableReserve(winterState_t *state, size_t count, bool_t record);
+//Returns a table of the 'count' key and value pairs sized for them up front, a record if
+//the keys are strings that fit in a shape. Later pairs replace earlier ones with the same key
+table_t *_winter_tableFrom(winterState_t *state, object_t *pairs, size_t count);
+
+//Field access through the inline cache of the instruction, which is NULL for shared chunks
+object_t *_winter_tableMissField(winterState_t *state, table_t *table, object_t *key, fieldCache_t *cache);
+void _winter_tableStoreMiss(winterState_t *state, table_t *table, object_t *key, object_t *value, fieldCache_t *cache);
+
+static inline object_t *_winter_tableGetField(winterState_t *state, table_t *table, object_t *key, fieldCache_t *cache) {
+	if (cache != NULL && table->shape != NULL) {
+		for (size_t way = 0; way < CACHE_WAYS; way++) {
+			if (cache->shapes[way] == table->shape && cache->next[way] == NULL) {
+				return &table->slots[cache->slots[way]];
+			}
+		}
+	}
+	return _winter_tableMissField(state, table, key, cache);
+}
+static inline void _winter_tableSetField(winterState_t *state, table_t *table, object_t *key, object_t *value, fieldCache_t *cache) {
+	if (cache != NULL && table->shape != NULL) {
+		for (size_t way = 0; way < CACHE_WAYS; way++) {
+			if (cache->shapes[way] == table->shape && cache->next[way] == NULL) {
+				object_t *slot = &table->slots[cache->slots[way]];
+				object_t previous = *slot;
+				*slot = *_winter_objectAddRef(state, value);
+				_winter_objectDelRef(state, &previous);
+				return;
+			}
+		}
+	}
+	_winter_tableStoreMiss(state, table, key, value, cache);
+}
+
+//Walks the entries in either layout
+typedef struct tableIter_t {
+	size_t    index;
+	bucket_t *bucket;
+	object_t *key, *value;
+} tableIter_t;
+
+//Moves to the next entry, false once they've all been visited
+static inline bool_t _winter_tableNext(const table_t *table, tableIter_t *it) {
+	if (table->shape != NULL) {
+		if (it->index == table->shape->count) return false;
+		it->key   = &table->shape->keys[it->index];
+		it->value = &table->slots[it->index++];
+		return true;
+	}
+	it->bucket = it->index++ == 0 ? table->head : it->bucket->next;
+	if (it->bucket == NULL) return false;
+	it->key   = &it->bucket->key;
+	it->value = &it->bucket->value;
+	return true;
+}
 
 #endif
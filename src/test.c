@@ -2,13 +2,13 @@
 #include "parser.h"
 #include "wstring.h"
 #include "table.h"
+#include "vm.h"
+#include "array.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
 
-ast_node_t *walkTree(winterState_t *state, ast_node_t *tree);
-
 static int allocs = 0;
 static int frees  = 0;
 
@@ -18,9 +18,11 @@ static inline void printObject(object_t *obj) {
 		case TYPE_ERROR:   printf("error: %s", obj->string->data); break;
 		case TYPE_NULL:    printf("null"); break;
 		case TYPE_REFERENCE: printf("ref -> "); printObject(obj->pointer); break;
-		case TYPE_INT:     printf("int: %lli", obj->integer); break;
+		case TYPE_INT:     printf("int: %lli", (long long)obj->integer); break;
 		case TYPE_FLOAT:   printf("float: %f", obj->floating); break;
 		case TYPE_STRING:  printf("string: \"%s\"", obj->string->data); break;
+		case TYPE_FUNCTION: printf("function"); break;
+		case TYPE_ARRAY:   printf("array of %zu", ((array_t*)obj->pointer)->length); break;
 		default: printf("object type: %i", obj->type); break;
 	}
 }
@@ -29,6 +31,10 @@ static inline void printAST(ast_node_t *tree, int level) {
 	for (int i = 1; i <= level; i++) {
 		printf("    |");
 	}
+	if (tree == NULL) {
+		printf("none\n");
+		return;
+	}
 	if (isOperator(tree->type) || tree->type == AST_PASS) {
 		printf("opr: %i\n", tree->type);
 		for (int i = 0; i < tree->numNodes; i++) {
@@ -44,6 +50,11 @@ static inline void printAST(ast_node_t *tree, int level) {
 	} else if (tree->type == AST_VALUE) {
 		printObject(&tree->value);
 		printf("\n");
+	} else if (tree->type == AST_CALL || tree->type == AST_FN || tree->type == AST_IF || tree->type == AST_RETURN) {
+		printf(tree->type == AST_CALL ? "call:\n" : tree->type == AST_FN ? "fn:\n" : tree->type == AST_IF ? "if:\n" : "return:\n");
+		for (size_t i = 0; i < tree->numNodes; i++) {
+			printAST(tree->children[i], level + 1);
+		}
 	} else if (tree->type == AST_LET) {
 		printf("let:\n");
 		for (size_t i = 0; i < tree->numNodes; i++) {
@@ -54,6 +65,14 @@ static inline void printAST(ast_node_t *tree, int level) {
 	}
 }
 
+static int print(winterState_t *state, winterValue_t *args, int argc) {
+	for (int i = 0; i < argc; i++) {
+		printObject(&args[i]);
+		printf(i < argc - 1 ? " " : "\n");
+	}
+	return 0;
+}
+
 void *allocator(void *ptr, size_t size) {
 	void *ret = NULL;
 	if (size) {
@@ -70,9 +89,101 @@ void *allocator(void *ptr, size_t size) {
 	return ret;
 }
 
+static char *readFile(const char *path) {
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) return NULL;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char *out = malloc(size + 1);
+	out[fread(out, 1, size, file)] = '\0';
+	fclose(file);
+	return out;
+}
+
+static int fileWriter(void *user, const void *data, size_t size) {
+	return fwrite(data, 1, size, user) == size ? 0 : -1;
+}
+
+#ifdef WINTER_EVENT_LOOP
+//Reports errors raised by coroutines the script spawned
+static void printFailure(void *user, winterState_t *state, const winterValue_t *result) {
+	if (winterTypeOf(result) == WINTER_ERROR) {
+		printObject((object_t*)result);
+		printf("\n");
+	}
+}
+#endif
+
+//winter file        runs a script, or a binary chunk if the name ends in .wbc
+//winter -c file out writes the binary chunk of a script
+static int runFile(winterState_t *state, int argc, char **argv) {
+	bool_t dump = strcmp(argv[1], "-c") == 0;
+	const char *path = argv[dump ? 2 : 1];
+	char error[256];
+	winterChunk_t *chunk;
+	
+	size_t length = strlen(path);
+	if (!dump && length > 4 && strcmp(path + length - 4, ".wbc") == 0) {
+		chunk = winterMapChunk(state, path, error, sizeof(error));
+	} else {
+		char *source = readFile(path);
+		if (source == NULL) {
+			printf("can't read %s\n", path);
+			return 1;
+		}
+		chunk = winterLoadString(state, source, error, sizeof(error));
+		free(source);
+	}
+	if (chunk == NULL) {
+		printf("error: %s\n", error);
+		return 1;
+	}
+	
+	int status = 0;
+	if (dump) {
+		FILE *out = argc > 3 ? fopen(argv[3], "wb") : NULL;
+		status = out == NULL || winterDumpChunk(state, chunk, false, fileWriter, out) != 0;
+		if (out != NULL) fclose(out);
+	} else {
+#ifdef WINTER_EVENT_LOOP
+		winterLoop_t *loop = winterCreateLoop(state, printFailure, NULL);
+#endif
+		const winterValue_t *result = winterRun(state, chunk);
+		printObject((object_t*)result);
+		printf("\n");
+		status = winterTypeOf(result) == WINTER_ERROR;
+#ifdef WINTER_EVENT_LOOP
+		//Coroutines the script spawned run once it returns
+		if (loop != NULL) {
+			if (status == 0) winterRunLoop(loop);
+			winterFreeLoop(loop);
+		}
+#endif
+	}
+	winterFreeChunk(state, chunk);
+	return status;
+}
+
 int main(int argc, char **argv) {
 	winterState_t *state = winterCreateState(allocator);
 	char buffer[512] = {0};
+	winterRegister(state, "print", print, -1);
+	winterOpenArrays(state);
+	winterOpenJson(state);
+	winterOpenPack(state);
+	winterOpenRegex(state);
+	//WINTER_JIT=0 runs everything in the interpreter
+	const char *jit = getenv("WINTER_JIT");
+	if (jit != NULL && strcmp(jit, "0") == 0) {
+		winterSetJit(state, 0);
+	}
+	
+	if (argc > 1) {
+		int status = runFile(state, argc, argv);
+		winterFreeState(state);
+		return status;
+	}
 	
 	printf("Winter interpreter v0.1\n");
 	
@@ -92,12 +203,10 @@ int main(int argc, char **argv) {
 		if (node != NULL) {
 			printAST(node, 0);
 			
-			node = walkTree(state, node);
-			
-			printObject(&node->value);
+			printObject(_winter_evaluate(state, node));
 			printf("\n");
-			_winter_objectDelRef(state, &node->value);
-			FREE(node);
+			_winter_stackPop(state, 1);
+			_winter_freeTree(state, node);
 		}
 	}
 	
@@ -0,0 +1,206 @@
+#include "utf8.h"
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(WINTER_NO_SIMD)
+#define UTF8_AVX2
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+#define HIGH_BITS 0x8080808080808080ull
+
+//Length of the run of ASCII bytes at the start
+static size_t asciiRun(const unsigned char *p, size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t word;
+		memcpy(&word, p + i, 8);
+		if (word & HIGH_BITS) break;
+	}
+	while (i < n && p[i] < 0x80) i++;
+	return i;
+}
+
+static stringEncoding_t checkScalar(const unsigned char *p, size_t n) {
+	size_t i = asciiRun(p, n);
+	if (i == n) {
+		return STRING_ASCII;
+	}
+	while (i < n) {
+		unsigned char lead = p[i];
+		if (lead < 0x80) {
+			i += asciiRun(p + i, n - i);
+			continue;
+		}
+		size_t follow;
+		uint32_t codepoint, least;
+		if (lead >= 0xc2 && lead <= 0xdf) {
+			follow = 1; codepoint = lead & 0x1f; least = 0x80;
+		} else if (lead >= 0xe0 && lead <= 0xef) {
+			follow = 2; codepoint = lead & 0x0f; least = 0x800;
+		} else if (lead >= 0xf0 && lead <= 0xf4) {
+			follow = 3; codepoint = lead & 0x07; least = 0x10000;
+		} else {
+			return STRING_BINARY;
+		}
+		if (n - i - 1 < follow) {
+			return STRING_BINARY;
+		}
+		for (size_t k = 1; k <= follow; k++) {
+			if ((p[i + k] & 0xc0) != 0x80) {
+				return STRING_BINARY;
+			}
+			codepoint = codepoint << 6 | (p[i + k] & 0x3f);
+		}
+		if (codepoint < least || codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint <= 0xdfff)) {
+			return STRING_BINARY;
+		}
+		i += follow + 1;
+	}
+	return STRING_UTF8;
+}
+
+#ifdef UTF8_AVX2
+//Error classes of a pair of bytes, the lookups of both bytes of a valid pair share none
+enum {
+	TOO_SHORT      = 1 << 0, //lead then no continuation
+	TOO_LONG       = 1 << 1, //ASCII then continuation
+	OVERLONG_3     = 1 << 2,
+	TOO_LARGE      = 1 << 3,
+	SURROGATE      = 1 << 4,
+	OVERLONG_2     = 1 << 5,
+	TOO_LARGE_1000 = 1 << 6,
+	OVERLONG_4     = 1 << 6,
+	TWO_CONTS      = 1 << 7, //allowed when the bytes before make it a third or fourth byte
+	CARRY          = TOO_SHORT | TOO_LONG | TWO_CONTS
+};
+
+//Looked up by the high nibble of the first byte of a pair, its low nibble and the high
+//nibble of the second byte
+static const uint8_t firstHigh[16] = {
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+	TOO_SHORT | OVERLONG_2,
+	TOO_SHORT,
+	TOO_SHORT | OVERLONG_3 | SURROGATE,
+	TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+};
+static const uint8_t firstLow[16] = {
+	CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+	CARRY | OVERLONG_2,
+	CARRY,
+	CARRY,
+	CARRY | TOO_LARGE,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000
+};
+static const uint8_t secondHigh[16] = {
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+};
+
+AVX2 static inline __m256i lookup(const uint8_t *table, __m256i nibbles) {
+	return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table)), nibbles);
+}
+
+//The block shifted right by one, two or three bytes with the end of the one before
+#define PREVIOUS(input, previous, n) \
+	_mm256_alignr_epi8((input), _mm256_permute2x128_si256((previous), (input), 0x21), 16 - (n))
+
+AVX2 static inline __m256i checkBlock(__m256i input, __m256i previous) {
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	
+	__m256i prev1 = PREVIOUS(input, previous, 1);
+	__m256i errors = _mm256_and_si256(
+		_mm256_and_si256(
+			lookup(firstHigh, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low)),
+			lookup(firstLow, _mm256_and_si256(prev1, low))),
+		lookup(secondHigh, _mm256_and_si256(_mm256_srli_epi16(input, 4), low)));
+	
+	//Two continuations in a row are right where the byte two back leads three or more, or
+	//the byte three back leads four
+	__m256i third  = _mm256_subs_epu8(PREVIOUS(input, previous, 2), _mm256_set1_epi8(0xe0 - 0x80));
+	__m256i fourth = _mm256_subs_epu8(PREVIOUS(input, previous, 3), _mm256_set1_epi8(0xf0 - 0x80));
+	__m256i must = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+	return _mm256_xor_si256(must, errors);
+}
+
+//Nonzero where the last three bytes start a sequence that goes past the block
+AVX2 static inline __m256i incomplete(__m256i input) {
+	const __m256i most = _mm256_setr_epi8(
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		(char)0xef, (char)0xdf, (char)0xbf);
+	return _mm256_subs_epu8(input, most);
+}
+
+AVX2 static stringEncoding_t checkAvx2(const unsigned char *p, size_t n) {
+	__m256i errors = _mm256_setzero_si256(), previous = errors, pending = errors;
+	bool_t ascii = true;
+	unsigned char tail[32];
+	for (size_t i = 0; i < n; i += 32) {
+		__m256i input;
+		if (n - i >= 32) {
+			input = _mm256_loadu_si256((const __m256i*)(p + i));
+		} else {
+			//Padded with NULs, which end a sequence left open like any ASCII would
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, p + i, n - i);
+			input = _mm256_loadu_si256((const __m256i*)tail);
+		}
+		if (_mm256_movemask_epi8(input) == 0) {
+			errors  = _mm256_or_si256(errors, pending);
+			pending = _mm256_setzero_si256();
+		} else {
+			ascii   = false;
+			errors  = _mm256_or_si256(errors, checkBlock(input, previous));
+			pending = incomplete(input);
+		}
+		previous = input;
+	}
+	errors = _mm256_or_si256(errors, pending);
+	if (!_mm256_testz_si256(errors, errors)) {
+		return STRING_BINARY;
+	}
+	return ascii ? STRING_ASCII : STRING_UTF8;
+}
+#endif
+
+stringEncoding_t _winter_utf8Check(const char *data, size_t length) {
+#ifdef UTF8_AVX2
+	if (length >= 32 && __builtin_cpu_supports("avx2")) {
+		return checkAvx2((const unsigned char*)data, length);
+	}
+#endif
+	return checkScalar((const unsigned char*)data, length);
+}
+
+size_t _winter_utf8Count(const char *data, size_t length) {
+	const unsigned char *p = (const unsigned char*)data;
+	size_t count = 0, i = 0;
+	//Every byte but a continuation, 10xxxxxx, starts a codepoint
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, p + i, 8);
+		uint64_t continuation = word & ~(word << 1) & HIGH_BITS;
+		count += 8 - (size_t)__builtin_popcountll(continuation);
+	}
+	for (; i < length; i++) {
+		count += (p[i] & 0xc0) != 0x80;
+	}
+	return count;
+}
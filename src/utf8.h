@@ -0,0 +1,27 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include "wtype.h"
+#include "wstring.h"
+
+//UTF-8 validation and counting for the encoding of strings, see wstring.h
+//
+//On x86-64 with GCC or Clang validation checks 32 bytes at a time with AVX2 when the CPU
+//has it. Each byte is classified by table lookups on its high nibble and on both nibbles of
+//the byte before it, which finds every error a pair of bytes can show: overlong forms,
+//surrogates, codepoints past U+10FFFF and misplaced continuation bytes. Whether the third
+//and fourth bytes of a sequence are continuations is checked against the bytes two and
+//three back. Blocks of only ASCII skip all of that. Other builds and short strings use the
+//scalar version, which skips ASCII 8 bytes at a time. Build with WINTER_NO_SIMD for it only
+
+//STRING_ASCII, STRING_UTF8 or STRING_BINARY for the bytes
+stringEncoding_t _winter_utf8Check(const char *data, size_t length);
+//Codepoints in valid UTF-8
+size_t _winter_utf8Count(const char *data, size_t length);
+
+//Bytes of the sequence started by a lead byte of valid UTF-8
+static inline size_t _winter_utf8Size(unsigned char lead) {
+	return lead < 0x80 ? 1 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+}
+
+#endif
@@ -0,0 +1,736 @@
+#include "vm.h"
+#include "table.h"
+#include "wstring.h"
+#include "function.h"
+#include "compiler.h"
+#include "gc.h"
+#include "frozen.h"
+#include "shape.h"
+#include "array.h"
+#include <string.h>
+
+#ifdef WINTER_JIT
+#include "jit.h"
+#endif
+
+#define TOP (&state->stack[state->top - 1])
+
+void _winter_stackInit(winterState_t *state) {
+	state->stack         = MALLOC(sizeof(object_t) * STACK_DEFAULT_SIZE);
+	state->stackSize     = STACK_DEFAULT_SIZE;
+	state->top           = 0;
+	state->frames        = MALLOC(sizeof(frame_t) * FRAMES_DEFAULT_SIZE);
+	state->numFrames     = 0;
+	state->frameCapacity = FRAMES_DEFAULT_SIZE;
+	state->openUpvalues  = NULL;
+	state->coroutine     = NULL;
+	state->coroutines    = NULL;
+}
+void _winter_stackFree(winterState_t *state) {
+	FREE(state->stack);
+	FREE(state->frames);
+	state->stack         = NULL;
+	state->stackSize     = 0;
+	state->top           = 0;
+	state->frames        = NULL;
+	state->numFrames     = 0;
+	state->frameCapacity = 0;
+}
+
+//Grows the stack to hold at least 'size' values, pointers into it are invalidated
+static inline void stackReserve(winterState_t *state, size_t size) {
+	if (size > state->stackSize) {
+		size_t capacity = state->stackSize;
+		while (capacity < size) {
+			capacity *= 2;
+		}
+		state->stack = REALLOC(state->stack, sizeof(object_t) * capacity);
+		state->stackSize = capacity;
+	}
+}
+
+object_t *_winter_stackPush(winterState_t *state, const object_t *value) {
+	stackReserve(state, state->top + 1);
+	object_t *slot = &state->stack[state->top++];
+	*slot = *value;
+	return slot;
+}
+void _winter_stackPop(winterState_t *state, size_t count) {
+	state->top -= count;
+}
+
+//Sets up the registers of a closure whose 'argc' arguments start at 'base'
+static inline void enterFrame(winterState_t *state, frame_t *frame, function_t *function, size_t base, int argc) {
+	proto_t *proto = function->proto;
+	size_t top = base + proto->numRegisters;
+	stackReserve(state, top);
+	for (size_t i = base + argc; i < top; i++) {
+		state->stack[i] = (object_t){ TYPE_NULL };
+	}
+	state->top = top;
+	
+#ifdef WINTER_JIT
+	//Shared prototypes are read by other threads at the same time, so they stay interpreted
+	if (proto->jit == NULL && proto->shared == NULL && state->jit && ++proto->hotness == JIT_THRESHOLD) {
+		_winter_jitCompile(state, proto);
+	}
+#endif
+	frame->function = function;
+	frame->pc       = proto->code;
+	frame->base     = base;
+}
+static inline bool_t pushFrame(winterState_t *state, function_t *function, size_t base, int argc) {
+	if (state->numFrames == MAX_FRAMES) {
+		return false;
+	} else if (state->numFrames == state->frameCapacity) {
+		state->frames = REALLOC(state->frames, sizeof(frame_t) * state->frameCapacity * 2);
+		state->frameCapacity *= 2;
+	}
+	enterFrame(state, &state->frames[state->numFrames++], function, base, argc);
+	return true;
+}
+
+//Stores an error and returns false if the value can't be called with 'argc' arguments
+static inline bool_t checkCall(winterState_t *state, const object_t *callee, int argc, object_t *error) {
+	if (callee->type != TYPE_FUNCTION) {
+		_winter_objectNewError(state, error, "attempt to call a value that isn't a function");
+		return false;
+	}
+	function_t *function = callee->pointer;
+	if (function->arity != ARITY_VARIADIC && function->arity != argc) {
+		_winter_objectNewError(state, error, "function expects %i arguments, got %i", function->arity, argc);
+		return false;
+	}
+	return true;
+}
+
+//Errors raised by the VM itself say which line they happened on
+static void locate(winterState_t *state, object_t *error, const proto_t *proto, const uint32_t *pc) {
+	if (proto->lines != NULL) {
+		uint32_t line = proto->lines[pc - 1 - proto->code];
+		if (line != 0) {
+			_winter_objectNewError(state, error, "line %u: %s", (unsigned)line, error->string->data);
+		}
+	}
+}
+
+//Inline cache of the field instruction, shared chunks may be running on other threads so
+//they don't get any
+static inline fieldCache_t *fieldCache(winterState_t *state, proto_t *proto, uint32_t extra) {
+	if (proto->shared != NULL) {
+		return NULL;
+	} else if (proto->caches == NULL) {
+		_winter_protoCaches(state, proto);
+	}
+	return &proto->caches[GET_BX(extra)];
+}
+
+//Every live value must be on the stack
+#define SAFE_POINT() do { _winter_zctCheck(state); _winter_gcCheck(state); } while (0)
+
+#define R(x) (&regs[x])
+#define K(x) (&constants[x])
+#ifdef WINTER_JIT
+#define LOAD_JIT() (jit = state->jit ? frame->function->proto->jit : NULL)
+#else
+#define LOAD_JIT() ((void)0)
+#endif
+#define LOAD_FRAME() do {                              \
+	frame     = &state->frames[state->numFrames - 1];  \
+	regs      = &state->stack[frame->base];            \
+	pc        = frame->pc;                             \
+	constants = frame->function->proto->constants;     \
+	LOAD_JIT();                                        \
+} while (0)
+#define RAISE(...) do {                                \
+	_winter_objectNewError(state, &result, __VA_ARGS__); \
+	goto located;                                      \
+} while (0)
+
+#define ARITHMETIC(function) do {                      \
+	result = *R(GET_B(i));                             \
+	int status = function(state, &result, R(GET_C(i))); \
+	if (status != OBJECT_OK) {                         \
+		RAISE(status == OBJECT_ERROR_ZERO ? "division by zero" : "incompatible type"); \
+	}                                                  \
+	*R(GET_A(i)) = result;                             \
+} while (0)
+
+//Integers skip the generic object functions, breaks out of the instruction
+#define INTEGER(op) {                                  \
+	object_t *b = R(GET_B(i)), *c = R(GET_C(i));       \
+	if (b->type == TYPE_INT && c->type == TYPE_INT) {  \
+		*R(GET_A(i)) = (object_t){ TYPE_INT, { .integer = b->integer op c->integer } }; \
+		break;                                         \
+	}                                                  \
+}
+
+//Runs frames until the one at index 'entry' returns
+static void execute(winterState_t *state, size_t entry) {
+	frame_t        *frame;
+	object_t       *regs;
+	const uint32_t *pc;
+	object_t       *constants;
+	object_t        result;
+#ifdef WINTER_JIT
+	jit_t          *jit;
+#endif
+	LOAD_FRAME();
+	
+	while (1) {
+#ifdef WINTER_JIT
+		//Runs compiled code until it reaches an instruction left to the interpreter
+		if (jit != NULL && _winter_jitCompiled(jit, pc)) {
+			pc = _winter_jitRun(state, jit, regs, constants, pc);
+		}
+#endif
+		uint32_t i = *pc++;
+		switch (GET_OP(i)) {
+			case OP_MOVE:     *R(GET_A(i)) = *R(GET_B(i)); break;
+			case OP_LOADK:    *R(GET_A(i)) = *K(GET_BX(i)); break;
+			case OP_LOADNULL: *R(GET_A(i)) = (object_t){ TYPE_NULL }; break;
+			
+			case OP_GETGLOBAL: {
+				object_t *value = _winter_tableGetObject(state->globals, K(GET_BX(i)));
+				if (value == NULL) {
+					RAISE("undeclared identifier '%s'", K(GET_BX(i))->string->data);
+				}
+				*R(GET_A(i)) = *value;
+			} break;
+			
+			case OP_SETGLOBAL: {
+				object_t *value = _winter_tableGetObject(state->globals, K(GET_BX(i)));
+				if (value == NULL) {
+					RAISE("undeclared identifier '%s'", K(GET_BX(i))->string->data);
+				}
+				object_t previous = *value;
+				*value = *_winter_objectAddRef(state, R(GET_A(i)));
+				_winter_objectDelRef(state, &previous);
+			} break;
+			
+			case OP_DEFGLOBAL:
+				if (_winter_tableGetObject(state->globals, K(GET_BX(i))) != NULL) {
+					RAISE("multiple declarations of '%s'", K(GET_BX(i))->string->data);
+				}
+				_winter_tableInsert(state, state->globals, K(GET_BX(i)), R(GET_A(i)));
+				break;
+			
+			case OP_GETUPVAL:
+				*R(GET_A(i)) = *_winter_upvalueGet(state, frame->function->upvalues[GET_B(i)]);
+				break;
+			
+			case OP_SETUPVAL: {
+				//Closed upvalues are on the heap and hold a counted reference
+				upvalue_t *upvalue = frame->function->upvalues[GET_B(i)];
+				if (upvalue->open) {
+					state->stack[upvalue->index] = *R(GET_A(i));
+				} else {
+					object_t previous = upvalue->closed;
+					upvalue->closed = *_winter_objectAddRef(state, R(GET_A(i)));
+					_winter_objectDelRef(state, &previous);
+				}
+			} break;
+			
+			case OP_GETINDEX: {
+				object_t *table = R(GET_B(i));
+				const object_t *value;
+				if (table->type == TYPE_TABLE) {
+					value = _winter_tableGetObject(table->pointer, R(GET_C(i)));
+				} else if (table->type == TYPE_FROZEN) {
+					value = _winter_frozenGet(table->pointer, R(GET_C(i)));
+				} else if (table->type == TYPE_ARRAY) {
+					array_t *array = table->pointer;
+					object_t *index = R(GET_C(i));
+					if (index->type != TYPE_INT || index->integer < 0 || (size_t)index->integer >= array->length) {
+						RAISE("array index out of range");
+					}
+					*R(GET_A(i)) = _winter_arrayGet(array, (size_t)index->integer);
+					break;
+				} else if (table->type == TYPE_STRING) {
+					//The codepoint as a string
+					wstring_t *string = table->string;
+					object_t *index = R(GET_C(i));
+					if (index->type != TYPE_INT || index->integer < 0 || (size_t)index->integer >= _winter_stringLength(state, string)) {
+						RAISE("string index out of range");
+					}
+					size_t size, offset = _winter_stringOffset(state, string, (size_t)index->integer, &size);
+					*R(GET_A(i)) = (object_t){ TYPE_STRING, { .string = _winter_stringCreateSize(state, string->data + offset, size) } };
+					break;
+				} else {
+					RAISE("attempt to index a value that isn't a table");
+				}
+				*R(GET_A(i)) = value != NULL ? *value : (object_t){ TYPE_NULL };
+			} break;
+			
+			case OP_SETINDEX: {
+				object_t *table = R(GET_A(i));
+				if (table->type == TYPE_FROZEN) {
+					RAISE("attempt to modify a frozen table");
+				} else if (table->type == TYPE_ARRAY) {
+					array_t *array = table->pointer;
+					object_t *index = R(GET_B(i));
+					if (index->type != TYPE_INT || index->integer < 0 || (size_t)index->integer >= array->length) {
+						RAISE("array index out of range");
+					} else if (array->readOnly) {
+						RAISE("attempt to modify a read only array");
+					} else if (!_winter_arraySet(array, (size_t)index->integer, R(GET_C(i)))) {
+						RAISE("arrays only hold numbers");
+					}
+					break;
+				} else if (table->type != TYPE_TABLE) {
+					RAISE("attempt to index a value that isn't a table");
+				}
+				_winter_tableSet(state, table->pointer, R(GET_B(i)), R(GET_C(i)));
+			} break;
+			
+			case OP_GETFIELD: {
+				object_t *table = R(GET_B(i));
+				fieldCache_t *cache = fieldCache(state, frame->function->proto, *pc++);
+				const object_t *value;
+				if (table->type == TYPE_TABLE) {
+					value = _winter_tableGetField(state, table->pointer, K(GET_C(i)), cache);
+				} else if (table->type == TYPE_FROZEN) {
+					value = _winter_frozenGet(table->pointer, K(GET_C(i)));
+				} else {
+					RAISE("attempt to index a value that isn't a table");
+				}
+				*R(GET_A(i)) = value != NULL ? *value : (object_t){ TYPE_NULL };
+			} break;
+			
+			case OP_SETFIELD: {
+				object_t *table = R(GET_A(i));
+				fieldCache_t *cache = fieldCache(state, frame->function->proto, *pc++);
+				if (table->type == TYPE_FROZEN) {
+					RAISE("attempt to modify a frozen table");
+				} else if (table->type != TYPE_TABLE) {
+					RAISE("attempt to index a value that isn't a table");
+				}
+				_winter_tableSetField(state, table->pointer, K(GET_B(i)), R(GET_C(i)), cache);
+			} break;
+			
+			case OP_NEWTABLE:
+				*R(GET_A(i)) = (object_t){ TYPE_TABLE, { .pointer = _winter_tableAlloc(state, 0) } };
+				_winter_zctCheck(state);
+				break;
+			
+			case OP_EXTRA: break;
+			
+			case OP_ADD:
+				INTEGER(+)
+				ARITHMETIC(_winter_objectAdd);
+				_winter_zctCheck(state);
+				break;
+			case OP_SUB:     INTEGER(-)  ARITHMETIC(_winter_objectSub);       break;
+			case OP_MUL:     INTEGER(*)  ARITHMETIC(_winter_objectMul);       break;
+			case OP_DIV:                  ARITHMETIC(_winter_objectDiv);       break;
+			case OP_MOD:                  ARITHMETIC(_winter_objectMod);       break;
+			case OP_POW:                  ARITHMETIC(_winter_objectPow);       break;
+			case OP_EQ:      INTEGER(==) ARITHMETIC(_winter_objectEq);        break;
+			case OP_NOTEQ:   INTEGER(!=) ARITHMETIC(_winter_objectNotEq);     break;
+			case OP_LESS:    INTEGER(<)  ARITHMETIC(_winter_objectLess);      break;
+			case OP_LEQ:     INTEGER(<=) ARITHMETIC(_winter_objectLessEq);    break;
+			case OP_GREATER: INTEGER(>)  ARITHMETIC(_winter_objectGreater);   break;
+			case OP_GEQ:     INTEGER(>=) ARITHMETIC(_winter_objectGreaterEq); break;
+			
+			case OP_NEGATE:
+				result = *R(GET_B(i));
+				if (_winter_objectNegate(state, &result) != OBJECT_OK) {
+					RAISE("incompatible type");
+				}
+				*R(GET_A(i)) = result;
+				break;
+			
+			case OP_JMP:
+				pc += GET_SBX(i);
+				break;
+			case OP_JMPIFNOT:
+				if (!_winter_objectTruthy(R(GET_A(i)))) {
+					pc += GET_SBX(i);
+				}
+				break;
+			
+			case OP_CLOSURE: {
+				proto_t *proto = frame->function->proto->protos[GET_BX(i)];
+				function_t *closure = _winter_closureAlloc(state, proto);
+				*R(GET_A(i)) = (object_t){ TYPE_FUNCTION, { .pointer = closure } };
+				
+				for (size_t u = 0; u < proto->numUpvalues; u++) {
+					upvaldesc_t *desc = &proto->upvalues[u];
+					upvalue_t *upvalue = desc->fromLocal ?
+						_winter_upvalueFind(state, frame->base + desc->index) :
+						frame->function->upvalues[desc->index];
+					
+					object_t obj = { TYPE_UPVALUE, { .pointer = upvalue } };
+					_winter_objectAddRef(state, &obj);
+					closure->upvalues[closure->numUpvalues++] = upvalue;
+				}
+				SAFE_POINT();
+			} break;
+			
+			case OP_CLOSE:
+				_winter_upvalueClose(state, frame->base + GET_A(i));
+				break;
+			
+			case OP_CALL:
+			case OP_TAILCALL: {
+				int a = GET_A(i), argc = GET_B(i);
+				if (!checkCall(state, R(a), argc, &result)) {
+					goto located;
+				}
+				
+				function_t *function = R(a)->pointer;
+				if (function->native != NULL) {
+					_winter_functionCall(state, function, R(a + 1), argc);
+					//Natives that call back into scripts can move the frames and the stack
+					frame = &state->frames[state->numFrames - 1];
+					regs  = &state->stack[frame->base];
+					*R(a) = *R(a + 1);
+					if (R(a)->type == TYPE_ERROR) {
+						result = *R(a);
+						goto raise;
+					}
+					SAFE_POINT();
+					
+					if (GET_OP(i) == OP_TAILCALL) {
+						result = *R(a);
+						goto ret;
+					}
+				} else if (GET_OP(i) == OP_CALL) {
+					frame->pc = pc;
+					if (!pushFrame(state, function, frame->base + a + 1, argc)) {
+						RAISE("stack overflow");
+					}
+					LOAD_FRAME();
+				} else {
+					//The callee and its arguments replace the running closure
+					size_t base = frame->base;
+					_winter_upvalueClose(state, base);
+					memmove(&state->stack[base - 1], R(a), sizeof(object_t) * (argc + 1));
+					enterFrame(state, frame, function, base, argc);
+					LOAD_FRAME();
+				}
+			} break;
+			
+			case OP_YIELD:
+				//The frames of a coroutine can only be kept if no native call is below them
+				if (state->coroutine == NULL) {
+					RAISE("attempt to yield outside of a coroutine");
+				} else if (entry != 0) {
+					RAISE("attempt to yield across a native call");
+				}
+				frame->pc = pc;
+				state->coroutine->value   = GET_B(i) ? *R(GET_A(i)) : (object_t){ TYPE_NULL };
+				state->coroutine->yielded = true;
+				return;
+			
+			case OP_RETURN:
+				result = GET_B(i) ? *R(GET_A(i)) : (object_t){ TYPE_NULL };
+			ret:
+				_winter_upvalueClose(state, frame->base);
+				state->stack[frame->base - 1] = result;
+				if (--state->numFrames == entry) {
+					state->top = frame->base;
+					return;
+				}
+				LOAD_FRAME();
+				state->top = frame->base + frame->function->proto->numRegisters;
+				SAFE_POINT();
+				break;
+		}
+	}
+	
+located:
+	locate(state, &result, frame->function->proto, pc);
+raise:
+	//Errors unwind every frame of this call
+	frame = &state->frames[entry];
+	_winter_upvalueClose(state, frame->base - 1);
+	state->stack[frame->base - 1] = result;
+	state->numFrames = entry;
+	state->top = frame->base;
+}
+
+void _winter_call(winterState_t *state, size_t func, int argc) {
+	object_t *callee = &state->stack[func];
+	if (!checkCall(state, callee, argc, callee)) {
+		state->top = func + 1;
+		return;
+	}
+	
+	function_t *function = callee->pointer;
+	if (function->native != NULL) {
+		if (argc == 0) {
+			_winter_stackPush(state, &(object_t){ TYPE_NULL });
+		}
+		_winter_functionCall(state, function, &state->stack[func + 1], argc);
+		state->stack[func] = state->stack[func + 1];
+		state->top = func + 1;
+		return;
+	}
+	
+	size_t entry = state->numFrames;
+	if (!pushFrame(state, function, func + 1, argc)) {
+		_winter_objectNewError(state, &state->stack[func], "stack overflow");
+		state->top = func + 1;
+		return;
+	}
+	execute(state, entry);
+}
+
+//Calls a closure of the prototype and pushes the result
+static object_t *run(winterState_t *state, proto_t *proto) {
+	volatile size_t base = state->top;
+	size_t frames = state->numFrames;
+	_winter_stackPush(state, &(object_t){ TYPE_NULL });
+	
+	jmp_buf handler, *previous = state->errorJump;
+	state->errorJump = &handler;
+	if (setjmp(handler) == 0) {
+		if (proto->shared != NULL) {
+			_winter_sharedHold(state, proto->shared);
+		}
+		state->stack[base] = (object_t){ TYPE_FUNCTION, { .pointer = _winter_closureAlloc(state, proto) } };
+		_winter_call(state, base, 0);
+	} else {
+		//Raised errors discard everything the evaluation pushed
+		_winter_upvalueClose(state, base);
+		state->numFrames = frames;
+		state->top = base;
+		_winter_stackPush(state, &(object_t){ TYPE_ERROR, { .string = state->memoryError } });
+	}
+	
+	state->errorJump = previous;
+	return TOP;
+}
+
+object_t *_winter_evaluate(winterState_t *state, ast_node_t *tree) {
+	object_t result;
+	proto_t *proto = _winter_compile(state, tree, &result);
+	if (proto == NULL) {
+		return _winter_stackPush(state, &result);
+	}
+	object_t *out = run(state, proto);
+	_winter_protoRelease(state, proto);
+	return out;
+}
+
+const winterValue_t *winterRun(winterState_t *state, winterChunk_t *chunk) {
+	//Outside of any call the stack only holds the previous result
+	if (state->numFrames == 0) {
+		state->top = 0;
+	}
+	return run(state, chunk);
+}
+
+const winterValue_t *winterCall(winterState_t *state, const char *name, const winterValue_t *args, int argc) {
+	wstring_t key = { REF_PERSISTENT, false, TYPE_STRING, false, STRING_UNCHECKED, 0, strlen(name), 0, (char*)name, NULL };
+	object_t *function = _winter_tableGetObject(state->globals, &(object_t){ TYPE_STRING, { .string = &key } });
+	//Undefined names fail like any other value that isn't a function
+	return _winter_callValue(state, function ? function : &(object_t){ TYPE_NULL }, args, argc);
+}
+
+const object_t *_winter_callValue(winterState_t *state, const object_t *function, const object_t *args, int argc) {
+	if (state->numFrames == 0) {
+		state->top = 0;
+	}
+	size_t base = state->top, frames = state->numFrames;
+	
+	jmp_buf handler, *previous = state->errorJump;
+	state->errorJump = &handler;
+	if (setjmp(handler) == 0) {
+		_winter_stackPush(state, function);
+		for (int i = 0; i < argc; i++) {
+			_winter_frozenHold(state, &args[i]);
+			_winter_stackPush(state, &args[i]);
+		}
+		_winter_call(state, base, argc);
+	} else {
+		_winter_upvalueClose(state, base);
+		state->numFrames = frames;
+		state->top = base;
+		_winter_stackPush(state, &(object_t){ TYPE_ERROR, { .string = state->memoryError } });
+	}
+	
+	state->errorJump = previous;
+	return TOP;
+}
+
+void winterSetJit(winterState_t *state, int enabled) {
+	state->jit = enabled != 0;
+}
+
+//Coroutines
+
+static inline void swapStacks(winterState_t *state, coroutine_t *coroutine) {
+	coroutine_t running = { state->stack, state->stackSize, state->top, state->frames,
+							state->numFrames, state->frameCapacity, state->openUpvalues };
+	state->stack         = coroutine->stack;
+	state->stackSize     = coroutine->stackSize;
+	state->top           = coroutine->top;
+	state->frames        = coroutine->frames;
+	state->numFrames     = coroutine->numFrames;
+	state->frameCapacity = coroutine->frameCapacity;
+	state->openUpvalues  = coroutine->openUpvalues;
+	coroutine->stack         = running.stack;
+	coroutine->stackSize     = running.stackSize;
+	coroutine->top           = running.top;
+	coroutine->frames        = running.frames;
+	coroutine->numFrames     = running.numFrames;
+	coroutine->frameCapacity = running.frameCapacity;
+	coroutine->openUpvalues  = running.openUpvalues;
+}
+
+//Counts the references of the running stack before it's swapped out, see coroutine_t
+static void suspend(winterState_t *state) {
+	for (size_t i = 0; i < state->top; i++) {
+		_winter_objectAddRef(state, &state->stack[i]);
+	}
+	for (upvalue_t *upvalue = state->openUpvalues; upvalue != NULL; upvalue = upvalue->next) {
+		upvalue->closed = *_winter_objectAddRef(state, &state->stack[upvalue->index]);
+		upvalue->open   = false;
+	}
+}
+//Undoes suspend once the stack is swapped back in, escaped closures may have changed the upvalues
+static void reopen(winterState_t *state) {
+	for (upvalue_t *upvalue = state->openUpvalues; upvalue != NULL; upvalue = upvalue->next) {
+		object_t previous = state->stack[upvalue->index];
+		state->stack[upvalue->index] = upvalue->closed;
+		upvalue->closed = (object_t){ TYPE_NULL };
+		upvalue->open   = true;
+		_winter_objectDelRef(state, &previous);
+	}
+	for (size_t i = 0; i < state->top; i++) {
+		_winter_objectDelRef(state, &state->stack[i]);
+	}
+}
+
+winterCoroutine_t *winterCreateCoroutine(winterState_t *state, const char *name, const winterValue_t *args, int argc) {
+	wstring_t key = { REF_PERSISTENT, false, TYPE_STRING, false, STRING_UNCHECKED, 0, strlen(name), 0, (char*)name, NULL };
+	object_t *function = _winter_tableGetObject(state->globals, &(object_t){ TYPE_STRING, { .string = &key } });
+	
+	size_t size = COROUTINE_STACK_SIZE;
+	while (size < (size_t)argc + 1) {
+		size *= 2;
+	}
+	//Every part is allocated before any is linked in, so running out of memory leaks none
+	coroutine_t *coroutine = _winter_poolTryAlloc(state, NULL, sizeof(coroutine_t));
+	object_t *stack = _winter_poolTryAlloc(state, NULL, sizeof(object_t) * size);
+	frame_t *frames = _winter_poolTryAlloc(state, NULL, sizeof(frame_t) * COROUTINE_FRAMES_SIZE);
+	if (coroutine == NULL || stack == NULL || frames == NULL) {
+		FREE(coroutine);
+		FREE(stack);
+		FREE(frames);
+		_winter_memoryError(state);
+		return NULL;
+	}
+	*coroutine = (coroutine_t){0};
+	coroutine->stack         = stack;
+	coroutine->stackSize     = size;
+	coroutine->frames        = frames;
+	coroutine->frameCapacity = COROUTINE_FRAMES_SIZE;
+	coroutine->status        = WINTER_SUSPENDED;
+	coroutine->next          = state->coroutines;
+	if (coroutine->next != NULL) {
+		coroutine->next->prev = coroutine;
+	}
+	state->coroutines = coroutine;
+	
+	//Starts out suspended on the call, undefined names fail once it's resumed
+	coroutine->stack[coroutine->top++] = function ? *function : (object_t){ TYPE_NULL };
+	for (int i = 0; i < argc; i++) {
+		_winter_frozenHold(state, &args[i]);
+		coroutine->stack[coroutine->top++] = args[i];
+	}
+	for (size_t i = 0; i < coroutine->top; i++) {
+		_winter_objectAddRef(state, &coroutine->stack[i]);
+	}
+	return coroutine;
+}
+
+//Takes the value as a copy, the host's pointer isn't kept across setjmp
+static const winterValue_t *resume(winterState_t *state, winterCoroutine_t *coroutine, object_t resumed) {
+	object_t result;
+	if (state->coroutine != NULL) {
+		_winter_objectNewError(state, &result, "attempt to resume a coroutine from inside one");
+		return _winter_stackPush(state, &result);
+	}
+	//The caller's stack would be swapped out where the collector can't see it
+	if (state->numFrames != 0) {
+		_winter_objectNewError(state, &result, "attempt to resume a coroutine from a native call");
+		return _winter_stackPush(state, &result);
+	}
+	state->top = 0;
+	if (coroutine->status != WINTER_SUSPENDED) {
+		_winter_objectNewError(state, &result, "attempt to resume a finished coroutine");
+		return _winter_stackPush(state, &result);
+	}
+	
+	swapStacks(state, coroutine);
+	state->coroutine = coroutine;
+	jmp_buf handler, *previous = state->errorJump;
+	state->errorJump = &handler;
+	if (setjmp(handler) == 0) {
+		_winter_frozenHold(state, &resumed);
+		reopen(state);
+		coroutine->yielded = false;
+		if (state->numFrames == 0) {
+			//First resume, the function and its arguments are on the stack
+			_winter_call(state, 0, (int)state->top - 1);
+		} else {
+			frame_t *frame = &state->frames[state->numFrames - 1];
+			state->stack[frame->base + GET_A(frame->pc[-1])] = resumed;
+			execute(state, 0);
+		}
+		
+		if (coroutine->yielded) {
+			result = coroutine->value;
+			suspend(state);
+		} else {
+			result = state->stack[0];
+			coroutine->status = WINTER_FINISHED;
+		}
+	} else {
+		_winter_upvalueClose(state, 0);
+		state->numFrames = 0;
+		state->top = 0;
+		result = (object_t){ TYPE_ERROR, { .string = state->memoryError } };
+		coroutine->status = WINTER_FINISHED;
+	}
+	state->errorJump = previous;
+	state->coroutine = NULL;
+	swapStacks(state, coroutine);
+	return _winter_stackPush(state, &result);
+}
+const winterValue_t *winterResume(winterState_t *state, winterCoroutine_t *coroutine, const winterValue_t *value) {
+	return resume(state, coroutine, value ? *value : (object_t){ TYPE_NULL });
+}
+
+winterCoroutineStatus_t winterCoroutineStatus(const winterCoroutine_t *coroutine) {
+	return coroutine->status;
+}
+
+void winterFreeCoroutine(winterState_t *state, winterCoroutine_t *coroutine) {
+	if (coroutine->status == WINTER_SUSPENDED) {
+		for (size_t i = 0; i < coroutine->top; i++) {
+			_winter_objectDelRef(state, &coroutine->stack[i]);
+		}
+		//Escaped closures keep the values the upvalues were closed over
+		while (coroutine->openUpvalues != NULL) {
+			upvalue_t *upvalue = coroutine->openUpvalues;
+			coroutine->openUpvalues = upvalue->next;
+			upvalue->next = NULL;
+			_winter_objectDelRef(state, &(object_t){ TYPE_UPVALUE, { .pointer = upvalue } });
+		}
+	}
+	if (coroutine->prev != NULL) {
+		coroutine->prev->next = coroutine->next;
+	} else {
+		state->coroutines = coroutine->next;
+	}
+	if (coroutine->next != NULL) {
+		coroutine->next->prev = coroutine->prev;
+	}
+	FREE(coroutine->stack);
+	FREE(coroutine->frames);
+	FREE(coroutine);
+}
@@ -0,0 +1,61 @@
+#ifndef VM_H
+#define VM_H
+
+#include "wtype.h"
+#include "object.h"
+#include "parser.h"
+#include "function.h"
+
+#define STACK_DEFAULT_SIZE  64
+#define FRAMES_DEFAULT_SIZE 16
+//Calls nested deeper than this raise a stack overflow, tail calls don't count
+#define MAX_FRAMES 200000
+//Coroutines start small since a state may hold thousands of them, both grow as needed
+#define COROUTINE_STACK_SIZE  16
+#define COROUTINE_FRAMES_SIZE 4
+
+//Each running closure owns a window of registers on the stack, its arguments are the
+//first registers and the closure itself sits just below them
+typedef struct frame_t {
+	function_t     *function;
+	const uint32_t *pc;
+	size_t          base; //stack index of register 0
+} frame_t;
+
+//Call with its own register stack and frames that suspends itself with yield
+//Only the running stack is in the state, the others are swapped out into their coroutine.
+//While suspended the values on its stack hold counted references and its open upvalues
+//are closed over their current values, so closures that escaped it keep working
+typedef struct coroutine_t {
+	object_t  *stack;
+	size_t     stackSize;
+	size_t     top;
+	frame_t   *frames;
+	size_t     numFrames;
+	size_t     frameCapacity;
+	upvalue_t *openUpvalues;
+	
+	winterCoroutineStatus_t status;
+	bool_t   yielded; //set when OP_YIELD suspends it
+	object_t value;   //passed out by the last yield
+	
+	struct coroutine_t *prev, *next; //in the state's list
+} coroutine_t;
+
+void _winter_stackInit(winterState_t *state);
+void _winter_stackFree(winterState_t *state);
+
+//Values on the stack are not reference counted, see gc.h
+object_t *_winter_stackPush(winterState_t *state, const object_t *value);
+void      _winter_stackPop(winterState_t *state, size_t count);
+
+//Calls the function at stack[func] with the 'argc' values above it, the result replaces
+//the function and everything above it is popped. Errors are returned as the result
+void _winter_call(winterState_t *state, size_t func, int argc);
+//Calls the function value like winterCall
+const object_t *_winter_callValue(winterState_t *state, const object_t *function, const object_t *args, int argc);
+
+//Compiles and runs the tree, then pushes the result onto the stack
+object_t *_winter_evaluate(winterState_t *state, ast_node_t *tree);
+
+#endif
@@ -2,17 +2,59 @@
 #include "winter.h"
 #include "wtype.h"
 #include "table.h"
+#include "gc.h"
+#include "vm.h"
+#include "wstring.h"
+#include "shared.h"
+#include "shape.h"
+#include "parallel.h"
+#include "regex.h"
 
 winterState_t *winterCreateState(winterAlloc_t allocator) {
 	winterState_t *ret;
 	ret = allocator(NULL, sizeof(winterState_t));
 	if (ret != NULL) {
 		ret->allocator = allocator;
+		ret->memory    = (winterMemoryStats_t){0};
+		ret->errorJump = NULL;
+		ret->shared    = NULL;
+		ret->numShared = 0;
+		ret->loop      = NULL;
+		ret->jit       = true;
+		ret->workers    = NULL;
+		ret->numWorkers = 0;
+		ret->workerInit = NULL;
+		ret->workerUser = NULL;
+		ret->isWorker   = false;
+		ret->regexes    = NULL;
+		_winter_poolInit(ret);
+		_winter_gcInit(ret);
+		_winter_stackInit(ret);
+		_winter_shapeInit(ret);
 		ret->globals   = _winter_tableAlloc(ret, 3);
+		ret->globals->_refcount = REF_PERSISTENT;
+		ret->natives   = _winter_tableAlloc(ret, 3);
+		ret->natives->_refcount = REF_PERSISTENT;
+		
+		object_t error;
+		_winter_objectNewError(ret, &error, "out of memory");
+		ret->memoryError = error.string;
+		ret->memoryError->_refcount = REF_PERSISTENT;
+		_winter_reconcile(ret);
 	}
 	return ret;
 }
 void winterFreeState(winterState_t *state) {
+	_winter_parallelFree(state);
+	_winter_regexFree(state);
+	state->top = 0;
 	_winter_tableFree(state, state->globals);
-	FREE(state);
+	_winter_tableFree(state, state->natives);
+	_winter_gcFree(state);
+	_winter_shapeFree(state);
+	_winter_sharedFree(state);
+	_winter_stringFree(state, state->memoryError);
+	_winter_stackFree(state);
+	_winter_poolFree(state);
+	state->allocator(state, 0);
 }
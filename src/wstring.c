@@ -1,4 +1,6 @@
 #include "wstring.h"
+#include "gc.h"
+#include "utf8.h"
 #include <string.h>
 
 hash_t _winter_stringHash(wstring_t *string) {
@@ -11,35 +13,67 @@ hash_t _winter_stringHash(wstring_t *string) {
 wstring_t *_winter_stringAlloc(winterState_t *state, size_t size) {
 	wstring_t *out = MALLOC(sizeof(wstring_t) + size);
 	out->_refcount = 0;
+	out->_zct      = false;
+	out->_type     = TYPE_STRING;
+	out->_mark     = false;
+	out->encoding  = STRING_UNCHECKED;
 	out->hash      = 0;
 	out->length    = 0;
 	out->capacity  = size;
 	out->data = (char*)(out + 1);
+	out->index     = NULL;
+	state->memory.strings++;
+	_winter_zctPush(state, TYPE_STRING, out);
 	return out;
 }
 wstring_t *_winter_stringCreateSize(winterState_t *state, const char *string, size_t size) {
 	wstring_t *out = _winter_stringAlloc(state, size + 1);
 	memcpy(out->data, string, size);
 	out->data[size] = '\0';
-	out->length = size;
+	out->length   = size;
+	out->encoding = _winter_utf8Check(out->data, size);
+	return out;
+}
+wstring_t *_winter_stringView(winterState_t *state, const char *string, size_t size) {
+	wstring_t *out = _winter_stringAlloc(state, 0);
+	out->data     = (char*)string;
+	out->length   = size;
+	out->encoding = _winter_utf8Check(string, size);
 	return out;
 }
 wstring_t *_winter_stringCreate(winterState_t *state, const char *string) {
 	return _winter_stringCreateSize(state, string, strlen(string));
 }
 void _winter_stringFree(winterState_t *state, wstring_t *string) {
+	if (string->_type == TYPE_ERROR) {
+		state->memory.errors--;
+	} else {
+		state->memory.strings--;
+	}
+	if (string->index != NULL) {
+		FREE(string->index);
+	}
 	FREE(string);
 }
 
 bool_t _winter_stringCompare(wstring_t *a, wstring_t *b) {
 	if (a == b) {
 		return true;
-	} else if ((_winter_stringHash(a) == _winter_stringHash(b)) && (a->length == b->length)) {
-		for (size_t i = 0; a->data[i] == b->data[i]; i++) {
-			if (i == a->length - 1) return true;
-		}
 	}
-	return false;
+	//Empty strings and ones with NUL bytes are compared by length
+	return _winter_stringHash(a) == _winter_stringHash(b) && a->length == b->length &&
+		memcmp(a->data, b->data, a->length) == 0;
+}
+
+int _winter_stringOrder(wstring_t *a, wstring_t *b) {
+	if (_winter_stringCompare(a, b)) {
+		return 0;
+	}
+	int order = memcmp(a->data, b->data, a->length < b->length ? a->length : b->length);
+	if (order == 0) {
+		return (a->length > b->length) - (a->length < b->length);
+	}
+	return (order > 0) - (order < 0);
 }
 
 wstring_t *_winter_stringDup(winterState_t *state, const wstring_t *string) {
@@ -54,5 +88,76 @@ wstring_t *_winter_stringCat(winterState_t *state, wstring_t *a, wstring_t *b) {
 	memcpy(out->data + a->length, b->data, b->length);
 	out->length = required-1;
 	out->data[required-1] = '\0';
+	//Joining valid UTF-8 gives valid UTF-8, so only other strings are checked again
+	stringEncoding_t ea = _winter_stringEncoding(a), eb = _winter_stringEncoding(b);
+	if (ea != STRING_BINARY && eb != STRING_BINARY) {
+		out->encoding = ea == STRING_ASCII && eb == STRING_ASCII ? STRING_ASCII : STRING_UTF8;
+	} else {
+		out->encoding = _winter_utf8Check(out->data, out->length);
+	}
 	return out;
 }
+
+stringEncoding_t _winter_stringEncoding(wstring_t *string) {
+	if (string->encoding == STRING_UNCHECKED) {
+		string->encoding = _winter_utf8Check(string->data, string->length);
+	}
+	return string->encoding;
+}
+
+static stringIndex_t *getIndex(winterState_t *state, wstring_t *string) {
+	if (string->index != NULL || string->_refcount == REF_PERSISTENT) {
+		return string->index;
+	}
+	const unsigned char *data = (const unsigned char*)string->data;
+	size_t count = _winter_utf8Count(string->data, string->length);
+	size_t steps = (count + STRING_INDEX_STEP - 1) / STRING_INDEX_STEP;
+	stringIndex_t *index = MALLOC(sizeof(stringIndex_t) + steps * sizeof(size_t));
+	index->count      = count;
+	index->last       = 0;
+	index->lastOffset = 0;
+	size_t offset = 0;
+	for (size_t i = 0; i < steps; i++) {
+		index->offsets[i] = offset;
+		for (size_t k = 0; k < STRING_INDEX_STEP && offset < string->length; k++) {
+			offset += _winter_utf8Size(data[offset]);
+		}
+	}
+	string->index = index;
+	return index;
+}
+
+size_t _winter_stringLength(winterState_t *state, wstring_t *string) {
+	if (_winter_stringEncoding(string) != STRING_UTF8) {
+		return string->length;
+	}
+	stringIndex_t *index = getIndex(state, string);
+	return index != NULL ? index->count : _winter_utf8Count(string->data, string->length);
+}
+
+size_t _winter_stringOffset(winterState_t *state, wstring_t *string, size_t i, size_t *size) {
+	const unsigned char *data = (const unsigned char*)string->data;
+	if (_winter_stringEncoding(string) != STRING_UTF8) {
+		*size = 1;
+		return i;
+	}
+	stringIndex_t *index = getIndex(state, string);
+	size_t at = 0, offset = 0;
+	if (index != NULL) {
+		at     = i - i % STRING_INDEX_STEP;
+		offset = index->offsets[i / STRING_INDEX_STEP];
+		if (index->last <= i && index->last > at) {
+			at     = index->last;
+			offset = index->lastOffset;
+		}
+	}
+	for (; at < i; at++) {
+		offset += _winter_utf8Size(data[offset]);
+	}
+	if (index != NULL) {
+		index->last       = i;
+		index->lastOffset = offset;
+	}
+	*size = _winter_utf8Size(data[offset]);
+	return offset;
+}
@@ -1,31 +1,66 @@
 #ifndef WSTRING_H
 #define WSTRING_H
 
-//TODO unicode
 #include "wtype.h"
 #include "object.h"
 
+//Strings are bytes, read as UTF-8 by length and indexing when they're valid UTF-8 and as
+//bytes when they aren't, so they can still hold binary data. Their encoding is worked out
+//when they're made from bytes that are known, see utf8.h, or on first use for those filled
+//in after. ASCII strings index codepoints by byte. Other UTF-8 strings get an index on
+//first use, with the count of codepoints and the offset of every STRING_INDEX_STEP-th one,
+//so finding one reads at most that many lead bytes, and fewer when the last one found is
+//on the way. Persistent strings, which threads may share, are scanned instead
+typedef enum stringEncoding_t {
+	STRING_UNCHECKED,
+	STRING_ASCII,
+	STRING_UTF8,  //valid with some codepoints past ASCII
+	STRING_BINARY //not valid UTF-8
+} stringEncoding_t;
+
+#define STRING_INDEX_STEP 64
+
+typedef struct stringIndex_t {
+	size_t count;       //codepoints
+	size_t last;        //codepoint found last
+	size_t lastOffset;
+	size_t offsets[];   //of codepoint i * STRING_INDEX_STEP
+} stringIndex_t;
+
 typedef struct wstring_t {
 	REFCOUNT;
+	uint8_t encoding; //stringEncoding_t
 	hash_t hash;
 	size_t length;
 	size_t capacity;
 	char  *data;
+	stringIndex_t *index; //made on first use, for STRING_UTF8 only
 } wstring_t;
 
 //Creates an automatic string with a literal value (no allocations)
-#define AUTO_STRING(str) (wstring_t){REF_PERSISTENT, 0, (sizeof(str)/sizeof(*str)), 0, str}
+#define AUTO_STRING(str) (wstring_t){REF_PERSISTENT, false, TYPE_STRING, false, STRING_UNCHECKED, 0, (sizeof(str)/sizeof(*str)), 0, str, NULL}
 
 wstring_t *_winter_stringAlloc(winterState_t *state, size_t size);
 wstring_t *_winter_stringCreateSize(winterState_t *state, const char *string, size_t size);
 wstring_t *_winter_stringCreate(winterState_t *state, const char *string);
+//Returns a string of the 'size' bytes at 'string' in place, which must be followed by a NUL
+//and outlive it. Its capacity is 0
+wstring_t *_winter_stringView(winterState_t *state, const char *string, size_t size);
 void _winter_stringFree(winterState_t *state, wstring_t *string);
 
 hash_t _winter_stringHash(wstring_t *string);
 bool_t _winter_stringCompare(wstring_t *a, wstring_t *b);
+//Orders the bytes of two strings like strcmp, including ones after a NUL
+int _winter_stringOrder(wstring_t *a, wstring_t *b);
 wstring_t *_winter_stringDup(winterState_t *state, const wstring_t *string);
 wstring_t *_winter_stringCat(winterState_t *state, wstring_t *a, wstring_t *b);
 
+stringEncoding_t _winter_stringEncoding(wstring_t *string);
+//Codepoints in the string, or bytes if it isn't UTF-8
+size_t _winter_stringLength(winterState_t *state, wstring_t *string);
+//Byte offset of codepoint 'i', which must be below the length, and its size in 'size'
+size_t _winter_stringOffset(winterState_t *state, wstring_t *string, size_t i, size_t *size);
+
 
 
 #endif
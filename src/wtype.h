@@ -2,18 +2,80 @@
 #define WTYPE_H
 
 #include "winter.h"
+#include "pool.h"
+#include <setjmp.h>
+#include <stdlib.h>
 
 //Forward declare
-typedef struct table_t table_t;
+typedef struct table_t   table_t;
+typedef struct object_t  object_t;
+typedef struct wstring_t wstring_t;
+typedef struct upvalue_t upvalue_t;
+typedef struct frame_t   frame_t;
+
+typedef struct gclist_t {
+	object_t *objects;
+	size_t    size;
+	size_t    capacity;
+} gclist_t;
 
 typedef struct winterState_t {
 	winterAlloc_t allocator;
+	pool_t        pool;
 	table_t      *globals;
+	table_t      *natives; //registered native functions by name
+	struct shape_t *shapes; //empty root of the record layouts, see shape.h
+	
+	//Shared chunks the state has run, values may point at their constants so they're
+	//held until the state is freed
+	struct shared_t **shared;
+	size_t            numShared;
+	
+	//Memory accounting
+	winterMemoryStats_t memory;
+	wstring_t          *memoryError; //preallocated so raising it can't fail
+	jmp_buf            *errorJump;   //innermost protected call
+	
+	//Register stack, values on it are not reference counted
+	object_t *stack;
+	size_t    stackSize;
+	size_t    top;
+	
+	//Call frames of running closures
+	frame_t   *frames;
+	size_t     numFrames;
+	size_t     frameCapacity;
+	upvalue_t *openUpvalues;
+	struct coroutine_t *coroutine; //owner of the stack, NULL for the state's own
+	struct coroutine_t *coroutines; //every coroutine not yet freed
+	struct loop_t      *loop;      //event loop running the state's coroutines, see loop.h
+	int                 jit;       //compiles hot prototypes to machine code, see jit.h
+	
+	//Worker threads of parallelmap and parallelreduce, started on first use, see parallel.h
+	struct executor_t *workers;
+	int                numWorkers; //0 for one per core
+	winterWorkerInit_t workerInit;
+	void              *workerUser;
+	int                isWorker;   //set in the states of those workers
+	
+	//Compiled regular expressions by the hash of their pattern, see regex.h
+	struct regex_t **regexes;
+	
+	//Deferred reference counting
+	gclist_t zct; //zero count table
+	size_t   zctLimit;
+	
+	//Cycle collector
+	gclist_t gcRoots;    //candidate roots
+	gclist_t gcDeferred; //roots only the stack kept alive, buffered again by the next reconcile
+	gclist_t gcWhite;    //garbage found during a collection
+	gclist_t gcWork;  //objects left to visit while tracing
+	size_t   gcBudget;
 } winterState_t;
 
-#define MALLOC(s)     (state->allocator(NULL, (s)))
-#define REALLOC(p, s) (state->allocator((p),  (s)))
-#define FREE(p)       (state->allocator((p),    0))
+#define MALLOC(s)     (_winter_poolAlloc(state, NULL, (s)))
+#define REALLOC(p, s) (_winter_poolAlloc(state, (p),  (s)))
+#define FREE(p)       (_winter_poolAlloc(state, (p),    0))
 
 typedef int bool_t;
 #ifndef true
@@ -65,25 +127,34 @@ static inline winterInt_t winter_strtoi(const char *number, int base) {
 	}
 	return out;
 }
+//Parses digits with a fraction, scaling the digits by a power of ten up to 1e22 is exact so
+//the one division rounds correctly. Longer literals go through strtod
 static inline winterFloat_t winter_strtof(const char *number) {
-	winterFloat_t out = 0;
-	
-	while (isNumber(*number)) {
-		out *= 10;
-		out += *number - '0';
-		number++;
+	uint64_t mantissa = 0;
+	int digits = 0, scale = 0;
+	bool_t fraction = false;
+	size_t size = 0;
+	for (; isNumber(number[size]) || (number[size] == '.' && !fraction); size++) {
+		if (number[size] == '.') {
+			fraction = true;
+		} else {
+			mantissa = mantissa * 10 + (uint64_t)(number[size] - '0');
+			digits += mantissa != 0;
+			scale += fraction;
+		}
 	}
-	if (*number == '.') {
-		number++;
+	if (digits <= 15 && scale <= 22) {
 		winterFloat_t divisor = 1;
-		while (isNumber(*number)) {
-			divisor *= 0.1;
-			out += (winterFloat_t)(*number - '0') * divisor;
-			number++;
-		}
+		for (int i = 0; i < scale; i++) divisor *= 10;
+		return (winterFloat_t)mantissa / divisor;
 	}
 	
-	return out;
+	//strtod needs the literal to end, digits past the buffer can't change the result much
+	char buffer[128];
+	size = size < sizeof(buffer) - 1 ? size : sizeof(buffer) - 1;
+	for (size_t i = 0; i < size; i++) buffer[i] = number[i];
+	buffer[size] = '\0';
+	return strtod(buffer, NULL);
 }
 
 #endif
@@ -0,0 +1,213 @@
+#include "check.h"
+#include "kernel.h"
+#include <math.h>
+
+enum { MAX = 72, OFFSETS = 4 };
+
+static const size_t sizes[] = { sizeof(double), sizeof(int64_t), sizeof(float), sizeof(int32_t) };
+
+//Element i of a buffer of any kind as a double, ints are exact in these tests
+static double get(arrayType_t kind, const void *p, size_t i) {
+	switch (kind) {
+		case ARRAY_FLOAT64: return ((const double*)p)[i];
+		case ARRAY_INT64:   return (double)((const int64_t*)p)[i];
+		case ARRAY_FLOAT32: return ((const float*)p)[i];
+		default:            return ((const int32_t*)p)[i];
+	}
+}
+
+static int64_t getInt(arrayType_t kind, const void *p, size_t i) {
+	return kind == ARRAY_INT64 ? ((const int64_t*)p)[i] : ((const int32_t*)p)[i];
+}
+
+//Small multiples of a quarter add up exactly in any order, ints are large enough to wrap
+static void fill(arrayType_t kind, void *p, size_t n, bool_t nan) {
+	for (size_t i = 0; i < n; i++) {
+		int r = rand() % 21 - 10;
+		switch (kind) {
+			case ARRAY_FLOAT64: ((double*)p)[i] = nan && r == 0 ? NAN : r * 0.25; break;
+			case ARRAY_FLOAT32: ((float*)p)[i] = nan && r == 0 ? NAN : r * 0.25f; break;
+			case ARRAY_INT64:   ((int64_t*)p)[i] = (int64_t)((uint64_t)r * 1000000007u * 1000000007u); break;
+			case ARRAY_INT32:   ((int32_t*)p)[i] = r * 100003; break;
+		}
+	}
+}
+
+//What the scalar loop computes, ints wrap around
+static void arith(arrayType_t kind, kernelOp_t op, void *out, const void *a, const void *b, bool_t scalar, size_t i) {
+	size_t j = scalar ? 0 : i;
+	if (kind == ARRAY_INT64 || kind == ARRAY_INT32) {
+		int64_t x = getInt(kind, a, i), y = getInt(kind, b, j);
+		uint64_t r = 0;
+		switch (op) {
+			case KERNEL_ADD: r = (uint64_t)x + (uint64_t)y; break;
+			case KERNEL_SUB: r = (uint64_t)x - (uint64_t)y; break;
+			case KERNEL_MUL: r = (uint64_t)x * (uint64_t)y; break;
+			case KERNEL_MIN: r = (uint64_t)(x < y ? x : y); break;
+			case KERNEL_MAX: r = (uint64_t)(x > y ? x : y); break;
+			default: break;
+		}
+		if (kind == ARRAY_INT64) {
+			((int64_t*)out)[i] = (int64_t)r;
+		} else {
+			((int32_t*)out)[i] = (int32_t)(uint32_t)r;
+		}
+		return;
+	}
+	double x = get(kind, a, i), y = get(kind, b, j), r = 0;
+	switch (op) {
+		case KERNEL_ADD: r = x + y; break;
+		case KERNEL_SUB: r = x - y; break;
+		case KERNEL_MUL: r = x * y; break;
+		case KERNEL_DIV: r = x / y; break;
+		case KERNEL_MIN: r = x < y ? x : y; break;
+		case KERNEL_MAX: r = x > y ? x : y; break;
+	}
+	if (kind == ARRAY_FLOAT64) {
+		((double*)out)[i] = r;
+	} else {
+		((float*)out)[i] = (float)r;
+	}
+}
+static int32_t compare(kernelCompare_t op, double x, double y) {
+	switch (op) {
+		case KERNEL_EQ: return x == y;
+		case KERNEL_NE: return x != y;
+		case KERNEL_LT: return x < y;
+		case KERNEL_LE: return x <= y;
+		case KERNEL_GT: return x > y;
+		default:        return x >= y;
+	}
+}
+static bool_t same(arrayType_t kind, const void *a, const void *b, size_t n) {
+	return memcmp(a, b, sizes[kind] * n) == 0;
+}
+
+//Every kernel matches the scalar loop at each length around the vector width and at
+//every alignment, so the vector bodies and their tails are both covered
+static void kernels(void) {
+	static _Alignas(32) unsigned char a[8 * (MAX + OFFSETS)], b[8 * (MAX + OFFSETS)];
+	static _Alignas(32) unsigned char out[8 * (MAX + OFFSETS)], want[8 * MAX];
+	static int32_t mask[MAX];
+	srand(1);
+	for (arrayType_t kind = ARRAY_FLOAT64; kind <= ARRAY_INT32; kind++) {
+		for (size_t offset = 0; offset < OFFSETS; offset++) {
+			for (size_t n = 0; n < MAX; n++) {
+				void *x = a + offset * sizes[kind], *y = b + offset * sizes[kind], *o = out + offset * sizes[kind];
+				fill(kind, x, n, false);
+				fill(kind, y, n, false);
+				for (kernelOp_t op = KERNEL_ADD; op <= KERNEL_MAX; op++) {
+					if (op == KERNEL_DIV && !isFloatArray(kind)) continue;
+					for (int scalar = 0; scalar < 2; scalar++) {
+						for (size_t i = 0; i < n; i++) {
+							arith(kind, op, want, x, y, scalar, i);
+						}
+						_winter_kernelArith(kind, op, o, x, y, scalar, n);
+						CHECK(same(kind, o, want, n));
+					}
+				}
+
+				double sum = 0, dot = 0;
+				size_t low = 0, high = 0;
+				uint64_t wrapped = 0, wrappedDot = 0;
+				for (size_t i = 0; i < n; i++) {
+					sum += get(kind, x, i);
+					dot += get(kind, x, i) * get(kind, y, i);
+					low = get(kind, x, i) < get(kind, x, low) ? i : low;
+					high = get(kind, x, i) > get(kind, x, high) ? i : high;
+					if (!isFloatArray(kind)) {
+						wrapped += (uint64_t)getInt(kind, x, i);
+						wrappedDot += (uint64_t)getInt(kind, x, i) * (uint64_t)getInt(kind, y, i);
+					}
+				}
+				object_t total = _winter_kernelReduce(kind, KERNEL_ADD, x, n);
+				if (isFloatArray(kind)) {
+					CHECK(total.type == TYPE_FLOAT && total.floating == sum);
+					object_t product = _winter_kernelDot(kind, x, y, n);
+					CHECK(product.type == TYPE_FLOAT && product.floating == dot);
+				} else {
+					CHECK(total.type == TYPE_INT && total.integer == (winterInt_t)wrapped);
+					object_t product = _winter_kernelDot(kind, x, y, n);
+					CHECK(product.type == TYPE_INT && product.integer == (winterInt_t)wrappedDot);
+				}
+				if (n > 0) {
+					object_t smallest = _winter_kernelReduce(kind, KERNEL_MIN, x, n);
+					object_t largest = _winter_kernelReduce(kind, KERNEL_MAX, x, n);
+					if (isFloatArray(kind)) {
+						CHECK(smallest.floating == get(kind, x, low) && largest.floating == get(kind, x, high));
+					} else {
+						CHECK(smallest.integer == getInt(kind, x, low) && largest.integer == getInt(kind, x, high));
+					}
+				}
+
+				//Floats compare NaN as unordered
+				fill(kind, x, n, true);
+				for (kernelCompare_t op = KERNEL_EQ; op <= KERNEL_GE; op++) {
+					for (int scalar = 0; scalar < 2; scalar++) {
+						_winter_kernelCompare(kind, op, mask, x, y, scalar, n);
+						for (size_t i = 0; i < n; i++) {
+							CHECK(mask[i] == compare(op, get(kind, x, i), get(kind, y, scalar ? 0 : i)));
+						}
+					}
+				}
+
+				int64_t indices64[MAX];
+				int32_t indices32[MAX];
+				for (size_t i = 0; i < n; i++) {
+					indices64[i] = rand() % (int)n;
+					indices32[i] = (int32_t)indices64[i];
+				}
+				CHECK(_winter_kernelGather(kind, o, x, n, ARRAY_INT64, indices64, n));
+				for (size_t i = 0; i < n; i++) {
+					CHECK(memcmp((unsigned char*)o + i * sizes[kind], (unsigned char*)x + indices64[i] * sizes[kind], sizes[kind]) == 0);
+				}
+				CHECK(_winter_kernelGather(kind, o, x, n, ARRAY_INT32, indices32, n));
+				for (size_t i = 0; i < n; i++) {
+					CHECK(memcmp((unsigned char*)o + i * sizes[kind], (unsigned char*)x + indices32[i] * sizes[kind], sizes[kind]) == 0);
+				}
+				if (n > 0) {
+					indices64[n - 1] = (int64_t)n;
+					indices32[n / 2] = -1;
+					CHECK(!_winter_kernelGather(kind, o, x, n, ARRAY_INT64, indices64, n));
+					CHECK(!_winter_kernelGather(kind, o, x, n, ARRAY_INT32, indices32, n));
+				}
+			}
+		}
+	}
+}
+
+//The script functions over views, mixed kinds and errors
+static void script(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenArrays(state);
+	runScript(state,
+		"let a = array(\"int64\", 100);\n"
+		"fn init(i) { if i == 100 { return a; } a[i] = i; return init(i + 1); }\n"
+		"init(0);\n"
+		"let f = copy(a, \"float32\");\n"
+		"let odd = slice(a, 1, 100, 2);\n");
+	CHECK(runInt(state, "sum(a);") == 99 * 100 / 2);
+	CHECK(runInt(state, "length(odd);") == 50);
+	CHECK(runInt(state, "sum(odd);") == 50 * 50);
+	CHECK(runInt(state, "dot(odd, odd) == dot(copy(odd), copy(odd));") == 1);
+	CHECK(runInt(state, "sum(vadd(a, f)) == 9900.0;") == 1);
+	CHECK(runInt(state, "sum(vmul(odd, 2)) == 5000;") == 1);
+	CHECK(runInt(state, "sum(compare(a, \">=\", 50));") == 50);
+	CHECK(runInt(state, "min(a) + max(a);") == 99);
+	CHECK(runInt(state, "vdiv(a, 2)[3] == 1.5;") == 1);
+	CHECK(runInt(state, "let idx = array(\"int32\", 3); idx[0] = 7; idx[1] = 0; idx[2] = 99; sum(gather(a, idx));") == 106);
+	CHECK(runInt(state, "let twice = copy(a); vadd(a, a, twice); twice[5];") == 10);
+	CHECK(runInt(state, "fill(slice(a, 0, 10), 1); sum(slice(a, 0, 10));") == 10);
+	CHECK(runFails(state, "a[100];"));
+	CHECK(runFails(state, "vadd(a, slice(a, 0, 10));"));
+	CHECK(runFails(state, "vadd(odd, 1, odd);"));
+	CHECK(runFails(state, "array(\"int8\", 3);"));
+	CHECK(runFails(state, "let bad = array(\"int32\", 1); bad[0] = 100; gather(a, bad);"));
+	winterFreeState(state);
+}
+
+int main(void) {
+	kernels();
+	script();
+	return 0;
+}
@@ -0,0 +1,69 @@
+#include "check.h"
+
+static int released;
+static void release(void *user, void *data) {
+	CHECK(user == data);
+	released++;
+	free(data);
+}
+
+static const char *source =
+	"let keep = null;\n"
+	"fn stats(a) { keep = slice(a, 0, length(a), 2); return sum(a) + a[1]; }\n"
+	"fn poke(a) { a[0] = 5; return a[0]; }\n"
+	"fn scale(a) { return vmul(a, 2.0); }\n"
+	"fn drop() { keep = null; return 0; }\n";
+
+int main(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenArrays(state);
+	runScript(state, source);
+
+	//Read only host memory is read in place, and released once its last slice is freed
+	enum { FRAME = 1000 };
+	float *frame = malloc(sizeof(float) * FRAME);
+	for (int i = 0; i < FRAME; i++) {
+		frame[i] = (float)i;
+	}
+	winterValue_t array;
+	CHECK(winterSetArray(state, &array, WINTER_FLOAT32, frame, FRAME, WINTER_READ_ONLY, release, frame) == 0);
+	CHECK(winterToFloat(winterCall(state, "stats", &array, 1)) == (FRAME - 1) * FRAME / 2 + 1);
+	CHECK(winterTypeOf(winterCall(state, "poke", &array, 1)) == WINTER_ERROR);
+	CHECK(frame[0] == 0.0f);
+	winterArrayType_t type;
+	size_t length;
+	ptrdiff_t stride;
+	const float *scaled = winterToArray(winterCall(state, "scale", &array, 1), &type, &length, &stride);
+	CHECK(scaled != NULL && scaled != frame && type == WINTER_FLOAT32 && length == FRAME && stride == 1);
+	CHECK(scaled[FRAME - 1] == 2.0f * (FRAME - 1));
+	winterCollect(state);
+	CHECK(released == 0);
+	winterCall(state, "drop", NULL, 0);
+	runScript(state, "null;");
+	winterCollect(state);
+	CHECK(released == 1);
+
+	//Writable memory is written in place
+	int64_t *values = malloc(sizeof(int64_t) * 4);
+	for (int i = 0; i < 4; i++) {
+		values[i] = i + 1;
+	}
+	CHECK(winterSetArray(state, &array, WINTER_INT64, values, 4, 0, release, values) == 0);
+	CHECK(winterToInt(winterCall(state, "poke", &array, 1)) == 5 && values[0] == 5);
+	CHECK(winterToInt(winterCall(state, "stats", &array, 1)) == 5 + 2 + 3 + 4 + 2);
+	ptrdiff_t step;
+	winterToArray(&array, NULL, &length, &step);
+	CHECK(length == 4 && step == 1);
+	CHECK(winterToArray(&(winterValue_t){ 0 }, NULL, NULL, NULL) == NULL);
+
+	//Misaligned memory is refused without releasing it
+	char *bytes = malloc(16);
+	CHECK(winterSetArray(state, &array, WINTER_INT32, bytes + 1, 2, 0, release, bytes + 1) == -1);
+	free(bytes);
+	CHECK(released == 1);
+
+	//Whatever is left is released with the state
+	winterFreeState(state);
+	CHECK(released == 2);
+	return 0;
+}
@@ -0,0 +1,113 @@
+#include "check.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+enum { COUNT = 5000 };
+
+static winterChannel_t *channel;
+static atomic_long total;
+
+//Sends its share of the numbers, every third one as a string
+static void *producer(void *arg) {
+	winterState_t *state = winterCreateState(testAllocator);
+	long id = (long)(intptr_t)arg;
+	for (long i = id * COUNT; i < (id + 1) * COUNT; i++) {
+		winterValue_t value;
+		if (i % 3 == 0) {
+			char text[32];
+			winterSetString(state, &value, text, (size_t)snprintf(text, sizeof(text), "%ld", i));
+		} else {
+			winterSetInt(&value, i);
+		}
+		while (winterSend(state, channel, &value) == 1) {
+			sched_yield();
+		}
+	}
+	winterFreeState(state);
+	return NULL;
+}
+static void *consumer(void *arg) {
+	winterState_t *state = winterCreateState(testAllocator);
+	long sum = 0;
+	for (long received = 0; received < (long)(intptr_t)arg;) {
+		const winterValue_t *value = winterReceive(state, channel);
+		if (value == NULL) {
+			sched_yield();
+			continue;
+		}
+		const char *text = winterToString(value, NULL);
+		sum += text != NULL ? atol(text) : (long)winterToInt(value);
+		received++;
+	}
+	total += sum;
+	winterFreeState(state);
+	return NULL;
+}
+
+//Every value sent by any producer is received once by some consumer
+static void threads(int producers, int consumers, int flags) {
+	channel = winterCreateChannel(testAllocator, 64, flags);
+	CHECK(channel != NULL);
+	total = 0;
+	pthread_t threads[8];
+	for (int i = 0; i < consumers; i++) {
+		CHECK(pthread_create(&threads[i], NULL, consumer, (void*)(intptr_t)(producers * COUNT / consumers)) == 0);
+	}
+	for (int i = 0; i < producers; i++) {
+		CHECK(pthread_create(&threads[consumers + i], NULL, producer, (void*)(intptr_t)i) == 0);
+	}
+	for (int i = 0; i < producers + consumers; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	long count = (long)producers * COUNT;
+	CHECK(total == count * (count - 1) / 2);
+	winterState_t *state = winterCreateState(testAllocator);
+	CHECK(winterReceive(state, channel) == NULL);
+	winterFreeState(state);
+	winterFreeChannel(channel);
+}
+
+//Tables keep their cycles and shared parts, errors keep their message
+static void values(void) {
+	winterState_t *from = winterCreateState(testAllocator), *to = winterCreateState(testAllocator);
+	runScript(to,
+		"fn check(t) {\n"
+		"	return (t.self.self.name == \"seven\") + (t.a == t.b) * 10 + (t.a.v == 1) * 100 + (t.f == 2.5) * 1000;\n"
+		"}\n");
+	winterChannel_t *queue = winterCreateChannel(testAllocator, 2, 0);
+	winterValue_t table = *runScript(from,
+		"let inner = {v = 1};\n"
+		"let t = {name = \"sev\" + \"en\", a = inner, b = inner, f = 2.5};\n"
+		"t.self = t;\n"
+		"t;\n");
+	CHECK(winterSend(from, queue, &table) == 0);
+	winterValue_t error;
+	winterSetError(from, &error, "boom %d", 3);
+	CHECK(winterSend(from, queue, &error) == 0);
+	CHECK(winterSend(from, queue, &error) == 1);
+
+	winterValue_t received = *winterReceive(to, queue);
+	CHECK(winterTypeOf(&received) == WINTER_TABLE);
+	CHECK(winterToInt(winterCall(to, "check", &received, 1)) == 1111);
+	const winterValue_t *message = winterReceive(to, queue);
+	CHECK(winterTypeOf(message) == WINTER_ERROR && strcmp(winterToString(message, NULL), "boom 3") == 0);
+	CHECK(winterReceive(to, queue) == NULL);
+
+	//Functions can't be sent, and messages still queued are freed with the channel
+	winterValue_t function = *runScript(from, "fn f() { return 1; } f;");
+	CHECK(winterSend(from, queue, &function) == -1);
+	winterValue_t string;
+	winterSetString(from, &string, "left", 4);
+	CHECK(winterSend(from, queue, &string) == 0);
+	winterFreeChannel(queue);
+	winterFreeState(from);
+	winterFreeState(to);
+}
+
+int main(void) {
+	threads(1, 1, WINTER_SINGLE_PRODUCER | WINTER_SINGLE_CONSUMER);
+	threads(4, 2, 0);
+	values();
+	return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "winter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Stops the test at the first check that fails
+#define CHECK(x) do {                                                              \
+	if (!(x)) {                                                                    \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);     \
+		exit(1);                                                                   \
+	}                                                                              \
+} while (0)
+
+static inline void *testAllocator(void *pointer, size_t size) {
+	if (size == 0) {
+		free(pointer);
+		return NULL;
+	}
+	return realloc(pointer, size);
+}
+
+//Runs a script and returns its result, the test fails if it doesn't compile or raises an
+//error. The chunk is freed, so strings in the result may point into it and only numbers
+//are read from it
+static inline const winterValue_t *runScript(winterState_t *state, const char *source) {
+	char error[256];
+	winterChunk_t *chunk = winterLoadString(state, source, error, sizeof(error));
+	if (chunk == NULL) {
+		fprintf(stderr, "compile error: %s\n%s\n", error, source);
+		exit(1);
+	}
+	const winterValue_t *result = winterRun(state, chunk);
+	if (winterTypeOf(result) == WINTER_ERROR) {
+		fprintf(stderr, "error: %s\n%s\n", winterToString(result, NULL), source);
+		exit(1);
+	}
+	//Functions the script defined hold the chunk's prototypes, which outlive it
+	winterFreeChunk(state, chunk);
+	return result;
+}
+static inline winterInt_t runInt(winterState_t *state, const char *source) {
+	return winterToInt(runScript(state, source));
+}
+//Whether a script that compiles raises an error
+static inline int runFails(winterState_t *state, const char *source) {
+	char error[256];
+	winterChunk_t *chunk = winterLoadString(state, source, error, sizeof(error));
+	if (chunk == NULL) {
+		fprintf(stderr, "compile error: %s\n%s\n", error, source);
+		exit(1);
+	}
+	int failed = winterTypeOf(winterRun(state, chunk)) == WINTER_ERROR;
+	winterFreeChunk(state, chunk);
+	return failed;
+}
+
+static inline size_t liveTables(winterState_t *state) {
+	winterMemoryStats_t stats;
+	winterGetMemoryStats(state, &stats);
+	return stats.tables;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include "check.h"
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct buffer_t {
+	char *data;
+	size_t size;
+} buffer_t;
+
+static int bufferWriter(void *user, const void *data, size_t size) {
+	buffer_t *buffer = user;
+	buffer->data = realloc(buffer->data, buffer->size + size);
+	memcpy(buffer->data + buffer->size, data, size);
+	buffer->size += size;
+	return 0;
+}
+
+static const char *source =
+	"fn mk(s) { return fn(t) { return s + t; }; }\n"
+	"let a = mk(\"ab\");\n"
+	"fn loop(n, total) { if n == 0 { return total; } return loop(n - 1, total + 1); }\n"
+	"(a(\"cd\") == \"abcd\") * 10000 + loop(1000, 0);\n";
+static const char *cached = "let s = \"abcd\"; s + \"ef\" == \"abcdef\";";
+
+static winterInt_t runChunk(winterState_t *state, winterChunk_t *chunk) {
+	const winterValue_t *result = winterRun(state, chunk);
+	CHECK(winterTypeOf(result) == WINTER_INT);
+	return winterToInt(result);
+}
+
+//Removes the files the cache wrote
+static void removeDirectory(const char *path) {
+	DIR *dir = opendir(path);
+	CHECK(dir != NULL);
+	char file[512];
+	for (struct dirent *entry; (entry = readdir(dir)) != NULL;) {
+		if (entry->d_name[0] != '.') {
+			snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+			unlink(file);
+		}
+	}
+	closedir(dir);
+	rmdir(path);
+}
+
+int main(void) {
+	char error[256];
+	winterState_t *state = winterCreateState(testAllocator);
+	winterChunk_t *chunk = winterLoadString(state, source, error, sizeof(error));
+	CHECK(chunk != NULL);
+	winterInt_t expected = runChunk(state, chunk);
+	CHECK(expected == 11000);
+	buffer_t binary = { 0 };
+	CHECK(winterDumpChunk(state, chunk, 1, bufferWriter, &binary) == 0);
+	winterFreeChunk(state, chunk);
+	winterFreeState(state);
+
+	//A binary chunk runs the same in another state
+	state = winterCreateState(testAllocator);
+	chunk = winterLoadChunk(state, binary.data, binary.size, error, sizeof(error));
+	CHECK(chunk != NULL);
+	CHECK(runChunk(state, chunk) == expected);
+	winterFreeChunk(state, chunk);
+
+	//Corrupt chunks are rejected or load as some valid chunk, and never crash
+	char *copy = malloc(binary.size);
+	for (size_t i = 0; i < binary.size; i++) {
+		memcpy(copy, binary.data, binary.size);
+		copy[i] ^= 0x5a;
+		winterChunk_t *corrupt = winterLoadChunk(state, copy, binary.size, error, sizeof(error));
+		if (corrupt != NULL) {
+			winterFreeChunk(state, corrupt);
+		}
+	}
+	CHECK(winterLoadChunk(state, binary.data, binary.size / 2, error, sizeof(error)) == NULL);
+	free(copy);
+
+	//Running out of memory while loading leaves nothing allocated
+	winterMemoryStats_t before, after;
+	winterCollect(state);
+	winterGetMemoryStats(state, &before);
+	size_t failures = 0;
+	for (size_t limit = 100; limit < 20000; limit += 16) {
+		winterSetMemoryLimit(state, before.bytes + limit);
+		winterChunk_t *partial = winterLoadChunk(state, binary.data, binary.size, error, sizeof(error));
+		winterSetMemoryLimit(state, 0);
+		if (partial != NULL) {
+			winterFreeChunk(state, partial);
+		}
+		failures += partial == NULL;
+		winterCollect(state);
+		winterGetMemoryStats(state, &after);
+		CHECK(after.bytes == before.bytes);
+	}
+	CHECK(failures > 0);
+
+	//Mapped files and the compile cache
+	char directory[] = "/tmp/wintertestXXXXXX";
+	CHECK(mkdtemp(directory) != NULL);
+	char path[512];
+	snprintf(path, sizeof(path), "%s/chunk.wbc", directory);
+	FILE *file = fopen(path, "wb");
+	CHECK(file != NULL && fwrite(binary.data, 1, binary.size, file) == binary.size);
+	fclose(file);
+	winterState_t *mapped = winterCreateState(testAllocator);
+	chunk = winterMapChunk(mapped, path, error, sizeof(error));
+	CHECK(chunk != NULL);
+	CHECK(runChunk(mapped, chunk) == expected);
+	winterFreeChunk(mapped, chunk);
+	winterFreeState(mapped);
+	unlink(path);
+	CHECK(winterMapChunk(state, path, error, sizeof(error)) == NULL);
+
+	for (int i = 0; i < 2; i++) {
+		winterState_t *fresh = winterCreateState(testAllocator);
+		chunk = winterLoadCached(fresh, cached, directory, error, sizeof(error));
+		CHECK(chunk != NULL);
+		CHECK(runChunk(fresh, chunk) == 1);
+		winterFreeChunk(fresh, chunk);
+		winterFreeState(fresh);
+	}
+	DIR *dir = opendir(directory);
+	size_t entries = 0;
+	for (struct dirent *entry; (entry = readdir(dir)) != NULL;) {
+		entries += entry->d_name[0] != '.';
+	}
+	closedir(dir);
+	CHECK(entries == 1);
+	removeDirectory(directory);
+
+	//Compile errors are reported
+	CHECK(winterLoadString(state, "let = 3;", error, sizeof(error)) == NULL && error[0] != '\0');
+	winterFreeState(state);
+	free(binary.data);
+	return 0;
+}
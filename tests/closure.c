@@ -0,0 +1,48 @@
+#include "check.h"
+
+int main(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	CHECK(runInt(state, "fn fact(n) { if n < 2 { return 1; } return n * fact(n - 1); } fact(10);") == 3628800);
+
+	//Each closure has its own upvalues, shared by the closures of one call
+	CHECK(runInt(state,
+		"fn counter() { let c = 0; return fn() { c = c + 1; return c; }; }\n"
+		"let a = counter();\n"
+		"let b = counter();\n"
+		"a(); a(); b();\n"
+		"a() * 10 + b();") == 32);
+	CHECK(runInt(state, "fn adder(x) { return fn(y) { return fn(z) { return x + y + z; }; }; } adder(1)(2)(3);") == 6);
+	CHECK(runInt(state, "fn f() { let x = 1; let g = fn() { return x; }; x = 5; return g; } f()();") == 5);
+	CHECK(runInt(state,
+		"fn pair() { let v = 10; let get = fn() { return v; }; let set = fn(n) { v = n; }; set(42); return get(); }\n"
+		"pair();") == 42);
+	CHECK(runInt(state, "fn mk() { let s = \"str\"; return fn() { return s + \"!\"; }; } mk()() == \"str!\";") == 1);
+	CHECK(runInt(state, "fn lots(n) { if n == 0 { return 0; } let h = fn() { return n; }; return lots(n - 1) + h(); } lots(100);") == 5050);
+	CHECK(runInt(state, "let k = fn(a, b) { return a - b; }; k(10, 3);") == 7);
+
+	//Tail calls don't grow the stack, other calls are limited
+	CHECK(runInt(state, "fn loop(n, acc) { if n == 0 { return acc; } return loop(n - 1, acc + n); } loop(1000000, 0);") == 500000500000);
+	CHECK(runInt(state, "fn even(n) { if n == 0 { return 1; } return odd(n - 1); } fn odd(n) { if n == 0 { return 0; } return even(n - 1); } even(100001);") == 0);
+	CHECK(runInt(state, "fn deep(n) { if n == 0 { return 0; } return 1 + deep(n - 1); } deep(1000);") == 1000);
+	CHECK(runFails(state, "deep(1000000);"));
+
+	CHECK(winterTypeOf(runScript(state, "fn noret() { let q = 3; } noret();")) == WINTER_NULL);
+	CHECK(runInt(state, "let x = 1; x = x + 1; x;") == 2);
+	CHECK(runInt(state, "let branch = 0; if 0 { branch = 1; } else if 2 > 1 { branch = 2; } else { branch = 3; } branch;") == 2);
+	CHECK(runFails(state, "k(1);"));
+	CHECK(runFails(state, "undefinedfn(1);"));
+	CHECK(runFails(state, "fn bad() { return 1 + \"a\"; } bad();"));
+	CHECK(runFails(state, "let x = 2;"));
+
+	//Closures referencing themselves are collected
+	winterCollect(state);
+	winterMemoryStats_t before, after;
+	winterGetMemoryStats(state, &before);
+	runScript(state, "fn cyc() { let f = fn() { return f; }; return f; } cyc()()();\n");
+	runScript(state, "fn churn(n) { if n == 0 { return 0; } cyc(); return churn(n - 1); } churn(1000);\n");
+	winterCollect(state);
+	winterGetMemoryStats(state, &after);
+	CHECK(after.functions == before.functions + 2);
+	winterFreeState(state);
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include "check.h"
+
+//Each comparison is called often enough to be compiled, and counts how often it was true
+static const char *source =
+	"fn lt(a, b) { return a < b; }\n"
+	"fn le(a, b) { return a <= b; }\n"
+	"fn gt(a, b) { return a > b; }\n"
+	"fn ge(a, b) { return a >= b; }\n"
+	"fn eq(a, b) { return a == b; }\n"
+	"fn ne(a, b) { return a != b; }\n"
+	"fn count(f, a, b, n, total) { if n == 0 { return total; } return count(f, a, b, n - 1, total + f(a, b)); }\n"
+	"let nan = 0.0 / 0.0;\n";
+
+static void numbers(int jit) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterSetJit(state, jit);
+	runScript(state, source);
+	//Nothing is ordered against NaN, so only != holds
+	CHECK(runInt(state, "count(lt, nan, 1.0, 100, 0);") == 0);
+	CHECK(runInt(state, "count(le, nan, nan, 100, 0);") == 0);
+	CHECK(runInt(state, "count(gt, 1.0, nan, 100, 0);") == 0);
+	CHECK(runInt(state, "count(ge, nan, 1.0, 100, 0);") == 0);
+	CHECK(runInt(state, "count(eq, nan, nan, 100, 0);") == 0);
+	CHECK(runInt(state, "count(ne, nan, nan, 100, 0);") == 100);
+	CHECK(runInt(state, "count(lt, 1, nan, 100, 0);") == 0);
+	CHECK(runInt(state, "count(ne, 1, nan, 100, 0);") == 100);
+
+	CHECK(runInt(state, "count(lt, -1.5, 1.0, 100, 0);") == 100);
+	CHECK(runInt(state, "count(le, 2.0, 2.0, 100, 0);") == 100);
+	CHECK(runInt(state, "count(gt, 2.0, 2.0, 100, 0);") == 0);
+	CHECK(runInt(state, "count(ge, 3, 2.5, 100, 0);") == 100);
+	CHECK(runInt(state, "count(eq, 2, 2.0, 100, 0);") == 100);
+	CHECK(runInt(state, "count(lt, -3, 2, 100, 0);") == 100);
+	winterFreeState(state);
+}
+
+static winterInt_t compareStrings(winterState_t *state, const char *name, const char *a, size_t aLength,
+	const char *b, size_t bLength) {
+	winterValue_t args[2];
+	winterSetString(state, &args[0], a, aLength);
+	winterSetString(state, &args[1], b, bLength);
+	return winterToInt(winterCall(state, name, args, 2));
+}
+
+//Strings are ordered by all their bytes, NULs included
+static void strings(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	runScript(state, source);
+	CHECK(runInt(state, "\"ab\" < \"abc\";") == 1);
+	CHECK(runInt(state, "\"b\" > \"abc\";") == 1);
+	CHECK(runInt(state, "\"\" < \"a\";") == 1);
+	CHECK(runInt(state, "\"abc\" >= \"abc\";") == 1);
+	CHECK(compareStrings(state, "lt", "ab\0c", 4, "ab\0d", 4) == 1);
+	CHECK(compareStrings(state, "gt", "ab\0d", 4, "ab\0c", 4) == 1);
+	CHECK(compareStrings(state, "lt", "ab", 2, "ab\0", 3) == 1);
+	CHECK(compareStrings(state, "le", "ab\0", 3, "ab", 2) == 0);
+	CHECK(compareStrings(state, "eq", "ab\0c", 4, "ab\0c", 4) == 1);
+	CHECK(compareStrings(state, "ne", "ab\0c", 4, "ab\0d", 4) == 1);
+	winterFreeState(state);
+}
+
+int main(void) {
+	numbers(0);
+	numbers(1);
+	strings();
+	return 0;
+}
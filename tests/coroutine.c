@@ -0,0 +1,147 @@
+#include "check.h"
+
+static const char *source =
+	"fn counter(n) {\n"
+	"	fn loop(i, total) { if i < n { return loop(i + 1, total + yield(i)); } return total; }\n"
+	"	return loop(0, 0);\n"
+	"}\n"
+	"let escaped = null;\n"
+	"fn capture() { let x = 1; escaped = fn() { x = x + 100; return x; }; let r = yield(x); return x + r; }\n"
+	"fn bump() { return escaped(); }\n"
+	"fn inner() { return yield(1); }\n"
+	"fn viaNative() { return callsYield(); }\n"
+	"fn bad() { yield(1); return 1 + null; }\n"
+	"fn strings(a) { let s = a + \"!\"; let t = yield(s); return s + t; }\n"
+	"fn allocate(n) { if n == 0 { return yield(0); } let t = {}; return allocate(n - 1); }\n"
+	"fn caller() { let t = {value = 7}; let rejected = resumeIt(); return t.value * rejected; }\n";
+
+static winterCoroutine_t *pending;
+
+static int callsYield(winterState_t *state, winterValue_t *args, int argc) {
+	args[0] = *winterCall(state, "inner", NULL, 0);
+	return 1;
+}
+static int resumeIt(winterState_t *state, winterValue_t *args, int argc) {
+	const winterValue_t *result = winterResume(state, pending, NULL);
+	winterSetInt(&args[0], winterTypeOf(result) == WINTER_ERROR);
+	return 1;
+}
+
+static winterState_t *setup(winterChunk_t **chunk) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterRegister(state, "callsYield", callsYield, 0);
+	winterRegister(state, "resumeIt", resumeIt, 0);
+	char error[256];
+	*chunk = winterLoadString(state, source, error, sizeof(error));
+	CHECK(*chunk != NULL);
+	CHECK(winterTypeOf(winterRun(state, *chunk)) != WINTER_ERROR);
+	return state;
+}
+
+//Thousands of suspended coroutines survive collections and finish with their totals
+static void many(winterState_t *state) {
+	enum { COUNT = 5000 };
+	static winterCoroutine_t *coroutines[COUNT];
+	winterValue_t value;
+	winterSetInt(&value, 10);
+	for (int i = 0; i < COUNT; i++) {
+		coroutines[i] = winterCreateCoroutine(state, "counter", &value, 1);
+	}
+	long sum = 0;
+	for (int round = 0; round < 11; round++) {
+		for (int i = 0; i < COUNT; i++) {
+			winterSetInt(&value, 2);
+			const winterValue_t *out = winterResume(state, coroutines[i], &value);
+			if (winterCoroutineStatus(coroutines[i]) == WINTER_FINISHED) {
+				sum += winterToInt(out);
+			} else {
+				CHECK(winterToInt(out) == round);
+			}
+		}
+		winterCollect(state);
+	}
+	CHECK(sum == COUNT * 20);
+	for (int i = 0; i < COUNT; i++) {
+		winterFreeCoroutine(state, coroutines[i]);
+	}
+}
+
+//Upvalues are shared with closures called while the coroutine waits
+static void upvalues(winterState_t *state) {
+	winterCoroutine_t *coroutine = winterCreateCoroutine(state, "capture", NULL, 0);
+	CHECK(winterToInt(winterResume(state, coroutine, NULL)) == 1);
+	CHECK(winterToInt(winterCall(state, "bump", NULL, 0)) == 101);
+	winterValue_t value;
+	winterSetInt(&value, 5);
+	CHECK(winterToInt(winterResume(state, coroutine, &value)) == 106);
+	CHECK(winterToInt(winterCall(state, "bump", NULL, 0)) == 201);
+	CHECK(winterTypeOf(winterResume(state, coroutine, NULL)) == WINTER_ERROR);
+	winterFreeCoroutine(state, coroutine);
+}
+
+//Yielding across a native or outside a coroutine, and errors inside one, are errors
+static void errors(winterState_t *state) {
+	winterCoroutine_t *coroutine = winterCreateCoroutine(state, "viaNative", NULL, 0);
+	CHECK(winterTypeOf(winterResume(state, coroutine, NULL)) == WINTER_ERROR);
+	winterFreeCoroutine(state, coroutine);
+	CHECK(winterTypeOf(winterCall(state, "inner", NULL, 0)) == WINTER_ERROR);
+
+	coroutine = winterCreateCoroutine(state, "bad", NULL, 0);
+	winterResume(state, coroutine, NULL);
+	CHECK(winterTypeOf(winterResume(state, coroutine, NULL)) == WINTER_ERROR);
+	CHECK(winterCoroutineStatus(coroutine) == WINTER_FINISHED);
+	winterFreeCoroutine(state, coroutine);
+
+	coroutine = winterCreateCoroutine(state, "missing", NULL, 0);
+	CHECK(winterTypeOf(winterResume(state, coroutine, NULL)) == WINTER_ERROR);
+	winterFreeCoroutine(state, coroutine);
+}
+
+//Values on a suspended stack are kept across collections, and released when it's freed
+static void strings(winterState_t *state) {
+	enum { COUNT = 100 };
+	winterCoroutine_t *coroutines[COUNT];
+	winterValue_t value;
+	for (int i = 0; i < COUNT; i++) {
+		winterSetString(state, &value, "abc", 3);
+		coroutines[i] = winterCreateCoroutine(state, "strings", &value, 1);
+		winterResume(state, coroutines[i], NULL);
+	}
+	winterCollect(state);
+	for (int i = 0; i < COUNT; i++) {
+		winterSetString(state, &value, "xyz", 3);
+		size_t length;
+		const char *out = winterToString(winterResume(state, coroutines[i], &value), &length);
+		CHECK(length == 7 && memcmp(out, "abc!xyz", 7) == 0);
+		winterFreeCoroutine(state, coroutines[i]);
+	}
+
+	winterCoroutine_t *coroutine = winterCreateCoroutine(state, "capture", NULL, 0);
+	winterResume(state, coroutine, NULL);
+	winterFreeCoroutine(state, coroutine);
+	CHECK(winterToInt(winterCall(state, "bump", NULL, 0)) == 101);
+}
+
+//A native can't resume a coroutine, whose collections would free its caller's registers
+static void fromNative(winterState_t *state) {
+	winterValue_t value;
+	winterSetInt(&value, 2000);
+	pending = winterCreateCoroutine(state, "allocate", &value, 1);
+	CHECK(winterToInt(winterCall(state, "caller", NULL, 0)) == 7);
+	CHECK(winterCoroutineStatus(pending) == WINTER_SUSPENDED);
+	CHECK(winterToInt(winterResume(state, pending, NULL)) == 0);
+	winterFreeCoroutine(state, pending);
+}
+
+int main(void) {
+	winterChunk_t *chunk;
+	winterState_t *state = setup(&chunk);
+	many(state);
+	upvalues(state);
+	errors(state);
+	strings(state);
+	fromNative(state);
+	winterFreeChunk(state, chunk);
+	winterFreeState(state);
+	return 0;
+}
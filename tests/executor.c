@@ -0,0 +1,99 @@
+#include "check.h"
+#include <stdatomic.h>
+
+enum { WORKERS = 4, JOBS = 400 };
+
+static atomic_long inits, finished, failed, total;
+
+static int twice(winterState_t *state, winterValue_t *args, int argc) {
+	winterSetInt(&args[0], winterToInt(&args[0]) * 2);
+	return 1;
+}
+static void init(void *user, winterState_t *state) {
+	winterRegister(state, "twice", twice, 1);
+	inits++;
+}
+static void done(void *user, winterState_t *state, const winterValue_t *result) {
+	if (winterTypeOf(result) == WINTER_ERROR) {
+		failed++;
+	} else {
+		total += winterToInt(result);
+	}
+	finished++;
+}
+
+static winterChunk_t *share(winterState_t *state, const char *source) {
+	char error[256];
+	winterChunk_t *chunk = winterLoadString(state, source, error, sizeof(error));
+	CHECK(chunk != NULL);
+	winterChunk_t *shared = winterShareChunk(state, chunk);
+	CHECK(shared != NULL);
+	winterFreeChunk(state, chunk);
+	return shared;
+}
+
+//Jobs finish in any order on any worker, so only their totals are checked
+int main(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterChunk_t *library = share(state,
+		"fn fib(n) { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }\n"
+		"fn doubled(n) { return twice(n) + 1; }\n");
+	winterChunk_t *expression = share(state, "6 * 7;");
+	static const long fibs[] = { 0, 1, 1, 2, 3, 5, 8, 13, 21, 34, 55, 89, 144, 233, 377, 610, 987, 1597, 2584, 4181 };
+
+	winterExecutor_t *executor = winterCreateExecutor(testAllocator, WORKERS, init, NULL);
+	CHECK(executor != NULL);
+	CHECK(inits == WORKERS);
+	long expected = 0;
+	for (int round = 0; round < 2; round++) {
+		for (int i = 0; i < JOBS; i++) {
+			winterValue_t arg;
+			winterSetInt(&arg, i % 20);
+			CHECK(winterSubmit(executor, library, "fib", &arg, 1, done, NULL) == 0);
+			CHECK(winterSubmit(executor, library, "doubled", &arg, 1, done, NULL) == 0);
+			CHECK(winterSubmit(executor, expression, NULL, NULL, 0, done, NULL) == 0);
+			expected += fibs[i % 20] + (i % 20) * 2 + 1 + 42;
+		}
+		winterWait(executor);
+		CHECK(finished == (long)JOBS * 3 * (round + 1));
+		CHECK(failed == 0);
+		CHECK(total == expected);
+	}
+
+	//Errors in a job are its result
+	CHECK(winterSubmit(executor, library, "missing", NULL, 0, done, NULL) == 0);
+	CHECK(winterSubmit(executor, library, "fib", NULL, 0, done, NULL) == 0);
+	winterWait(executor);
+	CHECK(failed == 2);
+
+	//Only shared chunks and values that belong to no state are accepted
+	winterValue_t string;
+	winterSetString(state, &string, "x", 1);
+	CHECK(winterSubmit(executor, library, "fib", &string, 1, done, NULL) != 0);
+	winterValue_t args[17];
+	for (int i = 0; i < 17; i++) {
+		winterSetInt(&args[i], i);
+	}
+	CHECK(winterSubmit(executor, library, "fib", args, 17, done, NULL) != 0);
+	char error[256];
+	winterChunk_t *local = winterLoadString(state, "1;", error, sizeof(error));
+	CHECK(winterSubmit(executor, local, NULL, NULL, 0, done, NULL) != 0);
+	winterFreeChunk(state, local);
+
+	//Jobs still queued are finished before the workers stop
+	for (int i = 0; i < JOBS; i++) {
+		CHECK(winterSubmit(executor, expression, NULL, NULL, 0, done, NULL) == 0);
+	}
+	winterFreeExecutor(executor);
+	CHECK(finished == (long)JOBS * 7 + 2);
+
+	//One worker per core
+	inits = 0;
+	executor = winterCreateExecutor(testAllocator, 0, init, NULL);
+	CHECK(inits >= 1);
+	winterFreeExecutor(executor);
+	winterFreeChunk(state, library);
+	winterFreeChunk(state, expression);
+	winterFreeState(state);
+	return 0;
+}
@@ -0,0 +1,169 @@
+#include "check.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+enum { THREADS = 8, SIZE = 1000 };
+
+static const char *source =
+	"fn get(t, k) { return t[k]; }\n"
+	"fn put(t, k, v) { t[k] = v; return t[k]; }\n"
+	"fn loop(t, i, n, total) { if i < n { return loop(t, i + 1, n, total + t[i]); } return total; }\n"
+	"fn name(t) { return t.name == \"routing\"; }\n";
+static const winterInt_t expected = (SIZE - 1) * SIZE / 2 * 3;
+
+static winterValue_t frozen;
+
+static void setKey(winterState_t *state, winterValue_t *key, const char *name) {
+	winterSetString(state, key, name, strlen(name));
+}
+
+//A table of ints, a name and an inner table that holds itself, frozen
+static void build(winterState_t *state) {
+	winterValue_t table, inner, key, value;
+	winterSetTable(state, &table);
+	winterSetTable(state, &inner);
+	for (int i = 0; i < SIZE; i++) {
+		winterSetInt(&key, i);
+		winterSetInt(&value, i * 3);
+		CHECK(winterTableSet(state, &table, &key, &value) == 0);
+	}
+	setKey(state, &key, "name");
+	winterSetString(state, &value, "routing", 7);
+	winterTableSet(state, &table, &key, &value);
+	setKey(state, &key, "inner");
+	winterTableSet(state, &table, &key, &inner);
+	setKey(state, &key, "self");
+	winterTableSet(state, &inner, &key, &inner);
+	winterSetFloat(&key, 0.5);
+	winterSetFloat(&value, 2.5);
+	winterTableSet(state, &inner, &key, &value);
+	frozen = table;
+	CHECK(winterFreeze(state, &frozen) == 0);
+	CHECK(winterIsFrozen(&frozen) && winterTypeOf(&frozen) == WINTER_TABLE);
+}
+
+//Reads go through the host API, writes are refused
+static void host(winterState_t *state) {
+	winterValue_t key;
+	setKey(state, &key, "name");
+	const winterValue_t *name = winterTableGet(&frozen, &key);
+	CHECK(name != NULL && strcmp(winterToString(name, NULL), "routing") == 0);
+	setKey(state, &key, "inner");
+	const winterValue_t *inner = winterTableGet(&frozen, &key);
+	setKey(state, &key, "self");
+	CHECK(memcmp(winterTableGet(inner, &key), inner, sizeof(winterValue_t)) == 0);
+	winterSetFloat(&key, 0.5);
+	CHECK(winterToFloat(winterTableGet(inner, &key)) == 2.5);
+	winterSetInt(&key, SIZE * 5);
+	CHECK(winterTableGet(&frozen, &key) == NULL);
+	CHECK(winterTableSet(state, &frozen, &key, &key) == -1);
+}
+
+//Scripts index it like a table and raise an error when writing to it
+static void script(winterState_t *state) {
+	winterValue_t args[3] = { frozen };
+	winterSetInt(&args[1], 7);
+	CHECK(winterToInt(winterCall(state, "get", args, 2)) == 21);
+	winterSetInt(&args[2], 1);
+	CHECK(winterTypeOf(winterCall(state, "put", args, 3)) == WINTER_ERROR);
+	CHECK(winterToInt(winterCall(state, "name", args, 1)) == 1);
+	winterValue_t loop[4] = { frozen };
+	winterSetInt(&loop[1], 0);
+	winterSetInt(&loop[2], SIZE);
+	winterSetInt(&loop[3], 0);
+	CHECK(winterToInt(winterCall(state, "loop", loop, 4)) == expected);
+}
+
+//Any number of states read it at once
+static void *reader(void *arg) {
+	winterState_t *state = winterCreateState(testAllocator);
+	runScript(state, source);
+	intptr_t passed = 0;
+	for (int i = 0; i < 20; i++) {
+		winterValue_t args[4] = { frozen };
+		winterSetInt(&args[1], 0);
+		winterSetInt(&args[2], SIZE);
+		winterSetInt(&args[3], 0);
+		passed += winterToInt(winterCall(state, "loop", args, 4)) == expected;
+	}
+	winterFreeState(state);
+	return (void*)passed;
+}
+
+static atomic_long total;
+static void done(void *user, winterState_t *state, const winterValue_t *result) {
+	total += winterTypeOf(result) == WINTER_ERROR ? -1000000 : winterToInt(result);
+}
+static int nullWriter(void *user, const void *data, size_t size) {
+	return 0;
+}
+
+int main(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	runScript(state, source);
+	build(state);
+	host(state);
+	script(state);
+
+	pthread_t threads[THREADS];
+	for (int i = 0; i < THREADS; i++) {
+		CHECK(pthread_create(&threads[i], NULL, reader, NULL) == 0);
+	}
+	for (int i = 0; i < THREADS; i++) {
+		void *passed;
+		pthread_join(threads[i], &passed);
+		CHECK((intptr_t)passed == 20);
+	}
+
+	//Functions can't be frozen, and images can't hold frozen tables
+	winterValue_t function = *runScript(state, "fn f() { return 1; } let holder = {f = f}; holder;");
+	CHECK(winterFreeze(state, &function) == -1);
+	char error[256];
+	winterChunk_t *chunk = winterLoadString(state, "let kept = null; fn keep(t) { kept = t; return 0; }", error, sizeof(error));
+	winterChunk_t *shared = winterShareChunk(state, chunk);
+	winterFreeChunk(state, chunk);
+	winterRun(state, shared);
+	winterCall(state, "keep", &frozen, 1);
+	CHECK(winterSaveImage(state, nullWriter, NULL) != 0);
+
+	//Channels and jobs keep the block alive after the state that froze it is freed
+	winterChannel_t *channel = winterCreateChannel(testAllocator, 4, 0);
+	winterValue_t wrapper, key;
+	winterSetTable(state, &wrapper);
+	setKey(state, &key, "data");
+	winterTableSet(state, &wrapper, &key, &frozen);
+	CHECK(winterSend(state, channel, &wrapper) == 0);
+	CHECK(winterSend(state, channel, &frozen) == 0);
+	winterExecutor_t *executor = winterCreateExecutor(testAllocator, 4, NULL, NULL);
+	chunk = winterLoadString(state, source, error, sizeof(error));
+	winterChunk_t *library = winterShareChunk(state, chunk);
+	winterFreeChunk(state, chunk);
+	long want = 0;
+	for (int i = 0; i < 200; i++) {
+		winterValue_t args[2] = { frozen };
+		winterSetInt(&args[1], i);
+		CHECK(winterSubmit(executor, library, "get", args, 2, done, NULL) == 0);
+		want += i * 3;
+	}
+	winterFreeChunk(state, shared);
+	winterFreeChunk(state, library);
+	winterFreeState(state);
+	winterWait(executor);
+	CHECK(total == want);
+	winterFreeExecutor(executor);
+
+	state = winterCreateState(testAllocator);
+	const winterValue_t *received = winterReceive(state, channel);
+	setKey(state, &key, "data");
+	winterValue_t data = *winterTableGet(received, &key);
+	CHECK(winterIsFrozen(&data));
+	setKey(state, &key, "name");
+	CHECK(strcmp(winterToString(winterTableGet(&data, &key), NULL), "routing") == 0);
+	received = winterReceive(state, channel);
+	CHECK(winterIsFrozen(received));
+	winterSetInt(&key, 10);
+	CHECK(winterToInt(winterTableGet(received, &key)) == 30);
+	winterFreeChannel(channel);
+	winterFreeState(state);
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include "check.h"
+
+//Tables that only reference each other are freed by the cycle collector
+static void pairs(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	size_t baseline = liveTables(state);
+	runScript(state,
+		"fn pairs(n) {\n"
+		"	if n == 0 { return 0; }\n"
+		"	let a = {};\n"
+		"	let b = {other = a};\n"
+		"	a.other = b;\n"
+		"	a.self = a;\n"
+		"	return pairs(n - 1);\n"
+		"}\n"
+		"pairs(1000);\n");
+	winterCollect(state);
+	CHECK(liveTables(state) == baseline);
+	winterFreeState(state);
+}
+
+//A cycle longer than the C stack could recurse over, built with tail calls
+static void longCycle(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	size_t baseline = liveTables(state);
+	runScript(state,
+		"fn build(n, t) { if n == 0 { return t; } return build(n - 1, {next = t}); }\n"
+		"let head = {next = null};\n"
+		"head.next = build(100000, head);\n"
+		"head = null;\n");
+	CHECK(liveTables(state) > baseline + 100000);
+	winterCollect(state);
+	CHECK(liveTables(state) == baseline);
+	winterFreeState(state);
+}
+
+//Slices of a small budget free the same garbage as one collection
+static void slices(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	size_t baseline = liveTables(state);
+	winterSetCollectBudget(state, 4);
+	runScript(state,
+		"fn ring(n, first, last) {\n"
+		"	if n == 0 { last.next = first; return 0; }\n"
+		"	let t = {next = null};\n"
+		"	last.next = t;\n"
+		"	return ring(n - 1, first, t);\n"
+		"}\n"
+		"fn rings(n) { if n == 0 { return 0; } let t = {}; ring(10, t, t); return rings(n - 1); }\n"
+		"rings(200);\n");
+	size_t steps = 0;
+	while (winterCollectStep(state) > 0) {
+		steps++;
+	}
+	winterCollect(state);
+	CHECK(steps > 1);
+	CHECK(liveTables(state) == baseline);
+	winterFreeState(state);
+}
+
+//Making garbage cycles over and over doesn't grow the heap
+static void steady(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	runScript(state,
+		"fn churn(n) {\n"
+		"	if n == 0 { return 0; }\n"
+		"	let a = {};\n"
+		"	a.self = a;\n"
+		"	return churn(n - 1);\n"
+		"}\n");
+	runScript(state, "churn(2000);");
+	winterCollect(state);
+	winterMemoryStats_t first, stats;
+	winterGetMemoryStats(state, &first);
+	for (int i = 0; i < 10; i++) {
+		runScript(state, "churn(2000);");
+		winterCollect(state);
+		winterGetMemoryStats(state, &stats);
+		CHECK(stats.tables == first.tables);
+		CHECK(stats.bytes <= first.bytes);
+	}
+	winterFreeState(state);
+}
+
+//A cycle dropped while stale registers still point at it is freed by a later collection
+static void staleRegisters(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	size_t baseline = liveTables(state);
+	runScript(state,
+		"fn build(n, t) { if n == 0 { return t; } return build(n - 1, {next = t}); }\n"
+		"let tail = {next = null};\n"
+		"let head = build(999, tail);\n"
+		"tail.next = head;\n"
+		"head = null;\n"
+		"tail = null;\n"
+		"fn spin(n) { if n == 0 { return 0; } let t = {}; return spin(n - 1); }\n"
+		"spin(1000);\n");
+	winterCollect(state);
+	CHECK(liveTables(state) == baseline);
+	winterFreeState(state);
+}
+
+//Reachable tables survive collections
+static void reachable(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	runScript(state,
+		"let keep = {value = 42};\n"
+		"keep.self = keep;\n"
+		"fn garbage(n) { if n == 0 { return 0; } let t = {}; t.self = t; return garbage(n - 1); }\n"
+		"garbage(500);\n");
+	winterCollect(state);
+	CHECK(runInt(state, "keep.self.self.value;") == 42);
+	winterFreeState(state);
+}
+
+int main(void) {
+	pairs();
+	longCycle();
+	slices();
+	steady();
+	staleRegisters();
+	reachable();
+	return 0;
+}
@@ -0,0 +1,145 @@
+#include "check.h"
+#include <unistd.h>
+
+typedef struct buffer_t {
+	char *data;
+	size_t size;
+} buffer_t;
+
+static int bufferWriter(void *user, const void *data, size_t size) {
+	buffer_t *buffer = user;
+	buffer->data = realloc(buffer->data, buffer->size + size);
+	memcpy(buffer->data + buffer->size, data, size);
+	buffer->size += size;
+	return 0;
+}
+
+static int twice(winterState_t *state, winterValue_t *args, int argc) {
+	winterSetInt(&args[0], winterToInt(&args[0]) * 2);
+	return 1;
+}
+
+//Closures that share an upvalue, a native, strings, floats and a table with a cycle
+static const char *setup =
+	"let greeting = \"hel\" + \"lo\";\n"
+	"let double = twice;\n"
+	"fn counter() {\n"
+	"	let n = 0;\n"
+	"	let inc = fn() { n = n + 1; return n; };\n"
+	"	let get = fn() { return n; };\n"
+	"	return fn(w) { if w == 0 { return inc(); } return get(); };\n"
+	"}\n"
+	"let c = counter();\n"
+	"c(0); c(0);\n"
+	"let pi = 3.5;\n"
+	"let config = {name = greeting, size = 3};\n"
+	"config.self = config;\n";
+//Each part of it is checked by a digit
+static const char *use =
+	"c(0); c(0) * 10 + c(1) + (greeting + \"!\" == \"hello!\") * 100 + (pi * 2.0 == 7.0) * 1000\n"
+	"	+ (config.self.self.name == \"hello\") * 10000 + double(config.size) * 100000;";
+static const winterInt_t expected = 611144;
+
+static winterState_t *createState(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterRegister(state, "twice", twice, 1);
+	return state;
+}
+
+//Bytes held once results left on the stack are dropped and collected. What freed cycles
+//held is released into the zero count table, which the second collection empties
+static size_t liveBytes(winterState_t *state) {
+	runScript(state, "null;");
+	winterCollect(state);
+	winterCollect(state);
+	winterMemoryStats_t stats;
+	winterGetMemoryStats(state, &stats);
+	return stats.bytes;
+}
+
+//Loads the image into a fresh state and runs the script that uses what it set up
+static void check(const buffer_t *image) {
+	char error[256];
+	winterState_t *state = createState();
+	CHECK(winterLoadImage(state, image->data, image->size, error, sizeof(error)) == 0);
+	CHECK(runInt(state, use) == expected);
+	winterFreeState(state);
+}
+
+int main(void) {
+	char error[256];
+	winterState_t *state = createState();
+	runScript(state, setup);
+	buffer_t image = { 0 };
+	CHECK(winterSaveImage(state, bufferWriter, &image) == 0);
+	winterFreeState(state);
+	check(&image);
+
+	//Natives must be registered before loading
+	state = winterCreateState(testAllocator);
+	CHECK(winterLoadImage(state, image.data, image.size, error, sizeof(error)) != 0 && error[0] != '\0');
+	winterFreeState(state);
+
+	//A loaded state saves the same globals again
+	state = createState();
+	CHECK(winterLoadImage(state, image.data, image.size, error, sizeof(error)) == 0);
+	buffer_t resaved = { 0 };
+	CHECK(winterSaveImage(state, bufferWriter, &resaved) == 0);
+	winterFreeState(state);
+	check(&resaved);
+
+	//Mapped from a file
+	char path[] = "/tmp/winterimageXXXXXX";
+	int fd = mkstemp(path);
+	CHECK(fd >= 0 && write(fd, image.data, image.size) == (ssize_t)image.size);
+	close(fd);
+	state = createState();
+	CHECK(winterMapImage(state, path, error, sizeof(error)) == 0);
+	CHECK(runInt(state, use) == expected);
+	winterFreeState(state);
+	unlink(path);
+	state = createState();
+	CHECK(winterMapImage(state, path, error, sizeof(error)) != 0);
+	winterFreeState(state);
+
+	//Corrupt images are rejected or load as some valid image, and never crash. The code is
+	//used in place, so each copy lives as long as its state
+	char *copy = malloc(image.size);
+	for (size_t i = 0; i < image.size; i++) {
+		memcpy(copy, image.data, image.size);
+		copy[i] ^= 0x5a;
+		state = createState();
+		winterLoadImage(state, copy, image.size, error, sizeof(error));
+		winterFreeState(state);
+	}
+	free(copy);
+	state = createState();
+	CHECK(winterLoadImage(state, image.data, image.size / 2, error, sizeof(error)) != 0);
+	winterFreeState(state);
+
+	//Running out of memory while loading leaves the globals as they were and nothing else
+	//allocated once collected. The collector's lists are grown first by making cyclic garbage
+	size_t failures = 0;
+	for (size_t limit = 0; limit < 20000; limit += 32) {
+		state = createState();
+		runScript(state, "fn garbage(n) { if n == 0 { return 0; } let t = {}; t.self = t; return garbage(n - 1); }\n"
+			"let greeting = 1;\n"
+			"garbage(500);\n");
+		size_t baseline = liveBytes(state);
+		winterSetMemoryLimit(state, baseline + limit);
+		int failed = winterLoadImage(state, image.data, image.size, error, sizeof(error)) != 0;
+		winterSetMemoryLimit(state, 0);
+		if (failed) {
+			failures++;
+			CHECK(liveBytes(state) == baseline);
+			CHECK(runInt(state, "greeting;") == 1);
+		} else {
+			CHECK(runInt(state, use) == expected);
+		}
+		winterFreeState(state);
+	}
+	CHECK(failures > 0);
+	free(image.data);
+	free(resaved.data);
+	return 0;
+}
@@ -0,0 +1,102 @@
+#include "check.h"
+#include <math.h>
+
+typedef struct buffer_t {
+	char data[4096];
+	size_t size;
+} buffer_t;
+
+static int bufferWriter(void *user, const void *data, size_t size) {
+	buffer_t *buffer = user;
+	CHECK(buffer->size + size < sizeof(buffer->data));
+	memcpy(buffer->data + buffer->size, data, size);
+	buffer->size += size;
+	buffer->data[buffer->size] = '\0';
+	return 0;
+}
+static const char *encode(winterState_t *state, const winterValue_t *value, buffer_t *buffer) {
+	buffer->size = 0;
+	CHECK(winterEncodeJson(state, value, bufferWriter, buffer) == 0);
+	return buffer->data;
+}
+
+//Documents decode and encode again in their compact form, with object keys in order
+static const char *roundTrips[][2] = {
+	{ "{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2}" },
+	{ "{\"a\":1,\"a\":2,\"b\":3}", "{\"a\":2,\"b\":3}" },
+	{ "[{\"a\":1,\"b\":2},{\"a\":3,\"b\":4,\"c\":5},{\"b\":6,\"a\":7}]", "[{\"a\":1,\"b\":2},{\"a\":3,\"b\":4,\"c\":5},{\"b\":6,\"a\":7}]" },
+	{ "[0.1, 1e300, -2.5e-10, 123456789.125, 1e16, 3.0, -0.0, 0.0001, 0.00001, 5e-324, 1.7976931348623157e308]",
+	  "[0.1,1e+300,-2.5e-10,123456789.125,1e+16,3.0,-0.0,0.0001,1e-05,5e-324,1.7976931348623157e+308]" },
+	{ "[[],{},[[]]]", "[[],{},[[]]]" },
+	{ "\"a\\u00e9\\ud83d\\ude00\\n\\t\\\"\\\\/\"", "\"a\xc3\xa9\xf0\x9f\x98\x80\\n\\t\\\"\\\\/\"" },
+	{ "[true,false,null, -12, 9223372036854775807]", "[1,0,null,-12,9223372036854775807]" },
+	{ " { \"k\" : [ 1 , 2 ] } ", "{\"k\":[1,2]}" },
+	{ "[1e999]", "[null]" },
+};
+static const char *invalid[] = { "{", "[1,]", "\"\\x\"", "1 2", "\"\\ud800\"", "01", "\"\x01\"", "", "[", "{\"a\" 1}", "tru" };
+
+static void documents(winterState_t *state) {
+	buffer_t buffer;
+	for (size_t i = 0; i < sizeof(roundTrips) / sizeof(*roundTrips); i++) {
+		const winterValue_t *value = winterDecodeJson(state, roundTrips[i][0], strlen(roundTrips[i][0]));
+		CHECK(winterTypeOf(value) != WINTER_ERROR);
+		CHECK(strcmp(encode(state, value, &buffer), roundTrips[i][1]) == 0);
+	}
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); i++) {
+		CHECK(winterTypeOf(winterDecodeJson(state, invalid[i], strlen(invalid[i]))) == WINTER_ERROR);
+	}
+	//Script strings can't hold quotes, so objects are only encoded there
+	CHECK(runInt(state, "let d = jsondecode(\"[[1,2,3],[2.5]]\"); d[0][2] + d[1][0] * 2;") == 8);
+	CHECK(strcmp(winterToString(runScript(state, "jsonencode({a = 1, b = {c = 2}});"), NULL), "{\"a\":1,\"b\":{\"c\":2}}") == 0);
+	CHECK(runFails(state, "fn f() { return 1; } jsonencode({g = f});"));
+}
+
+//Floats print with Grisu2's digits, which read back as the same bits and are the shortest
+//in nearly every case. 1e23 is one it misses
+static void floats(winterState_t *state) {
+	static const struct { double value; const char *text; } exact[] = {
+		{ 0.1, "0.1" }, { 0.3, "0.3" }, { 1.0, "1.0" }, { 100.0, "100.0" }, { 1e15, "1e+15" },
+		{ 2.0 / 3, "0.6666666666666666" }, { 1e23, "9.999999999999999e+22" }, { 74.17869892607294, "74.17869892607294" },
+		{ 2.2250738585072014e-308, "2.2250738585072014e-308" }, { 9007199254740993.0, "9007199254740992.0" },
+	};
+	buffer_t buffer;
+	winterValue_t value;
+	for (size_t i = 0; i < sizeof(exact) / sizeof(*exact); i++) {
+		winterSetFloat(&value, exact[i].value);
+		CHECK(strcmp(encode(state, &value, &buffer), exact[i].text) == 0);
+	}
+	winterSetFloat(&value, NAN);
+	CHECK(strcmp(encode(state, &value, &buffer), "null") == 0);
+
+	uint64_t seed = 88172645463325252ull;
+	for (long i = 0; i < 300000; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		double v;
+		if (i % 3 == 0) {
+			memcpy(&v, &seed, sizeof(v));
+			if (!isfinite(v)) continue;
+		} else if (i % 3 == 1) {
+			v = (double)(seed % 1000000) / pow(10, (double)(seed >> 40 & 7));
+		} else {
+			v = (double)(seed >> 11) * 0x1p-53 * pow(10, (double)((int)(seed % 40) - 20));
+		}
+		winterSetFloat(&value, v);
+		const char *text = encode(state, &value, &buffer);
+		CHECK(strtod(text, NULL) == v && signbit(strtod(text, NULL)) == signbit(v));
+		CHECK(strpbrk(text, ".e") != NULL);
+		//Reading it back gives the float again
+		const winterValue_t *decoded = winterDecodeJson(state, text, strlen(text));
+		CHECK(winterTypeOf(decoded) == WINTER_FLOAT && winterToFloat(decoded) == v);
+	}
+}
+
+int main(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenJson(state);
+	documents(state);
+	floats(state);
+	winterFreeState(state);
+	return 0;
+}
@@ -0,0 +1,133 @@
+#include "check.h"
+#include <stdarg.h>
+#include <unistd.h>
+
+enum { CLIENTS = 20, ROUNDS = 10, BIG = 1 << 20 };
+
+static const char *source =
+	"fn echo(c) { let m = read(c, 4096); if m == \"\" { close(c); return 0; } write(c, m); return echo(c); }\n"
+	"fn serve(fd, n) { if n == 0 { close(fd); return 0; } spawn(\"echo\", accept(fd)); return serve(fd, n - 1); }\n"
+	"fn talk(s, i, n, total) { if i == n { close(s); return total; } write(s, \"x\"); let r = read(s, 1); sleep(0); return talk(s, i + 1, n, total + (r == \"x\")); }\n"
+	"fn client(p, n) { return talk(connect(\"127.0.0.1\", p), 0, n, 0); }\n"
+	"fn pipes(k) { let p = pipe(); spawn(\"produce\", p[1], k); return consume(p[0], 0); }\n"
+	"fn produce(w, k) { if k == 0 { close(w); return 0; } write(w, \"xy\"); sleep(1); return produce(w, k - 1); }\n"
+	"fn consume(r, n) { let m = read(r, 1); if m == \"\" { close(r); return n; } return consume(r, n + 1); }\n"
+	"fn stuck(r) { return read(r, 10); }\n"
+	"fn waker(fd) { sleep(10); close(fd); return 5; }\n"
+	"fn big(w, s) { let n = write(w, s); close(w); return n; }\n"
+	"fn drain(r, data) { let m = read(r, 65536); if m == \"\" { close(r); return data; } return drain(r, data + m); }\n"
+	"fn once(r) { return read(r, 1); }\n"
+	"fn poke(w) { sleep(5); write(w, \"q\"); close(w); return 0; }\n"
+	"fn timed() { let t = now(); sleep(20); return now() - t >= 20; }\n"
+	"let fired = 0;\n"
+	"fn fire(n) { fired = fired + n; return fired; }\n";
+
+//Results of one kind of coroutine, strings count their length
+typedef struct tally_t {
+	long finished, errors, total;
+} tally_t;
+
+static void done(void *user, winterState_t *state, const winterValue_t *result) {
+	tally_t *tally = user;
+	tally->finished++;
+	size_t length;
+	if (winterTypeOf(result) == WINTER_ERROR) {
+		tally->errors++;
+	} else if (winterToString(result, &length) != NULL) {
+		tally->total += (long)length;
+	} else {
+		tally->total += (long)winterToInt(result);
+	}
+}
+
+static void spawn(winterLoop_t *loop, const char *name, tally_t *tally, int argc, ...) {
+	winterValue_t args[4];
+	va_list list;
+	va_start(list, argc);
+	for (int i = 0; i < argc; i++) {
+		winterSetInt(&args[i], va_arg(list, int));
+	}
+	va_end(list);
+	CHECK(winterSpawn(loop, name, args, argc, tally ? done : NULL, tally) == 0);
+}
+
+int main(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterLoop_t *loop = winterCreateLoop(state, NULL, NULL);
+	CHECK(loop != NULL);
+	CHECK(winterCreateLoop(state, NULL, NULL) == NULL);
+	runScript(state, source);
+
+	//Clients talk to an echo server over loopback
+	int server = (int)runInt(state, "listen(0);");
+	winterValue_t arg;
+	winterSetInt(&arg, server);
+	int port = (int)winterToInt(winterCall(state, "port", &arg, 1));
+	tally_t clients = { 0 };
+	spawn(loop, "serve", NULL, 2, server, CLIENTS);
+	for (int i = 0; i < CLIENTS; i++) {
+		spawn(loop, "client", &clients, 2, port, ROUNDS);
+	}
+
+	//Pipes made by scripts, closing a descriptor wakes its reader with an error
+	tally_t pipes = { 0 }, stuck = { 0 }, waker = { 0 };
+	for (int i = 0; i < 50; i++) {
+		spawn(loop, "pipes", &pipes, 1, 3);
+	}
+	int fds[2];
+	CHECK(pipe(fds) == 0);
+	spawn(loop, "stuck", &stuck, 1, fds[0]);
+	spawn(loop, "waker", &waker, 1, fds[0]);
+
+	//A write bigger than the pipe's buffer waits for the reader
+	tally_t big = { 0 }, drain = { 0 };
+	int bulk[2];
+	CHECK(pipe(bulk) == 0);
+	char *data = malloc(BIG);
+	memset(data, 'z', BIG);
+	winterValue_t args[2];
+	winterSetInt(&args[0], bulk[1]);
+	winterSetString(state, &args[1], data, BIG);
+	free(data);
+	CHECK(winterSpawn(loop, "big", args, 2, done, &big) == 0);
+	winterSetInt(&args[0], bulk[0]);
+	winterSetString(state, &args[1], "", 0);
+	CHECK(winterSpawn(loop, "drain", args, 2, done, &drain) == 0);
+
+	//A descriptor has one reader at a time
+	tally_t once = { 0 };
+	int shared[2];
+	CHECK(pipe(shared) == 0);
+	spawn(loop, "once", &once, 1, shared[0]);
+	spawn(loop, "once", &once, 1, shared[0]);
+	spawn(loop, "poke", NULL, 1, shared[1]);
+
+	tally_t timed = { 0 };
+	spawn(loop, "timed", &timed, 0);
+	runScript(state, "after(5, \"fire\", 2); after(1, \"fire\", 1);");
+
+	CHECK(winterRunLoop(loop) == 0);
+	CHECK(clients.finished == CLIENTS && clients.errors == 0 && clients.total == CLIENTS * ROUNDS);
+	CHECK(pipes.finished == 50 && pipes.errors == 0 && pipes.total == 50 * 6);
+	CHECK(stuck.errors == 1 && waker.total == 5);
+	CHECK(big.errors == 0 && big.total == BIG);
+	CHECK(drain.errors == 0 && drain.total == BIG);
+	CHECK(once.finished == 2 && once.errors == 1 && once.total == 1);
+	CHECK(timed.total == 1);
+	CHECK(runInt(state, "fired;") == 3);
+
+	//Coroutines still waiting are freed with the loop
+	CHECK(pipe(fds) == 0);
+	spawn(loop, "stuck", NULL, 1, fds[0]);
+	spawn(loop, "produce", NULL, 2, fds[1], 1);
+	winterFreeLoop(loop);
+	close(fds[0]);
+	close(fds[1]);
+	close(shared[0]);
+
+	//Waiting outside of a coroutine is an error
+	winterSetInt(&arg, 0);
+	CHECK(winterTypeOf(winterCall(state, "stuck", &arg, 1)) == WINTER_ERROR);
+	winterFreeState(state);
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include "check.h"
+
+//Bytes held once results left on the stack are dropped and collected
+static size_t liveBytes(winterState_t *state) {
+	runScript(state, "null;");
+	winterCollect(state);
+	winterMemoryStats_t stats;
+	winterGetMemoryStats(state, &stats);
+	return stats.bytes;
+}
+
+//Running out of memory anywhere while decoding leaves nothing allocated once collected
+//Objects with more keys than a record holds are tables with buckets, allocated in two parts
+static void decode(void) {
+	char json[16384];
+	size_t length = 0;
+	json[length++] = '[';
+	for (int i = 0; i < 20; i++) {
+		length += (size_t)sprintf(json + length, "%s{", i ? "," : "");
+		for (int j = 0; j < 40; j++) {
+			length += (size_t)sprintf(json + length, "%s\"k%d\":[%d]", j ? "," : "", j, j);
+		}
+		json[length++] = '}';
+	}
+	json[length++] = ']';
+
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenJson(state);
+	//Buffers kept for later calls are allocated by the first
+	winterValue_t first;
+	winterSetString(state, &first, json, length);
+	CHECK(winterTypeOf(winterCall(state, "jsondecode", &first, 1)) != WINTER_ERROR);
+	size_t baseline = liveBytes(state);
+	size_t failures = 0;
+	for (size_t limit = baseline; limit < baseline + 400000; limit += 1000) {
+		//Strings made by the host are freed by the collection once the call is done
+		winterValue_t arg;
+		winterSetString(state, &arg, json, length);
+		winterSetMemoryLimit(state, limit);
+		const winterValue_t *result = winterCall(state, "jsondecode", &arg, 1);
+		failures += winterTypeOf(result) == WINTER_ERROR;
+		winterSetMemoryLimit(state, 0);
+		CHECK(liveBytes(state) == baseline);
+	}
+	CHECK(failures > 0);
+	winterFreeState(state);
+}
+
+//The same holds for scripts making tables, closures, strings and coroutines
+static int spawn(winterState_t *state, winterValue_t *args, int argc) {
+	winterCoroutine_t *coroutine = winterCreateCoroutine(state, "worker", NULL, 0);
+	winterFreeCoroutine(state, coroutine);
+	return 0;
+}
+static void script(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterRegister(state, "spawn", spawn, 0);
+	runScript(state,
+		"fn worker() { return 0; }\n"
+		"fn make(n, keep) {\n"
+		"	if n == 0 { return keep; }\n"
+		"	let t = {a = n, b = keep, f = fn() { return n; }, s = \"x\" + \"y\"};\n"
+		"	spawn();\n"
+		"	return make(n - 1, t);\n"
+		"}\n"
+		"make(200, null);\n");
+	size_t baseline = liveBytes(state);
+	size_t failures = 0;
+	for (size_t limit = baseline; limit < baseline + 100000; limit += 97) {
+		winterValue_t args[2];
+		winterSetInt(&args[0], 200);
+		winterSetNull(&args[1]);
+		winterSetMemoryLimit(state, limit);
+		failures += winterTypeOf(winterCall(state, "make", args, 2)) == WINTER_ERROR;
+		winterSetMemoryLimit(state, 0);
+		CHECK(liveBytes(state) == baseline);
+	}
+	CHECK(failures > 0);
+	winterFreeState(state);
+}
+
+int main(void) {
+	decode();
+	script();
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include "check.h"
+
+static int add(winterState_t *state, winterValue_t *args, int argc) {
+	winterSetInt(&args[0], winterToInt(&args[0]) + winterToInt(&args[1]));
+	return 1;
+}
+static int greet(winterState_t *state, winterValue_t *args, int argc) {
+	size_t length;
+	const char *name = winterToString(&args[0], &length);
+	if (name == NULL) {
+		winterSetError(state, &args[0], "greet: expected a string, got type %i", winterTypeOf(&args[0]));
+		return 1;
+	}
+	char buffer[64];
+	int size = snprintf(buffer, sizeof(buffer), "hello %s", name);
+	winterSetString(state, &args[0], buffer, (size_t)size);
+	return 1;
+}
+static int half(winterState_t *state, winterValue_t *args, int argc) {
+	winterSetFloat(&args[0], 1.5);
+	return 1;
+}
+static int count(winterState_t *state, winterValue_t *args, int argc) {
+	winterSetInt(&args[0], argc);
+	return 1;
+}
+static int nothing(winterState_t *state, winterValue_t *args, int argc) {
+	return 0;
+}
+
+int main(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterRegister(state, "add", add, 2);
+	winterRegister(state, "greet", greet, 1);
+	winterRegister(state, "half", half, 0);
+	winterRegister(state, "count", count, -1);
+	winterRegister(state, "nothing", nothing, 0);
+
+	//Natives are values called like script functions, their results are values too
+	CHECK(runInt(state, "add(1, add(2, 3)) * 2;") == 12);
+	CHECK(runInt(state, "greet(\"bob\") == \"hello bob\";") == 1);
+	CHECK(winterToFloat(runScript(state, "half() + 1;")) == 2.5);
+	CHECK(runInt(state, "count() * 10 + count(1, 2, 3);") == 3);
+	CHECK(winterTypeOf(runScript(state, "nothing();")) == WINTER_NULL);
+	CHECK(runInt(state, "let f = add; f(20, 22);") == 42);
+	CHECK(runInt(state, "fn twice(g, x) { return g(g(x, x), x); } twice(add, 3);") == 9);
+
+	//Wrong arity and errors set by the native are raised in the script
+	CHECK(runFails(state, "add(1);"));
+	CHECK(runFails(state, "half(1);"));
+	CHECK(runFails(state, "greet(3);"));
+	CHECK(runFails(state, "missing(1);"));
+
+	//Registering a name again replaces the function
+	winterRegister(state, "add", half, 0);
+	CHECK(winterToFloat(runScript(state, "add();")) == 1.5);
+
+	//Calling natives over and over doesn't leave values behind
+	runScript(state, "fn loop(n) { if n == 0 { return 0; } let s = greet(\"loop\") + \"!\"; return loop(n - 1); }\n");
+	runScript(state, "loop(100);");
+	winterCollect(state);
+	winterMemoryStats_t first, stats;
+	winterGetMemoryStats(state, &first);
+	runScript(state, "loop(2000);");
+	winterCollect(state);
+	winterGetMemoryStats(state, &stats);
+	CHECK(stats.strings == first.strings);
+	CHECK(stats.functions == first.functions);
+	winterFreeState(state);
+	return 0;
+}
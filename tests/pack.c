@@ -0,0 +1,59 @@
+#include "check.h"
+
+static const char *source =
+	"let inner = {v = 1, s = \"shared\" + \"!\"};\n"
+	"let t = {a = inner, b = inner, f = -2.5, n = 9223372036854775807, name = \"pack\"};\n"
+	"t.self = t;\n"
+	"t[3] = \"three\";\n"
+	"t[0.5] = null;\n"
+	"let xs = array(\"int32\", 4); xs[2] = 7;\n"
+	"t.xs = xs;\n"
+	"t.view = slice(xs, 1, 4);\n"
+	"fn check(u) {\n"
+	"	return (u.self.self.name == \"pack\") + (u.a == u.b) * 10 + (u.a.s == \"shared!\") * 100 + (u.f == -2.5) * 1000\n"
+	"		+ (u.n == 9223372036854775807) * 10000 + (u[3] == \"three\") * 100000 + (u.xs[2] + u.view[1] == 14) * 1000000;\n"
+	"}\n";
+
+int main(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenArrays(state);
+	winterOpenPack(state);
+	runScript(state, source);
+	CHECK(runInt(state, "check(t);") == 1111111);
+	CHECK(runInt(state, "check(unpack(pack(t)));") == 1111111);
+	CHECK(runInt(state, "unpack(pack(3)) + unpack(pack(0.5)) == 3.5;") == 1);
+	CHECK(runFails(state, "fn f() { return 1; } pack({g = f});"));
+	CHECK(runFails(state, "unpack(\"not packed\");"));
+
+	//The size is reported when the buffer is too small, and strings can borrow from the data
+	winterValue_t string;
+	winterSetString(state, &string, "borrowed", 8);
+	size_t size = winterEncodeValue(state, &string, NULL, 0);
+	CHECK(size > 8);
+	char *data = malloc(size);
+	CHECK(winterEncodeValue(state, &string, data, size) == size);
+	size_t length;
+	const char *text = winterToString(winterDecodeValue(state, data, size, 0), &length);
+	CHECK(length == 8 && memcmp(text, "borrowed", 8) == 0 && (text < data || text >= data + size));
+	text = winterToString(winterDecodeValue(state, data, size, WINTER_BORROW), &length);
+	CHECK(length == 8 && memcmp(text, "borrowed", 8) == 0 && text >= data && text < data + size);
+
+	//Damaged data is refused or decodes as some value, and never crashes
+	const winterValue_t *packed = runScript(state, "pack(t);");
+	size_t packedSize;
+	const char *bytes = winterToString(packed, &packedSize);
+	char *copy = malloc(packedSize);
+	memcpy(copy, bytes, packedSize);
+	char *damaged = malloc(packedSize);
+	for (size_t i = 0; i < packedSize; i++) {
+		memcpy(damaged, copy, packedSize);
+		damaged[i] ^= 0x5a;
+		winterDecodeValue(state, damaged, packedSize, 0);
+		CHECK(winterTypeOf(winterDecodeValue(state, copy, i, 0)) == WINTER_ERROR);
+	}
+	winterFreeState(state);
+	free(copy);
+	free(damaged);
+	free(data);
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include "check.h"
+
+enum { COUNT = 5000 };
+
+static int twice(winterState_t *state, winterValue_t *args, int argc) {
+	winterSetFloat(&args[0], winterToFloat(&args[0]) * 2);
+	return 1;
+}
+//Workers have their own globals, 'nested' calls back into the workers from one of them
+static void init(void *user, winterState_t *worker) {
+	winterRegister(worker, "twice", twice, 1);
+	runScript(worker, "fn nested(x) { return parallelreduce(array(\"int32\", 4), nested, 0); }");
+	(*(int*)user)++;
+}
+
+static const char *source =
+	"fn lookup(x, t) { return twice(x) + t.k; }\n"
+	"fn nested(x) { return x; }\n"
+	"fn add(x, y) { return x + y; }\n"
+	"fn square(x) { return x * x; }\n"
+	"fn mapped(a, t) { return sum(parallelmap(a, lookup, null, t)); }\n"
+	"fn reduced(a) { return parallelreduce(a, add, 0); }\n"
+	"fn wrap(x) { return nested(x); }\n"
+	"fn recursive(a) { return parallelmap(a, wrap); }\n"
+	"fn captures(a) { let k = 1; return parallelmap(a, fn(x) { return x + k; }); }\n"
+	"fn into(a) { let out = array(\"int64\", length(a)); parallelmap(a, square, out); return out; }\n"
+	"fn strided(a) { return parallelreduce(slice(a, 1, length(a), 3), add, 0); }\n";
+
+int main(void) {
+	int inits = 0;
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenArrays(state);
+	winterSetWorkers(state, 3, init, &inits);
+	runScript(state, source);
+
+	double *data = malloc(sizeof(double) * COUNT);
+	for (int i = 0; i < COUNT; i++) {
+		data[i] = i;
+	}
+	winterValue_t args[2], key, value;
+	CHECK(winterSetArray(state, &args[0], WINTER_FLOAT64, data, COUNT, WINTER_READ_ONLY, NULL, NULL) == 0);
+	winterSetTable(state, &args[1]);
+	winterSetString(state, &key, "k", 1);
+	winterSetInt(&value, 1);
+	winterTableSet(state, &args[1], &key, &value);
+
+	//Tables must be frozen to reach the workers
+	CHECK(winterTypeOf(winterCall(state, "mapped", args, 2)) == WINTER_ERROR);
+	CHECK(winterFreeze(state, &args[1]) == 0);
+	CHECK(winterToFloat(winterCall(state, "mapped", args, 2)) == 2.0 * (COUNT - 1) * COUNT / 2 + COUNT);
+	CHECK(inits == 3);
+	CHECK(winterToFloat(winterCall(state, "reduced", args, 1)) == (COUNT - 1) * COUNT / 2);
+	CHECK(winterToFloat(winterCall(state, "strided", args, 1)) == 1666 * 1667 / 2 * 3 + 1667);
+
+	//Results go into a given array, converted to its kind
+	const winterValue_t *out = winterCall(state, "into", args, 1);
+	winterArrayType_t type;
+	size_t length;
+	const int64_t *squares = winterToArray(out, &type, &length, NULL);
+	CHECK(type == WINTER_INT64 && length == COUNT);
+	for (int i = 0; i < COUNT; i++) {
+		CHECK(squares[i] == (int64_t)i * i);
+	}
+
+	//Workers can't start parallel work, and callbacks can't capture
+	CHECK(winterTypeOf(winterCall(state, "recursive", args, 1)) == WINTER_ERROR);
+	CHECK(winterTypeOf(winterCall(state, "captures", args, 1)) == WINTER_ERROR);
+
+	//Replacing the workers starts new ones on first use
+	winterSetWorkers(state, 2, init, &inits);
+	CHECK(inits == 3);
+	CHECK(winterToFloat(winterCall(state, "reduced", args, 1)) == (COUNT - 1) * COUNT / 2);
+	CHECK(inits == 5);
+	winterFreeState(state);
+	free(data);
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include "check.h"
+#include "wtype.h"
+
+enum { COUNT = 20000, ROUNDS = 300000 };
+static unsigned char *pointers[COUNT];
+static size_t sizes[COUNT];
+
+static void fill(int i, size_t from) {
+	for (size_t k = from; k < sizes[i]; k++) {
+		pointers[i][k] = (unsigned char)(i + k);
+	}
+}
+static void verify(int i) {
+	for (size_t k = 0; k < sizes[i]; k++) {
+		CHECK(pointers[i][k] == (unsigned char)(i + k));
+	}
+}
+
+//Random allocations, reallocations and frees across the size classes and large sizes keep
+//their contents, and freeing all of them hands every slot back
+int main(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterPoolStats_t before, stats;
+	winterGetPoolStats(state, &before);
+
+	srand(1);
+	for (int round = 0; round < ROUNDS; round++) {
+		int i = rand() % COUNT;
+		if (pointers[i] == NULL) {
+			sizes[i] = rand() % 4 == 0 ? (size_t)(rand() % 3000 + 1) : (size_t)(rand() % 200 + 1);
+			pointers[i] = MALLOC(sizes[i]);
+			fill(i, 0);
+		} else if (rand() % 3 == 0) {
+			verify(i);
+			size_t size = (size_t)(rand() % 2000 + 1);
+			pointers[i] = REALLOC(pointers[i], size);
+			size_t kept = size < sizes[i] ? size : sizes[i];
+			sizes[i] = kept;
+			verify(i);
+			sizes[i] = size;
+			fill(i, kept);
+		} else {
+			verify(i);
+			FREE(pointers[i]);
+			pointers[i] = NULL;
+		}
+	}
+
+	winterGetPoolStats(state, &stats);
+	CHECK(stats.usedSlots > before.usedSlots);
+	CHECK(stats.fragmentation >= 0.0 && stats.fragmentation < 1.0);
+
+	for (int i = 0; i < COUNT; i++) {
+		if (pointers[i] != NULL) {
+			verify(i);
+			FREE(pointers[i]);
+		}
+	}
+	winterGetPoolStats(state, &stats);
+	CHECK(stats.usedSlots == before.usedSlots);
+	CHECK(stats.usedBytes == before.usedBytes);
+	CHECK(stats.largeAllocs == before.largeAllocs);
+
+	//Small objects come from pages, so the host allocator sees few of the calls
+	for (int i = 0; i < COUNT; i++) {
+		sizes[i] = (size_t)(i % POOL_MAX_SMALL + 1);
+		pointers[i] = MALLOC(sizes[i]);
+		fill(i, 0);
+	}
+	winterPoolStats_t small;
+	winterGetPoolStats(state, &small);
+	CHECK(small.hostCalls - stats.hostCalls < COUNT / 100);
+	CHECK(small.largeAllocs == before.largeAllocs);
+	for (int i = 0; i < COUNT; i++) {
+		verify(i);
+		FREE(pointers[i]);
+	}
+	winterFreeState(state);
+	return 0;
+}
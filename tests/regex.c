@@ -0,0 +1,83 @@
+#include "check.h"
+
+//Decodes a hex field of the corpus, '-' is empty
+static size_t unhex(const char *field, char *out) {
+	size_t length = 0;
+	if (strcmp(field, "-") != 0) {
+		for (; field[0] && field[1]; field += 2) {
+			unsigned byte;
+			CHECK(sscanf(field, "%2x", &byte) == 1);
+			out[length++] = (char)byte;
+		}
+	}
+	return length;
+}
+
+//Every case of the corpus finds the spans Python's re module found
+static void corpus(winterState_t *state, const char *path) {
+	FILE *file = fopen(path, "r");
+	CHECK(file != NULL);
+	char line[4096], pattern[1024], subject[1024], field[2][1024];
+	size_t cases = 0;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (line[0] == '#') continue;
+		int start, consumed;
+		CHECK(sscanf(line, "%1023s %1023s %d %n", field[0], field[1], &start, &consumed) == 3);
+		size_t patternLength = unhex(field[0], pattern), subjectLength = unhex(field[1], subject);
+		winterValue_t args[3];
+		winterSetString(state, &args[0], pattern, patternLength);
+		winterSetString(state, &args[1], subject, subjectLength);
+		winterSetInt(&args[2], start);
+		const char *spans = line + consumed;
+
+		const winterValue_t *result = winterCall(state, "match", args, 3);
+		CHECK(winterTypeOf(result) != WINTER_ERROR);
+		int matched = spans[0] != '-' || (spans[1] != '\n' && spans[1] != '\0');
+		if (!matched) {
+			CHECK(winterTypeOf(result) == WINTER_NULL);
+		} else {
+			winterArrayType_t type;
+			size_t length;
+			const int64_t *offsets = winterToArray(result, &type, &length, NULL);
+			CHECK(offsets != NULL && type == WINTER_INT64);
+			for (size_t i = 0; i < length; i++) {
+				char *end;
+				long want = strtol(spans, &end, 10);
+				CHECK(end != spans && offsets[i] == want);
+				spans = end;
+			}
+			CHECK(strtol(spans, NULL, 10) == 0 && strspn(spans, " \n") == strlen(spans));
+		}
+		winterSetString(state, &args[0], pattern, patternLength);
+		winterSetString(state, &args[1], subject, subjectLength);
+		CHECK(winterToInt(winterCall(state, "matches", args, 3)) == matched);
+		cases++;
+	}
+	fclose(file);
+	CHECK(cases > 2000);
+}
+
+static void script(winterState_t *state) {
+	//Spans 6 14 of the match and 6 9, 10 14 of the groups
+	CHECK(runInt(state, "let m = match(\"(\\w+)@(\\w+)\", \"mail: joe@site.org\"); length(m) * 100 + sum(m);") == 659);
+	CHECK(runInt(state, "substr(\"mail: joe@site.org\", 6, 9) == \"joe\";") == 1);
+	CHECK(runInt(state, "substr(\"abc\", 1) == \"bc\";") == 1);
+	CHECK(runInt(state, "sum(match(\"b+?\", \"abbb\"));") == 3);
+	CHECK(runInt(state, "match(\"x\", \"abc\") == null;") == 1);
+	CHECK(runFails(state, "match(\"(a\", \"a\");"));
+	CHECK(runFails(state, "match(\"a{2,1}\", \"a\");"));
+	CHECK(runFails(state, "match(\"[a\", \"a\");"));
+	CHECK(runInt(state, "match(\"a\", \"a\", 5) == null;") == 1);
+	CHECK(runFails(state, "match(\"a\", \"a\", -1);"));
+}
+
+int main(int argc, char **argv) {
+	CHECK(argc == 2);
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenArrays(state);
+	winterOpenRegex(state);
+	corpus(state, argv[1]);
+	script(state);
+	winterFreeState(state);
+	return 0;
+}
@@ -0,0 +1,7 @@
+# Runs WINTER on SCRIPT and compares what it prints with the .out file next to the script
+execute_process(COMMAND ${WINTER} ${SCRIPT} OUTPUT_VARIABLE output ERROR_VARIABLE output)
+string(REGEX REPLACE "\\.w$" ".out" expected_file ${SCRIPT})
+file(READ ${expected_file} expected)
+if (NOT output STREQUAL expected)
+	message(FATAL_ERROR "${SCRIPT} printed:\n${output}\nexpected:\n${expected}")
+endif()
@@ -0,0 +1,21 @@
+// Integer division and modulo truncate toward zero
+print(7 / 2, -7 / 2, 7 / -2, 7 % 3, -7 % 3, 7 % -3);
+let smallest = -9223372036854775807 - 1;
+print(smallest, smallest / -1, smallest % -1);
+
+// Floats
+print(7.0 / 2, 1.5 + 2, 3 - 0.5, 2 * 2.5, 7.5 % 2, -7.5 % 2);
+print(1 / 0.0, -1 / 0.0, 0.5 + 0.25 == 0.75, 0.1 + 0.2 == 0.3, 123.456 * 1000);
+
+// Powers of integers are exact, negative powers truncate
+print(2 ** 10, (0 - 2) ** 3, 3 ** 0, 0 ** 0, 2 ** 62, 10 ** 18);
+print(2 ** -1, 1 ** -5, (0 - 1) ** -3, 2.0 ** 0.5, 4 ** 0.5);
+
+// Literals and negation
+print(0x10, 0b101, -(2), -(2.5), -(smallest + 1));
+
+// Hot arithmetic gives the same results once compiled
+fn step(n, i, f) { if n == 0 { return i + f; } return step(n - 1, i * 3 % 1000003 + 1, f / 2 + 1.5); }
+print(step(1000, 1, 1.0));
+fn divide(n, total) { if n == 0 { return total; } return divide(n - 1, total + 1000 / n + 1000 % n); }
+print(divide(100, 0));
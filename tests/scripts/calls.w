@@ -0,0 +1,29 @@
+// Calls: recursion, closures over locals and arguments, functions as values
+fn fib(n) { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }
+print(fib(20));
+
+fn counter() {
+	let count = 0;
+	return fn() { count = count + 1; return count; };
+}
+let a = counter();
+let b = counter();
+a(); a();
+print(a(), b());
+
+fn apply(f, x) { return f(x); }
+fn twice(x) { return x * 2; }
+fn doubled(n) { if n == 0 { return 0; } return apply(twice, n) + doubled(n - 1); }
+print(doubled(100));
+
+fn adder(x) { return fn(y) { return x + y; }; }
+fn addAll(n, total) { if n == 0 { return total; } return addAll(n - 1, adder(n)(total)); }
+print(addAll(1000, 0));
+
+fn nothing() { }
+fn early(x) { if x { return "early"; } return "late"; }
+print(nothing(), early(1), early(0));
+
+fn three(a, b, c) { return a * 100 + b * 10 + c; }
+fn many(n, total) { if n == 0 { return total; } return many(n - 1, total + three(1, 2, 3)); }
+print(many(200, 0));
@@ -0,0 +1,27 @@
+// Integers, floats and their mix
+print(1 < 2, 2 < 1, 2 <= 2, 3 > 2.5, 2.5 >= 3, 2 == 2.0, 2 != 2.0);
+print(-1 < 0, -1.5 < -1, 0.0 == -0.0, 9007199254740993 > 9007199254740992);
+
+// NaN is unordered, only != is true
+let nan = 0.0 / 0.0;
+print(nan < 1.0, nan <= 1.0, nan > 1.0, nan >= 1.0, nan == nan, nan != nan);
+print(1 < nan, 1 == nan, 1 != nan);
+
+// Strings are ordered by their bytes, then their length
+print("a" < "b", "ab" < "abc", "abc" < "abd", "b" > "abc", "" < "a", "abc" == "abc");
+print("Z" < "a", "abc" >= "abc", "abc" != "abd");
+
+// Values of different types are equal only to themselves
+print(null == null, null == 0, "1" == 1, {} == {});
+let t = {};
+print(t == t, t != t);
+
+// Hot comparisons give the same results once compiled
+fn lt(a, b) { return a < b; }
+fn le(a, b) { return a <= b; }
+fn eq(a, b) { return a == b; }
+fn ne(a, b) { return a != b; }
+fn count(f, a, b, n, total) { if n == 0 { return total; } return count(f, a, b, n - 1, total + f(a, b)); }
+print(count(lt, 1, 2, 100, 0), count(lt, 2.5, 2, 100, 0), count(le, 2.0, 2.0, 100, 0));
+print(count(lt, nan, 1.0, 100, 0), count(le, nan, nan, 100, 0), count(eq, nan, nan, 100, 0), count(ne, nan, nan, 100, 0));
+print(count(eq, 3, 3, 100, 0), count(ne, 3, 4, 100, 0), count(lt, "a", "b", 100, 0));
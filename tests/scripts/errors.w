@@ -0,0 +1,4 @@
+// Integer division by zero is an error
+fn divide(a, b) { return a / b; }
+print(divide(1, 2), divide(1.0, 0));
+divide(1, 0);
@@ -0,0 +1,29 @@
+// Globals read by hot functions see every assignment
+let scale = 2;
+fn scaled(x) { return x * scale; }
+fn run(n, total) { if n == 0 { return total; } return run(n - 1, total + scaled(1)); }
+print(run(100, 0));
+scale = 3;
+print(run(100, 0));
+scale = 0.5;
+print(run(100, 0));
+
+// Replacing a function is seen by callers that were already compiled
+fn shape() { return "square"; }
+fn describe(n, last) { if n == 0 { return last; } return describe(n - 1, shape()); }
+print(describe(100, null));
+shape = fn() { return "circle"; };
+print(describe(100, null));
+
+// Globals assigned from inside functions
+let total = 0;
+fn add(n) { if n == 0 { return 0; } total = total + n; return add(n - 1); }
+add(100);
+print(total);
+
+// Tables held by globals
+let config = {depth = 1};
+fn deepen(n) { if n == 0 { return config.depth; } config.depth = config.depth + 1; return deepen(n - 1); }
+print(deepen(200));
+config = {depth = 1000};
+print(deepen(1));
@@ -0,0 +1,26 @@
+// Self tail calls run in constant stack, deeper than any frame limit
+fn count(n, total) { if n == 0 { return total; } return count(n - 1, total + 1); }
+print(count(1000000, 0));
+
+fn gcd(a, b) { if b == 0 { return a; } return gcd(b, a % b); }
+fn gcds(n, total) { if n == 0 { return total; } return gcds(n - 1, total + gcd(n * 6, 84)); }
+print(gcds(500, 0));
+
+// Arguments are all read before any is replaced
+fn swap(n, a, b) { if n == 0 { return a * 10 + b; } return swap(n - 1, b, a); }
+print(swap(1001, 1, 2), swap(1000, 1, 2));
+
+// The floats and integers an argument holds can change between iterations
+fn mixed(n, x) { if n == 0 { return x; } if n == 50 { return mixed(n - 1, x + 0.5); } return mixed(n - 1, x + 1); }
+print(mixed(100, 0));
+
+// Tail calls of other functions and of closures
+fn even(n) { if n == 0 { return 1; } return odd(n - 1); }
+fn odd(n) { if n == 0 { return 0; } return even(n - 1); }
+print(even(10000), odd(7));
+
+fn loop(n) {
+	fn step(i, total) { if i > n { return total; } return step(i + 1, total + i); }
+	return step(1, 0);
+}
+print(loop(100000));
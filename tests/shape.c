@@ -0,0 +1,61 @@
+#include "check.h"
+
+//Each site runs often enough to be compiled, and sees more shapes than its cache has ways
+static const char *source =
+	"fn getX(t) { return t.x; }\n"
+	"fn setX(t, v) { t.x = v; return t; }\n"
+	"fn sumX(list, n, total) { if n == 0 { return total; } return sumX(list.next, n - 1, total + getX(list.item)); }\n"
+	"fn make(i) {\n"
+	"	if i % 6 == 0 { return {x = i}; }\n"
+	"	if i % 6 == 1 { return {a = 0, x = i}; }\n"
+	"	if i % 6 == 2 { return {b = 0, c = 0, x = i}; }\n"
+	"	if i % 6 == 3 { let t = {}; t.y = 0; t.x = i; return t; }\n"
+	"	if i % 6 == 4 { let t = {}; t.x = i; t.z = 0; return t; }\n"
+	"	let t = {x = 0}; t[1.5] = 0; t.x = i; return t;\n"
+	"}\n"
+	"fn list(i, n, rest) { if i == n { return rest; } return list(i + 1, n, {item = make(i), next = rest}); }\n"
+	"fn grow(t, n) { if n == 0 { return t; } setX(t, n); return grow({next = t}, n - 1); }\n"
+	"fn wide() {\n"
+	"	let t = {k0 = 0, k1 = 1, k2 = 2, k3 = 3, k4 = 4, k5 = 5, k6 = 6, k7 = 7, k8 = 8, k9 = 9};\n"
+	"	t.k10 = 10; t.k11 = 11; t.k12 = 12; t.k13 = 13; t.k14 = 14; t.k15 = 15; t.k16 = 16; t.k17 = 17;\n"
+	"	t.k18 = 18; t.k19 = 19; t.k20 = 20; t.k21 = 21; t.k22 = 22; t.k23 = 23; t.k24 = 24; t.k25 = 25;\n"
+	"	t.k26 = 26; t.k27 = 27; t.k28 = 28; t.k29 = 29; t.k30 = 30; t.k31 = 31; t.x = 32; t.k33 = 33;\n"
+	"	return t;\n"
+	"}\n"
+	"fn readWide(t, n, total) { if n == 0 { return total; } return readWide(t, n - 1, total + t.x + t.k0 + t.k31 + t.k33); }\n";
+
+static void shapes(int jit) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterSetJit(state, jit);
+	runScript(state, source);
+	//Polymorphic reads, including a table that left its shape for buckets
+	CHECK(runInt(state, "sumX(list(0, 600, null), 600, 0);") == 599 * 600 / 2);
+	CHECK(runInt(state, "sumX(list(0, 600, null), 600, 0);") == 599 * 600 / 2);
+
+	//A cached read sees a table that moved to buckets after the cache saw its shape
+	CHECK(runInt(state,
+		"let moved = {x = 5};\n"
+		"fn readMoved(n, total) { if n == 0 { return total; } return readMoved(n - 1, total + getX(moved)); }\n"
+		"readMoved(100, 0);\n") == 500);
+	CHECK(runInt(state, "moved[2] = 3; moved.x = 7; readMoved(100, 0);") == 700);
+
+	//Stores that add a key, and tables with more keys than a shape holds
+	CHECK(runInt(state, "let g = grow({}, 300); g.next.x * 10 + g.next.next.x;") == 12);
+	CHECK(runInt(state, "readWide(wide(), 100, 0);") == 100 * (32 + 0 + 31 + 33));
+
+	//Fields of the same name in different places
+	CHECK(runInt(state,
+		"let p = {x = 1, y = 2};\n"
+		"let q = {y = 3, x = 4};\n"
+		"fn both(n, total) { if n == 0 { return total; } return both(n - 1, total + getX(p) * 10 + getX(q)); }\n"
+		"both(100, 0);\n") == 100 * 14);
+	CHECK(runFails(state, "getX(3);"));
+	CHECK(runInt(state, "getX({y = 1}) == null;") == 1);
+	winterFreeState(state);
+}
+
+int main(void) {
+	shapes(0);
+	shapes(1);
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include "check.h"
+#include <pthread.h>
+
+enum { THREADS = 8, RUNS = 200 };
+
+//Field loads and global calls run often enough to be compiled, without inline caches
+static const char *source =
+	"let w = \"world\";\n"
+	"fn mk(a) { return fn(b) { return a + \" \" + b + \"!\"; }; }\n"
+	"let f = mk(\"hello\");\n"
+	"let point = {x = 3, y = 4};\n"
+	"fn sum(p, n, total) { if n == 0 { return total; } return sum(p, n - 1, total + p.x * p.y); }\n"
+	"(f(w) == \"hello world!\") + sum(point, 200, 0);\n";
+static const winterInt_t expected = 1 + 200 * 12;
+
+//Each thread runs the chunk in states of its own, then drops the reference it was handed
+static void *worker(void *arg) {
+	winterChunk_t *chunk = arg;
+	intptr_t passed = 0;
+	for (int i = 0; i < RUNS; i++) {
+		winterState_t *state = winterCreateState(testAllocator);
+		const winterValue_t *result = winterRun(state, chunk);
+		passed += winterTypeOf(result) == WINTER_INT && winterToInt(result) == expected;
+		winterFreeState(state);
+	}
+	winterFreeChunk(NULL, chunk);
+	return (void*)passed;
+}
+
+int main(void) {
+	char error[256];
+	winterState_t *state = winterCreateState(testAllocator);
+	winterChunk_t *chunk = winterLoadString(state, source, error, sizeof(error));
+	CHECK(chunk != NULL);
+	winterChunk_t *shared = winterShareChunk(state, chunk);
+	CHECK(shared != NULL);
+	winterFreeChunk(state, chunk);
+
+	pthread_t threads[THREADS];
+	for (int i = 0; i < THREADS; i++) {
+		CHECK(pthread_create(&threads[i], NULL, worker, winterRetainChunk(shared)) == 0);
+	}
+	const winterValue_t *result = winterRun(state, shared);
+	CHECK(winterToInt(result) == expected);
+	//Values the state made point into the chunk, which it holds until it's freed
+	winterFreeChunk(state, shared);
+	winterValue_t name;
+	winterSetString(state, &name, "there", 5);
+	size_t length;
+	const char *greeting = winterToString(winterCall(state, "f", &name, 1), &length);
+	CHECK(greeting != NULL && length == 12 && memcmp(greeting, "hello there!", 12) == 0);
+	for (int i = 0; i < THREADS; i++) {
+		void *passed;
+		CHECK(pthread_join(threads[i], &passed) == 0);
+		CHECK((intptr_t)passed == RUNS);
+	}
+	winterFreeState(state);
+	return 0;
+}
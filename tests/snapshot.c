@@ -0,0 +1,162 @@
+#include "check.h"
+#include "snapshot.h"
+#include "object.h"
+
+typedef struct buffer_t {
+	unsigned char *data;
+	size_t size, capacity;
+} buffer_t;
+
+static int bufferWriter(void *user, const void *data, size_t size) {
+	buffer_t *buffer = user;
+	if (buffer->size + size > buffer->capacity) {
+		buffer->capacity = (buffer->size + size) * 2;
+		buffer->data = realloc(buffer->data, buffer->capacity);
+	}
+	memcpy(buffer->data + buffer->size, data, size);
+	buffer->size += size;
+	return 0;
+}
+
+//What a snapshot holds, read the way tools/heapsummary.c reads it
+typedef struct summary_t {
+	size_t nodes, edges, roots;
+	size_t byType[TYPE_COUNT];
+	size_t byRoot[SNAPSHOT_ROOT_TASK + 1];
+	uint64_t ids[4096];
+	char previews[4096][SNAPSHOT_PREVIEW + 1];
+} summary_t;
+
+static uint64_t readInt(const unsigned char **at, int bytes) {
+	uint64_t out = 0;
+	for (int i = 0; i < bytes; i++) {
+		out |= (uint64_t)(*at)[i] << (8 * i);
+	}
+	*at += bytes;
+	return out;
+}
+static bool_t known(const summary_t *s, uint64_t id) {
+	for (size_t i = 0; i < s->nodes; i++) {
+		if (s->ids[i] == id) return true;
+	}
+	return false;
+}
+static bool_t hasPreview(const summary_t *s, const char *text) {
+	for (size_t i = 0; i < s->nodes; i++) {
+		if (strcmp(s->previews[i], text) == 0) return true;
+	}
+	return false;
+}
+
+//Every node is written once before the end, and edges and roots only point at nodes
+static void readSnapshot(const buffer_t *buffer, summary_t *s) {
+	memset(s, 0, sizeof(*s));
+	const unsigned char *at = buffer->data, *end = buffer->data + buffer->size;
+	CHECK(buffer->size > 4 && memcmp(at, SNAPSHOT_MAGIC, 3) == 0 && at[3] == SNAPSHOT_VERSION);
+	at += 4;
+	//References are checked once every node has been read
+	uint64_t refs[8192];
+	size_t numRefs = 0;
+	while (at < end && *at != SNAPSHOT_END) {
+		switch (*at++) {
+			case SNAPSHOT_ROOT: {
+				uint8_t kind = *at++;
+				CHECK(kind <= SNAPSHOT_ROOT_TASK);
+				s->byRoot[kind]++;
+				at += 8;
+				uint8_t type = *at++;
+				uint64_t id = readInt(&at, 8);
+				if (isRefCounted(type) && numRefs < 8192) refs[numRefs++] = id;
+				s->roots++;
+				break;
+			}
+			case SNAPSHOT_NODE: {
+				CHECK(s->nodes < 4096);
+				uint64_t id = readInt(&at, 8);
+				CHECK(!known(s, id));
+				uint8_t type = *at++;
+				CHECK(type < TYPE_COUNT);
+				at += 8;
+				uint32_t length = (uint32_t)readInt(&at, 4);
+				CHECK(length <= SNAPSHOT_PREVIEW);
+				memcpy(s->previews[s->nodes], at, length);
+				s->previews[s->nodes][length] = '\0';
+				at += length;
+				s->ids[s->nodes++] = id;
+				s->byType[type]++;
+				break;
+			}
+			case SNAPSHOT_EDGE: {
+				uint64_t from = readInt(&at, 8);
+				if (numRefs < 8192) refs[numRefs++] = from;
+				for (int i = 0; i < 2; i++) {
+					uint8_t type = *at++;
+					uint64_t id = readInt(&at, 8);
+					if (isRefCounted(type) && numRefs < 8192) refs[numRefs++] = id;
+				}
+				s->edges++;
+				break;
+			}
+			default:
+				CHECK(!"unknown record");
+		}
+	}
+	CHECK(at + 1 == end && *at == SNAPSHOT_END);
+	for (size_t i = 0; i < numRefs; i++) {
+		CHECK(known(s, refs[i]));
+	}
+}
+
+static summary_t summary;
+
+//Globals and the tables, strings and functions they reach are in the snapshot, and writing
+//it doesn't change the heap
+static void globals(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	runScript(state,
+		"let name = \"hello world\";\n"
+		"let config = {routes = {}};\n"
+		"fn fill(n) { if n == 0 { return 0; } config.routes[n] = \"route-value\" + \"!\"; return fill(n - 1); }\n"
+		"fill(50);\n"
+		"config.routes.back = config;\n");
+	size_t tables = liveTables(state);
+	buffer_t first = { 0 }, second = { 0 };
+	CHECK(winterHeapSnapshot(state, bufferWriter, &first) == 0);
+	CHECK(winterHeapSnapshot(state, bufferWriter, &second) == 0);
+	CHECK(first.size == second.size && memcmp(first.data, second.data, first.size) == 0);
+	CHECK(liveTables(state) == tables);
+
+	readSnapshot(&first, &summary);
+	CHECK(summary.byRoot[SNAPSHOT_ROOT_GLOBALS] > 0);
+	CHECK(summary.byType[TYPE_TABLE] >= 2);
+	CHECK(summary.byType[TYPE_STRING] >= 50);
+	CHECK(summary.byType[TYPE_FUNCTION] >= 1);
+	CHECK(summary.edges >= 50);
+	CHECK(hasPreview(&summary, "hello world"));
+	CHECK(hasPreview(&summary, "route-value!"));
+	free(first.data);
+	free(second.data);
+	winterFreeState(state);
+}
+
+//Values only a suspended coroutine holds are reached from its stack
+static void coroutines(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	runScript(state, "fn gen() { let t = {who = \"gen\" + \"-local\"}; yield(1); return t; }\n");
+	winterCoroutine_t *coroutine = winterCreateCoroutine(state, "gen", NULL, 0);
+	winterResume(state, coroutine, NULL);
+	buffer_t buffer = { 0 };
+	CHECK(winterHeapSnapshot(state, bufferWriter, &buffer) == 0);
+	readSnapshot(&buffer, &summary);
+	CHECK(summary.byRoot[SNAPSHOT_ROOT_COROUTINE] > 0);
+	CHECK(hasPreview(&summary, "gen-local"));
+	free(buffer.data);
+	winterFreeCoroutine(state, coroutine);
+	winterFreeState(state);
+}
+
+int main(void) {
+	globals();
+	coroutines();
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include "check.h"
+#include "kernel.h"
+#include <math.h>
+
+static int compareDouble(const void *a, const void *b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	if (isnan(x)) return isnan(y) ? 0 : 1;
+	if (isnan(y)) return -1;
+	return (x > y) - (x < y);
+}
+static int compareFloat(const void *a, const void *b) {
+	float x = *(const float*)a, y = *(const float*)b;
+	if (isnan(x)) return isnan(y) ? 0 : 1;
+	if (isnan(y)) return -1;
+	return (x > y) - (x < y);
+}
+static int compareInt64(const void *a, const void *b) {
+	int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+	return (x > y) - (x < y);
+}
+static int compareInt32(const void *a, const void *b) {
+	int32_t x = *(const int32_t*)a, y = *(const int32_t*)b;
+	return (x > y) - (x < y);
+}
+
+//Random, sorted, reversed, few distinct, organ pipe, constant, with NaNs, extremes and
+//nearly sorted contents
+enum { PATTERNS = 9 };
+static int64_t generate(int pattern, size_t i, size_t n) {
+	switch (pattern) {
+		case 0: return (int64_t)((uint64_t)rand() << 40 ^ (uint64_t)rand() << 20 ^ (uint64_t)rand());
+		case 1: return (int64_t)i;
+		case 2: return (int64_t)(n - i);
+		case 3: return rand() % 4;
+		case 4: return i < n / 2 ? (int64_t)i : (int64_t)(n - i);
+		case 5: return 7;
+		case 6: return rand() % 1000 - 500;
+		case 7: return i % 2 ? INT64_MIN + rand() % 3 : INT64_MAX - rand() % 3;
+		default: return (i * 7919) % 97 == 0 ? rand() : (int64_t)i;
+	}
+}
+
+static bool_t sameFloats(const double *a, const double *b, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		if (!(a[i] == b[i] || (isnan(a[i]) && isnan(b[i])))) return false;
+	}
+	return true;
+}
+
+//Each kind sorts like qsort at sizes around the cutoffs between the algorithms
+static void kernels(void) {
+	static const size_t sizes[] = { 0, 1, 2, 3, 5, 10, 23, 24, 25, 50, 100, 127, 128, 129, 255, 256, 257, 1000, 4096, 10007, 100000 };
+	srand(1);
+	for (int pattern = 0; pattern < PATTERNS; pattern++) {
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+			size_t n = sizes[s];
+			double *d = malloc(n * 8 + 8), *dWant = malloc(n * 8 + 8);
+			float *f = malloc(n * 4 + 4), *fWant = malloc(n * 4 + 4);
+			int64_t *l = malloc(n * 8 + 8), *lWant = malloc(n * 8 + 8), *scratch = malloc(n * 8 + 8);
+			int32_t *w = malloc(n * 4 + 4), *wWant = malloc(n * 4 + 4);
+			for (size_t i = 0; i < n; i++) {
+				int64_t v = generate(pattern, i, n);
+				l[i] = lWant[i] = v;
+				w[i] = wWant[i] = (int32_t)v;
+				d[i] = dWant[i] = pattern == 6 && i % 13 == 0 ? NAN : (double)v / 3.0;
+				f[i] = fWant[i] = (float)d[i];
+			}
+			_winter_kernelSort(ARRAY_FLOAT64, d, NULL, n);
+			qsort(dWant, n, 8, compareDouble);
+			CHECK(sameFloats(d, dWant, n));
+			_winter_kernelSort(ARRAY_FLOAT32, f, NULL, n);
+			qsort(fWant, n, 4, compareFloat);
+			for (size_t i = 0; i < n; i++) {
+				CHECK(f[i] == fWant[i] || (isnan(f[i]) && isnan(fWant[i])));
+			}
+			_winter_kernelSort(ARRAY_INT64, l, scratch, n);
+			qsort(lWant, n, 8, compareInt64);
+			CHECK(n == 0 || memcmp(l, lWant, n * 8) == 0);
+			_winter_kernelSort(ARRAY_INT32, w, scratch, n);
+			qsort(wWant, n, 4, compareInt32);
+			CHECK(n == 0 || memcmp(w, wWant, n * 4) == 0);
+			free(d);
+			free(dWant);
+			free(f);
+			free(fWant);
+			free(l);
+			free(lWant);
+			free(scratch);
+			free(w);
+			free(wWant);
+		}
+	}
+}
+
+//Tables of numbers or strings, and any values with a function, which keeps equal ones in order
+static void script(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenArrays(state);
+	runScript(state,
+		"fn check(t, i, n) { if i + 1 >= n { return 1; } if t[i + 1] < t[i] { return 0; } return check(t, i + 1, n); }\n"
+		"fn fillKeys(t, i, n, seed) { if i == n { return t; } t[i] = (seed * 7919) % 1009; return fillKeys(t, i + 1, n, seed + 1); }\n"
+		"fn byKey(x, y) { return x.key < y.key; }\n");
+	CHECK(runInt(state, "check(sort(fillKeys({}, 0, 500, 1)), 0, 500);") == 1);
+	CHECK(runInt(state, "let mixed = fillKeys({}, 0, 10, 1); mixed[3] = 2.5; check(sort(mixed), 0, 10);") == 1);
+	CHECK(runInt(state, "let words = {}; words[0] = \"pear\"; words[1] = \"apple\"; words[2] = \"fig\"; sort(words); (words[0] == \"apple\") + (words[2] == \"pear\") * 10;") == 11);
+	CHECK(runInt(state,
+		"let r = {};\n"
+		"r[0] = {key = 2, order = 0}; r[1] = {key = 1, order = 1}; r[2] = {key = 2, order = 2}; r[3] = {key = 1, order = 3};\n"
+		"sort(r, byKey);\n"
+		"r[0].order * 1000 + r[1].order * 100 + r[2].order * 10 + r[3].order;\n") == 1302);
+	CHECK(runInt(state, "let a = array(\"float64\", 4); a[0] = 3.0; a[1] = 0.0 / 0.0; a[2] = -1.0; a[3] = 2.0; sort(a); (a[0] == -1.0) + (a[2] == 3.0) * 10;") == 11);
+	CHECK(runFails(state, "let gap = {}; gap[0] = 1; gap[2] = 2; sort(gap);"));
+	CHECK(runFails(state, "let odd = {}; odd[0] = 1; odd[1] = \"a\"; sort(odd);"));
+	winterFreeState(state);
+}
+
+int main(void) {
+	kernels();
+	script();
+	return 0;
+}
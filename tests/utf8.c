@@ -0,0 +1,172 @@
+#include "check.h"
+#include "utf8.h"
+
+//Decodes one sequence at a time by the table of well-formed sequences in the Unicode
+//standard, returning the encoding and counting the codepoints of valid UTF-8
+static stringEncoding_t reference(const unsigned char *s, size_t length, size_t *count) {
+	bool_t ascii = true;
+	*count = 0;
+	for (size_t i = 0; i < length; (*count)++) {
+		unsigned char lead = s[i];
+		int size = 1;
+		unsigned char low = 0x80, high = 0xbf;
+		if (lead < 0x80) {
+			i++;
+			continue;
+		} else if (lead >= 0xc2 && lead <= 0xdf) {
+			size = 2;
+		} else if (lead >= 0xe0 && lead <= 0xef) {
+			size = 3;
+			if (lead == 0xe0) low = 0xa0;
+			if (lead == 0xed) high = 0x9f;
+		} else if (lead >= 0xf0 && lead <= 0xf4) {
+			size = 4;
+			if (lead == 0xf0) low = 0x90;
+			if (lead == 0xf4) high = 0x8f;
+		} else {
+			return STRING_BINARY;
+		}
+		if (length - i < (size_t)size || s[i + 1] < low || s[i + 1] > high) {
+			return STRING_BINARY;
+		}
+		for (int k = 2; k < size; k++) {
+			if (s[i + k] < 0x80 || s[i + k] > 0xbf) {
+				return STRING_BINARY;
+			}
+		}
+		ascii = false;
+		i += (size_t)size;
+	}
+	return ascii ? STRING_ASCII : STRING_UTF8;
+}
+
+static const char *pieces[] = {
+	"a", "Z", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xed\x9f\xbf", "\xee\x80\x80", "\xf4\x8f\xbf\xbf"
+};
+//Overlong forms, surrogates, codepoints past U+10FFFF, stray and missing continuations
+static const char *bad[] = {
+	"\x80", "\xc0\x80", "\xc1\xbf", "\xe0\x80\x80", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff",
+	"\xc3", "\xe2\x82", "\xf0\x9f\x98", "\xf8\x88\x80\x80\x80", "\xe0\x9f\xbf", "\xf0\x8f\xbf\xbf"
+};
+
+static size_t append(char *out, size_t length, const char *piece) {
+	size_t size = strlen(piece);
+	memcpy(out + length, piece, size);
+	return length + size;
+}
+
+//Random text of valid sequences with bad ones and random bytes mixed in, long enough to
+//cross the vector blocks and starting at every offset within one, agrees with the reference
+static void validate(void) {
+	static char buffer[4096];
+	srand(3);
+	for (int round = 0; round < 20000; round++) {
+		char *text = buffer + round % 32;
+		size_t length = 0;
+		int count = rand() % 3 == 0 ? rand() % 11 : rand() % 300;
+		for (int i = 0; i < count; i++) {
+			length = rand() % 10 == 0 ? append(text, length, rand() % 2 ? "a" : "\xc3") :
+				append(text, length, pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))]);
+		}
+		if (rand() % 10 < 3) {
+			char tail[1200];
+			size_t at = length > 0 ? (size_t)rand() % (length + 1) : 0, size = length - at;
+			memcpy(tail, text + at, size);
+			length = append(text, at, bad[rand() % (sizeof(bad) / sizeof(bad[0]))]);
+			memcpy(text + length, tail, size);
+			length += size;
+		}
+		if (rand() % 10 == 0) {
+			length = (size_t)(rand() % 100);
+			for (size_t i = 0; i < length; i++) {
+				text[i] = (char)(rand() % 256);
+			}
+		}
+		if (rand() % 5 == 0 && length > 0) {
+			length = (size_t)rand() % length;
+		}
+		size_t codepoints;
+		stringEncoding_t want = reference((const unsigned char*)text, length, &codepoints);
+		CHECK(_winter_utf8Check(text, length) == want);
+		if (want != STRING_BINARY) {
+			CHECK(_winter_utf8Count(text, length) == codepoints);
+		}
+	}
+}
+
+//Codepoints of a long UTF-8 string are found in any order, past the steps of its index and
+//back from the last one found, and the walk over all of them gives the string back
+static const char *source =
+	"fn at(s, i) { return s[i]; }\n"
+	"fn walk(s, i, out) { if i == length(s) { return out; } return walk(s, i + 1, out + s[i]); }\n";
+
+static void indexing(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenArrays(state);
+	runScript(state, source);
+	enum { COUNT = 500 };
+	static char text[COUNT * 4];
+	const char *at[COUNT];
+	size_t length = 0;
+	srand(5);
+	for (int i = 0; i < COUNT; i++) {
+		at[i] = pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+		length = append(text, length, at[i]);
+	}
+	winterValue_t args[3];
+	winterSetString(state, &args[0], text, length);
+	CHECK(winterToInt(winterCall(state, "length", args, 1)) == COUNT);
+	for (int round = 0; round < 3000; round++) {
+		int i = round < COUNT ? round : round % 2 ? rand() % COUNT : COUNT - 1 - round % COUNT;
+		winterSetString(state, &args[0], text, length);
+		winterSetInt(&args[1], i);
+		size_t size;
+		const char *out = winterToString(winterCall(state, "at", args, 2), &size);
+		CHECK(out != NULL && size == strlen(at[i]) && memcmp(out, at[i], size) == 0);
+	}
+	winterSetString(state, &args[0], text, length);
+	winterSetInt(&args[1], 0);
+	winterSetString(state, &args[2], "", 0);
+	size_t size;
+	const char *out = winterToString(winterCall(state, "walk", args, 3), &size);
+	CHECK(out != NULL && size == length && memcmp(out, text, length) == 0);
+	winterSetString(state, &args[0], text, length);
+	winterSetInt(&args[1], COUNT);
+	CHECK(winterTypeOf(winterCall(state, "at", args, 2)) == WINTER_ERROR);
+	winterFreeState(state);
+}
+
+//ASCII and binary strings index by byte, and joining keeps what each part was
+static void scripts(void) {
+	winterState_t *state = winterCreateState(testAllocator);
+	winterOpenArrays(state);
+	runScript(state, source);
+	CHECK(runInt(state, "length(\"h\xc3\xa9llo\");") == 5);
+	CHECK(runInt(state, "\"h\xc3\xa9llo\"[1] == \"\xc3\xa9\";") == 1);
+	CHECK(runInt(state, "\"h\xc3\xa9llo\"[2] == \"l\";") == 1);
+	CHECK(runInt(state, "length(\"plain\" + \"\xe2\x82\xac\");") == 6);
+	CHECK(runInt(state, "length(\"\");") == 0);
+	CHECK(runFails(state, "\"abc\"[3];"));
+
+	winterValue_t args[2];
+	winterSetString(state, &args[0], "a\xc3", 2);
+	CHECK(winterToInt(winterCall(state, "length", args, 1)) == 2);
+	winterSetString(state, &args[0], "a\xc3", 2);
+	winterSetInt(&args[1], 1);
+	size_t size;
+	const char *out = winterToString(winterCall(state, "at", args, 2), &size);
+	CHECK(out != NULL && size == 1 && (unsigned char)out[0] == 0xc3);
+	//The lone lead byte finds its continuation once joined
+	winterSetString(state, &args[0], "a\xc3", 2);
+	winterSetString(state, &args[1], "\xa9", 1);
+	runScript(state, "fn join(a, b) { return length(a + b); }");
+	CHECK(winterToInt(winterCall(state, "join", args, 2)) == 2);
+	winterFreeState(state);
+}
+
+int main(void) {
+	validate();
+	indexing();
+	scripts();
+	return 0;
+}
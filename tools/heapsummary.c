@@ -0,0 +1,451 @@
+/*
+** Summarizes a heap snapshot written by winterHeapSnapshot
+** Usage: heapsummary <snapshot> [number of paths]
+**
+** Prints the size of every object type, then the objects retaining the most memory
+** along with the path they are reached by. Retained sizes come from the dominator tree
+** of the object graph.
+*/
+
+#include "snapshot.h"
+#include "object.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct value_t {
+	uint8_t  type;
+	uint64_t payload;
+} value_t;
+
+typedef struct node_t {
+	uint64_t id;
+	uint8_t  type;
+	uint64_t size;
+	char     preview[SNAPSHOT_PREVIEW + 1];
+	
+	//Filled in by analysis
+	size_t   parent;  //node it was first reached from
+	value_t  label;   //key it was reached by, or root kind and index
+	size_t   order;   //preorder number, 0 if unreached
+	size_t   idom;
+	uint64_t retained;
+} node_t;
+
+typedef struct edge_t {
+	uint64_t from;
+	value_t  key;
+	value_t  value;
+} edge_t;
+
+typedef struct root_t {
+	uint8_t  kind;
+	uint64_t index;
+	value_t  value;
+} root_t;
+
+//Node 0 is a virtual root pointing at every snapshot root
+static node_t *nodes;
+static size_t  numNodes, nodeCapacity;
+static edge_t *edges;
+static size_t  numEdges, edgeCapacity;
+static root_t *roots;
+static size_t  numRoots, rootCapacity;
+
+//Id to node index, open addressing
+static size_t *lookup;
+static size_t  lookupSize;
+
+static const char *typeNames[TYPE_COUNT] = {
+	[TYPE_UNKNOWN]   = "unknown",
+	[TYPE_REFERENCE] = "reference",
+	[TYPE_NULL]      = "null",
+	[TYPE_INT]       = "int",
+	[TYPE_FLOAT]     = "float",
+	[TYPE_STRING]    = "string",
+	[TYPE_TABLE]     = "table",
+	[TYPE_FUNCTION]  = "function",
+	[TYPE_ERROR]     = "error",
+	[TYPE_UPVALUE]   = "upvalue",
+	[TYPE_FROZEN]    = "frozen",
+	[TYPE_ARRAY]     = "array"
+};
+static const char *typeName(size_t type) {
+	return type < TYPE_COUNT && typeNames[type] != NULL ? typeNames[type] : "?";
+}
+
+static void *grow(void *array, size_t *capacity, size_t count, size_t size) {
+	if (count == *capacity) {
+		*capacity = *capacity ? *capacity * 2 : 64;
+		array = realloc(array, *capacity * size);
+		if (array == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	return array;
+}
+
+static int readInt(FILE *file, uint64_t *out, int bytes) {
+	unsigned char in[8];
+	if (fread(in, 1, bytes, file) != (size_t)bytes) return 0;
+	*out = 0;
+	for (int i = 0; i < bytes; i++) {
+		*out |= (uint64_t)in[i] << (i * 8);
+	}
+	return 1;
+}
+static int readValue(FILE *file, value_t *out) {
+	uint64_t type;
+	if (!readInt(file, &type, 1) || !readInt(file, &out->payload, 8)) return 0;
+	out->type = (uint8_t)type;
+	return 1;
+}
+
+static int readSnapshot(FILE *file) {
+	char magic[sizeof(SNAPSHOT_MAGIC) - 1];
+	uint64_t version;
+	if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) ||
+		!readInt(file, &version, 1) || version != SNAPSHOT_VERSION) {
+		fprintf(stderr, "not a version %i heap snapshot\n", SNAPSHOT_VERSION);
+		return 0;
+	}
+	
+	nodes = grow(nodes, &nodeCapacity, numNodes, sizeof(node_t));
+	memset(&nodes[numNodes++], 0, sizeof(node_t));
+	
+	uint64_t record;
+	while (readInt(file, &record, 1)) {
+		uint64_t value;
+		switch (record) {
+			case SNAPSHOT_ROOT: {
+				roots = grow(roots, &rootCapacity, numRoots, sizeof(root_t));
+				root_t *root = &roots[numRoots++];
+				if (!readInt(file, &value, 1) || !readInt(file, &root->index, 8) || !readValue(file, &root->value)) return 0;
+				root->kind = (uint8_t)value;
+			} break;
+			
+			case SNAPSHOT_NODE: {
+				nodes = grow(nodes, &nodeCapacity, numNodes, sizeof(node_t));
+				node_t *node = &nodes[numNodes++];
+				memset(node, 0, sizeof(node_t));
+				uint64_t length;
+				if (!readInt(file, &node->id, 8) || !readInt(file, &value, 1) || !readInt(file, &node->size, 8) ||
+					!readInt(file, &length, 4) || length > SNAPSHOT_PREVIEW ||
+					fread(node->preview, 1, length, file) != length) return 0;
+				node->type = (uint8_t)value;
+			} break;
+			
+			case SNAPSHOT_EDGE: {
+				edges = grow(edges, &edgeCapacity, numEdges, sizeof(edge_t));
+				edge_t *edge = &edges[numEdges++];
+				if (!readInt(file, &edge->from, 8) || !readValue(file, &edge->key) || !readValue(file, &edge->value)) return 0;
+			} break;
+			
+			case SNAPSHOT_END:
+				return 1;
+			
+			default:
+				fprintf(stderr, "unknown record '%c'\n", (int)record);
+				return 0;
+		}
+	}
+	fprintf(stderr, "truncated snapshot\n");
+	return 0;
+}
+
+static inline size_t hashId(uint64_t id) {
+	id ^= id >> 33;
+	id *= 0xff51afd7ed558ccdULL;
+	id ^= id >> 33;
+	return (size_t)id & (lookupSize - 1);
+}
+static void buildLookup(void) {
+	lookupSize = 16;
+	while (lookupSize < numNodes * 2) lookupSize *= 2;
+	lookup = calloc(lookupSize, sizeof(size_t));
+	for (size_t i = 1; i < numNodes; i++) {
+		size_t slot = hashId(nodes[i].id);
+		while (lookup[slot] != 0) slot = (slot + 1) & (lookupSize - 1);
+		lookup[slot] = i;
+	}
+}
+//Returns 0 for values that aren't nodes
+static size_t findNode(const value_t *value) {
+	if (value->type < TYPE_STRING) return 0;
+	for (size_t slot = hashId(value->payload); lookup[slot] != 0; slot = (slot + 1) & (lookupSize - 1)) {
+		if (nodes[lookup[slot]].id == value->payload) return lookup[slot];
+	}
+	return 0;
+}
+
+//Successors of every node in compressed rows, same for predecessors
+static size_t *succStart, *succ;
+static size_t *predStart, *pred;
+
+//Counts the edge when the fill cursors are NULL, stores it otherwise
+static void link(size_t from, size_t to, size_t *succFill, size_t *predFill) {
+	if (to == 0) return;
+	if (succFill == NULL) {
+		succStart[from + 1]++;
+		predStart[to + 1]++;
+	} else {
+		succ[succFill[from]++] = to;
+		pred[predFill[to]++] = from;
+	}
+}
+static void buildGraph(void) {
+	succStart = calloc(numNodes + 1, sizeof(size_t));
+	predStart = calloc(numNodes + 1, sizeof(size_t));
+	size_t *succFill = NULL, *predFill = NULL;
+	
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			for (size_t i = 0; i < numNodes; i++) {
+				succStart[i + 1] += succStart[i];
+				predStart[i + 1] += predStart[i];
+			}
+			succ = malloc(sizeof(size_t) * (succStart[numNodes] + 1));
+			pred = malloc(sizeof(size_t) * (predStart[numNodes] + 1));
+			succFill = malloc(sizeof(size_t) * (numNodes + 1));
+			predFill = malloc(sizeof(size_t) * (numNodes + 1));
+			memcpy(succFill, succStart, sizeof(size_t) * (numNodes + 1));
+			memcpy(predFill, predStart, sizeof(size_t) * (numNodes + 1));
+		}
+		for (size_t i = 0; i < numRoots; i++) {
+			link(0, findNode(&roots[i].value), succFill, predFill);
+		}
+		for (size_t i = 0; i < numEdges; i++) {
+			value_t from = { TYPE_TABLE, edges[i].from };
+			size_t index = findNode(&from);
+			link(index, findNode(&edges[i].key), succFill, predFill);
+			link(index, findNode(&edges[i].value), succFill, predFill);
+		}
+	}
+	free(succFill);
+	free(predFill);
+}
+
+//Iterative depth first search numbering nodes in preorder from 1, unreached nodes keep 0
+static size_t *preorder;
+static size_t  numOrdered;
+static void numberNodes(void) {
+	size_t *stack = malloc(sizeof(size_t) * numNodes);
+	size_t *next  = malloc(sizeof(size_t) * numNodes);
+	preorder = malloc(sizeof(size_t) * (numNodes + 1));
+	
+	size_t top = 0;
+	stack[top++] = 0;
+	next[0] = succStart[0];
+	preorder[++numOrdered] = 0;
+	nodes[0].order = numOrdered;
+	while (top > 0) {
+		size_t node = stack[top - 1];
+		if (next[node] < succStart[node + 1]) {
+			size_t child = succ[next[node]++];
+			if (nodes[child].order == 0) {
+				preorder[++numOrdered] = child;
+				nodes[child].order  = numOrdered;
+				nodes[child].parent = node;
+				next[child] = succStart[child];
+				stack[top++] = child;
+			}
+		} else {
+			top--;
+		}
+	}
+	free(stack);
+	free(next);
+}
+
+//Lengauer and Tarjan, "A Fast Algorithm for Finding Dominators in a Flowgraph", the simple
+//version with path compression. Arrays are indexed by preorder number
+static size_t *semi, *ancestor, *best;
+
+//Returns the node with the smallest semidominator on the path up to the forest root
+static size_t eval(size_t v, size_t *path) {
+	if (ancestor[v] == 0) return v;
+	size_t count = 0;
+	for (size_t u = v; ancestor[ancestor[u]] != 0; u = ancestor[u]) {
+		path[count++] = u;
+	}
+	//Compress from the top of the path down
+	while (count-- > 0) {
+		size_t u = path[count];
+		if (semi[best[ancestor[u]]] < semi[best[u]]) best[u] = best[ancestor[u]];
+		ancestor[u] = ancestor[ancestor[u]];
+	}
+	return best[v];
+}
+static void computeDominators(void) {
+	size_t n = numOrdered + 1;
+	size_t *idom   = calloc(n, sizeof(size_t));
+	size_t *parent = calloc(n, sizeof(size_t));
+	size_t *bucket = calloc(n, sizeof(size_t)); //first node waiting on a semidominator
+	size_t *link   = calloc(n, sizeof(size_t)); //next node in the same bucket
+	size_t *path   = malloc(sizeof(size_t) * n);
+	semi     = malloc(sizeof(size_t) * n);
+	ancestor = calloc(n, sizeof(size_t));
+	best     = malloc(sizeof(size_t) * n);
+	for (size_t v = 1; v < n; v++) {
+		semi[v] = best[v] = v;
+		parent[v] = v > 1 ? nodes[nodes[preorder[v]].parent].order : 0;
+	}
+	
+	for (size_t w = n - 1; w > 1; w--) {
+		size_t node = preorder[w];
+		for (size_t p = predStart[node]; p < predStart[node + 1]; p++) {
+			size_t v = nodes[pred[p]].order;
+			if (v == 0) continue;
+			size_t u = eval(v, path);
+			if (semi[u] < semi[w]) semi[w] = semi[u];
+		}
+		link[w] = bucket[semi[w]];
+		bucket[semi[w]] = w;
+		ancestor[w] = parent[w];
+		
+		for (size_t v = bucket[parent[w]]; v != 0; v = link[v]) {
+			size_t u = eval(v, path);
+			idom[v] = semi[u] < semi[v] ? u : parent[w];
+		}
+		bucket[parent[w]] = 0;
+	}
+	for (size_t w = 2; w < n; w++) {
+		if (idom[w] != semi[w]) idom[w] = idom[idom[w]];
+		nodes[preorder[w]].idom = preorder[idom[w]];
+	}
+	
+	//Reverse preorder puts every node before its dominator
+	for (size_t v = n - 1; v > 0; v--) {
+		node_t *node = &nodes[preorder[v]];
+		node->retained += node->size;
+		if (v > 1) {
+			nodes[node->idom].retained += node->retained;
+		}
+	}
+	free(idom);
+	free(parent);
+	free(bucket);
+	free(link);
+	free(path);
+	free(semi);
+	free(ancestor);
+	free(best);
+}
+
+//Labels the edges nodes were first reached by, used to print paths
+static void labelNodes(void) {
+	for (size_t i = 0; i < numRoots; i++) {
+		size_t node = findNode(&roots[i].value);
+		if (node != 0 && nodes[node].parent == 0) {
+			nodes[node].label = (value_t){ roots[i].kind, roots[i].index };
+		}
+	}
+	for (size_t i = 0; i < numEdges; i++) {
+		value_t from = { TYPE_TABLE, edges[i].from };
+		size_t index = findNode(&from);
+		size_t node  = findNode(&edges[i].value);
+		if (node != 0 && nodes[node].parent == index) {
+			nodes[node].label = edges[i].key;
+		}
+	}
+}
+
+//Roots are labeled with their kind and index
+static void printRoot(size_t node) {
+	value_t *label = &nodes[node].label;
+	unsigned long long index = (unsigned long long)label->payload;
+	switch (label->type) {
+		case SNAPSHOT_ROOT_GLOBALS:   printf("globals"); break;
+		case SNAPSHOT_ROOT_STACK:     printf("stack[%llu]", index); break;
+		case SNAPSHOT_ROOT_COROUTINE: printf("coroutine %llu stack[%llu]", index >> 32, index & 0xffffffffu); break;
+		case SNAPSHOT_ROOT_TASK:      printf("task %llu %s", index >> 1, index & 1 ? "result" : "buffer"); break;
+		default:                      printf("root"); break;
+	}
+}
+static void printKey(size_t node) {
+	value_t *label = &nodes[node].label;
+	size_t key = findNode(label);
+	if (key != 0 && nodes[key].type == TYPE_STRING) {
+		printf(".%s", nodes[key].preview);
+	} else if (label->type == TYPE_INT) {
+		printf("[%lld]", (long long)label->payload);
+	} else if (label->type == TYPE_UNKNOWN) {
+		//Reached through a table key
+		printf("[key]");
+	} else {
+		printf("[%s]", typeName(label->type));
+	}
+}
+//Paths can be as long as the heap is deep, so they're gathered instead of recursing
+static void printPath(size_t node, size_t *path) {
+	size_t count = 0;
+	for (; nodes[node].parent != 0; node = nodes[node].parent) {
+		path[count++] = node;
+	}
+	printRoot(node);
+	while (count-- > 0) {
+		printKey(path[count]);
+	}
+}
+
+static int compareRetained(const void *a, const void *b) {
+	uint64_t x = nodes[*(const size_t*)a].retained;
+	uint64_t y = nodes[*(const size_t*)b].retained;
+	return (x < y) - (x > y);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <snapshot> [number of paths]\n", argv[0]);
+		return 1;
+	}
+	size_t numPaths = argc > 2 ? (size_t)atoi(argv[2]) : 20;
+	
+	FILE *file = fopen(argv[1], "rb");
+	if (file == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	int ok = readSnapshot(file);
+	fclose(file);
+	if (!ok) return 1;
+	
+	buildLookup();
+	buildGraph();
+	numberNodes();
+	computeDominators();
+	labelNodes();
+	
+	printf("%-10s %10s %14s\n", "type", "count", "bytes");
+	for (size_t type = TYPE_STRING; type < TYPE_COUNT; type++) {
+		uint64_t count = 0, bytes = 0;
+		for (size_t i = 1; i < numNodes; i++) {
+			if (nodes[i].type == type) {
+				count++;
+				bytes += nodes[i].size;
+			}
+		}
+		if (count > 0) {
+			printf("%-10s %10llu %14llu\n", typeName(type), (unsigned long long)count, (unsigned long long)bytes);
+		}
+	}
+	printf("%-10s %10llu %14llu\n\n", "total", (unsigned long long)(numNodes - 1), (unsigned long long)nodes[0].retained);
+	
+	size_t *sorted = malloc(sizeof(size_t) * numNodes);
+	for (size_t i = 0; i < numNodes - 1; i++) {
+		sorted[i] = i + 1;
+	}
+	qsort(sorted, numNodes - 1, sizeof(size_t), compareRetained);
+	size_t *path = malloc(sizeof(size_t) * numNodes);
+	
+	printf("%14s %14s  %-8s path\n", "retained", "self", "type");
+	for (size_t i = 0; i < numPaths && i < numNodes - 1; i++) {
+		node_t *node = &nodes[sorted[i]];
+		printf("%14llu %14llu  %-8s ", (unsigned long long)node->retained, (unsigned long long)node->size,
+			   typeName(node->type));
+		printPath(sorted[i], path);
+		printf("\n");
+	}
+	return 0;
+}